@@ -17,10 +17,15 @@
 /* #define DBC_BLIT_NO_SIMD // */
 /* #define DBC_BLIT_NO_RUNTIME_CPU_DETECTION // */
 /* #define DBC_BLIT_NO_GCC_ASM // */
+/* #define DBC_BLIT_NO_SSE41 // */
 /* #define DBC_BLIT_NO_AVX2 // */
+/* #define DBC_BLIT_NO_FMA // */
+/* #define DBC_BLIT_AUTOTUNE // */
+/* #define DBC_BLIT_STATS // */
 /* #define DBC_BLIT_UNROLL 0 // */
 /* #define dbcb_unroll_limit_for_mode(mode,modulated) 0 // */
 /* #define dbcb_allow_sse2_for_mode(mode,modulated) 0 // */
+/* #define dbcb_allow_sse41_for_mode(mode,modulated) 0 // */
 /* #define dbcb_allow_avx2_for_mode(mode,modulated) 0 // */
 
 /*
@@ -51,6 +56,81 @@ typedef unsigned long long u64 __attribute__((__may_alias__));
 #endif
 */
 
+/*
+// Example of trace hooks: test_trace() writes dbc_blit_trace.json
+// (Chrome trace-event format, open in chrome://tracing or Perfetto).
+#define CHECK_TRACE
+*/
+#ifdef CHECK_TRACE
+static void trace_begin(int mode,int w,int h,int tier);
+static void trace_end(void);
+#define dbcb_trace_begin(mode,w,h,tier) trace_begin(mode,w,h,tier)
+#define dbcb_trace_end()                trace_end()
+#endif
+
+/*
+// Sweep benchmark: test_sweep() writes dbc_blit_sweep.csv with ns/pixel
+// for each mode and tier over sprite widths, heights and misalignments
+// (one row per configuration, one column per width). Takes several
+// minutes. Rebuild with different DBC_BLIT_UNROLL to compare unrolling.
+#define CHECK_SWEEP
+*/
+/*
+// Multi-threaded scaling benchmark: test_threads() runs random blits
+// on 1..N threads (N defaults to the number of CPUs), both on separate
+// framebuffers and on disjoint bands of one framebuffer. Also
+// test_compositor() runs double-buffered command buffers, recorded on
+// one thread and executed on another. Requires POSIX threads (compile
+// with -pthread).
+#define CHECK_THREADS 0
+*/
+/*
+// Hardware counters: test_counters() reads cycles, instructions, cache
+// and branch misses, and backend stalls (via Linux perf_event_open())
+// around the 'Rand' benchmark, for each mode and tier. Counters that
+// are not available (see /proc/sys/kernel/perf_event_paranoid) are
+// shown as '-'.
+#define CHECK_PERF
+*/
+/*
+// Blit recording: test_record() records a few frames of blits (via
+// dbcb_record_blit()) into dbc_blit.trace, a compact binary trace, then
+// replays it against synthetic surfaces and reports time per frame.
+// Applications can record their own traces with record_open(),
+// record_frame() and record_close() from this file; define CHECK_REPLAY
+// as a file name to replay such a trace instead.
+#define CHECK_RECORD
+#define CHECK_REPLAY "game.trace"
+*/
+#ifdef CHECK_RECORD
+static void record_blit(
+    int src_w,int src_h,int src_stride,const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,const unsigned char *dst_pixels,
+    int x,int y,const float *color,int mode);
+#define dbcb_record_blit(src_w,src_h,src_stride,src_pixels,dst_w,dst_h,dst_stride,dst_pixels,x,y,color,mode) \
+    record_blit(src_w,src_h,src_stride,src_pixels,dst_w,dst_h,dst_stride,dst_pixels,x,y,color,mode)
+#endif
+/*
+// Kernel microbenchmarks: test_kernels() runs each kernel from
+// test_ops() in isolation on L1-resident data, and prints cycles
+// (rdtsc, where available) per pixel, for each kernel width.
+#define CHECK_KERNELS
+*/
+#if defined(CHECK_PERF) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* For syscall(). */
+#endif
+#if (defined(CHECK_THREADS) || defined(CHECK_TRACE)) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L /* For clock_gettime(), sysconf(). */
+#endif
+
+#if defined(CHECK_SWEEP) || defined(CHECK_PERF)
+/* Highest allowed tier: 1 - C, 2 - SSE2, 3 - SSE4.1, 4 - AVX2. */
+static int bench_tier=4;
+#define dbcb_allow_sse2_for_mode(mode,modulated)  (bench_tier>=2)
+#define dbcb_allow_sse41_for_mode(mode,modulated) (bench_tier>=3)
+#define dbcb_allow_avx2_for_mode(mode,modulated)  (bench_tier>=4)
+#endif
+
 #include "dbc_blit.h"
 
 #include <stdint.h>
@@ -86,7 +166,7 @@ static int online_compiler=1;
 static int online_compiler=0;
 #endif
 
-static unsigned char buffer[W*H*4];
+static unsigned char buffer[W*H*8];
 static unsigned char sprite[10*1024*1024*4];
 
 #if 0
@@ -186,10 +266,35 @@ static int mode_pixel_size(int mode)
         case DBCB_MODE_COLORKEY16 :
         case DBCB_MODE_5551       :
             return 2;
+#ifndef DBC_BLIT_NO_GAMMA
+        case DBCB_MODE_HALF_ALPHA :
+        case DBCB_MODE_HALF_PMA   :
+        case DBCB_MODE_HALF_MUL   :
+            return 8;
+        case DBCB_MODE_HALF_RESOLVE:
+            return 4;
+#endif
     }
     return 0;
 }
 
+/* Same as mode_pixel_size(), but for src (differs for half-float modes). */
+static int mode_src_pixel_size(int mode)
+{
+    switch(mode)
+    {
+#ifndef DBC_BLIT_NO_GAMMA
+        case DBCB_MODE_HALF_ALPHA :
+        case DBCB_MODE_HALF_PMA   :
+        case DBCB_MODE_HALF_MUL   :
+            return 4;
+        case DBCB_MODE_HALF_RESOLVE:
+            return 8;
+#endif
+    }
+    return mode_pixel_size(mode);
+}
+
 #ifndef DBC_BLIT_NO_GAMMA
 static void test_gamma()
 {
@@ -317,6 +422,81 @@ static void test_gamma()
 }
 #endif /* DBC_BLIT_NO_GAMMA */
 
+#ifdef CHECK_KERNELS
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define BENCH_TICKS() ((double)__rdtsc())
+#define BENCH_UNIT "TSC cycles"
+#define BENCH_REPEATS 16
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define BENCH_TICKS() ((double)__builtin_ia32_rdtsc())
+#define BENCH_UNIT "TSC cycles"
+#define BENCH_REPEATS 16
+#else
+#define BENCH_TICKS() (1.0e+9*(double)clock()/CLOCKS_PER_SEC)
+#define BENCH_UNIT "ns"
+#define BENCH_REPEATS 1024
+#endif
+
+/* If set, test_op() measures op instead of printing its results. */
+static int ops_bench;
+static double ops_bench_overhead;
+
+static void bench_nop(const dbcb_uint8 *src,dbcb_uint8 *dst) {(void)src;(void)dst;}
+
+/*
+    Best (over several trials) ticks per call of op, applied to
+    L1-resident src and dst (4 KiB each) of random bytes, or, if white,
+    src of all-0xFF bytes (opaque for blends, identity for MUL).
+*/
+static double bench_calls(int mode,uintptr_t op,const float *color,int op_bytes,int white)
+{
+    static unsigned char s[4096],d[4096],d0[4096],sw[4096];
+    const unsigned char *src=(white?sw:s);
+    static int initialized=0;
+    void (*op_data)(const dbcb_uint8*,dbcb_uint8*)=(void (*)(const dbcb_uint8*,dbcb_uint8*))op;
+    void (*op_color)(const dbcb_uint8*,dbcb_uint8*,const float*)=(void (*)(const dbcb_uint8*,dbcb_uint8*,const float*))op;
+    void (*op_key8)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint8)=(void (*)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint8))op;
+    void (*op_key16)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint16)=(void (*)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint16))op;
+    int calls=4096/op_bytes;
+    double t,best=-1.0;
+    int trial,r,i;
+    if(!initialized)
+    {
+        RNG rng;
+        RNG_init(&rng,1);
+        for(i=0;i<4096;++i) s[i]=(unsigned char)RNG_generate(&rng),d0[i]=(unsigned char)RNG_generate(&rng);
+        memset(sw,0xFF,sizeof(sw));
+        initialized=1;
+    }
+    for(trial=0;trial<16;++trial)
+    {
+        memcpy(d,d0,sizeof(d));
+        t=BENCH_TICKS();
+        for(r=0;r<BENCH_REPEATS;++r)
+            switch(mode)
+            {
+                case 0: for(i=0;i<calls;++i) op_data(src+op_bytes*i,d+op_bytes*i); break;
+                case 1: for(i=0;i<calls;++i) op_color(src+op_bytes*i,d+op_bytes*i,color); break;
+                case 2: for(i=0;i<calls;++i) op_key8(src+op_bytes*i,d+op_bytes*i,(dbcb_uint8)(dbcb_uint32)color[0]); break;
+                case 3: for(i=0;i<calls;++i) op_key16(src+op_bytes*i,d+op_bytes*i,(dbcb_uint16)(dbcb_uint32)color[0]); break;
+                default: return 0.0;
+            }
+        t=(BENCH_TICKS()-t)/((double)calls*BENCH_REPEATS);
+        if(best<0.0||t<best) best=t;
+    }
+    return best;
+}
+
+static void bench_op(int mode,uintptr_t op,const float *color,int pixel_bytes,int op_pixels,const char *comment)
+{
+    double t=bench_calls(mode,op,color,pixel_bytes*op_pixels,0)-ops_bench_overhead;
+    double u=bench_calls(mode,op,color,pixel_bytes*op_pixels,1)-ops_bench_overhead;
+    printf("%-10s%7.2f%7.2f\n",comment,(t>0.0?t:0.0)/(double)op_pixels,(u>0.0?u:0.0)/(double)op_pixels);
+    fflush(stdout);
+}
+#endif /* CHECK_KERNELS */
+
 /*
     Some versions of GCC claim that "ISO C forbids conversion of function pointer to object pointer type".
     So, uintptr_t.
@@ -332,6 +512,9 @@ static void test_op(int mode,uintptr_t op,const float *color,int pixel_bytes,int
     void (*op_color)(const dbcb_uint8*,dbcb_uint8*,const float*)=(void (*)(const dbcb_uint8*,dbcb_uint8*,const float*))op;
     void (*op_key8)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint8)=(void (*)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint8))op;
     void (*op_key16)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint16)=(void (*)(const dbcb_uint8*,dbcb_uint8*,dbcb_uint16))op;
+#ifdef CHECK_KERNELS
+    if(ops_bench) {bench_op(mode,op,color,pixel_bytes,op_pixels,comment);return;}
+#endif
     RNG_init(&rng,seed);
     for(i=0;i<64;++i)
     {
@@ -458,9 +641,35 @@ WRAPPER(1,dbcB_bgpm_1_sse2)
 WRAPPER(0,dbcB_bgx_1_sse2)
 WRAPPER(1,dbcB_bgxm_1_sse2)
 #endif /* DBC_BLIT_NO_GAMMA */
+#ifndef DBC_BLIT_NO_SSE41
+WRAPPER(0,dbcB_bla_1_sse41)
+WRAPPER(0,dbcB_bla_2_sse41)
+WRAPPER(0,dbcB_bla_4_sse41)
+WRAPPER(0,dbcB_blp_1_sse41)
+WRAPPER(0,dbcB_blp_2_sse41)
+WRAPPER(0,dbcB_blp_4_sse41)
+WRAPPER(2,dbcB_b8m_4_sse41)
+WRAPPER(2,dbcB_b8m_8_sse41)
+WRAPPER(2,dbcB_b8m_16_sse41)
+WRAPPER(3,dbcB_b16m_2_sse41)
+WRAPPER(3,dbcB_b16m_4_sse41)
+WRAPPER(3,dbcB_b16m_8_sse41)
+WRAPPER(0,dbcB_b5551_2_sse41)
+WRAPPER(0,dbcB_b5551_4_sse41)
+WRAPPER(0,dbcB_b5551_8_sse41)
+WRAPPER(2,dbcB_b32t_2_sse41)
+WRAPPER(2,dbcB_b32t_4_sse41)
+WRAPPER(0,dbcB_b32s_2_sse41)
+WRAPPER(0,dbcB_b32s_4_sse41)
+WRAPPER(0,dbcB_blx_1_sse41)
+WRAPPER(0,dbcB_blx_2_sse41)
+WRAPPER(0,dbcB_blx_4_sse41)
+#endif /* DBC_BLIT_NO_SSE41 */
 #ifndef DBC_BLIT_NO_AVX2
 WRAPPER(1,dbcB_b32m_1_avx2)
 WRAPPER(1,dbcB_b32m_2_avx2)
+WRAPPER(1,dbcB_b32m_4_avx2)
+WRAPPER(1,dbcB_b32m_8_avx2)
 WRAPPER(0,dbcB_bla_1_avx2)
 WRAPPER(0,dbcB_bla_2_avx2)
 WRAPPER(0,dbcB_bla_4_avx2)
@@ -471,8 +680,12 @@ WRAPPER(0,dbcB_blp_4_avx2)
 WRAPPER(0,dbcB_blp_8_avx2)
 WRAPPER(1,dbcB_blam_1_avx2)
 WRAPPER(1,dbcB_blam_2_avx2)
+WRAPPER(1,dbcB_blam_4_avx2)
+WRAPPER(1,dbcB_blam_8_avx2)
 WRAPPER(1,dbcB_blpm_1_avx2)
 WRAPPER(1,dbcB_blpm_2_avx2)
+WRAPPER(1,dbcB_blpm_4_avx2)
+WRAPPER(1,dbcB_blpm_8_avx2)
 WRAPPER(2,dbcB_b8m_4_avx2)
 WRAPPER(2,dbcB_b8m_8_avx2)
 WRAPPER(2,dbcB_b8m_16_avx2)
@@ -497,6 +710,8 @@ WRAPPER(0,dbcB_blx_4_avx2)
 WRAPPER(0,dbcB_blx_8_avx2)
 WRAPPER(1,dbcB_blxm_1_avx2)
 WRAPPER(1,dbcB_blxm_2_avx2)
+WRAPPER(1,dbcB_blxm_4_avx2)
+WRAPPER(1,dbcB_blxm_8_avx2)
 #ifndef DBC_BLIT_NO_GAMMA
 WRAPPER(1,dbcB_b32g_1_avx2)
 WRAPPER(1,dbcB_b32g_2_avx2)
@@ -512,6 +727,40 @@ WRAPPER(0,dbcB_bgx_1_avx2)
 WRAPPER(0,dbcB_bgx_2_avx2)
 WRAPPER(1,dbcB_bgxm_1_avx2)
 WRAPPER(1,dbcB_bgxm_2_avx2)
+#ifdef DBCB_GAMMA_FMA
+WRAPPER(0,dbcB_bga_1_fma)
+WRAPPER(0,dbcB_bga_2_fma)
+WRAPPER(0,dbcB_bga_4_fma)
+WRAPPER(0,dbcB_bga_8_fma)
+WRAPPER(1,dbcB_bgam_1_fma)
+WRAPPER(1,dbcB_bgam_2_fma)
+WRAPPER(1,dbcB_bgam_4_fma)
+WRAPPER(1,dbcB_bgam_8_fma)
+WRAPPER(0,dbcB_bgp_1_fma)
+WRAPPER(0,dbcB_bgp_2_fma)
+WRAPPER(0,dbcB_bgp_4_fma)
+WRAPPER(0,dbcB_bgp_8_fma)
+WRAPPER(1,dbcB_bgpm_1_fma)
+WRAPPER(1,dbcB_bgpm_2_fma)
+WRAPPER(1,dbcB_bgpm_4_fma)
+WRAPPER(1,dbcB_bgpm_8_fma)
+WRAPPER(0,dbcB_bgx_1_fma)
+WRAPPER(0,dbcB_bgx_2_fma)
+WRAPPER(0,dbcB_bgx_4_fma)
+WRAPPER(0,dbcB_bgx_8_fma)
+WRAPPER(1,dbcB_bgxm_1_fma)
+WRAPPER(1,dbcB_bgxm_2_fma)
+WRAPPER(1,dbcB_bgxm_4_fma)
+WRAPPER(1,dbcB_bgxm_8_fma)
+#endif
+WRAPPER(0,dbcB_bha_2_f16c)
+WRAPPER(1,dbcB_bham_2_f16c)
+WRAPPER(0,dbcB_bhp_2_f16c)
+WRAPPER(1,dbcB_bhpm_2_f16c)
+WRAPPER(0,dbcB_bhx_2_f16c)
+WRAPPER(1,dbcB_bhxm_2_f16c)
+WRAPPER(0,dbcB_bhr_2_f16c)
+WRAPPER(1,dbcB_bhrm_2_f16c)
 #endif /* DBC_BLIT_NO_GAMMA */
 #endif /* DBC_BLIT_NO_AVX2 */
 #endif /* DBCB_X86_OR_X64 */
@@ -537,12 +786,24 @@ WRAPPER(1,dbcB_bgxm_2_avx2)
 #define IF_SSE2(x) ((void)0)
 #endif
 
+#if !defined(DBC_BLIT_NO_SIMD) && !defined(DBC_BLIT_NO_SSE41)
+#define IF_SSE41(x) (dbcB_has_sse41?(x):((void)0))
+#else
+#define IF_SSE41(x) ((void)0)
+#endif
+
 #if !defined(DBC_BLIT_NO_SIMD) && !defined(DBC_BLIT_NO_AVX2)
 #define IF_AVX2(x) (dbcB_has_avx2?(x):((void)0))
 #else
 #define IF_AVX2(x) ((void)0)
 #endif
 
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_GAMMA_FMA)
+#define IF_FMA(x) (dbcB_has_avx2&&dbcB_has_fma?(x):((void)0))
+#else
+#define IF_FMA(x) ((void)0)
+#endif
+
 static void test_ops()
 {
     float color[4]={0.5f,0.5f,0.25f,1.0f};
@@ -550,6 +811,9 @@ static void test_ops()
     float key[4]={(float)0x44A1u,0.0f,0.0f,0.0f};
 #else
     float key[4]={(float)0xA144u,0.0f,0.0f,0.0f};
+#endif
+#ifdef CHECK_KERNELS
+    if(!ops_bench)
 #endif
     printf("Testing operations.\n");
                printf("dbcB_b32m_*:\n");
@@ -557,11 +821,16 @@ static void test_ops()
     IF_SSE2((TEST_OP(1,dbcB_b32m_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_b32m_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_b32m_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_b32m_4_avx2  ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_b32m_8_avx2  ,color,4, 8,64,32,1,0,4,"|"," 8_avx2")));
                printf("dbcB_bla_*:\n");
              TEST_OP(0,dbcB_bla_1_c      ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(0,dbcB_bla_1_sse2   ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_bla_2_sse2   ,color,4, 2,64,32,1,0,4,"|"," 2_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_bla_4_sse2   ,color,4, 4,64,32,1,0,4,"|"," 4_sse2")));
+    IF_SSE41((TEST_OP(0,dbcB_bla_1_sse41  ,color,4, 1,64,32,1,0,4,"|"," 1_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_bla_2_sse41  ,color,4, 2,64,32,1,0,4,"|"," 2_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_bla_4_sse41  ,color,4, 4,64,32,1,0,4,"|"," 4_sse41")));
     IF_AVX2((TEST_OP(0,dbcB_bla_1_avx2   ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_bla_2_avx2   ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_bla_4_avx2   ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
@@ -571,6 +840,9 @@ static void test_ops()
     IF_SSE2((TEST_OP(0,dbcB_blp_1_sse2   ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_blp_2_sse2   ,color,4, 2,64,32,1,0,4,"|"," 2_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_blp_4_sse2   ,color,4, 4,64,32,1,0,4,"|"," 4_sse2")));
+    IF_SSE41((TEST_OP(0,dbcB_blp_1_sse41  ,color,4, 1,64,32,1,0,4,"|"," 1_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_blp_2_sse41  ,color,4, 2,64,32,1,0,4,"|"," 2_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_blp_4_sse41  ,color,4, 4,64,32,1,0,4,"|"," 4_sse41")));
     IF_AVX2((TEST_OP(0,dbcB_blp_1_avx2   ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_blp_2_avx2   ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_blp_4_avx2   ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
@@ -580,11 +852,15 @@ static void test_ops()
     IF_SSE2((TEST_OP(1,dbcB_blam_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_blam_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_blam_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_blam_4_avx2  ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_blam_8_avx2  ,color,4, 8,64,32,1,0,4,"|"," 8_avx2")));
                printf("dbcB_blpm_*:\n");
              TEST_OP(1,dbcB_blpm_1_c     ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(1,dbcB_blpm_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_blpm_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_blpm_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_blpm_4_avx2  ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_blpm_8_avx2  ,color,4, 8,64,32,1,0,4,"|"," 8_avx2")));
                printf("dbcB_b8m_*:\n");
              TEST_OP(2,dbcB_b8m_1_c      ,key  ,1, 1, 4,32,1,0,7,""," 1_c");
              TEST_OP(2,dbcB_b8m_2_c      ,key  ,1, 2, 4,32,1,0,4,""," 2_c");
@@ -593,6 +869,9 @@ static void test_ops()
     IF_SSE2((TEST_OP(2,dbcB_b8m_4_sse2   ,key  ,1, 4, 4,32,1,0,4,""," 4_sse2")));
     IF_SSE2((TEST_OP(2,dbcB_b8m_8_sse2   ,key  ,1, 8, 4,32,1,0,4,""," 8_sse2")));
     IF_SSE2((TEST_OP(2,dbcB_b8m_16_sse2  ,key  ,1,16, 4,32,1,0,4,""," 16_sse2")));
+    IF_SSE41((TEST_OP(2,dbcB_b8m_4_sse41  ,key  ,1, 4, 4,32,1,0,4,""," 4_sse41")));
+    IF_SSE41((TEST_OP(2,dbcB_b8m_8_sse41  ,key  ,1, 8, 4,32,1,0,4,""," 8_sse41")));
+    IF_SSE41((TEST_OP(2,dbcB_b8m_16_sse41 ,key  ,1,16, 4,32,1,0,4,""," 16_sse41")));
     IF_AVX2((TEST_OP(2,dbcB_b8m_4_avx2   ,key  ,1, 4, 4,32,1,0,4,""," 4_avx2")));
     IF_AVX2((TEST_OP(2,dbcB_b8m_8_avx2   ,key  ,1, 8, 4,32,1,0,4,""," 8_avx2")));
     IF_AVX2((TEST_OP(2,dbcB_b8m_16_avx2  ,key  ,1,16, 4,32,1,0,4,""," 16_avx2")));
@@ -604,6 +883,9 @@ static void test_ops()
     IF_SSE2((TEST_OP(3,dbcB_b16m_2_sse2  ,key  ,2, 2, 4,32,1,0,4,""," 2_sse2")));
     IF_SSE2((TEST_OP(3,dbcB_b16m_4_sse2  ,key  ,2, 4, 4,32,1,0,4,""," 4_sse2")));
     IF_SSE2((TEST_OP(3,dbcB_b16m_8_sse2  ,key  ,2, 8, 4,32,1,0,4,""," 8_sse2")));
+    IF_SSE41((TEST_OP(3,dbcB_b16m_2_sse41 ,key  ,2, 2, 4,32,1,0,4,""," 2_sse41")));
+    IF_SSE41((TEST_OP(3,dbcB_b16m_4_sse41 ,key  ,2, 4, 4,32,1,0,4,""," 4_sse41")));
+    IF_SSE41((TEST_OP(3,dbcB_b16m_8_sse41 ,key  ,2, 8, 4,32,1,0,4,""," 8_sse41")));
     IF_AVX2((TEST_OP(3,dbcB_b16m_2_avx2  ,key  ,2, 2, 4,32,1,0,4,""," 2_avx2")));
     IF_AVX2((TEST_OP(3,dbcB_b16m_4_avx2  ,key  ,2, 4, 4,32,1,0,4,""," 4_avx2")));
     IF_AVX2((TEST_OP(3,dbcB_b16m_8_avx2  ,key  ,2, 8, 4,32,1,0,4,""," 8_avx2")));
@@ -615,6 +897,9 @@ static void test_ops()
     IF_SSE2((TEST_OP(0,dbcB_b5551_2_sse2 ,key  ,2, 2, 4,32,1,0,4,""," 2_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_b5551_4_sse2 ,key  ,2, 4, 4,32,1,0,4,""," 4_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_b5551_8_sse2 ,key  ,2, 8, 4,32,1,0,4,""," 8_sse2")));
+    IF_SSE41((TEST_OP(0,dbcB_b5551_2_sse41,key  ,2, 2, 4,32,1,0,4,""," 2_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_b5551_4_sse41,key  ,2, 4, 4,32,1,0,4,""," 4_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_b5551_8_sse41,key  ,2, 8, 4,32,1,0,4,""," 8_sse41")));
     IF_AVX2((TEST_OP(0,dbcB_b5551_2_avx2 ,key  ,2, 2, 4,32,1,0,4,""," 2_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_b5551_4_avx2 ,key  ,2, 4, 4,32,1,0,4,""," 4_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_b5551_8_avx2 ,key  ,2, 8, 4,32,1,0,4,""," 8_avx2")));
@@ -624,6 +909,9 @@ static void test_ops()
     IF_SSE2((TEST_OP(0,dbcB_blx_1_sse2   ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_blx_2_sse2   ,color,4, 2,64,32,1,0,4,"|"," 2_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_blx_4_sse2   ,color,4, 4,64,32,1,0,4,"|"," 4_sse2")));
+    IF_SSE41((TEST_OP(0,dbcB_blx_1_sse41  ,color,4, 1,64,32,1,0,4,"|"," 1_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_blx_2_sse41  ,color,4, 2,64,32,1,0,4,"|"," 2_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_blx_4_sse41  ,color,4, 4,64,32,1,0,4,"|"," 4_sse41")));
     IF_AVX2((TEST_OP(0,dbcB_blx_1_avx2   ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_blx_2_avx2   ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_blx_4_avx2   ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
@@ -633,12 +921,16 @@ static void test_ops()
     IF_SSE2((TEST_OP(1,dbcB_blxm_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_blxm_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_blxm_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_blxm_4_avx2  ,color,4, 4,64,32,1,0,4,"|"," 4_avx2")));
+    IF_AVX2((TEST_OP(1,dbcB_blxm_8_avx2  ,color,4, 8,64,32,1,0,4,"|"," 8_avx2")));
                printf("dbcB_b32t_*:\n");
              TEST_OP(2,dbcB_b32t_1_c     ,key  ,4, 1,64,32,1,0,7,"|"," 1_c");
              TEST_OP(2,dbcB_b32t_2_c     ,key  ,4, 2,64,32,1,0,4,"|"," 1_c");
              TEST_OP(2,dbcB_b32t_4_c     ,key  ,4, 4,64,32,1,0,4,"|"," 1_c");
     IF_SSE2((TEST_OP(2,dbcB_b32t_2_sse2  ,key  ,4, 2,64,32,1,0,4,"|"," 2_sse2")));
     IF_SSE2((TEST_OP(2,dbcB_b32t_4_sse2  ,key  ,4, 4,64,32,1,0,4,"|"," 4_sse2")));
+    IF_SSE41((TEST_OP(2,dbcB_b32t_2_sse41 ,key  ,4, 2,64,32,1,0,4,"|"," 2_sse41")));
+    IF_SSE41((TEST_OP(2,dbcB_b32t_4_sse41 ,key  ,4, 4,64,32,1,0,4,"|"," 4_sse41")));
     IF_AVX2((TEST_OP(2,dbcB_b32t_2_avx2  ,key  ,4, 2,64,32,1,0,4,"|"," 2_avx2")));
     IF_AVX2((TEST_OP(2,dbcB_b32t_4_avx2  ,key  ,4, 4,64,32,1,0,4,"|"," 4_avx2")));
     IF_AVX2((TEST_OP(2,dbcB_b32t_8_avx2  ,key  ,4, 8,64,32,1,0,4,"|"," 8_avx2")));
@@ -648,6 +940,8 @@ static void test_ops()
              TEST_OP(0,dbcB_b32s_4_c     ,key  ,4, 4,64,32,1,0,4,"|"," 1_c");
     IF_SSE2((TEST_OP(0,dbcB_b32s_2_sse2  ,key  ,4, 2,64,32,1,0,4,"|"," 2_sse2")));
     IF_SSE2((TEST_OP(0,dbcB_b32s_4_sse2  ,key  ,4, 4,64,32,1,0,4,"|"," 4_sse2")));
+    IF_SSE41((TEST_OP(0,dbcB_b32s_2_sse41 ,key  ,4, 2,64,32,1,0,4,"|"," 2_sse41")));
+    IF_SSE41((TEST_OP(0,dbcB_b32s_4_sse41 ,key  ,4, 4,64,32,1,0,4,"|"," 4_sse41")));
     IF_AVX2((TEST_OP(0,dbcB_b32s_2_avx2  ,key  ,4, 2,64,32,1,0,4,"|"," 2_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_b32s_4_avx2  ,key  ,4, 4,64,32,1,0,4,"|"," 4_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_b32s_8_avx2  ,key  ,4, 8,64,32,1,0,4,"|"," 8_avx2")));
@@ -662,39 +956,338 @@ static void test_ops()
     IF_SSE2((TEST_OP(0,dbcB_bga_1_sse2   ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(0,dbcB_bga_1_avx2   ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_bga_2_avx2   ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_FMA ((TEST_OP(0,dbcB_bga_1_fma    ,color,4, 1,64,32,1,0,4,"|"," 1_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bga_2_fma    ,color,4, 2,64,32,1,0,4,"|"," 2_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bga_4_fma    ,color,4, 4,64,32,1,0,4,"|"," 4_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bga_8_fma    ,color,4, 8,64,32,1,0,4,"|"," 8_fma")));
                printf("dbcB_bgam_*:\n");
              TEST_OP(1,dbcB_bgam_1_c     ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(1,dbcB_bgam_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_bgam_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_bgam_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_FMA ((TEST_OP(1,dbcB_bgam_1_fma   ,color,4, 1,64,32,1,0,4,"|"," 1_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgam_2_fma   ,color,4, 2,64,32,1,0,4,"|"," 2_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgam_4_fma   ,color,4, 4,64,32,1,0,4,"|"," 4_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgam_8_fma   ,color,4, 8,64,32,1,0,4,"|"," 8_fma")));
                printf("dbcB_bgp_*:\n");
              TEST_OP(0,dbcB_bgp_1_c      ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(0,dbcB_bgp_1_sse2   ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(0,dbcB_bgp_1_avx2   ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_bgp_2_avx2   ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_FMA ((TEST_OP(0,dbcB_bgp_1_fma    ,color,4, 1,64,32,1,0,4,"|"," 1_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bgp_2_fma    ,color,4, 2,64,32,1,0,4,"|"," 2_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bgp_4_fma    ,color,4, 4,64,32,1,0,4,"|"," 4_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bgp_8_fma    ,color,4, 8,64,32,1,0,4,"|"," 8_fma")));
                printf("dbcB_bgpm_*:\n");
              TEST_OP(1,dbcB_bgpm_1_c     ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(1,dbcB_bgpm_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_bgpm_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_bgpm_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_FMA ((TEST_OP(1,dbcB_bgpm_1_fma   ,color,4, 1,64,32,1,0,4,"|"," 1_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgpm_2_fma   ,color,4, 2,64,32,1,0,4,"|"," 2_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgpm_4_fma   ,color,4, 4,64,32,1,0,4,"|"," 4_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgpm_8_fma   ,color,4, 8,64,32,1,0,4,"|"," 8_fma")));
                printf("dbcB_bgx_*:\n");
              TEST_OP(0,dbcB_bgx_1_c      ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(0,dbcB_bgx_1_sse2   ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(0,dbcB_bgx_1_avx2   ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(0,dbcB_bgx_2_avx2   ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_FMA ((TEST_OP(0,dbcB_bgx_1_fma    ,color,4, 1,64,32,1,0,4,"|"," 1_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bgx_2_fma    ,color,4, 2,64,32,1,0,4,"|"," 2_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bgx_4_fma    ,color,4, 4,64,32,1,0,4,"|"," 4_fma")));
+    IF_FMA ((TEST_OP(0,dbcB_bgx_8_fma    ,color,4, 8,64,32,1,0,4,"|"," 8_fma")));
                printf("dbcB_bgxm_*:\n");
              TEST_OP(1,dbcB_bgxm_1_c     ,color,4, 1,64,32,1,0,7,"|"," 1_c");
     IF_SSE2((TEST_OP(1,dbcB_bgxm_1_sse2  ,color,4, 1,64,32,1,0,4,"|"," 1_sse2")));
     IF_AVX2((TEST_OP(1,dbcB_bgxm_1_avx2  ,color,4, 1,64,32,1,0,4,"|"," 1_avx2")));
     IF_AVX2((TEST_OP(1,dbcB_bgxm_2_avx2  ,color,4, 2,64,32,1,0,4,"|"," 2_avx2")));
+    IF_FMA ((TEST_OP(1,dbcB_bgxm_1_fma   ,color,4, 1,64,32,1,0,4,"|"," 1_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgxm_2_fma   ,color,4, 2,64,32,1,0,4,"|"," 2_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgxm_4_fma   ,color,4, 4,64,32,1,0,4,"|"," 4_fma")));
+    IF_FMA ((TEST_OP(1,dbcB_bgxm_8_fma   ,color,4, 8,64,32,1,0,4,"|"," 8_fma")));
+#endif /* DBC_BLIT_NO_GAMMA */
+    printf("\n");
+}
+
+
+/* Applies op (n pixels at a time) and 1-pixel ref to 8 pixels of src over random dst. */
+static void check_uniform(int *bad,void (*op)(const dbcb_uint8*,dbcb_uint8*),int n,void (*ref)(const dbcb_uint8*,dbcb_uint8*),const unsigned char *src,dbcb_uint32 seed)
+{
+    unsigned char d[32],t[32];
+    RNG rng;
+    int i;
+    RNG_init(&rng,seed);
+    for(i=0;i<32;++i) d[i]=t[i]=(unsigned char)RNG_generate(&rng);
+    for(i=0;i<8;i+=n) op(src+4*i,d+4*i);
+    for(i=0;i<8;++i) ref(src+4*i,t+4*i);
+    if(memcmp(d,t,32)) ++*bad;
+}
+
+/*
+    Uniform src blocks: fully transparent (alpha 0, and all-zero for PMA),
+    fully opaque, and white (identity for MUL), which take block-level
+    early-outs in SIMD blends. Results must match the 1-pixel C versions.
+*/
+static void test_early_outs()
+{
+    static const char *tiers[5]={"C","SSE2","SSE4.1","AVX2","FMA"};
+    unsigned char src[4][32];
+    int bad[5]={0,0,0,0,0},ran[5]={0,0,0,0,0};
+    RNG rng;
+    int i,k;
+    printf("Testing uniform blocks.\n");
+    RNG_init(&rng,1);
+    for(i=0;i<32;++i)
+    {
+        unsigned char r=(unsigned char)RNG_generate(&rng);
+#ifdef DBC_BLIT_DATA_BIG_ENDIAN
+        int alpha=(i%4==0);
+#else
+        int alpha=(i%4==3);
+#endif
+        src[0][i]=(unsigned char)(alpha?0:r);
+        src[1][i]=0;
+        src[2][i]=(unsigned char)(alpha?255:r);
+        src[3][i]=255;
+    }
+#define EARLY(t,f,n,ref) (ran[t]=1,check_uniform(bad+t,wrapper_##f,n,wrapper_##ref,src[k],(dbcb_uint32)(k+1)))
+    for(k=0;k<4;++k)
+    {
+                   EARLY(0,dbcB_bla_1_c    ,1,dbcB_bla_1_c);
+                   EARLY(0,dbcB_blp_1_c    ,1,dbcB_blp_1_c);
+                   EARLY(0,dbcB_blx_1_c    ,1,dbcB_blx_1_c);
+        IF_SSE2 ((EARLY(1,dbcB_bla_4_sse2 ,4,dbcB_bla_1_c)));
+        IF_SSE2 ((EARLY(1,dbcB_blp_4_sse2 ,4,dbcB_blp_1_c)));
+        IF_SSE2 ((EARLY(1,dbcB_blx_4_sse2 ,4,dbcB_blx_1_c)));
+        IF_SSE41((EARLY(2,dbcB_bla_4_sse41,4,dbcB_bla_1_c)));
+        IF_SSE41((EARLY(2,dbcB_blp_4_sse41,4,dbcB_blp_1_c)));
+        IF_SSE41((EARLY(2,dbcB_blx_4_sse41,4,dbcB_blx_1_c)));
+        IF_AVX2 ((EARLY(3,dbcB_bla_4_avx2 ,4,dbcB_bla_1_c)));
+        IF_AVX2 ((EARLY(3,dbcB_bla_8_avx2 ,8,dbcB_bla_1_c)));
+        IF_AVX2 ((EARLY(3,dbcB_blp_4_avx2 ,4,dbcB_blp_1_c)));
+        IF_AVX2 ((EARLY(3,dbcB_blp_8_avx2 ,8,dbcB_blp_1_c)));
+        IF_AVX2 ((EARLY(3,dbcB_blx_4_avx2 ,4,dbcB_blx_1_c)));
+        IF_AVX2 ((EARLY(3,dbcB_blx_8_avx2 ,8,dbcB_blx_1_c)));
+#ifndef DBC_BLIT_NO_GAMMA
+        IF_FMA  ((EARLY(4,dbcB_bga_1_fma  ,1,dbcB_bga_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bga_2_fma  ,2,dbcB_bga_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bga_4_fma  ,4,dbcB_bga_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bga_8_fma  ,8,dbcB_bga_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgp_1_fma  ,1,dbcB_bgp_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgp_2_fma  ,2,dbcB_bgp_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgp_4_fma  ,4,dbcB_bgp_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgp_8_fma  ,8,dbcB_bgp_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgx_1_fma  ,1,dbcB_bgx_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgx_2_fma  ,2,dbcB_bgx_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgx_4_fma  ,4,dbcB_bgx_1_c)));
+        IF_FMA  ((EARLY(4,dbcB_bgx_8_fma  ,8,dbcB_bgx_1_c)));
+#endif
+    }
+#undef EARLY
+    for(i=0;i<5;++i)
+        if(ran[i]) printf("  %-20s| %s\n",tiers[i],(bad[i]?"DIFFERS":"ok"));
+    printf("\n");
+    fflush(stdout);
+}
+
+#ifdef CHECK_KERNELS
+/* Runs test_ops() list as microbenchmarks. */
+static void test_kernels()
+{
+    printf("Benchmarking operations.\n");
+    if(online_compiler) {printf("  Skipped.\n\n");return;}
+    ops_bench_overhead=bench_calls(0,(uintptr_t)bench_nop,0,4,0);
+    printf("%s per pixel, for L1-resident random data (so blends take the\n",BENCH_UNIT);
+    printf("general path), and for white src (opaque for blends, identity for\n");
+    printf("MUL, so wide kernels take early-outs), minus call overhead (%.2f\n",ops_bench_overhead);
+    printf("per call).\n");
+    ops_bench=1;
+    test_ops();
+    ops_bench=0;
+}
+#endif
+
+#ifndef DBC_BLIT_NO_GAMMA
+/* Reference binary16 -> double (exact). */
+static double half2d(dbcb_uint16 h)
+{
+    int e=(h>>10)&31,m=h&1023;
+    double r;
+    if(e==31) r=HUGE_VAL;
+    else if(e==0) r=ldexp((double)m,-24);
+    else     r=ldexp((double)(m+1024),e-25);
+    return (h&0x8000u)?-r:r;
+}
+
+/* Reference float -> binary16, round to nearest-even (no NaN). */
+static dbcb_uint16 d2half(float f)
+{
+    double x=fabs((double)f);
+    dbcb_uint16 s=(dbcb_uint16)(f<0.0f||(f==0.0f&&1.0f/f<0.0f)?0x8000u:0u);
+    dbcb_uint16 lo=0,hi=0x7C00u;
+    if(x>=65520.0) return (dbcb_uint16)(s|0x7C00u);
+    /* Find largest h with half2d(h)<=x. */
+    while(hi-lo>1)
+    {
+        dbcb_uint16 mid=(dbcb_uint16)((lo+hi)/2);
+        if(half2d(mid)<=x) lo=mid; else hi=mid;
+    }
+    if(x-half2d(lo)>half2d((dbcb_uint16)(lo+1))-x) ++lo;
+    else if(x-half2d(lo)==half2d((dbcb_uint16)(lo+1))-x&&(lo&1)) ++lo;
+    return (dbcb_uint16)(s|lo);
+}
+
+static void test_half()
+{
+    RNG rng;
+    int i,k,cnt;
+    printf("Testing half-float modes.\n");
+    cnt=0;
+    for(i=0;i<65536;++i)
+    {
+        float f=dbcB_half2float((dbcb_uint16)i);
+        if((i&0x7C00)==0x7C00&&(i&0x3FF)) {if(f==f) ++cnt; continue;}
+        if((double)f!=half2d((dbcb_uint16)i)||dbcB_float2half(f)!=(dbcb_uint16)i) ++cnt;
+    }
+    printf("  half->float mismatches: %d.\n",cnt);
+    RNG_init(&rng,1);
+    cnt=0;
+    for(i=0;i<1000000;++i)
+    {
+        dbcb_uint32 x=RNG_generate(&rng);
+        float f;
+        /* Mostly exponents near half-float range. */
+        if(i&7) x=(x&0x807FFFFFu)|((dbcb_uint32)(96+RNG_generate(&rng)%48)<<23);
+        if((x&0x7F800000u)==0x7F800000u) continue;
+        memcpy(&f,&x,4);
+        if(dbcB_float2half(f)!=d2half(f)) ++cnt;
+    }
+    printf("  float->half mismatches: %d.\n",cnt);
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64) && !defined(DBC_BLIT_NO_AVX2)
+    if(dbcB_has_avx2&&dbcB_has_f16c)
+    {
+        const char *name[8]={"bha","bham","bhp","bhpm","bhx","bhxm","bhr","bhrm"};
+        for(k=0;k<8;++k)
+        {
+            cnt=0;
+            for(i=0;i<100000;++i)
+            {
+                unsigned char s[16],d0[16],d1[16];
+                float color[4];
+                int j;
+                for(j=0;j<16;++j) s[j]=(unsigned char)RNG_generate(&rng);
+                for(j=0;j<8;++j)
+                {
+                    /* Finite, non-negative. */
+                    dbcb_uint16 h=(dbcb_uint16)(RNG_generate(&rng)&0x7FFFu);
+                    if((h&0x7C00u)==0x7C00u) h&=0x3FFFu;
+                    dbcb_store16(h,d0+2*j);
+                    if(k>=6) dbcb_store16(h,s+2*j);
+                }
+                if(!(RNG_generate(&rng)&3)) s[3]=s[7]=0;
+                if(!(RNG_generate(&rng)&3)) s[3]=s[7]=255;
+                for(j=0;j<4;++j) color[j]=(float)(RNG_generate(&rng)%2048)/1024.0f;
+                memcpy(d1,d0,16);
+                switch(k)
+                {
+                    case 0: dbcB_bha_2_c(s,d0);                                      wrapper_dbcB_bha_2_f16c (s,d1);       break;
+                    case 1: dbcB_bham_1_c(s,d0,color);dbcB_bham_1_c(s+4,d0+8,color); wrapper_dbcB_bham_2_f16c(s,d1,color); break;
+                    case 2: dbcB_bhp_2_c(s,d0);                                      wrapper_dbcB_bhp_2_f16c (s,d1);       break;
+                    case 3: dbcB_bhpm_1_c(s,d0,color);dbcB_bhpm_1_c(s+4,d0+8,color); wrapper_dbcB_bhpm_2_f16c(s,d1,color); break;
+                    case 4: dbcB_bhx_2_c(s,d0);                                      wrapper_dbcB_bhx_2_f16c (s,d1);       break;
+                    case 5: dbcB_bhxm_1_c(s,d0,color);dbcB_bhxm_1_c(s+4,d0+8,color); wrapper_dbcB_bhxm_2_f16c(s,d1,color); break;
+                    case 6: dbcB_bhr_2_c(s,d0);                                      wrapper_dbcB_bhr_2_f16c (s,d1);       break;
+                    case 7: dbcB_bhrm_1_c(s,d0,color);dbcB_bhrm_1_c(s+8,d0+4,color); wrapper_dbcB_bhrm_2_f16c(s,d1,color); break;
+                }
+                if(memcmp(d0,d1,16)) ++cnt;
+            }
+            printf("  dbcB_%s_2_f16c vs C mismatches: %d.\n",name[k],cnt);
+        }
+    }
+#endif
+    (void)k;
+    printf("\n");
+    fflush(stdout);
+}
 #endif /* DBC_BLIT_NO_GAMMA */
+
+static void test_modulation()
+{
+    RNG rng;
+    int i,j,k,cnt=0,cnt_sse2=0,cnt_avx2=0;
+    double max_err=0.0;
+    printf("Testing fixed-point modulation.\n");
+    RNG_init(&rng,1);
+    for(i=0;i<100000;++i)
+    {
+        unsigned char s[32],d0[32],d1[32];
+        float color[4];
+        dbcb_uint16 mul[4];
+        (void)d1;
+        for(j=0;j<32;++j) s[j]=(unsigned char)RNG_generate(&rng);
+        for(j=0;j<4;++j)
+        {
+            switch(RNG_generate(&rng)&3)
+            {
+                case 0:  color[j]=(float)(RNG_generate(&rng)%257)/256.0f; break;
+                case 1:  color[j]=(float)(RNG_generate(&rng)%256)/255.0f; break;
+                default: color[j]=(float)(RNG_generate(&rng)>>8)/16777215.0f; break;
+            }
+        }
+        dbcB_color2mul16(color,mul);
+        for(j=0;j<8;++j)
+        {
+            dbcb_uint32 S,D;
+            dbcB_b32k_1_c(s+4*j,d0+4*j,mul);
+            S=dbcb_load32(s+4*j);
+            D=dbcb_load32(d0+4*j);
+            for(k=0;k<4;++k)
+            {
+                double err=fabs((double)color[k]*(double)dbcB_getb(S,(dbcb_uint32)k)-(double)dbcB_getb(D,(dbcb_uint32)k));
+                if(err>max_err) max_err=err;
+                if(err>0.51) ++cnt;
+            }
+        }
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+        if(dbcB_has_sse2)
+        {
+            dbcB_b32k_1_sse2(s,d1,mul);
+            dbcB_b32k_2_sse2(s+4,d1+4,mul);
+            dbcB_b32k_4_sse2(s+12,d1+12,mul);
+            dbcB_b32k_1_sse2(s+28,d1+28,mul);
+            if(memcmp(d0,d1,32)) ++cnt_sse2;
+        }
+#ifndef DBC_BLIT_NO_AVX2
+        if(dbcB_has_avx2)
+        {
+            dbcB_b32k_1_avx2(s,d1,mul);
+            dbcB_b32k_2_avx2(s+4,d1+4,mul);
+            dbcB_b32k_4_avx2(s+12,d1+12,mul);
+            dbcB_b32k_1_avx2(s+28,d1+28,mul);
+            if(memcmp(d0,d1,32)) ++cnt_avx2;
+            dbcB_b32k_8_avx2(s,d1,mul);
+            if(memcmp(d0,d1,32)) ++cnt_avx2;
+        }
+#endif
+#endif
+    }
+    printf("  Max error: %.4f, errors above 0.51: %d.\n",max_err,cnt);
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+    if(dbcB_has_sse2) printf("  dbcB_b32k_*_sse2 vs C mismatches: %d.\n",cnt_sse2);
+#ifndef DBC_BLIT_NO_AVX2
+    if(dbcB_has_avx2) printf("  dbcB_b32k_*_avx2 vs C mismatches: %d.\n",cnt_avx2);
+#endif
+#endif
+    (void)cnt_sse2;
+    (void)cnt_avx2;
     printf("\n");
+    fflush(stdout);
 }
 
 static void gen_sprite(unsigned char *dst,int T,int mode,int key,dbcb_uint32 seed)
 {
     RNG rng;
-    int pixel_size=mode_pixel_size(mode);
+    int pixel_size=mode_src_pixel_size(mode);
     dbcb_int32 x,y;
     RNG_init(&rng,seed);
     for(y=0;y<T;++y)
@@ -738,6 +1331,9 @@ static void gen_sprite(unsigned char *dst,int T,int mode,int key,dbcb_uint32 see
                 case DBCB_MODE_MUG:
                 case DBCB_MODE_ALPHATEST:
                 case DBCB_MODE_CPYG:
+                case DBCB_MODE_HALF_ALPHA:
+                case DBCB_MODE_HALF_PMA:
+                case DBCB_MODE_HALF_MUL:
                 {
                     dbcb_int32 a=w+(dbcb_int32)(RNG_generate(&rng)%17-8);
                     if(a<0) a=0;
@@ -746,13 +1342,13 @@ static void gen_sprite(unsigned char *dst,int T,int mode,int key,dbcb_uint32 see
                     dst[id+1]=(unsigned char)RNG_generate(&rng);
                     dst[id+2]=(unsigned char)RNG_generate(&rng);
                     dst[id+3]=(unsigned char)a;
-                    if((mode==DBCB_MODE_PMA||mode==DBCB_MODE_PMG)&&(RNG_generate(&rng)&255))
+                    if((mode==DBCB_MODE_PMA||mode==DBCB_MODE_PMG||mode==DBCB_MODE_HALF_PMA)&&(RNG_generate(&rng)&255))
                     {
                         dst[id+0]=(unsigned char)dbcB_div255_round((dbcb_uint32)(dst[id+0]*a));
                         dst[id+1]=(unsigned char)dbcB_div255_round((dbcb_uint32)(dst[id+1]*a));
                         dst[id+2]=(unsigned char)dbcB_div255_round((dbcb_uint32)(dst[id+2]*a));
                     }
-                    if((mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG))
+                    if((mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG||mode==DBCB_MODE_HALF_MUL))
                     {
                         dst[id+3]=(unsigned char)RNG_generate(&rng);
                         if(RNG_generate(&rng)&255)
@@ -777,10 +1373,104 @@ static void gen_sprite(unsigned char *dst,int T,int mode,int key,dbcb_uint32 see
                     if(!(RNG_generate(&rng)&511)) dbcb_store32(RNG_generate(&rng)|0x00FFFFFFu,dst+id);
                     break;
                 }
+#ifndef DBC_BLIT_NO_GAMMA
+                case DBCB_MODE_HALF_RESOLVE:
+                {
+                    /* Linear, with some values out of [0;1]. */
+                    dbcb_int32 a=w+(dbcb_int32)(RNG_generate(&rng)%17-8);
+                    int i;
+                    for(i=0;i<3;++i) dbcb_store16(dbcB_float2half((float)(RNG_generate(&rng)%1200)/1000.0f),dst+id+2*i);
+                    dbcb_store16(dbcB_float2half((float)a/255.0f),dst+id+6);
+                    if(!(RNG_generate(&rng)&511)) dbcb_store16(0xBC00u,dst+id); /* -1.0 */
+                    if(!(RNG_generate(&rng)&511)) dbcb_store16(0x7C00u,dst+id); /* inf */
+                    break;
+                }
+#endif
             }
         }
 }
 
+#ifdef CHECK_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PERF_EVENTS 6
+static int perf_fd[PERF_EVENTS]={-1,-1,-1,-1,-1,-1};
+/* Counts from the last test_performance() call, -1 if not available. */
+static double perf_count[PERF_EVENTS];
+
+/* Cycles, instructions, L1D read misses, LLC misses, branch misses, backend stalls. */
+static int perf_open()
+{
+    static const dbcb_uint32 types[PERF_EVENTS]={
+        PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE,PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE};
+    static const dbcb_uint32 configs[PERF_EVENTS]={
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_STALLED_CYCLES_BACKEND};
+    int i,ret=0;
+    for(i=0;i<PERF_EVENTS;++i)
+    {
+        struct perf_event_attr attr;
+        memset(&attr,0,sizeof(attr));
+        attr.type=types[i];
+        attr.size=sizeof(attr);
+        attr.config=configs[i];
+        attr.disabled=1;
+        attr.exclude_kernel=1;
+        attr.exclude_hv=1;
+        attr.read_format=PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+        /* Each event separately, so that unsupported ones do not take the rest down. */
+        perf_fd[i]=(int)syscall(SYS_perf_event_open,&attr,0,-1,-1,0);
+        if(perf_fd[i]>=0) ++ret;
+    }
+    return ret;
+}
+
+static void perf_close()
+{
+    int i;
+    for(i=0;i<PERF_EVENTS;++i)
+    {
+        if(perf_fd[i]>=0) close(perf_fd[i]);
+        perf_fd[i]=-1;
+    }
+}
+
+static void perf_start()
+{
+    int i;
+    for(i=0;i<PERF_EVENTS;++i)
+    {
+        if(perf_fd[i]<0) continue;
+        ioctl(perf_fd[i],PERF_EVENT_IOC_RESET,0);
+        ioctl(perf_fd[i],PERF_EVENT_IOC_ENABLE,0);
+    }
+}
+
+static void perf_stop()
+{
+    int i;
+    for(i=0;i<PERF_EVENTS;++i)
+    {
+        /* value, time enabled, time running. */
+        uint64_t v[3];
+        perf_count[i]=-1.0;
+        if(perf_fd[i]<0) continue;
+        ioctl(perf_fd[i],PERF_EVENT_IOC_DISABLE,0);
+        if(read(perf_fd[i],v,sizeof(v))!=(ssize_t)sizeof(v)||v[2]==0) continue;
+        /* Scale, if the event was multiplexed with others. */
+        perf_count[i]=(double)v[0]*((double)v[1]/(double)v[2]);
+    }
+}
+#endif /* CHECK_PERF */
+
 static double test_performance(int N,int sprite_size,int test,int mode,int g,dbcb_uint32 seed)
 {
     RNG rng;
@@ -788,6 +1478,7 @@ static double test_performance(int N,int sprite_size,int test,int mode,int g,dbc
     int x0=0,y0=0,w=W,h=H;
     int num_sprites=1;
     int pixel_size=mode_pixel_size(mode);
+    int src_pixel_size=mode_src_pixel_size(mode);
     int F=0;
     double t;
     float color[4]={1.0f,0.5f,0.25f,0.5f};
@@ -806,12 +1497,15 @@ static double test_performance(int N,int sprite_size,int test,int mode,int g,dbc
     if(!(pixel_size>0)) return -1.0;
     for(k=0;k<num_sprites;++k)
     {
-        gen_sprite(sprite+T*T*pixel_size*k,sprite_size,mode,(mode==DBCB_MODE_5551?-1:1),seed+(dbcb_uint32)k);
+        gen_sprite(sprite+T*T*src_pixel_size*k,sprite_size,mode,(mode==DBCB_MODE_5551?-1:1),seed+(dbcb_uint32)k);
     }
     memset(buffer,0x89u,(size_t)(W*H*pixel_size));
     if(mode==DBCB_MODE_ALPHATEST) color[0]=73.0f;
-    if(mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG) F=(test==0?4:4*(W*H/(T*T+1)+1));
+    if(mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG||mode==DBCB_MODE_HALF_MUL) F=(test==0?4:4*(W*H/(T*T+1)+1));
     t=(double)clock();
+#ifdef CHECK_PERF
+    perf_start();
+#endif
     for(j=0;j<N;++j)
     {
         dbcb_int32 x,y,s;
@@ -819,28 +1513,33 @@ static double test_performance(int N,int sprite_size,int test,int mode,int g,dbc
         y=(dbcb_int32)(RNG_generate(&rng)%(dbcb_uint32)h)+y0;
         s=(dbcb_int32)(RNG_generate(&rng)%(dbcb_uint32)num_sprites);
         dbc_blit(
-            T,T,pixel_size*T,sprite+s*(T*T)*pixel_size,
+            T,T,src_pixel_size*T,sprite+s*(T*T)*src_pixel_size,
             W,H,pixel_size*W,buffer,
             x,y,
             (g?color:0),
             mode);
-        if((mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG)&&j%F==F-1&&j<N-F)
+        if(F&&j%F==F-1&&j<N-F)
         {
             /*
                 Multiplication turns buffer to black, which than makes pixel blit
                 early-out, producing erroneously high speed, so we reset it once
                 in a while. Time added by this should not affect the result much.
             */
-            if(test==0)
+            if(test==0&&src_pixel_size==pixel_size)
                 dbc_blit(
                     T,T,pixel_size*T,sprite+s*(T*T)*pixel_size,
                     W,H,pixel_size*W,buffer,
                     x,y,
                     0,
                     DBCB_MODE_COPY);
+            else if(test==0)
+                for(k=0;k<T;++k) memset(buffer+((y+k)*W+x)*pixel_size,0x89u,(size_t)(T*pixel_size));
             else memset(buffer,0x89u,(size_t)(W*H*pixel_size));
         }
     }
+#ifdef CHECK_PERF
+    perf_stop();
+#endif
     t=(double)clock()-t;
     t/=CLOCKS_PER_SEC;
     t/=(double)T*(double)T;
@@ -912,7 +1611,7 @@ static dbcb_uint32 test_render(int mode,int g)
 
 static void test_modes()
 {
-#define TEST_RENDER(mode) do{dbcb_uint32 h0,h1;h0=test_render(mode,0);h1=test_render(mode,1);printf("%-20s|",#mode);printf(" %08X (%-7s)|",h0,(h0==ref[mode][0]?"ok":"DIFFERS"));printf(" %08X (%-7s)|",h1,(h1==ref[mode][1]?"ok":"DIFFERS"));printf("\n");fflush(stdout);}while(0)
+#define TEST_RENDER(mode) do{dbcb_uint32 h0,h1;h0=test_render(mode,0);h1=test_render(mode,1);printf("%-22s|",#mode);printf(" %08X (%-7s)|",h0,(h0==ref[mode][0]?"ok":"DIFFERS"));printf(" %08X (%-7s)|",h1,(h1==ref[mode][1]?"ok":"DIFFERS"));printf("\n");fflush(stdout);}while(0)
 
     dbcb_uint32 ref[][2]={
 #ifdef DBC_BLIT_DATA_BIG_ENDIAN
@@ -927,7 +1626,11 @@ static void test_modes()
 /* DBCB_MODE_MUL       */ {0xB595469Fu , 0xFE9A12EBu},
 /* DBCB_MODE_MUG       */ {0xB1EF3DF7u , 0x96A2BE39u},
 /* DBCB_MODE_ALPHATEST */ {0xD0CEA91Au , 0x693FCC76u},
-/* DBCB_MODE_CPYG      */ {0xD0CEA91Au , 0x40689476u}
+/* DBCB_MODE_CPYG      */ {0xD0CEA91Au , 0x40689476u},
+/* DBCB_MODE_HALF_ALPHA*/ {0x9328DB3Au , 0xA1432BD1u},
+/* DBCB_MODE_HALF_PMA  */ {0xC147C08Bu , 0x6DCEC6C6u},
+/* DBCB_MODE_HALF_MUL  */ {0x98E20E81u , 0xBEF1A3FCu},
+/* DBCB_MODE_HALF_RESOLVE*/ {0x485394EEu , 0xC739D812u}
 #else
 /* DBCB_MODE_COPY      */ {0x055CA7BAu , 0x7566D2C0u},
 /* DBCB_MODE_ALPHA     */ {0xADBF7A88u , 0xD409C9ACu},
@@ -940,7 +1643,11 @@ static void test_modes()
 /* DBCB_MODE_MUL       */ {0x14A6ED5Fu , 0x75ABC32Bu},
 /* DBCB_MODE_MUG       */ {0xB0769277u , 0x2060DBB9u},
 /* DBCB_MODE_ALPHATEST */ {0x055CA7BAu , 0xAA5DF296u},
-/* DBCB_MODE_CPYG      */ {0x055CA7BAu , 0xDAC59256u}
+/* DBCB_MODE_CPYG      */ {0x055CA7BAu , 0xDAC59256u},
+/* DBCB_MODE_HALF_ALPHA*/ {0x7A3FB21Au , 0x707A3591u},
+/* DBCB_MODE_HALF_PMA  */ {0xB7FF334Bu , 0xEA1E9226u},
+/* DBCB_MODE_HALF_MUL  */ {0xA2133B81u , 0x4153505Cu},
+/* DBCB_MODE_HALF_RESOLVE*/ {0xEB37514Eu , 0xD898AD72u}
 #endif
     };
 
@@ -963,76 +1670,1852 @@ static void test_modes()
     TEST_RENDER(DBCB_MODE_ALPHATEST  );
 #ifndef DBC_BLIT_NO_GAMMA
     TEST_RENDER(DBCB_MODE_CPYG       );
+    TEST_RENDER(DBCB_MODE_HALF_ALPHA );
+    TEST_RENDER(DBCB_MODE_HALF_PMA   );
+    TEST_RENDER(DBCB_MODE_HALF_MUL   );
+    TEST_RENDER(DBCB_MODE_HALF_RESOLVE);
 #endif
 
     printf("\n");
 }
 
-static void test_speed()
+/* Fills 5 layers: opaque background, and 4 full-height layers over it. */
+static int gen_layers(dbcb_layer *layers)
 {
-#define TEST(N0,N1,size,mode,t,p) do{printf("%-20s|%4d|",#mode,size); test_perf(N0,N1,size,mode,t,p);} while(0)
-
-    int g=3;
-    int size=64;
-    int p=0;
-    int m=(online_compiler?50:100);
-#if defined(ONLINE_COMPILER) && defined(DBC_BLIT_NO_SIMD)
-    m/=2;
-#endif
-    printf("Testing performance.\n");
-    if(p) printf("Timings are in gigapixels/second.\n");
-    else  printf("Timings are in ns/pixel.\n");
-    printf("Sprites are %dx%d, and contain a combination of transparent,\n",size,size);
-    printf("semitransparent (where applicable), and opaque pixels.\n");
-    printf("Column 'Fill' estimates pure fillrate: blit(0,0,sprites[0]).\n");
-    printf("Column 'Rand' estimates random access: blit(rnd(W),rnd(H),sprites[rnd(N)]).\n");
-    printf("                    |    |Non-modulated|  Modulated  |\n");
-    printf("                    |    |------+------+------+------|\n");
-    printf("                    |Size| Fill | Rand | Fill | Rand |\n");
-    printf("--------------------+----+------+------+------+------|\n");
-    fflush(stdout);
-    /* Warm-up. */
-    (void)test_performance(50*m,size,3,DBCB_MODE_COPY,0,1);
-    TEST(  500*m,   50*m,size,DBCB_MODE_COPY        ,g,p);
-    TEST(  100*m,   50*m,size,DBCB_MODE_ALPHA       ,g,p);
-    TEST(  100*m,   50*m,size,DBCB_MODE_PMA         ,g,p);
+    static const float color[4]={1.0f,0.5f,0.25f,0.5f};
+    int sizes[5]={W,H,H,H,H};
+    int modes[5]={DBCB_MODE_COPY,DBCB_MODE_ALPHA,DBCB_MODE_PMA,DBCB_MODE_MUL,DBCB_MODE_ALPHA};
+    int xs[5]={0,150,-100,250,100},ys[5]={-100,20,-50,0,100};
+    int count=5,i,j;
+    unsigned char *p=sprite;
 #ifndef DBC_BLIT_NO_GAMMA
-    TEST(   10*m,   10*m,size,DBCB_MODE_GAMMA       ,g,p);
-    TEST(   10*m,   10*m,size,DBCB_MODE_PMG         ,g,p);
-#endif
-    TEST( 1000*m, 1000*m,size,DBCB_MODE_COLORKEY8   ,g,p);
-    TEST(  500*m,  500*m,size,DBCB_MODE_COLORKEY16  ,g,p);
-    TEST(  500*m,  500*m,size,DBCB_MODE_5551        ,g,p);
-    TEST(  100*m,   50*m,size,DBCB_MODE_MUL         ,g,p);
-#ifndef DBC_BLIT_NO_GAMMA
-    TEST(   20*m,   10*m,size,DBCB_MODE_MUG         ,g,p);
-#endif
-    TEST(  500*m,  200*m,size,DBCB_MODE_ALPHATEST   ,g,p);
-#ifndef DBC_BLIT_NO_GAMMA
-    TEST(  500*m,   20*m,size,DBCB_MODE_CPYG        ,g,p);
+    modes[4]=DBCB_MODE_GAMMA;
 #endif
+    for(i=0;i<count;++i)
+    {
+        gen_sprite(p,sizes[i],modes[i],1,(dbcb_uint32)(i+1));
+        layers[i].w=sizes[i];
+        layers[i].h=sizes[i];
+        layers[i].stride=sizes[i]*4;
+        layers[i].pixels=p;
+        layers[i].x=xs[i];
+        layers[i].y=ys[i];
+        layers[i].color=(i==2?color:0);
+        layers[i].mode=modes[i];
+        layers[i].flags=0;
+        if(i==0) for(j=0;j<W*W;++j) dbcb_store32(dbcb_load32(p+j*4)|0xFF000000u,p+j*4); /* Opaque. */
+        p+=sizes[i]*sizes[i]*4;
+    }
+    return count;
+}
+
+static void test_layers()
+{
+    dbcb_layer layers[5];
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    int N=(online_compiler?10:50);
+    int count,i,j;
+    double t0,t1;
+    printf("Testing layers.\n");
+    count=gen_layers(layers);
+    t0=(double)clock();
+    for(j=0;j<N;++j)
+        for(i=0;i<count;++i)
+            dbc_blit(layers[i].w,layers[i].h,layers[i].stride,layers[i].pixels,W,H,W*4,dst0,layers[i].x,layers[i].y,layers[i].color,layers[i].mode);
+    t0=(double)clock()-t0;
+    t1=(double)clock();
+    for(j=0;j<N;++j)
+        dbc_blit_layers(W,H,W*4,dst1,layers,count);
+    t1=(double)clock()-t1;
+    printf("  %d layers, %dx%d dst.\n",count,W,H);
+    printf("  Sequential dbc_blit(): %6.2f ns/pixel.\n",1.0e+9*t0/CLOCKS_PER_SEC/((double)N*W*H));
+    printf("  dbc_blit_layers()    : %6.2f ns/pixel.\n",1.0e+9*t1/CLOCKS_PER_SEC/((double)N*W*H));
+    printf("  Result: %s.\n",(memcmp(dst0,dst1,(size_t)(W*H*4))?"DIFFERS":"ok"));
     printf("\n");
+    fflush(stdout);
 }
 
-int main()
+static void test_damage()
 {
-    printf("Testing dbc_blit.h.\n");
+    static unsigned char covered[W*H];
+    dbcb_layer layers[5];
+    dbcb_damage damage;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    RNG rng;
+    int N=(online_compiler?100:1000);
+    int count,i,j,k,x,y,bad=0;
+    double t0,t1;
+    printf("Testing damage tracking.\n");
+    /* Random rectangles: result must cover them, and be disjoint. */
+    RNG_init(&rng,1);
+    for(k=0;k<100;++k)
+    {
+        int n=1+(int)(RNG_generate(&rng)%200);
+        memset(covered,0,sizeof(covered));
+        dbcb_damage_clear(&damage);
+        for(i=0;i<n;++i)
+        {
+            int w=1+(int)(RNG_generate(&rng)%64),h=1+(int)(RNG_generate(&rng)%64);
+            int x0=(int)(RNG_generate(&rng)%(W+64))-64,y0=(int)(RNG_generate(&rng)%(H+64))-64;
+            dbcb_damage_add_blit(&damage,w,h,W,H,x0,y0);
+            for(y=(y0<0?0:y0);y<y0+h&&y<H;++y)
+                for(x=(x0<0?0:x0);x<x0+w&&x<W;++x)
+                    covered[y*W+x]=1;
+        }
+        if(damage.count>DBCB_DAMAGE_MAX_RECTS) ++bad;
+        for(i=0;i<damage.count;++i)
+        {
+            const dbcb_rect *r=damage.rects+i;
+            for(j=i+1;j<damage.count;++j)
+            {
+                const dbcb_rect *q=damage.rects+j;
+                if(r->x0<q->x1&&q->x0<r->x1&&r->y0<q->y1&&q->y0<r->y1) ++bad;
+            }
+            for(y=r->y0;y<r->y1;++y)
+                for(x=r->x0;x<r->x1;++x)
+                    if(x>=0&&x<W&&y>=0&&y<H) covered[y*W+x]=0;
+        }
+        for(i=0;i<W*H;++i) bad+=covered[i];
+    }
+    printf("  Rectangle set: %s.\n",(bad?"DIFFERS":"ok"));
+    /* Moving a layer: damaged recompositing must match the full one. */
+    count=gen_layers(layers);
+    layers[3].w=layers[3].h=64; /* Top-left corner of the sprite. */
+    dbc_blit_layers(W,H,W*4,dst1,layers,count);
+    dbcb_damage_clear(&damage);
+    dbcb_damage_add_blit(&damage,layers[3].w,layers[3].h,W,H,layers[3].x,layers[3].y);
+    layers[3].x+=7;
+    layers[3].y+=5;
+    dbcb_damage_add_blit(&damage,layers[3].w,layers[3].h,W,H,layers[3].x,layers[3].y);
+    dbc_blit_layers_damaged(W,H,W*4,dst1,layers,count,&damage);
+    t0=(double)clock();
+    for(j=0;j<N;++j) dbc_blit_layers_damaged(W,H,W*4,dst1,layers,count,&damage);
+    t0=(double)clock()-t0;
+    t1=(double)clock();
+    for(j=0;j<N/10;++j) dbc_blit_layers(W,H,W*4,dst0,layers,count);
+    t1=(double)clock()-t1;
+    printf("  Full recompositing   : %8.2f us/frame.\n",1.0e+6*t1/CLOCKS_PER_SEC/(double)(N/10));
+    printf("  Damaged recompositing: %8.2f us/frame (%d rects).\n",1.0e+6*t0/CLOCKS_PER_SEC/(double)N,damage.count);
+    printf("  Result: %s.\n",(memcmp(dst0,dst1,(size_t)(W*H*4))?"DIFFERS":"ok"));
+    printf("\n");
     fflush(stdout);
-    printf("Compiler:\n");
-#ifdef __cplusplus
-    printf("  Compiled as C++.\n");
-#if (__cplusplus+0)>0
-    printf("  __cplusplus                       is set to %ld.\n",(long)(__cplusplus));
-#endif
-#else
-    printf("  Compiled as C.\n");
-#endif
-#ifdef __STDC__
-    printf("  __STDC__                          is set to %d.\n",(__STDC__ + 0));
-#endif
-#if defined(__STDC_VERSION__)
-    printf("  __STDC_VERSION__                  is set to %ld.\n",(long)(__STDC_VERSION__ + 0));
-#endif
+}
+
+static void test_culling()
+{
+    static dbcb_layer layers[2048];
+    static unsigned short coverage[((W+DBCB_COVERAGE_BLOCK-1)/DBCB_COVERAGE_BLOCK)*((H+DBCB_COVERAGE_BLOCK-1)/DBCB_COVERAGE_BLOCK)];
+    static const float half[4]={1.0f,1.0f,1.0f,0.5f};
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    unsigned char *tiles=sprite,*opaque=sprite+4*32*32*4,*alpha=opaque+64*64*4;
+    RNG rng;
+    int N=(online_compiler?10:50);
+    int count=0,i,j,x,y;
+    double t0,t1;
+    printf("Testing occlusion culling.\n");
+    RNG_init(&rng,1);
+    /* 4 tile variants, opaque and semitransparent sprites. */
+    for(i=0;i<4;++i) gen_sprite(tiles+i*32*32*4,32,DBCB_MODE_COPY,1,(dbcb_uint32)(i+1));
+    for(i=0;i<4*32*32;++i) dbcb_store32(dbcb_load32(tiles+i*4)|0xFF000000u,tiles+i*4);
+    gen_sprite(opaque,64,DBCB_MODE_ALPHA,1,5);
+    for(i=0;i<64*64;++i) dbcb_store32(dbcb_load32(opaque+i*4)|0xFF000000u,opaque+i*4);
+    gen_sprite(alpha,64,DBCB_MODE_ALPHA,1,6);
+    /* Background, opaque and semitransparent tile map layers, then sprites. */
+    for(j=0;j<3;++j)
+        for(y=-16;y<H;y+=32)
+            for(x=(j==0?0:-8);x<W;x+=32)
+            {
+                dbcb_layer *l=layers+count++;
+                l->w=l->h=32;
+                l->stride=32*4;
+                l->pixels=tiles+(RNG_generate(&rng)%4)*32*32*4;
+                l->x=x;
+                l->y=y+(j==2?8:0);
+                l->color=(j==2?half:0);
+                l->mode=(j==0?DBCB_MODE_COPY:DBCB_MODE_ALPHA);
+                l->flags=(j==1?DBCB_LAYER_OPAQUE:0);
+            }
+    while(count<(int)(sizeof(layers)/sizeof(layers[0])))
+    {
+        dbcb_layer *l=layers+count;
+        int o=(int)(RNG_generate(&rng)&1);
+        l->w=l->h=64;
+        l->stride=64*4;
+        l->pixels=(o?opaque:alpha);
+        l->x=(int)(RNG_generate(&rng)%(W+64))-64;
+        l->y=(int)(RNG_generate(&rng)%(H+64))-64;
+        l->color=0;
+        l->mode=(o&&(count&2)?DBCB_MODE_COPY:DBCB_MODE_ALPHA);
+        l->flags=(o?DBCB_LAYER_OPAQUE:0);
+        ++count;
+    }
+    t0=(double)clock();
+    for(j=0;j<N;++j) dbc_blit_layers(W,H,W*4,dst0,layers,count);
+    t0=(double)clock()-t0;
+    t1=(double)clock();
+    for(j=0;j<N;++j) dbc_blit_layers_culled(W,H,W*4,dst1,layers,count,coverage);
+    t1=(double)clock()-t1;
+    printf("  %d layers, %dx%d dst.\n",count,W,H);
+    printf("  dbc_blit_layers()       : %8.2f us/frame.\n",1.0e+6*t0/CLOCKS_PER_SEC/(double)N);
+    printf("  dbc_blit_layers_culled(): %8.2f us/frame.\n",1.0e+6*t1/CLOCKS_PER_SEC/(double)N);
+    printf("  Result: %s.\n",(memcmp(dst0,dst1,(size_t)(W*H*4))?"DIFFERS":"ok"));
+    /* More layers than coverage can index: must not drop any. */
+    {
+        static dbcb_layer many[65536+64];
+        int n=(int)(sizeof(many)/sizeof(many[0]));
+        for(i=0;i<n;++i)
+        {
+            many[i]=layers[i%count];
+            many[i].w=many[i].h=8;
+        }
+        dbc_blit_layers(W,H,W*4,dst0,many,n);
+        dbc_blit_layers_culled(W,H,W*4,dst1,many,n,coverage);
+        printf("  %d layers: %s.\n",n,(memcmp(dst0,dst1,(size_t)(W*H*4))?"DIFFERS":"ok"));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_analysis()
+{
+#define MODE(mode) {mode,#mode}
+    static const struct {int mode;const char *name;} modes[]={
+        MODE(DBCB_MODE_COPY),MODE(DBCB_MODE_ALPHA),MODE(DBCB_MODE_PMA),MODE(DBCB_MODE_COLORKEY8),
+        MODE(DBCB_MODE_5551),MODE(DBCB_MODE_MUL),MODE(DBCB_MODE_ALPHATEST),
+#ifndef DBC_BLIT_NO_GAMMA
+        MODE(DBCB_MODE_GAMMA),MODE(DBCB_MODE_PMG),MODE(DBCB_MODE_MUG),MODE(DBCB_MODE_HALF_ALPHA)
+#endif
+    };
+#undef MODE
+    static const char *kinds[3]={"transparent","opaque","mixed"};
+    const int S=64,T=32,DW=W/2,DH=H/2;
+    float color[4]={1.0f,0.5f,0.25f,0.5f};
+    unsigned char *canvas=sprite,*tmp=sprite+S*S*8;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    dbcb_sprite_info info;
+    RNG rng;
+    int N=(online_compiler?20000:100000);
+    int m,k,i,j,x,y;
+    double t0,t1;
+    printf("Testing sprite analysis.\n");
+    RNG_init(&rng,1);
+    for(m=0;m<(int)(sizeof(modes)/sizeof(modes[0]));++m)
+    {
+        int mode=modes[m].mode,ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+        int bad=0,found[3]={0,0,0};
+        if(!(ps>0)) continue;
+        for(k=0;k<3;++k)
+        {
+            /* k: 0 - empty canvas, 1 - opaque sprite in it, 2 - normal sprite in it. */
+            for(i=0;i<S*S;++i)
+            {
+                if(mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG) dbcb_store32(0xFFFFFFFFu,canvas+i*4);
+                else if(mode==DBCB_MODE_PMA||mode==DBCB_MODE_PMG) dbcb_store32(0u,canvas+i*4);
+                else if(mode==DBCB_MODE_5551) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)&0x7FFFu),canvas+i*2);
+                else if(ps==4) dbcb_store32(RNG_generate(&rng)&0x00FFFFFFu,canvas+i*4);
+                else canvas[i]=(unsigned char)RNG_generate(&rng);
+            }
+            if(k>0)
+            {
+                gen_sprite(tmp,T,mode,1,(dbcb_uint32)(m+1));
+                for(i=0;i<T*T;++i)
+                {
+                    if(k==1&&ps==4) dbcb_store32(dbcb_load32(tmp+i*4)|0xFF000000u,tmp+i*4);
+                    if(k==1&&ps==2) dbcb_store16((dbcb_uint16)(dbcb_load16(tmp+i*2)|0x8000u),tmp+i*2);
+                }
+                for(y=0;y<T;++y) memcpy(canvas+((y+21)*S+13)*ps,tmp+y*T*ps,(size_t)(T*ps));
+            }
+            dbcb_analyze_sprite(S,S,S*ps,canvas,mode,&info);
+            found[info.kind]++;
+            for(j=0;j<200;++j)
+            {
+                const float *c=(j&1?color:0);
+                x=(int)(RNG_generate(&rng)%(dbcb_uint32)(DW+S))-S;
+                y=(int)(RNG_generate(&rng)%(dbcb_uint32)(DH+S))-S;
+                if(j%50==0)
+                {
+                    for(i=0;i<DW*DH*dps;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+                    memcpy(dst1,dst0,(size_t)(DW*DH*dps));
+                }
+                dbc_blit(S,S,S*ps,canvas,DW,DH,DW*dps,dst0,x,y,c,mode);
+                dbc_blit_analyzed(S,S,S*ps,canvas,DW,DH,DW*dps,dst1,x,y,c,mode,&info);
+                if(memcmp(dst0,dst1,(size_t)(DW*DH*dps))) {++bad;memcpy(dst1,dst0,(size_t)(DW*DH*dps));}
+            }
+        }
+        printf("  %-20s| %s/%s/%s | %s\n",modes[m].name,
+            (found[0]?kinds[0]:"-"),(found[1]?kinds[1]:"-"),(found[2]?kinds[2]:"-"),(bad?"DIFFERS":"ok"));
+    }
+    /* Timing: 32x32 sprite with transparent border in 64x64. */
+    gen_sprite(tmp,T,DBCB_MODE_ALPHA,1,1);
+    memset(canvas,0,(size_t)(S*S*4));
+    for(y=0;y<T;++y) memcpy(canvas+((y+21)*S+13)*4,tmp+y*T*4,(size_t)(T*4));
+    dbcb_analyze_sprite(S,S,S*4,canvas,DBCB_MODE_ALPHA,&info);
+    t0=(double)clock();
+    for(j=0;j<N;++j) dbc_blit(S,S,S*4,canvas,W,H,W*4,buffer,(j*37)%(W-S),(j*11)%(H-S),0,DBCB_MODE_ALPHA);
+    t0=(double)clock()-t0;
+    t1=(double)clock();
+    for(j=0;j<N;++j) dbc_blit_analyzed(S,S,S*4,canvas,W,H,W*4,buffer,(j*37)%(W-S),(j*11)%(H-S),0,DBCB_MODE_ALPHA,&info);
+    t1=(double)clock()-t1;
+    printf("  64x64 sprite with 32x32 content, DBCB_MODE_ALPHA:\n");
+    printf("  dbc_blit()         : %6.2f ns/blit.\n",1.0e+9*t0/CLOCKS_PER_SEC/(double)N);
+    printf("  dbc_blit_analyzed(): %6.2f ns/blit.\n",1.0e+9*t1/CLOCKS_PER_SEC/(double)N);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_masked()
+{
+#define MODE(mode) {mode,#mode}
+    static const struct {int mode;const char *name;} modes[]={
+        MODE(DBCB_MODE_COPY),MODE(DBCB_MODE_ALPHA),MODE(DBCB_MODE_PMA),MODE(DBCB_MODE_COLORKEY8),
+        MODE(DBCB_MODE_MUL),MODE(DBCB_MODE_ALPHATEST),
+#ifndef DBC_BLIT_NO_GAMMA
+        MODE(DBCB_MODE_GAMMA),MODE(DBCB_MODE_PMG),MODE(DBCB_MODE_HALF_ALPHA),MODE(DBCB_MODE_HALF_PMA)
+#endif
+    };
+#undef MODE
+    static const float white[4]={1.0f,1.0f,1.0f,1.0f};
+    const int S=64,M=96,DW=W/2,DH=H/2;
+    float color[4]={1.0f,0.5f,0.25f,0.5f};
+    unsigned char *src=sprite,*coverage=sprite+S*S*8;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    dbcb_mask mask;
+    RNG rng;
+    int N=(online_compiler?20000:100000);
+    int m,i,j,k,x,y,X,Y;
+    double t0,t1;
+    printf("Testing masked blit.\n");
+    RNG_init(&rng,1);
+    mask.w=M;
+    mask.h=M;
+    mask.stride=M;
+    mask.pixels=coverage;
+    for(m=0;m<(int)(sizeof(modes)/sizeof(modes[0]));++m)
+    {
+        int mode=modes[m].mode,ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+        int first=(mode==DBCB_MODE_ALPHA||mode==DBCB_MODE_GAMMA||mode==DBCB_MODE_HALF_ALPHA?3:
+                   mode==DBCB_MODE_PMA||mode==DBCB_MODE_PMG||mode==DBCB_MODE_HALF_PMA?0:4);
+        int bad=0;
+        if(!(ps>0)) continue;
+        gen_sprite(src,S,mode,1,(dbcb_uint32)(m+1));
+        if(mode==DBCB_MODE_ALPHATEST) color[0]=73.0f; else color[0]=1.0f;
+        for(j=0;j<200;++j)
+        {
+            const float *c=(j&1?color:0);
+            /* Mostly 0 and 255 runs, some partial coverage. */
+            for(i=0;i<M*M;i+=k)
+            {
+                dbcb_uint32 r=RNG_generate(&rng);
+                int v=(r%4u==0?0:r%4u==1?(int)(r>>8)&255:255);
+                for(k=0;k<1+(int)((r>>16)%8u)&&i+k<M*M;++k) coverage[i+k]=(unsigned char)v;
+            }
+            x=(int)(RNG_generate(&rng)%(dbcb_uint32)(DW+S))-S;
+            y=(int)(RNG_generate(&rng)%(dbcb_uint32)(DH+S))-S;
+            mask.x=(j%3==0?x:(int)(RNG_generate(&rng)%(dbcb_uint32)(DW+M))-M);
+            mask.y=(j%3==0?y:(int)(RNG_generate(&rng)%(dbcb_uint32)(DH+M))-M);
+            for(i=0;i<DW*DH*dps;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+            /* Finite halves: NaN and -0 are not bit-exact between tiers. */
+            if(dps==8) for(i=0;i<DW*DH*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),dst0+i*2);
+            memcpy(dst1,dst0,(size_t)(DW*DH*dps));
+            /* Reference: pixel by pixel, with color scaled by coverage. */
+            for(Y=0;Y<DH;++Y)
+                for(X=0;X<DW;++X)
+                {
+                    float scaled[4];
+                    int v;
+                    if(X<x||X>=x+S||Y<y||Y>=y+S) continue;
+                    if(X<mask.x||X>=mask.x+M||Y<mask.y||Y>=mask.y+M) continue;
+                    v=coverage[(Y-mask.y)*M+(X-mask.x)];
+                    if(v==0) continue;
+                    for(k=0;k<4;++k) scaled[k]=(k>=first?(c?c:white)[k]*((float)v/255.0f):(c?c:white)[k]);
+                    dbc_blit(1,1,S*ps,src+((Y-y)*S+(X-x))*ps,DW,DH,DW*dps,dst0,X,Y,(v<255&&first<4?scaled:c),mode);
+                }
+            dbc_blit_masked(S,S,S*ps,src,DW,DH,DW*dps,dst1,x,y,c,mode,&mask);
+            if(memcmp(dst0,dst1,(size_t)(DW*DH*dps))) ++bad;
+        }
+        printf("  %-20s| %s\n",modes[m].name,(bad?"DIFFERS":"ok"));
+    }
+    /* Timing: circular mask with antialiased edge, aligned to src. */
+    gen_sprite(src,S,DBCB_MODE_ALPHA,1,1);
+    for(Y=0;Y<S;++Y)
+        for(X=0;X<S;++X)
+        {
+            double r=sqrt((X-S/2+0.5)*(X-S/2+0.5)+(Y-S/2+0.5)*(Y-S/2+0.5));
+            double v=255.0*(S/2-r);
+            coverage[Y*S+X]=(unsigned char)(v<0.0?0.0:v>255.0?255.0:v);
+        }
+    mask.w=S;
+    mask.h=S;
+    mask.stride=S;
+    t0=(double)clock();
+    for(j=0;j<N;++j) dbc_blit(S,S,S*4,src,W,H,W*4,buffer,(j*37)%(W-S),(j*11)%(H-S),0,DBCB_MODE_ALPHA);
+    t0=(double)clock()-t0;
+    t1=(double)clock();
+    for(j=0;j<N;++j)
+    {
+        x=(j*37)%(W-S);
+        y=(j*11)%(H-S);
+        mask.x=x;
+        mask.y=y;
+        dbc_blit_masked(S,S,S*4,src,W,H,W*4,buffer,x,y,0,DBCB_MODE_ALPHA,&mask);
+    }
+    t1=(double)clock()-t1;
+    printf("  64x64 sprite, circular mask, DBCB_MODE_ALPHA:\n");
+    printf("  dbc_blit()       : %6.2f ns/blit.\n",1.0e+9*t0/CLOCKS_PER_SEC/(double)N);
+    printf("  dbc_blit_masked(): %6.2f ns/blit.\n",1.0e+9*t1/CLOCKS_PER_SEC/(double)N);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_tiled()
+{
+#define MODE(mode) {mode,#mode}
+    static const struct {int mode;const char *name;} modes[]={
+        MODE(DBCB_MODE_COPY),MODE(DBCB_MODE_ALPHA),MODE(DBCB_MODE_PMA),MODE(DBCB_MODE_COLORKEY8),
+        MODE(DBCB_MODE_COLORKEY16),MODE(DBCB_MODE_MUL),
+#ifndef DBC_BLIT_NO_GAMMA
+        MODE(DBCB_MODE_GAMMA),MODE(DBCB_MODE_HALF_ALPHA)
+#endif
+    };
+#undef MODE
+    static const int sizes[4]={1,7,16,100};
+    const int DW=W/4,DH=H/4,S=100;
+    float color[4]={1.0f,0.5f,0.25f,0.5f};
+    unsigned char *src=sprite;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    RNG rng;
+    int N=(online_compiler?200:1000);
+    int m,i,j,k,X,Y;
+    double t0,t1;
+    printf("Testing tiled fill.\n");
+    RNG_init(&rng,1);
+    for(m=0;m<(int)(sizeof(modes)/sizeof(modes[0]));++m)
+    {
+        int mode=modes[m].mode,ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+        int bad=0;
+        if(!(ps>0)) continue;
+        gen_sprite(src,S,mode,1,(dbcb_uint32)(m+1));
+        for(j=0;j<40;++j)
+        {
+            /* Odd j: nine-slice, even j: pattern fill. */
+            int sw=sizes[RNG_generate(&rng)%4u],sh=sizes[RNG_generate(&rng)%4u];
+            int x=(int)(RNG_generate(&rng)%(dbcb_uint32)DW)-DW/4,y=(int)(RNG_generate(&rng)%(dbcb_uint32)DH)-DH/4;
+            int w=(int)(RNG_generate(&rng)%(dbcb_uint32)DW),h=(int)(RNG_generate(&rng)%(dbcb_uint32)DH);
+            int px=(int)(RNG_generate(&rng)%64u)-32,py=(int)(RNG_generate(&rng)%64u)-32;
+            int l=(int)(RNG_generate(&rng)%(dbcb_uint32)(sw+1)),t=(int)(RNG_generate(&rng)%(dbcb_uint32)(sh+1));
+            int r=(int)(RNG_generate(&rng)%(dbcb_uint32)(sw-l+1)),b=(int)(RNG_generate(&rng)%(dbcb_uint32)(sh-t+1));
+            const float *c=(j&2?color:0);
+            for(i=0;i<DW*DH*dps;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+            if(dps==8) for(i=0;i<DW*DH*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),dst0+i*2);
+            memcpy(dst1,dst0,(size_t)(DW*DH*dps));
+            /* Reference: pixel by pixel. */
+            for(Y=(y>0?y:0);Y<y+h&&Y<DH;++Y)
+                for(X=(x>0?x:0);X<x+w&&X<DW;++X)
+                {
+                    int u,v;
+                    if(j&1)
+                    {
+                        int cl=(l<w?l:w),cr=(r<w-cl?r:w-cl),ct=(t<h?t:h),cb=(b<h-ct?b:h-ct);
+                        int dx=X-x,dy=Y-y;
+                        if(dx<cl) u=dx; else if(dx>=w-cr) u=sw-r+(dx-(w-cr)); else if(sw-l-r>0) u=l+(dx-cl)%(sw-l-r); else continue;
+                        if(dy<ct) v=dy; else if(dy>=h-cb) v=sh-b+(dy-(h-cb)); else if(sh-t-b>0) v=t+(dy-ct)%(sh-t-b); else continue;
+                    }
+                    else
+                    {
+                        u=((X-x+px)%sw+sw)%sw;
+                        v=((Y-y+py)%sh+sh)%sh;
+                    }
+                    dbc_blit(1,1,S*ps,src+(v*S+u)*ps,DW,DH,DW*dps,dst0,X,Y,c,mode);
+                }
+            if(j&1) dbc_blit_nine_slice(sw,sh,S*ps,src,DW,DH,DW*dps,dst1,x,y,w,h,l,t,r,b,c,mode);
+            else    dbc_blit_tiled(sw,sh,S*ps,src,DW,DH,DW*dps,dst1,x,y,w,h,px,py,c,mode);
+            if(memcmp(dst0,dst1,(size_t)(DW*DH*dps))) ++bad;
+        }
+        printf("  %-20s| %s\n",modes[m].name,(bad?"DIFFERS":"ok"));
+    }
+    /* Timing: 8x8, 16x16, and 32x32 patterns over the whole dst. */
+    for(m=8;m<=32;m*=2)
+    {
+        gen_sprite(src,m,DBCB_MODE_ALPHA,1,1);
+        t0=(double)clock();
+        for(k=0;k<N;++k)
+            for(Y=0;Y<H;Y+=m)
+                for(X=0;X<W;X+=m)
+                    dbc_blit(m,m,m*4,src,W,H,W*4,buffer,X,Y,0,DBCB_MODE_ALPHA);
+        t0=(double)clock()-t0;
+        t1=(double)clock();
+        for(k=0;k<N;++k) dbc_blit_tiled(m,m,m*4,src,W,H,W*4,buffer,0,0,W,H,0,0,0,DBCB_MODE_ALPHA);
+        t1=(double)clock()-t1;
+        printf("  %dx%d pattern over %dx%d, DBCB_MODE_ALPHA:\n",m,m,W,H);
+        printf("  dbc_blit() per tile: %6.3f ms/fill.\n",1.0e+3*t0/CLOCKS_PER_SEC/(double)N);
+        printf("  dbc_blit_tiled()   : %6.3f ms/fill.\n",1.0e+3*t1/CLOCKS_PER_SEC/(double)N);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_gradient()
+{
+#define MODE(mode) {mode,#mode}
+    static const struct {int mode;const char *name;} modes[]={
+        MODE(DBCB_MODE_COPY),MODE(DBCB_MODE_ALPHA),MODE(DBCB_MODE_PMA),MODE(DBCB_MODE_COLORKEY8),
+        MODE(DBCB_MODE_MUL),
+#ifndef DBC_BLIT_NO_GAMMA
+        MODE(DBCB_MODE_CPYG),MODE(DBCB_MODE_GAMMA),MODE(DBCB_MODE_PMG),MODE(DBCB_MODE_MUG),
+        MODE(DBCB_MODE_HALF_ALPHA),MODE(DBCB_MODE_HALF_RESOLVE)
+#endif
+    };
+#undef MODE
+    const int S=100,DW=W/4,DH=H/4;
+    float corners[16],color[4];
+    unsigned char *src=sprite,*grad=sprite+S*S*8;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    RNG rng;
+    int N=(online_compiler?20:100);
+    int m,i,j,k,X,Y;
+    double t0,t1,t2;
+    printf("Testing gradient modulation.\n");
+    RNG_init(&rng,1);
+    for(m=0;m<(int)(sizeof(modes)/sizeof(modes[0]));++m)
+    {
+        int mode=modes[m].mode,ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+        int bad=0;
+        if(!(ps>0)) continue;
+        gen_sprite(src,S,mode,1,(dbcb_uint32)(m+1));
+        for(j=0;j<20;++j)
+        {
+            int sw=1+(int)(RNG_generate(&rng)%(dbcb_uint32)S),sh=1+(int)(RNG_generate(&rng)%(dbcb_uint32)S);
+            int x=(int)(RNG_generate(&rng)%(dbcb_uint32)DW)-DW/4,y=(int)(RNG_generate(&rng)%(dbcb_uint32)DH)-DH/4;
+            /* No colors above 1 for half-float dst: cancellation makes off by 1 relative. */
+            for(i=0;i<16;++i) corners[i]=(float)(RNG_generate(&rng)%(dps==8?1001u:1200u))/1000.0f;
+            for(i=0;i<DW*DH*dps;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+            if(dps==8) for(i=0;i<DW*DH*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),dst0+i*2);
+            memcpy(dst1,dst0,(size_t)(DW*DH*dps));
+            /* Reference: pixel by pixel, with exactly interpolated color. */
+            for(Y=0;Y<sh;++Y)
+                for(X=0;X<sw;++X)
+                {
+                    float fx=(sw>1?(float)X/(float)(sw-1):0.0f),fy=(sh>1?(float)Y/(float)(sh-1):0.0f);
+                    for(k=0;k<4;++k)
+                    {
+                        float l=corners[k]+(corners[8+k]-corners[k])*fy;
+                        float r=corners[4+k]+(corners[12+k]-corners[4+k])*fy;
+                        color[k]=l+(r-l)*fx;
+                    }
+                    if(mode==DBCB_MODE_COLORKEY8) memcpy(color,corners,sizeof(color));
+                    dbc_blit(1,1,S*ps,src+(Y*S+X)*ps,DW,DH,DW*dps,dst0,x+X,y+Y,color,mode);
+                }
+            dbc_blit_gradient(sw,sh,S*ps,src,DW,DH,DW*dps,dst1,x,y,corners,mode);
+            /* Off by 1 is allowed (per byte, or per half). */
+            if(dps==8)
+            {
+                for(i=0;i<DW*DH*4;++i)
+                {
+                    int a=(int)dbcb_load16(dst0+i*2),b=(int)dbcb_load16(dst1+i*2);
+                    if(a-b>1||b-a>1) {++bad;break;}
+                }
+            }
+            else
+            {
+                int tolerance=(mode==DBCB_MODE_COLORKEY8?0:1);
+                for(i=0;i<DW*DH*dps;++i)
+                    if(dst0[i]-dst1[i]>tolerance||dst1[i]-dst0[i]>tolerance) {++bad;break;}
+            }
+        }
+        printf("  %-20s| %s\n",modes[m].name,(bad?"DIFFERS":"ok"));
+    }
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+    /* Rows of all tiers must match exactly (not MUL: its C kernel rounds differently, rarely). */
+    {
+        static const int row_modes[]={
+            DBCB_MODE_COPY,DBCB_MODE_ALPHA,DBCB_MODE_PMA,
+#ifndef DBC_BLIT_NO_GAMMA
+            DBCB_MODE_CPYG,DBCB_MODE_GAMMA,DBCB_MODE_PMG,DBCB_MODE_MUG,
+            DBCB_MODE_HALF_ALPHA,DBCB_MODE_HALF_PMA,DBCB_MODE_HALF_MUL,DBCB_MODE_HALF_RESOLVE
+#endif
+        };
+        int bad=0;
+        float c[4],dc[4];
+        gen_sprite(src,S,DBCB_MODE_ALPHA,1,1);
+        /* Half-float src for DBCB_MODE_HALF_RESOLVE. */
+        for(i=0;i<S*S*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),grad+i*2);
+        for(j=0;j<1000;++j)
+        {
+            int n=1+(int)(RNG_generate(&rng)%40u),t;
+            /* Colors stay in [0;1]: C kernels do not clamp alpha above 1. */
+            for(i=0;i<4;++i) c[i]=(float)(100u+RNG_generate(&rng)%800u)/1000.0f;
+            for(i=0;i<4;++i) dc[i]=((float)(RNG_generate(&rng)%2001u)-1000.0f)/400000.0f;
+            for(i=0;i<n*4;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+            /* Half-float dst, finite. */
+            for(i=0;i<n*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),dst0+n*4+i*2);
+            for(t=DBCB_STATS_TIER_SSE2;t<=DBCB_STATS_TIER_AVX2;t+=2)
+            {
+#ifndef DBC_BLIT_NO_AVX2
+                if(t==DBCB_STATS_TIER_AVX2&&!DBCB_HAS_AVX2) continue;
+#endif
+                for(m=0;m<(int)(sizeof(row_modes)/sizeof(row_modes[0]));++m)
+                {
+                    int mode=row_modes[m],ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+                    const unsigned char *s=(ps==8?grad:src)+j%S*ps;
+                    const unsigned char *d=(dps==8?dst0+n*4:dst0);
+#ifndef DBC_BLIT_NO_AVX2
+                    if(mode>=DBCB_MODE_HALF_ALPHA&&(t!=DBCB_STATS_TIER_AVX2||!DBCB_HAS_F16C)) continue;
+#else
+                    if(mode>=DBCB_MODE_HALF_ALPHA) continue;
+#endif
+                    memcpy(dst1,d,(size_t)(n*dps));
+                    memcpy(dst1+n*dps,d,(size_t)(n*dps));
+                    dbcB_gradient_row(mode,DBCB_STATS_TIER_C,s,dst1,n,c,dc);
+                    dbcB_gradient_row(mode,t,s,dst1+n*dps,n,c,dc);
+                    if(memcmp(dst1,dst1+n*dps,(size_t)(n*dps))) ++bad;
+                }
+            }
+        }
+        printf("  %-20s| %s\n","SIMD rows vs C",(bad?"DIFFERS":"ok"));
+    }
+    /* Same for fixed-point rows, all four modes, with sums in range over the row. */
+    {
+        int bad=0;
+        dbcb_uint32 c[4],dc[4];
+        gen_sprite(src,S,DBCB_MODE_ALPHA,1,2);
+        for(j=0;j<2000;++j)
+        {
+            int n=1+(int)(RNG_generate(&rng)%40u),t;
+            const unsigned char *s=src+(j%S*S+(int)(RNG_generate(&rng)%(dbcb_uint32)(S-n)))*4;
+            for(i=0;i<4;++i)
+            {
+                dbcb_uint32 a=RNG_generate(&rng),b=RNG_generate(&rng);
+                if(n<2) b=a;
+                c[i]=a;
+                dc[i]=(b>=a?(b-a)/(dbcb_uint32)(n>1?n-1:1):0u-(a-b)/(dbcb_uint32)(n>1?n-1:1));
+            }
+            /* Opaque rows, for the early-outs. */
+            if(j%3==0) {c[3]=0xFFFF0000u|(RNG_generate(&rng)&0xFFFFu); dc[3]=0;}
+            for(i=0;i<n*4;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+            for(t=DBCB_STATS_TIER_SSE2;t<=DBCB_STATS_TIER_AVX2;++t)
+            {
+#ifndef DBC_BLIT_NO_SSE41
+                if(t==DBCB_STATS_TIER_SSE41&&!DBCB_HAS_SSE41) continue;
+#endif
+#ifndef DBC_BLIT_NO_AVX2
+                if(t==DBCB_STATS_TIER_AVX2&&!DBCB_HAS_AVX2) continue;
+#endif
+                for(m=DBCB_MODE_COPY;m<=DBCB_MODE_MUL;++m)
+                {
+                    if(m!=DBCB_MODE_COPY&&m!=DBCB_MODE_ALPHA&&m!=DBCB_MODE_PMA&&m!=DBCB_MODE_MUL) continue;
+                    memcpy(dst1,dst0,(size_t)(n*4));
+                    memcpy(dst1+n*4,dst0,(size_t)(n*4));
+                    dbcB_gradient_row_k(m,DBCB_STATS_TIER_C,s,dst1,n,c,dc);
+                    dbcB_gradient_row_k(m,t,s,dst1+n*4,n,c,dc);
+                    if(memcmp(dst1,dst1+n*4,(size_t)(n*4))) ++bad;
+                }
+            }
+        }
+        printf("  %-20s| %s\n","Fixed rows vs C",(bad?"DIFFERS":"ok"));
+    }
+#endif
+    /* Timing: vignette over the whole dst, vs. gradient surface and DBCB_MODE_MUL. */
+    for(i=0;i<16;++i) corners[i]=(i%4==3?1.0f:(i==0||i==15?1.0f:0.25f));
+    gen_sprite(src,S,DBCB_MODE_ALPHA,1,1);
+    for(Y=0;Y<S;++Y)
+        for(X=0;X<S;++X)
+            for(k=0;k<4;++k)
+            {
+                float fx=(float)X/(float)(S-1),fy=(float)Y/(float)(S-1);
+                float l=corners[k]+(corners[8+k]-corners[k])*fy;
+                float r=corners[4+k]+(corners[12+k]-corners[4+k])*fy;
+                grad[(Y*S+X)*4+k]=(unsigned char)(255.0f*(l+(r-l)*fx)+0.5f);
+            }
+    t0=(double)clock();
+    for(k=0;k<N;++k)
+        for(Y=0;Y<H;Y+=S)
+            for(X=0;X<W;X+=S)
+                dbc_blit(S,S,S*4,src,W,H,W*4,buffer,X,Y,corners,DBCB_MODE_ALPHA);
+    t0=(double)clock()-t0;
+    t1=(double)clock();
+    for(k=0;k<N;++k)
+        for(Y=0;Y<H;Y+=S)
+            for(X=0;X<W;X+=S)
+            {
+                dbc_blit(S,S,S*4,src,W,H,W*4,buffer,X,Y,0,DBCB_MODE_ALPHA);
+                dbc_blit(S,S,S*4,grad,W,H,W*4,buffer,X,Y,0,DBCB_MODE_MUL);
+            }
+    t1=(double)clock()-t1;
+    t2=(double)clock();
+    for(k=0;k<N;++k)
+        for(Y=0;Y<H;Y+=S)
+            for(X=0;X<W;X+=S)
+                dbc_blit_gradient(S,S,S*4,src,W,H,W*4,buffer,X,Y,corners,DBCB_MODE_ALPHA);
+    t2=(double)clock()-t2;
+    printf("  %dx%d sprites over %dx%d, DBCB_MODE_ALPHA:\n",S,S,W,H);
+    printf("  dbc_blit(), constant color: %6.3f ms/frame.\n",1.0e+3*t0/CLOCKS_PER_SEC/(double)N);
+    printf("  dbc_blit(), then MUL pass : %6.3f ms/frame.\n",1.0e+3*t1/CLOCKS_PER_SEC/(double)N);
+    printf("  dbc_blit_gradient()       : %6.3f ms/frame.\n",1.0e+3*t2/CLOCKS_PER_SEC/(double)N);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_cmdbuf()
+{
+#define MODE(mode) {mode,#mode}
+    static const struct {int mode;const char *name;} modes[]={
+        MODE(DBCB_MODE_COPY),MODE(DBCB_MODE_ALPHA),MODE(DBCB_MODE_PMA),MODE(DBCB_MODE_COLORKEY8),
+        MODE(DBCB_MODE_MUL),MODE(DBCB_MODE_ALPHATEST),
+#ifndef DBC_BLIT_NO_GAMMA
+        MODE(DBCB_MODE_GAMMA),MODE(DBCB_MODE_HALF_ALPHA)
+#endif
+    };
+#undef MODE
+    enum {CAPACITY=1000};
+    static dbcb_layer layers[CAPACITY];
+    static float colors[4*CAPACITY];
+    const int S=64,DW=W/2,DH=H/2;
+    unsigned char *src=sprite;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    dbcb_cmdbuf buf;
+    RNG rng;
+    int N=(online_compiler?20:100);
+    int m,i,j,k;
+    double t0,t1,t2;
+    printf("Testing command buffers.\n");
+    RNG_init(&rng,1);
+    dbcb_cmdbuf_init(&buf,layers,colors,CAPACITY);
+    for(m=0;m<(int)(sizeof(modes)/sizeof(modes[0]));++m)
+    {
+        int mode=modes[m].mode,ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+        int bad=0;
+        if(!(ps>0)) continue;
+        gen_sprite(src,S,mode,1,(dbcb_uint32)(m+1));
+        for(i=0;i<DW*DH*dps;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+        if(dps==8) for(i=0;i<DW*DH*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),dst0+i*2);
+        memcpy(dst1,dst0,(size_t)(DW*DH*dps));
+        dbcb_cmdbuf_clear(&buf);
+        for(j=0;j<200;++j)
+        {
+            int w=1+(int)(RNG_generate(&rng)%(dbcb_uint32)S),h=1+(int)(RNG_generate(&rng)%(dbcb_uint32)S);
+            int x=(int)(RNG_generate(&rng)%(dbcb_uint32)(DW+S))-S,y=(int)(RNG_generate(&rng)%(dbcb_uint32)(DH+S))-S;
+            float color[4];
+            for(k=0;k<4;++k) color[k]=(float)(RNG_generate(&rng)%1000u)/1000.0f;
+            if(mode==DBCB_MODE_ALPHATEST) color[0]=73.0f;
+            dbc_blit(w,h,S*ps,src,DW,DH,DW*dps,dst0,x,y,(j&1?color:0),mode);
+            if(!dbcb_cmdbuf_blit(&buf,w,h,S*ps,src,x,y,(j&1?color:0),mode)) ++bad;
+            /* The buffer keeps its own copy of the color. */
+            for(k=0;k<4;++k) color[k]=-1.0f;
+        }
+        dbc_blit_cmdbuf(DW,DH,DW*dps,dst1,&buf);
+        if(memcmp(dst0,dst1,(size_t)(DW*DH*dps))) ++bad;
+        printf("  %-20s| %s\n",modes[m].name,(bad?"DIFFERS":"ok"));
+    }
+    /* Full buffer drops blits. */
+    {
+        dbcb_cmdbuf small;
+        dbcb_cmdbuf_init(&small,layers,colors,16);
+        for(j=0;j<20;++j) dbcb_cmdbuf_blit(&small,S,S,S*4,src,0,0,0,DBCB_MODE_ALPHA);
+        printf("  %-20s| %s\n","Overflow",(small.count==16&&small.dropped==4?"ok":"DIFFERS"));
+    }
+    /* Timing: 1000 64x64 sprites, direct vs. recorded then executed. */
+    gen_sprite(src,S,DBCB_MODE_ALPHA,1,1);
+    t0=(double)clock();
+    for(k=0;k<N;++k)
+    {
+        RNG_init(&rng,1);
+        for(j=0;j<CAPACITY;++j)
+            dbc_blit(S,S,S*4,src,W,H,W*4,buffer,
+                (int)(RNG_generate(&rng)%(dbcb_uint32)(W-S)),(int)(RNG_generate(&rng)%(dbcb_uint32)(H-S)),0,DBCB_MODE_ALPHA);
+    }
+    t0=(double)clock()-t0;
+    t1=t2=0.0;
+    for(k=0;k<N;++k)
+    {
+        double t=(double)clock();
+        RNG_init(&rng,1);
+        dbcb_cmdbuf_clear(&buf);
+        for(j=0;j<CAPACITY;++j)
+            dbcb_cmdbuf_blit(&buf,S,S,S*4,src,
+                (int)(RNG_generate(&rng)%(dbcb_uint32)(W-S)),(int)(RNG_generate(&rng)%(dbcb_uint32)(H-S)),0,DBCB_MODE_ALPHA);
+        t1+=(double)clock()-t;
+        t=(double)clock();
+        dbc_blit_cmdbuf(W,H,W*4,buffer,&buf);
+        t2+=(double)clock()-t;
+    }
+    printf("  %d %dx%d sprites over %dx%d, DBCB_MODE_ALPHA:\n",CAPACITY,S,S,W,H);
+    printf("  dbc_blit()         : %7.3f ms/frame.\n",1.0e+3*t0/CLOCKS_PER_SEC/(double)N);
+    printf("  dbcb_cmdbuf_blit() : %7.3f ms/frame (producer).\n",1.0e+3*t1/CLOCKS_PER_SEC/(double)N);
+    printf("  dbc_blit_cmdbuf()  : %7.3f ms/frame (compositor).\n",1.0e+3*t2/CLOCKS_PER_SEC/(double)N);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_tiled_fb()
+{
+#define MODE(mode) {mode,#mode}
+    static const struct {int mode;const char *name;} modes[]={
+        MODE(DBCB_MODE_COPY),MODE(DBCB_MODE_ALPHA),MODE(DBCB_MODE_PMA),MODE(DBCB_MODE_COLORKEY8),
+        MODE(DBCB_MODE_COLORKEY16),MODE(DBCB_MODE_MUL),
+#ifndef DBC_BLIT_NO_GAMMA
+        MODE(DBCB_MODE_GAMMA),MODE(DBCB_MODE_HALF_ALPHA)
+#endif
+    };
+#undef MODE
+    const int S=64,T=DBCB_FB_TILE,DW=W/2-7,DH=H/2-5;
+    unsigned char *src=sprite,*tiled=sprite+20*1024*1024;
+    unsigned char *dst0=buffer,*dst1=buffer+W*H*4;
+    RNG rng;
+    int N=(online_compiler?20:100);
+    int m,i,j,k;
+    double t0,t1,t2;
+    printf("Testing tiled framebuffer.\n");
+    RNG_init(&rng,1);
+    for(m=0;m<(int)(sizeof(modes)/sizeof(modes[0]));++m)
+    {
+        int mode=modes[m].mode,ps=mode_src_pixel_size(mode),dps=mode_pixel_size(mode);
+        int bad=0;
+        if(!(ps>0)) continue;
+        gen_sprite(src,S,mode,1,(dbcb_uint32)(m+1));
+        for(i=0;i<DW*DH*dps;++i) dst0[i]=(unsigned char)RNG_generate(&rng);
+        if(dps==8) for(i=0;i<DW*DH*4;++i) dbcb_store16((dbcb_uint16)(RNG_generate(&rng)%0x7C00u),dst0+i*2);
+        dbcb_tiled_fb_load(DW,DH,dps,DW*dps,dst0,tiled);
+        for(j=0;j<200;++j)
+        {
+            int w=1+(int)(RNG_generate(&rng)%(dbcb_uint32)S),h=1+(int)(RNG_generate(&rng)%(dbcb_uint32)S);
+            int x=(int)(RNG_generate(&rng)%(dbcb_uint32)(DW+S))-S,y=(int)(RNG_generate(&rng)%(dbcb_uint32)(DH+S))-S;
+            float color[4];
+            for(k=0;k<4;++k) color[k]=(float)(RNG_generate(&rng)%1000u)/1000.0f;
+            dbc_blit(w,h,S*ps,src,DW,DH,DW*dps,dst0,x,y,(j&1?color:0),mode);
+            dbc_blit_tiled_fb(w,h,S*ps,src,DW,DH,tiled,x,y,(j&1?color:0),mode);
+        }
+        memset(dst1,0,(size_t)(DW*DH*dps));
+        dbcb_tiled_fb_detile(DW,DH,dps,tiled,DW*dps,dst1);
+        if(memcmp(dst0,dst1,(size_t)(DW*DH*dps))) ++bad;
+        printf("  %-20s| %s\n",modes[m].name,(bad?"DIFFERS":"ok"));
+    }
+    printf("  %-20s| %s\n","Size",(dbcb_tiled_fb_size(DW,DH,4)==((DW+T-1)/T)*((DH+T-1)/T)*T*T*4&&dbcb_tiled_fb_size(0,DH,4)==0&&dbcb_tiled_fb_size(32768,32768,4)==0&&dbcb_tiled_fb_size(32768,16384,2)==1024*1024*1024?"ok":"DIFFERS"));
+    /* Timing: 1000 64x64 sprites, linear vs. tiled, and the detile pass. */
+    gen_sprite(src,S,DBCB_MODE_ALPHA,1,1);
+    for(m=0;m<2;++m)
+    {
+        /* Framebuffer that fits in L2, and one that does not. */
+        int FW=(m?2048:W),FH=(m?2048:H);
+        unsigned char *linear=(m?sprite+1024*1024:buffer);
+        t0=(double)clock();
+        for(k=0;k<N;++k)
+        {
+            RNG_init(&rng,1);
+            for(j=0;j<1000;++j)
+                dbc_blit(S,S,S*4,src,FW,FH,FW*4,linear,
+                    (int)(RNG_generate(&rng)%(dbcb_uint32)(FW-S)),(int)(RNG_generate(&rng)%(dbcb_uint32)(FH-S)),0,DBCB_MODE_ALPHA);
+        }
+        t0=(double)clock()-t0;
+        t1=(double)clock();
+        for(k=0;k<N;++k)
+        {
+            RNG_init(&rng,1);
+            for(j=0;j<1000;++j)
+                dbc_blit_tiled_fb(S,S,S*4,src,FW,FH,tiled,
+                    (int)(RNG_generate(&rng)%(dbcb_uint32)(FW-S)),(int)(RNG_generate(&rng)%(dbcb_uint32)(FH-S)),0,DBCB_MODE_ALPHA);
+        }
+        t1=(double)clock()-t1;
+        t2=(double)clock();
+        for(k=0;k<N;++k) dbcb_tiled_fb_detile(FW,FH,4,tiled,FW*4,linear);
+        t2=(double)clock()-t2;
+        printf("  1000 %dx%d sprites over %dx%d, DBCB_MODE_ALPHA:\n",S,S,FW,FH);
+        printf("  Linear             : %7.3f ms/frame.\n",1.0e+3*t0/CLOCKS_PER_SEC/(double)N);
+        printf("  Tiled              : %7.3f ms/frame.\n",1.0e+3*t1/CLOCKS_PER_SEC/(double)N);
+        printf("  Detile             : %7.3f ms/frame.\n",1.0e+3*t2/CLOCKS_PER_SEC/(double)N);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+#ifdef DBC_BLIT_AUTOTUNE
+static void test_autotune()
+{
+    static const char *names[16]={
+        "DBCB_MODE_COPY","DBCB_MODE_ALPHA","DBCB_MODE_PMA","DBCB_MODE_GAMMA",
+        "DBCB_MODE_PMG","DBCB_MODE_COLORKEY8","DBCB_MODE_COLORKEY16","DBCB_MODE_5551",
+        "DBCB_MODE_MUL","DBCB_MODE_MUG","DBCB_MODE_ALPHATEST","DBCB_MODE_CPYG",
+        "DBCB_MODE_HALF_ALPHA","DBCB_MODE_HALF_PMA","DBCB_MODE_HALF_MUL","DBCB_MODE_HALF_RESOLVE"};
+    static const char tiers[6]="-CS4A";
+    unsigned char saved[sizeof(dbcB_tune_tier)+sizeof(dbcB_tune_no_unroll)];
+    const char *filename="dbc_blit.tune";
+    int mode,modulated,b;
+    double t;
+    printf("Autotuning.\n");
+    fflush(stdout);
+    t=(double)clock();
+    dbcb_autotune();
+    t=((double)clock()-t)/CLOCKS_PER_SEC;
+    printf("  Done in %.2f s.\n",t);
+    printf("  Tier (C/SSE2/SSE4.1/AVX2) for widths <=8/<=32/<=128/more, and unrolling:\n");
+    printf("                        |Non-modulated|  Modulated  |\n");
+    for(mode=0;mode<16;++mode)
+    {
+        printf("  %-22s|",names[mode]);
+        for(modulated=0;modulated<2;++modulated)
+        {
+            printf(" ");
+            for(b=0;b<DBCB_TUNE_BUCKETS;++b) printf("%c",tiers[dbcB_tune_tier[mode][modulated][b]]);
+            printf(" %-6s|",(dbcB_tune_no_unroll[mode][modulated]?"-":"unroll"));
+        }
+        printf("\n");
+    }
+    if(!online_compiler)
+    {
+        int ok;
+        memcpy(saved,dbcB_tune_tier,sizeof(dbcB_tune_tier));
+        memcpy(saved+sizeof(dbcB_tune_tier),dbcB_tune_no_unroll,sizeof(dbcB_tune_no_unroll));
+        ok=dbcb_autotune_save(filename);
+        memset(dbcB_tune_tier,0,sizeof(dbcB_tune_tier));
+        memset(dbcB_tune_no_unroll,0,sizeof(dbcB_tune_no_unroll));
+        ok=ok&&dbcb_autotune_load(filename);
+        ok=ok&&!memcmp(saved,dbcB_tune_tier,sizeof(dbcB_tune_tier));
+        ok=ok&&!memcmp(saved+sizeof(dbcB_tune_tier),dbcB_tune_no_unroll,sizeof(dbcB_tune_no_unroll));
+        printf("  Save/load: %s.\n",(ok?"ok":"DIFFERS"));
+        remove(filename);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+#endif /* DBC_BLIT_AUTOTUNE */
+
+#ifdef DBC_BLIT_STATS
+static void test_stats()
+{
+    /* 4x2 sprite: transparent, opaque, and 2 blended pixels per row. */
+    static const dbcb_uint32 src[8]={
+        0x00112233u,0xFF445566u,0x80778899u,0x01AABBCCu,
+        0x00112233u,0xFF445566u,0x80778899u,0x01AABBCCu};
+    unsigned char s[8*4],d[8*8*4];
+    static const float corners[16]={
+        1.0f,1.0f,1.0f,1.0f, 1.0f,0.5f,0.5f,1.0f,
+        0.5f,1.0f,0.5f,0.5f, 0.25f,0.25f,1.0f,0.5f};
+    dbcb_stats stats;
+    double calls=0.0,pixels=0.0;
+    int i,ok=1,counted;
+    printf("Testing statistics.\n");
+    for(i=0;i<8;++i) dbcb_store32(src[i],s+4*i);
+    memset(d,0,sizeof(d));
+    dbcb_stats_reset();
+    /* Left column clipped away. */
+    dbc_blit(4,2,16,s,8,8,32,d,-1,3,0,DBCB_MODE_ALPHA);
+    dbcb_stats_snapshot(&stats);
+    for(i=0;i<DBCB_STATS_TIERS;++i)
+    {
+        calls+=stats.calls[DBCB_MODE_ALPHA][i];
+        pixels+=stats.pixels[DBCB_MODE_ALPHA][i];
+    }
+    ok=ok&&calls==1.0&&pixels==6.0&&stats.clipped[DBCB_MODE_ALPHA]==2.0;
+    counted=(stats.calls[DBCB_MODE_ALPHA][DBCB_STATS_TIER_C]==1.0);
+    if(counted)
+        ok=ok&&stats.transparent[DBCB_MODE_ALPHA]==0.0
+             &&stats.opaque[DBCB_MODE_ALPHA]==2.0
+             &&stats.blended[DBCB_MODE_ALPHA]==4.0;
+    else
+        ok=ok&&stats.opaque[DBCB_MODE_ALPHA]==0.0
+             &&stats.blended[DBCB_MODE_ALPHA]==0.0;
+    /* Fully clipped: not a call, only clipped pixels. */
+    dbcb_stats_reset();
+    dbc_blit(4,2,16,s,8,8,32,d,9,3,0,DBCB_MODE_ALPHA);
+    dbcb_stats_snapshot(&stats);
+    for(i=0;i<DBCB_STATS_TIERS;++i)
+        ok=ok&&stats.calls[DBCB_MODE_ALPHA][i]==0.0;
+    ok=ok&&stats.clipped[DBCB_MODE_ALPHA]==8.0;
+    /* Gradient: counted the same way. */
+    dbcb_stats_reset();
+    dbc_blit_gradient(4,2,16,s,8,8,32,d,-1,3,corners,DBCB_MODE_ALPHA);
+    dbcb_stats_snapshot(&stats);
+    calls=pixels=0.0;
+    for(i=0;i<DBCB_STATS_TIERS;++i)
+    {
+        calls+=stats.calls[DBCB_MODE_ALPHA][i];
+        pixels+=stats.pixels[DBCB_MODE_ALPHA][i];
+    }
+    ok=ok&&calls==1.0&&pixels==6.0&&stats.clipped[DBCB_MODE_ALPHA]==2.0;
+    dbcb_stats_reset();
+    dbcb_stats_snapshot(&stats);
+    ok=ok&&stats.calls[DBCB_MODE_ALPHA][DBCB_STATS_TIER_C]==0.0&&stats.clipped[DBCB_MODE_ALPHA]==0.0;
+    printf("  Counters%s: %s.\n",(counted?"":" (SIMD, no per-pixel classes)"),(ok?"ok":"DIFFERS"));
+    printf("\n");
+    fflush(stdout);
+}
+#endif /* DBC_BLIT_STATS */
+
+#ifdef CHECK_TRACE
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static FILE *trace_file;
+static double trace_start;
+static int trace_spans,trace_depth;
+
+/* Monotonic wall time, in seconds (clock() is CPU time, not a timeline). */
+static double trace_now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER c,f;
+    QueryPerformanceCounter(&c);
+    QueryPerformanceFrequency(&f);
+    return (double)c.QuadPart/(double)f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec+1.0e-9*(double)ts.tv_nsec;
+#endif
+}
+
+static double trace_us()
+{
+    return 1.0e+6*(trace_now()-trace_start);
+}
+
+static void trace_begin(int mode,int w,int h,int tier)
+{
+    static const char *names[16]={
+        "COPY","ALPHA","PMA","GAMMA","PMG","COLORKEY8","COLORKEY16","5551",
+        "MUL","MUG","ALPHATEST","CPYG","HALF_ALPHA","HALF_PMA","HALF_MUL","HALF_RESOLVE"};
+    static const char *tiers[DBCB_STATS_TIERS]={"C","SSE2","SSE4.1","AVX2"};
+    if(!trace_file) return;
+    fprintf(trace_file,"%s{\"name\":\"%s\",\"cat\":\"dbc_blit\",\"ph\":\"B\",\"pid\":1,\"tid\":1,\"ts\":%.3f,"
+        "\"args\":{\"w\":%d,\"h\":%d,\"tier\":\"%s\"}}",
+        (trace_spans?",\n":""),names[mode],trace_us(),w,h,tiers[tier]);
+    ++trace_spans;
+    ++trace_depth;
+}
+
+static void trace_end(void)
+{
+    if(!trace_file) return;
+    fprintf(trace_file,",\n{\"ph\":\"E\",\"pid\":1,\"tid\":1,\"ts\":%.3f}",trace_us());
+    --trace_depth;
+}
+
+static void test_trace()
+{
+    const char *filename="dbc_blit_trace.json";
+    dbcb_layer layers[5];
+    int count,i;
+    printf("Tracing.\n");
+    if(online_compiler) {printf("  Skipped.\n\n");return;}
+    trace_file=fopen(filename,"wb");
+    if(!trace_file) {printf("  Can't open %s.\n\n",filename);return;}
+    trace_start=trace_now();
+    trace_spans=trace_depth=0;
+    fprintf(trace_file,"{\"traceEvents\":[\n");
+    count=gen_layers(layers);
+    for(i=0;i<count;++i)
+        dbc_blit(layers[i].w,layers[i].h,layers[i].stride,layers[i].pixels,W,H,W*4,buffer,layers[i].x,layers[i].y,layers[i].color,layers[i].mode);
+    dbc_blit_layers(W,H,W*4,buffer,layers,count);
+    fprintf(trace_file,"\n]}\n");
+    fclose(trace_file);
+    trace_file=0;
+    printf("  %d spans written to %s: %s.\n",trace_spans,filename,(trace_spans>=count&&trace_depth==0?"ok":"DIFFERS"));
+    printf("\n");
+    fflush(stdout);
+}
+#endif /* CHECK_TRACE */
+
+#ifdef CHECK_RECORD
+/*
+    Trace format: "DBCBTRC1", followed by records, made of little-endian
+    32-bit words. Frame end is a single 0. Blit is 1, src_id, src_w, src_h,
+    src_stride, dst_id, dst_w, dst_h, dst_stride, x, y, mode, flags; then
+    color (4 floats) if flags&1, and FNV-1a hash of src pixels if flags&2.
+    Surfaces are identified by pointer (id is the order of first use);
+    pixels themselves are not stored, so traces are safe to share.
+*/
+#define RECORD_SURFACES 1024
+static FILE *record_file;
+static int record_hashes;
+static const unsigned char *record_ptrs[RECORD_SURFACES];
+static int record_num_ptrs;
+static long record_blits,record_frames;
+
+static void record_put(dbcb_uint32 v)
+{
+    unsigned char b[4];
+    b[0]=(unsigned char)(v>> 0);
+    b[1]=(unsigned char)(v>> 8);
+    b[2]=(unsigned char)(v>>16);
+    b[3]=(unsigned char)(v>>24);
+    fwrite(b,1,4,record_file);
+}
+
+static dbcb_uint32 record_id(const unsigned char *p)
+{
+    int i;
+    for(i=0;i<record_num_ptrs;++i)
+        if(record_ptrs[i]==p) return (dbcb_uint32)i;
+    if(record_num_ptrs==RECORD_SURFACES) return RECORD_SURFACES-1; /* Table is full, share the last id. */
+    record_ptrs[record_num_ptrs]=p;
+    return (dbcb_uint32)record_num_ptrs++;
+}
+
+static void record_blit(
+    int src_w,int src_h,int src_stride,const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,const unsigned char *dst_pixels,
+    int x,int y,const float *color,int mode)
+{
+    int row=(mode>=DBCB_MODE_COPY&&mode<=DBCB_MODE_HALF_RESOLVE?src_w*mode_src_pixel_size(mode):0);
+    dbcb_uint32 flags=(color?1u:0u)|(record_hashes&&row>0&&src_h>0?2u:0u);
+    dbcb_uint32 u;
+    int i,j;
+    if(!record_file||!src_pixels||!dst_pixels) return;
+    record_put(1u);
+    record_put(record_id(src_pixels));
+    record_put((dbcb_uint32)src_w);
+    record_put((dbcb_uint32)src_h);
+    record_put((dbcb_uint32)src_stride);
+    record_put(record_id(dst_pixels));
+    record_put((dbcb_uint32)dst_w);
+    record_put((dbcb_uint32)dst_h);
+    record_put((dbcb_uint32)dst_stride);
+    record_put((dbcb_uint32)x);
+    record_put((dbcb_uint32)y);
+    record_put((dbcb_uint32)mode);
+    record_put(flags);
+    if(flags&1u)
+        for(i=0;i<4;++i) {memcpy(&u,color+i,4);record_put(u);}
+    if(flags&2u)
+    {
+        u=2166136261u;
+        for(j=0;j<src_h;++j)
+            for(i=0;i<row;++i)
+                u=(u^src_pixels[j*src_stride+i])*16777619u;
+        record_put(u);
+    }
+    ++record_blits;
+}
+
+static int record_open(const char *filename,int hashes)
+{
+    record_file=fopen(filename,"wb");
+    if(!record_file) return 0;
+    fwrite("DBCBTRC1",1,8,record_file);
+    record_hashes=hashes;
+    record_num_ptrs=0;
+    record_blits=record_frames=0;
+    return 1;
+}
+
+static void record_frame()
+{
+    if(!record_file) return;
+    record_put(0u);
+    ++record_frames;
+}
+
+static void record_close()
+{
+    if(record_file) fclose(record_file);
+    record_file=0;
+}
+
+typedef struct replay_surface
+{
+    size_t size,offset; /* Bytes needed after and before pixels pointer. */
+    int stride;         /* As first seen. */
+    int src_mode;       /* Mode of first use as src, -1 if never src. */
+    unsigned char *memory;
+} replay_surface;
+
+static dbcb_uint32 replay_get(const unsigned char *p)
+{
+    return (dbcb_uint32)p[0]|((dbcb_uint32)p[1]<<8)|((dbcb_uint32)p[2]<<16)|((dbcb_uint32)p[3]<<24);
+}
+
+static void replay_use(replay_surface *s,int w,int h,int stride,int src_mode)
+{
+    size_t a=(size_t)(stride<0?-stride:stride);
+    size_t size=(h>0?a*(size_t)(h-1):0)+(w>0?(size_t)w*8:0);
+    if(s->size==0&&s->offset==0) s->stride=stride;
+    if(size>s->size) s->size=size;
+    if(stride<0&&h>0&&a*(size_t)(h-1)>s->offset) s->offset=a*(size_t)(h-1);
+    if(s->src_mode<0&&src_mode>=0) s->src_mode=src_mode;
+}
+
+/* Re-executes a trace against synthetic surfaces, reports time per frame. */
+static void test_replay(const char *filename)
+{
+    static unsigned char tile[64*64*8];
+    const int passes=5;
+    replay_surface *surfaces=0;
+    unsigned char *data=0;
+    FILE *f;
+    long size=0,pos,frames=0,blits=0,frame;
+    int num_surfaces=0,pass,i,ok=1;
+    double best=-1.0,slowest=0.0;
+    printf("  Replaying %s.\n",filename);
+    f=fopen(filename,"rb");
+    if(f&&fseek(f,0,SEEK_END)==0) size=ftell(f);
+    if(f&&size>=8&&fseek(f,0,SEEK_SET)==0) data=(unsigned char*)malloc((size_t)size);
+    if(data&&fread(data,1,(size_t)size,f)!=(size_t)size) {free(data);data=0;}
+    if(f) fclose(f);
+    if(!data||memcmp(data,"DBCBTRC1",8)!=0) {printf("  Can't read trace.\n\n");free(data);return;}
+    surfaces=(replay_surface*)calloc(RECORD_SURFACES,sizeof(replay_surface));
+    if(!surfaces) {printf("  Out of memory.\n\n");free(data);return;}
+    for(i=0;i<RECORD_SURFACES;++i) surfaces[i].src_mode=-1;
+    /* First pass: validate, and collect surface sizes. */
+    for(pos=8;ok&&pos+4<=size;)
+    {
+        const unsigned char *r=data+pos;
+        dbcb_uint32 flags,src_id,dst_id;
+        if(replay_get(r)==0u) {++frames;pos+=4;continue;}
+        if(replay_get(r)!=1u||pos+13*4>size) {ok=0;break;}
+        src_id=replay_get(r+4);
+        dst_id=replay_get(r+20);
+        flags=replay_get(r+48);
+        if(src_id>=RECORD_SURFACES||dst_id>=RECORD_SURFACES||flags>3u) {ok=0;break;}
+        replay_use(&surfaces[src_id],(int)replay_get(r+8),(int)replay_get(r+12),(int)replay_get(r+16),(int)replay_get(r+44));
+        replay_use(&surfaces[dst_id],(int)replay_get(r+24),(int)replay_get(r+28),(int)replay_get(r+32),-1);
+        if((int)src_id>=num_surfaces) num_surfaces=(int)src_id+1;
+        if((int)dst_id>=num_surfaces) num_surfaces=(int)dst_id+1;
+        pos+=13*4+((flags&1u)?16:0)+((flags&2u)?4:0);
+        ++blits;
+    }
+    if(!ok||pos!=size||frames==0) {printf("  Bad trace.\n\n");free(surfaces);free(data);return;}
+    for(i=0;i<num_surfaces&&ok;++i)
+    {
+        replay_surface *s=&surfaces[i];
+        s->memory=(unsigned char*)malloc(s->offset+s->size+1);
+        if(!s->memory) ok=0;
+    }
+    if(!ok) {printf("  Out of memory.\n\n");}
+    for(pass=0;ok&&pass<passes;++pass)
+    {
+        double total=0.0,worst=0.0,t;
+        /* Fill surfaces: sprites (tiled gen_sprite()) for src, 0x89 for dst. */
+        for(i=0;i<num_surfaces;++i)
+        {
+            replay_surface *s=&surfaces[i];
+            int ps=(s->src_mode>=DBCB_MODE_COPY&&s->src_mode<=DBCB_MODE_HALF_RESOLVE?mode_src_pixel_size(s->src_mode):0);
+            size_t a=(size_t)(s->stride<0?-s->stride:s->stride),k;
+            if(ps>0&&a>0)
+            {
+                gen_sprite(tile,64,s->src_mode,(s->src_mode==DBCB_MODE_5551?-1:1),(dbcb_uint32)i);
+                for(k=0;k<s->offset+s->size;++k)
+                    s->memory[k]=tile[((k/a)%64)*(size_t)(64*ps)+(k%a)%(size_t)(64*ps)];
+            }
+            else memset(s->memory,0x89u,s->offset+s->size);
+        }
+        pos=8;
+        for(frame=0;frame<frames;++frame)
+        {
+            t=(double)clock();
+            for(;;)
+            {
+                const unsigned char *r=data+pos;
+                float color[4];
+                dbcb_uint32 flags,u;
+                replay_surface *src,*dst;
+                pos+=4;
+                if(replay_get(r)==0u) break;
+                src=&surfaces[replay_get(r+4)];
+                dst=&surfaces[replay_get(r+20)];
+                flags=replay_get(r+48);
+                if(flags&1u)
+                    for(i=0;i<4;++i) {u=replay_get(r+52+4*i);memcpy(color+i,&u,4);}
+                dbc_blit(
+                    (int)replay_get(r+8),(int)replay_get(r+12),(int)replay_get(r+16),src->memory+src->offset,
+                    (int)replay_get(r+24),(int)replay_get(r+28),(int)replay_get(r+32),dst->memory+dst->offset,
+                    (int)replay_get(r+36),(int)replay_get(r+40),
+                    ((flags&1u)?color:0),
+                    (int)replay_get(r+44));
+                pos+=12*4+((flags&1u)?16:0)+((flags&2u)?4:0);
+            }
+            t=((double)clock()-t)/CLOCKS_PER_SEC;
+            total+=t;
+            if(t>worst) worst=t;
+        }
+        if(best<0.0||total<best) {best=total;slowest=worst;}
+    }
+    if(ok)
+    {
+        printf("  %ld frames, %ld blits, %d surfaces.\n",frames,blits,num_surfaces);
+        printf("  %.3f ms/frame (best of %d passes), slowest frame %.3f ms.\n",1.0e+3*best/(double)frames,passes,1.0e+3*slowest);
+    }
+    for(i=0;i<num_surfaces;++i) free(surfaces[i].memory);
+    free(surfaces);
+    free(data);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void test_record()
+{
+    const char *filename="dbc_blit.trace";
+    const int frames=30,num_sprites=100,T=64;
+    unsigned char *small=sprite+4*1024*1024*4;
+    dbcb_layer layers[5];
+    RNG rng;
+    int count,f,i,j;
+    printf("Recording.\n");
+    if(online_compiler) {printf("  Skipped.\n\n");return;}
+    count=gen_layers(layers);
+    for(i=0;i<8;++i) gen_sprite(small+T*T*4*i,T,(i&1?DBCB_MODE_PMA:DBCB_MODE_ALPHA),1,(dbcb_uint32)(100+i));
+    if(!record_open(filename,1)) {printf("  Can't open %s.\n\n",filename);return;}
+    RNG_init(&rng,1);
+    /* Scrolling layers, with sprites on top. */
+    for(f=0;f<frames;++f)
+    {
+        for(i=0;i<count;++i)
+            dbc_blit(layers[i].w,layers[i].h,layers[i].stride,layers[i].pixels,W,H,W*4,buffer,layers[i].x-(i?f:0),layers[i].y,layers[i].color,layers[i].mode);
+        for(j=0;j<num_sprites;++j)
+        {
+            int s=(int)(RNG_generate(&rng)%8u);
+            dbc_blit(
+                T,T,T*4,small+T*T*4*s,
+                W,H,W*4,buffer,
+                (int)(RNG_generate(&rng)%(dbcb_uint32)(W+T))-T,
+                (int)(RNG_generate(&rng)%(dbcb_uint32)(H+T))-T,
+                0,
+                (s&1?DBCB_MODE_PMA:DBCB_MODE_ALPHA));
+        }
+        record_frame();
+    }
+    record_close();
+    printf("  %ld blits in %ld frames written to %s: %s.\n",record_blits,record_frames,filename,
+        (record_blits==(long)frames*(count+num_sprites)&&record_frames==frames?"ok":"DIFFERS"));
+#ifdef CHECK_REPLAY
+    test_replay(CHECK_REPLAY);
+#else
+    test_replay(filename);
+#endif
+}
+#endif /* CHECK_RECORD */
+
+#if defined(CHECK_SWEEP) || defined(CHECK_PERF)
+/*
+    Whether tier has its own kernels for mode on this CPU, so that limiting
+    dispatch to it does not just measure a lower tier (same checks as in
+    dbcB_autotune()).
+*/
+static int bench_has_tier(int tier,int mode,int modulated)
+{
+    switch(tier)
+    {
+        case 1: return 1;
+#ifndef DBC_BLIT_NO_SIMD
+        case 2: return dbcB_has_sse2&&mode<DBCB_MODE_HALF_ALPHA;
+#ifndef DBC_BLIT_NO_SSE41
+        case 3: return dbcB_has_sse41&&dbcB_sse41_mode(mode,modulated);
+#endif
+#ifndef DBC_BLIT_NO_AVX2
+        case 4: return dbcB_has_avx2&&(mode<DBCB_MODE_HALF_ALPHA||dbcB_has_f16c);
+#endif
+#endif
+    }
+    (void)mode;
+    (void)modulated;
+    return 0;
+}
+#endif
+
+#ifdef CHECK_SWEEP
+/* ns/pixel for blitting w x h sprite region, offset by given number of pixels. */
+static double sweep_measure(int mode,int modulated,int w,int h,int src_offset,int dst_offset)
+{
+    static const int T=260;
+    float color[4]={1.0f,0.5f,0.25f,0.5f};
+    int pixel_size=mode_pixel_size(mode);
+    int src_pixel_size=mode_src_pixel_size(mode);
+    const unsigned char *src=sprite+src_offset*src_pixel_size;
+    unsigned char *dst=buffer+(64-(size_t)buffer%64)%64;
+    clock_t t,t0,budget=CLOCKS_PER_SEC/200+1; /* Several clock() ticks even on Windows. */
+    long n=0;
+    int i;
+    if(mode==DBCB_MODE_ALPHATEST) color[0]=73.0f;
+    memset(dst,0x89u,(size_t)(W*(h+1)*pixel_size));
+    t0=clock();
+    do
+    {
+        for(i=0;i<16;++i)
+            dbc_blit(
+                w,h,src_pixel_size*T,src,
+                W-16,H,pixel_size*W,dst,
+                dst_offset,0,
+                (modulated?color:0),
+                mode);
+        n+=16;
+        /* Same as in test_performance(): multiplication turns dst black. */
+        if((mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG||mode==DBCB_MODE_HALF_MUL)&&n%256==0)
+            memset(dst,0x89u,(size_t)(W*(h+1)*pixel_size));
+        t=clock()-t0;
+    } while(t<budget);
+    return 1.0e+9*(double)t/CLOCKS_PER_SEC/((double)n*w*h);
+}
+
+static void test_sweep()
+{
+    static const char *names[16]={
+        "COPY","ALPHA","PMA","GAMMA","PMG","COLORKEY8","COLORKEY16","5551",
+        "MUL","MUG","ALPHATEST","CPYG","HALF_ALPHA","HALF_PMA","HALF_MUL","HALF_RESOLVE"};
+    static const char *tiers[5]={"","C","SSE2","SSE4.1","AVX2"};
+    static const int heights[2]={4,64};
+    const char *filename="dbc_blit_sweep.csv";
+    FILE *f;
+    int widths[64],num_widths=0;
+    int mode,modulated,tier,hi,src_offset,dst_offset,i,rows=0;
+    clock_t t=clock();
+    printf("Sweep benchmark.\n");
+    if(online_compiler) {printf("  Skipped.\n\n");return;}
+    f=fopen(filename,"wb");
+    if(!f) {printf("  Can't open %s.\n\n",filename);return;}
+    for(i=1;i<=32;++i) widths[num_widths++]=i;
+    for(i=40;i<=256;i+=8) widths[num_widths++]=i;
+    fprintf(f,"mode,modulated,tier,height,src_offset,dst_offset");
+    for(i=0;i<num_widths;++i) fprintf(f,",%d",widths[i]);
+    fprintf(f,"\n");
+    for(mode=0;mode<16;++mode)
+    {
+        if(!mode_pixel_size(mode)) continue;
+        gen_sprite(sprite,260,mode,1,(dbcb_uint32)mode);
+        for(modulated=0;modulated<2;++modulated)
+            for(tier=1;tier<=4;++tier)
+            {
+                if(!bench_has_tier(tier,mode,modulated)) continue;
+                bench_tier=tier;
+#ifdef DBC_BLIT_AUTOTUNE
+                dbcB_tune_force=tier;
+#endif
+                for(hi=0;hi<2;++hi)
+                    for(src_offset=0;src_offset<2;++src_offset)
+                        for(dst_offset=0;dst_offset<4;++dst_offset)
+                        {
+                            fprintf(f,"%s,%d,%s,%d,%d,%d",names[mode],modulated,tiers[tier],heights[hi],src_offset,dst_offset);
+                            for(i=0;i<num_widths;++i)
+                                fprintf(f,",%.3f",sweep_measure(mode,modulated,widths[i],heights[hi],src_offset,dst_offset));
+                            fprintf(f,"\n");
+                            ++rows;
+                        }
+            }
+        printf("  %-12s done.\n",names[mode]);
+        fflush(stdout);
+    }
+    bench_tier=4;
+#ifdef DBC_BLIT_AUTOTUNE
+    dbcB_tune_force=0;
+#endif
+    fclose(f);
+    printf("  %d rows written to %s in %.0f s.\n",rows,filename,(double)(clock()-t)/CLOCKS_PER_SEC);
+    printf("\n");
+    fflush(stdout);
+}
+#endif /* CHECK_SWEEP */
+
+#ifdef CHECK_PERF
+static void test_counters()
+{
+    static const int modes[]={
+        DBCB_MODE_COPY,DBCB_MODE_ALPHA,DBCB_MODE_PMA,
+#ifndef DBC_BLIT_NO_GAMMA
+        DBCB_MODE_GAMMA,DBCB_MODE_PMG,
+#endif
+        DBCB_MODE_COLORKEY8,DBCB_MODE_COLORKEY16,DBCB_MODE_5551,DBCB_MODE_MUL,
+#ifndef DBC_BLIT_NO_GAMMA
+        DBCB_MODE_MUG,
+#endif
+        DBCB_MODE_ALPHATEST};
+    static const char *names[16]={
+        "COPY","ALPHA","PMA","GAMMA","PMG","COLORKEY8","COLORKEY16","5551",
+        "MUL","MUG","ALPHATEST","CPYG","HALF_ALPHA","HALF_PMA","HALF_MUL","HALF_RESOLVE"};
+    static const char *tiers[5]={"","C","SSE2","SSE4.1","AVX2"};
+    const int T=64;
+    int N=(online_compiler?200:2000);
+    int i,k,tier;
+    printf("Testing hardware counters.\n");
+    if(perf_open()==0||perf_fd[0]<0)
+    {
+        perf_close();
+        printf("  Counters not available (perf_event_open() failed).\n\n");
+        return;
+    }
+    printf("  'Rand' test, %dx%d sprites, non-modulated. Per pixel: time, cycles,\n",T,T);
+    printf("  instructions per cycle; per 1000 pixels: L1D read misses, LLC misses,\n");
+    printf("  branch misses; backend stalls as %% of cycles.\n");
+    printf("  %-12s|%-6s| ns/px|cyc/px| IPC | L1D/kpx| LLC/kpx| brm/kpx|stall%%|\n","","");
+    fflush(stdout);
+    /* Warm-up. */
+    (void)test_performance(N,T,3,DBCB_MODE_COPY,0,1);
+    for(i=0;i<(int)(sizeof(modes)/sizeof(modes[0]));++i)
+    {
+        for(tier=4;tier>=1;--tier)
+        {
+            double t,px=(double)N*T*T;
+            if(!bench_has_tier(tier,modes[i],0)) continue;
+            bench_tier=tier;
+#ifdef DBC_BLIT_AUTOTUNE
+            dbcB_tune_force=tier;
+#endif
+            t=test_performance(N,T,3,modes[i],0,1);
+            printf("  %-12s|%-6s|%6.3f|",names[modes[i]],tiers[tier],t);
+            if(perf_count[0]>0.0) printf("%6.2f|",perf_count[0]/px); else printf("%6s|","-");
+            if(perf_count[0]>0.0&&perf_count[1]>=0.0) printf("%5.2f|",perf_count[1]/perf_count[0]); else printf("%5s|","-");
+            for(k=2;k<5;++k)
+            {
+                if(perf_count[k]>=0.0) printf("%8.2f|",1000.0*perf_count[k]/px);
+                else printf("%8s|","-");
+            }
+            if(perf_count[0]>0.0&&perf_count[5]>=0.0) printf("%5.1f%%|\n",100.0*perf_count[5]/perf_count[0]);
+            else printf("%6s|\n","-");
+            fflush(stdout);
+        }
+    }
+    bench_tier=4;
+#ifdef DBC_BLIT_AUTOTUNE
+    dbcB_tune_force=0;
+#endif
+    perf_close();
+    printf("\n");
+}
+#endif /* CHECK_PERF */
+
+#ifdef CHECK_THREADS
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct thread_job
+{
+    int mode;
+    int blits;
+    int band_h;
+    unsigned char *dst;
+    dbcb_uint32 seed;
+} thread_job;
+
+static double wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec+1.0e-9*(double)ts.tv_nsec;
+}
+
+/* Same as 'Rand' in test_performance(), but within dst band. */
+static void *thread_blit(void *arg)
+{
+    const thread_job *job=(const thread_job*)arg;
+    const int T=64,num_sprites=200;
+    int pixel_size=mode_pixel_size(job->mode);
+    int src_pixel_size=mode_src_pixel_size(job->mode);
+    int F=(job->mode==DBCB_MODE_MUL||job->mode==DBCB_MODE_MUG||job->mode==DBCB_MODE_HALF_MUL?4*(W*job->band_h/(T*T+1)+1):0);
+    RNG rng;
+    int j;
+    RNG_init(&rng,job->seed);
+    for(j=0;j<job->blits;++j)
+    {
+        dbcb_int32 x,y,s;
+        x=(dbcb_int32)(RNG_generate(&rng)%(dbcb_uint32)(W-T));
+        y=(dbcb_int32)(RNG_generate(&rng)%(dbcb_uint32)(job->band_h-T));
+        s=(dbcb_int32)(RNG_generate(&rng)%(dbcb_uint32)num_sprites);
+        dbc_blit(
+            T,T,src_pixel_size*T,sprite+s*(T*T)*src_pixel_size,
+            W,job->band_h,pixel_size*W,job->dst,
+            x,y,
+            0,
+            job->mode);
+        if(F&&j%F==F-1) memset(job->dst,0x89u,(size_t)(W*job->band_h*pixel_size));
+    }
+    return 0;
+}
+
+static void *thread_copy(void *arg)
+{
+    const thread_job *job=(const thread_job*)arg;
+    size_t size=(size_t)(W*job->band_h*4);
+    int j;
+    for(j=0;j<job->blits;++j) memcpy(job->dst+(j&1?0:size),job->dst+(j&1?size:0),size);
+    return 0;
+}
+
+/* Runs n jobs in parallel, returns wall time. */
+static double run_threads(void *(*fn)(void*),thread_job *jobs,int n)
+{
+    pthread_t threads[64];
+    double t=wall_time();
+    int i;
+    for(i=0;i<n;++i) pthread_create(&threads[i],0,fn,&jobs[i]);
+    for(i=0;i<n;++i) pthread_join(threads[i],0);
+    return wall_time()-t;
+}
+
+static void test_threads()
+{
+    static const int modes[]={
+        DBCB_MODE_COPY,DBCB_MODE_ALPHA,DBCB_MODE_PMA,
+#ifndef DBC_BLIT_NO_GAMMA
+        DBCB_MODE_GAMMA,DBCB_MODE_PMG,
+#endif
+        DBCB_MODE_COLORKEY8,DBCB_MODE_COLORKEY16,DBCB_MODE_5551,DBCB_MODE_MUL,
+#ifndef DBC_BLIT_NO_GAMMA
+        DBCB_MODE_MUG,
+#endif
+        DBCB_MODE_ALPHATEST};
+    static const char *names[16]={
+        "COPY","ALPHA","PMA","GAMMA","PMG","COLORKEY8","COLORKEY16","5551",
+        "MUL","MUG","ALPHATEST","CPYG","HALF_ALPHA","HALF_PMA","HALF_MUL","HALF_RESOLVE"};
+    const int T=64;
+    thread_job jobs[64];
+    int counts[8],num_counts=0;
+    int max_threads=(CHECK_THREADS+0);
+    int shared,c,i,k;
+    printf("Testing multi-threaded scaling.\n");
+    if(online_compiler) {printf("  Skipped.\n\n");return;}
+    if(max_threads<=0) max_threads=(int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(max_threads<1) max_threads=1;
+    if(max_threads>64) max_threads=64;
+    for(i=1;i<max_threads&&num_counts<7;i*=2) counts[num_counts++]=i;
+    counts[num_counts++]=max_threads;
+    for(k=0;k<200;++k) gen_sprite(sprite+T*T*4*k,T,DBCB_MODE_ALPHA,1,(dbcb_uint32)k);
+    printf("  Aggregate gigapixels/s for 64x64 sprites at random positions, and\n");
+    printf("  (in parentheses) estimated memory traffic in GB/s, compared to\n");
+    printf("  memcpy() with the same number of threads and buffer size.\n");
+    for(shared=0;shared<2;++shared)
+    {
+        /* Each thread gets W x band_h pixels (of up to 8 bytes), plus the same for memcpy(). */
+        int band_h=(shared?H/max_threads:H);
+        unsigned char *memory;
+        double copy_rate[8];
+        if(band_h<2*T) band_h=2*T;
+        memory=(unsigned char*)malloc((size_t)(W*band_h*8)*(size_t)(2*max_threads));
+        if(!memory) {printf("  Out of memory.\n\n");return;}
+        printf("  %s:\n",(shared?"Bands of one framebuffer":"Separate framebuffers"));
+        printf("  %-20s|","");
+        for(c=0;c<num_counts;++c) printf(" %3d thread%s  |",counts[c],(counts[c]>1?"s":" "));
+        printf("\n");
+        for(c=0;c<num_counts;++c)
+        {
+            /* memcpy() between two halves of each thread's area. */
+            for(i=0;i<counts[c];++i)
+            {
+                jobs[i].dst=memory+(size_t)(W*band_h*8)*(size_t)(2*i);
+                jobs[i].band_h=band_h;
+                jobs[i].blits=(int)(200000000/(W*band_h*4))+1;
+            }
+            copy_rate[c]=2.0*(double)jobs[0].blits*(double)(W*band_h*4)*(double)counts[c]/run_threads(thread_copy,jobs,counts[c]);
+        }
+        printf("  %-20s|","memcpy()");
+        for(c=0;c<num_counts;++c) printf(" %13.1f|",1.0e-9*copy_rate[c]);
+        printf("\n");
+        for(k=0;k<(int)(sizeof(modes)/sizeof(modes[0]));++k)
+        {
+            int mode=modes[k];
+            int pixel_size=mode_pixel_size(mode);
+            int src_pixel_size=mode_src_pixel_size(mode);
+            int blits;
+            double t;
+            for(i=0;i<200;++i) gen_sprite(sprite+T*T*src_pixel_size*i,T,mode,(mode==DBCB_MODE_5551?-1:1),(dbcb_uint32)i);
+            /* Calibrate for roughly 0.1 s per thread. */
+            jobs[0].mode=mode;
+            jobs[0].blits=256;
+            jobs[0].seed=1u;
+            jobs[0].dst=memory;
+            jobs[0].band_h=band_h;
+            memset(memory,0x89u,(size_t)(W*band_h*pixel_size));
+            t=run_threads(thread_blit,jobs,1);
+            blits=(int)(0.1*256.0/(t>1.0e-6?t:1.0e-6))+1;
+            printf("  DBCB_MODE_%-10s|",names[mode]);
+            for(c=0;c<num_counts;++c)
+            {
+                double rate;
+                for(i=0;i<counts[c];++i)
+                {
+                    jobs[i].mode=mode;
+                    jobs[i].blits=blits;
+                    jobs[i].band_h=band_h;
+                    jobs[i].seed=(dbcb_uint32)(i+1);
+                    /* Bands are adjacent, separate framebuffers are not. */
+                    jobs[i].dst=memory+(shared?(size_t)(W*band_h*pixel_size)*(size_t)i:(size_t)(W*band_h*8)*(size_t)(2*i));
+                    memset(jobs[i].dst,0x89u,(size_t)(W*band_h*pixel_size));
+                }
+                rate=(double)blits*(double)(T*T)*(double)counts[c]/run_threads(thread_blit,jobs,counts[c]);
+                /* Traffic estimate: read src, read and write dst (COPY does not read dst). */
+                printf(" %5.2f (%5.1f)|",1.0e-9*rate,1.0e-9*rate*(double)(src_pixel_size+(mode==DBCB_MODE_COPY?1:2)*pixel_size));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+        free(memory);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/* Producer/compositor pipeline over two command buffers. */
+typedef struct pipeline
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    dbcb_cmdbuf bufs[2];
+    int ready[2]; /* Recorded, not yet executed. */
+    int frames;
+    unsigned char *fb;
+} pipeline;
+
+static void *pipeline_compositor(void *arg)
+{
+    pipeline *p=(pipeline*)arg;
+    int f;
+    for(f=0;f<p->frames;++f)
+    {
+        pthread_mutex_lock(&p->lock);
+        while(!p->ready[f&1]) pthread_cond_wait(&p->cond,&p->lock);
+        pthread_mutex_unlock(&p->lock);
+        dbc_blit_cmdbuf(W,H,W*4,p->fb,&p->bufs[f&1]);
+        pthread_mutex_lock(&p->lock);
+        p->ready[f&1]=0;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+    }
+    return 0;
+}
+
+/* Frame f: 1000 64x64 sprites at random positions. */
+static void pipeline_record(dbcb_cmdbuf *buf,int f)
+{
+    const int T=64;
+    RNG rng;
+    int j;
+    RNG_init(&rng,(dbcb_uint32)(f+1));
+    dbcb_cmdbuf_clear(buf);
+    for(j=0;j<1000;++j)
+    {
+        int x=(int)(RNG_generate(&rng)%(dbcb_uint32)(W-T)),y=(int)(RNG_generate(&rng)%(dbcb_uint32)(H-T));
+        int s=(int)(RNG_generate(&rng)%200u);
+        dbcb_cmdbuf_blit(buf,T,T,T*4,sprite+s*(T*T)*4,x,y,0,DBCB_MODE_ALPHA);
+    }
+}
+
+static void test_compositor()
+{
+    static dbcb_layer layers[2][1000];
+    static float colors[2][4*1000];
+    const int T=64,frames=(online_compiler?10:100);
+    unsigned char *fb0=buffer,*fb1=buffer+W*H*4;
+    pipeline p;
+    pthread_t thread;
+    double t0,t1,busy=0.0;
+    int f,k;
+    printf("Testing command buffers with compositor thread.\n");
+    for(k=0;k<200;++k) gen_sprite(sprite+T*T*4*k,T,DBCB_MODE_ALPHA,1,(dbcb_uint32)k);
+    pthread_mutex_init(&p.lock,0);
+    pthread_cond_init(&p.cond,0);
+    for(k=0;k<2;++k)
+    {
+        dbcb_cmdbuf_init(&p.bufs[k],layers[k],colors[k],1000);
+        p.ready[k]=0;
+    }
+    p.frames=frames;
+    /* Single thread: record and execute each frame. */
+    memset(fb0,0x89u,(size_t)(W*H*4));
+    t0=wall_time();
+    for(f=0;f<frames;++f)
+    {
+        pipeline_record(&p.bufs[0],f);
+        dbc_blit_cmdbuf(W,H,W*4,fb0,&p.bufs[0]);
+    }
+    t0=wall_time()-t0;
+    /* Two threads: frame f+1 is recorded while frame f is composited. */
+    memset(fb1,0x89u,(size_t)(W*H*4));
+    p.fb=fb1;
+    t1=wall_time();
+    pthread_create(&thread,0,pipeline_compositor,&p);
+    for(f=0;f<frames;++f)
+    {
+        double t;
+        pthread_mutex_lock(&p.lock);
+        while(p.ready[f&1]) pthread_cond_wait(&p.cond,&p.lock);
+        pthread_mutex_unlock(&p.lock);
+        t=wall_time();
+        pipeline_record(&p.bufs[f&1],f);
+        busy+=wall_time()-t;
+        pthread_mutex_lock(&p.lock);
+        p.ready[f&1]=1;
+        pthread_cond_broadcast(&p.cond);
+        pthread_mutex_unlock(&p.lock);
+    }
+    pthread_join(thread,0);
+    t1=wall_time()-t1;
+    pthread_cond_destroy(&p.cond);
+    pthread_mutex_destroy(&p.lock);
+    printf("  %-20s| %s\n","Result",(memcmp(fb0,fb1,(size_t)(W*H*4))?"DIFFERS":"ok"));
+    printf("  1000 %dx%d sprites per frame over %dx%d, DBCB_MODE_ALPHA:\n",T,T,W,H);
+    printf("  Single thread       : %7.3f ms/frame.\n",1.0e+3*t0/(double)frames);
+    printf("  Pipelined           : %7.3f ms/frame.\n",1.0e+3*t1/(double)frames);
+    printf("  Producer (recording): %7.3f ms/frame.\n",1.0e+3*busy/(double)frames);
+    printf("\n");
+    fflush(stdout);
+}
+#endif /* CHECK_THREADS */
+
+static void test_speed()
+{
+#define TEST(N0,N1,size,mode,t,p) do{printf("%-22s|%4d|",#mode,size); test_perf(N0,N1,size,mode,t,p);} while(0)
+
+    int g=3;
+    int size=64;
+    int p=0;
+    int m=(online_compiler?50:100);
+#if defined(ONLINE_COMPILER) && defined(DBC_BLIT_NO_SIMD)
+    m/=2;
+#endif
+    printf("Testing performance.\n");
+    if(p) printf("Timings are in gigapixels/second.\n");
+    else  printf("Timings are in ns/pixel.\n");
+    printf("Sprites are %dx%d, and contain a combination of transparent,\n",size,size);
+    printf("semitransparent (where applicable), and opaque pixels.\n");
+    printf("Column 'Fill' estimates pure fillrate: blit(0,0,sprites[0]).\n");
+    printf("Column 'Rand' estimates random access: blit(rnd(W),rnd(H),sprites[rnd(N)]).\n");
+    printf("                      |    |Non-modulated|  Modulated  |\n");
+    printf("                      |    |------+------+------+------|\n");
+    printf("                      |Size| Fill | Rand | Fill | Rand |\n");
+    printf("----------------------+----+------+------+------+------|\n");
+    fflush(stdout);
+    /* Warm-up. */
+    (void)test_performance(50*m,size,3,DBCB_MODE_COPY,0,1);
+    TEST(  500*m,   50*m,size,DBCB_MODE_COPY        ,g,p);
+    TEST(  100*m,   50*m,size,DBCB_MODE_ALPHA       ,g,p);
+    TEST(  100*m,   50*m,size,DBCB_MODE_PMA         ,g,p);
+#ifndef DBC_BLIT_NO_GAMMA
+    TEST(   10*m,   10*m,size,DBCB_MODE_GAMMA       ,g,p);
+    TEST(   10*m,   10*m,size,DBCB_MODE_PMG         ,g,p);
+#endif
+    TEST( 1000*m, 1000*m,size,DBCB_MODE_COLORKEY8   ,g,p);
+    TEST(  500*m,  500*m,size,DBCB_MODE_COLORKEY16  ,g,p);
+    TEST(  500*m,  500*m,size,DBCB_MODE_5551        ,g,p);
+    TEST(  100*m,   50*m,size,DBCB_MODE_MUL         ,g,p);
+#ifndef DBC_BLIT_NO_GAMMA
+    TEST(   20*m,   10*m,size,DBCB_MODE_MUG         ,g,p);
+#endif
+    TEST(  500*m,  200*m,size,DBCB_MODE_ALPHATEST   ,g,p);
+#ifndef DBC_BLIT_NO_GAMMA
+    TEST(  500*m,   20*m,size,DBCB_MODE_CPYG        ,g,p);
+    TEST(   20*m,   10*m,size,DBCB_MODE_HALF_ALPHA  ,g,p);
+    TEST(   20*m,   10*m,size,DBCB_MODE_HALF_PMA    ,g,p);
+    TEST(   20*m,   10*m,size,DBCB_MODE_HALF_MUL    ,g,p);
+    TEST(   20*m,   10*m,size,DBCB_MODE_HALF_RESOLVE,g,p);
+#endif
+    printf("\n");
+}
+
+int main()
+{
+    printf("Testing dbc_blit.h.\n");
+    fflush(stdout);
+    printf("Compiler:\n");
+#ifdef __cplusplus
+    printf("  Compiled as C++.\n");
+#if (__cplusplus+0)>0
+    printf("  __cplusplus                       is set to %ld.\n",(long)(__cplusplus));
+#endif
+#else
+    printf("  Compiled as C.\n");
+#endif
+#ifdef __STDC__
+    printf("  __STDC__                          is set to %d.\n",(__STDC__ + 0));
+#endif
+#if defined(__STDC_VERSION__)
+    printf("  __STDC_VERSION__                  is set to %ld.\n",(long)(__STDC_VERSION__ + 0));
+#endif
 #if defined(__STDC_HOSTED__)
     printf("  __STDC_HOSTED__                   is set to %d.\n",(__STDC_HOSTED__ + 0));
 #endif
@@ -1144,8 +3627,17 @@ int main()
 #ifdef DBC_BLIT_NO_AVX2
     printf("  DBC_BLIT_NO_AVX2                  is set.\n");
 #endif
+#ifdef DBC_BLIT_NO_FMA
+    printf("  DBC_BLIT_NO_FMA                   is set.\n");
+#endif
 #ifdef DBC_BLIT_UNROLL
     printf("  DBC_BLIT_UNROLL                   is set to %d.\n",(DBC_BLIT_UNROLL + 0));
+#endif
+#ifdef DBC_BLIT_AUTOTUNE
+    printf("  DBC_BLIT_AUTOTUNE                 is set.\n");
+#endif
+#ifdef DBC_BLIT_STATS
+    printf("  DBC_BLIT_STATS                    is set.\n");
 #endif
     printf("\n");
     printf("Initialization...");
@@ -1157,19 +3649,64 @@ int main()
 #ifdef DBCB_X86_OR_X64
     if(dbcB_has_sse2) printf("  SSE2 detected.\n");
     else              printf("  SSE2 not detected.\n");
+#ifndef DBC_BLIT_NO_SSE41
+    if(dbcB_has_sse41) printf("  SSE4.1 detected.\n");
+    else               printf("  SSE4.1 not detected.\n");
+#endif
 #ifndef DBC_BLIT_NO_AVX2
     if(dbcB_has_avx2) printf("  AVX2 detected.\n");
     else              printf("  AVX2 not detected.\n");
+    if(dbcB_has_f16c) printf("  F16C detected.\n");
+    else              printf("  F16C not detected.\n");
+    if(dbcB_has_fma)  printf("  FMA detected.\n");
+    else              printf("  FMA not detected.\n");
 #endif
 #endif
 #endif
     printf("\n");
     fflush(stdout);
 
+#ifdef DBC_BLIT_AUTOTUNE
+    if(1) test_autotune();
+#endif
     if(1) test_speed();
+#ifdef CHECK_SWEEP
+    if(1) test_sweep();
+#endif
+#ifdef CHECK_THREADS
+    if(1) test_threads();
+    if(1) test_compositor();
+#endif
+#ifdef CHECK_PERF
+    if(1) test_counters();
+#endif
     if(1) test_modes();
+    if(1) test_layers();
+    if(1) test_damage();
+    if(1) test_culling();
+    if(1) test_analysis();
+    if(1) test_masked();
+    if(1) test_tiled();
+    if(1) test_gradient();
+    if(1) test_cmdbuf();
+    if(1) test_tiled_fb();
+#ifdef DBC_BLIT_STATS
+    if(1) test_stats();
+#endif
+#ifdef CHECK_TRACE
+    if(1) test_trace();
+#endif
+#ifdef CHECK_RECORD
+    if(1) test_record();
+#endif
     if(1) test_ops();
+    if(1) test_early_outs();
+#ifdef CHECK_KERNELS
+    if(1) test_kernels();
+#endif
+    test_modulation();
 #ifndef DBC_BLIT_NO_GAMMA
+    test_half();
     if(!online_compiler) test_gamma();
 #endif
     fflush(stdout);
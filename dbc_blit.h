@@ -13,7 +13,7 @@ COMPILATION
     to make implementation static to the translation unit that includes it.
 
 USAGE
-    Blitter API exposes a single function
+    Blitter API is built around a single function
 dbc_blit(src_w,src_h,src_stride_in_bytes,src_pixels,
          dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
          x,y,color,mode)
@@ -25,6 +25,8 @@ dbc_blit(src_w,src_h,src_stride_in_bytes,src_pixels,
     32-bit RGBA (or BGRA; the blitter does not care, except the 'color'
     is understood to use the same order; however color[3] always corresponds
     to alpha channel).
+    The exception are half-float modes (DBCB_MODE_HALF_*), where src and dst
+    formats differ (see below).
 
     (w,h,stride,pixels) describes a surface - a rectangular array of pixels,
     stored such that pixel (x,y) is located at pixels+y*stride+x*pixel_size.
@@ -114,6 +116,303 @@ DBCB_MODE_ALPHATEST - alpha test. src is copied to dst (unchanged)
     pixel is rejected. The implementation is optimized to be somewhat
     faster if threshold is exactly 128.
 
+DBCB_MODE_HALF_ALPHA - gamma-corrected alpha-blending into half-float
+    dst. src is 32-bit RGBA, with color components sRGB-encoded and alpha
+    linear (same as in DBCB_MODE_GAMMA). dst is 64-bit RGBA16F: each
+    component is IEEE 754 half-precision float (binary16), stored as 16-bit
+    value (same as pixels in DBCB_MODE_COLORKEY16), in linear space.
+    The result is not clamped, so dst can hold values outside [0;1].
+    Equations:
+    Cf=Cm*srgb2linear(Cs)*Am*As+Cd*(1-Am*As)
+    Af=Am*As+Ad*(1-Am*As)
+
+DBCB_MODE_HALF_PMA - same as DBCB_MODE_HALF_ALPHA, but premultiplied.
+    Equations:
+    Cf=Cm*srgb2linear(Cs)+Cd*(1-Am*As)
+    Af=Am*As+Ad*(1-Am*As)
+
+DBCB_MODE_HALF_MUL - same as DBCB_MODE_HALF_ALPHA, but multiplication.
+    Equations:
+    Cf=Cm*srgb2linear(Cs)*Cd
+    Af=Am*As*Ad
+
+DBCB_MODE_HALF_RESOLVE - converts half-float src (in the format of dst
+    above) to 32-bit sRGB-encoded dst. Equations:
+    Cf=linear2srgb(clamp(Cm*Cs))
+    Af=clamp(Am*As)
+    The intended use is to composite several layers with DBCB_MODE_HALF_*
+    into an intermediate RGBA16F buffer, and then resolve it into
+    the final 32-bit one. Unlike using DBCB_MODE_GAMMA/DBCB_MODE_PMG for
+    every layer, this decodes dst and encodes the result once per pixel,
+    instead of once per pixel per layer, and does not lose precision
+    between layers.
+    Half-float modes are not available with DBC_BLIT_NO_GAMMA.
+
+LAYERS
+    If a frame is composed of several large layers (e.g. background,
+    parallax, UI), blitting them one after another reads and writes
+    the whole dst once per layer. Function
+dbc_blit_layers(dst_w,dst_h,dst_stride_in_bytes,dst_pixels,layers,count)
+    takes an array of 'count' layers (struct dbcb_layer, which holds
+    the arguments for dbc_blit(), other than dst), and produces the same
+    result as calling dbc_blit() for each of them in order, but does so
+    band by band: dst is split into horizontal bands of a few rows, and
+    all layers are applied to a band before moving to the next one.
+    That way each band stays in cache (L1 for typical widths) while
+    the layers are applied, and is read from and written to memory once.
+    Band size is controlled by
+#define DBC_BLIT_LAYER_BAND_BYTES bytes
+    which sets the approximate size of dst band (default is 32768).
+    Band is at least 1 row. Each layer still incurs the dbc_blit() call
+    overhead per band it intersects, so this mostly pays off for large
+    layers; for small sprites plain dbc_blit() is just as good.
+    Layers may use different modes, but should agree on dst format.
+    dbcb_layer also has 'flags' (see OCCLUSION CULLING), which is its last
+    member, so initializers that list only the dbc_blit() arguments leave
+    it 0; layers filled in member by member must set it explicitly.
+
+DAMAGE TRACKING
+    If only small parts of the frame change, recompositing all of it is
+    wasteful. dbcb_damage holds a set of non-overlapping dst rectangles
+    (dbcb_rect, with x0,y0 inclusive and x1,y1 exclusive):
+dbcb_damage_clear(damage)
+    empties it,
+dbcb_damage_add(damage,x0,y0,x1,y1)
+    adds a rectangle, and
+dbcb_damage_add_blit(damage,src_w,src_h,dst_w,dst_h,x,y)
+    adds the part of dst that dbc_blit() with these arguments would touch
+    (clipped same as dbc_blit() does). Added rectangles are merged with
+    existing ones if they overlap, or if the bounding box does not waste
+    much area; at most DBCB_DAMAGE_MAX_RECTS rectangles are kept, beyond
+    that the cheapest pairs are merged. The result covers everything that
+    was added, and rectangles never overlap.
+dbc_blit_layers_damaged(dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                        layers,count,damage)
+    recomposites only the damaged part of dst: same as
+    dbc_blit_layers(), but every blit is restricted to damage rectangles,
+    and layers that do not intersect them are skipped. Empty damage costs
+    nothing. This produces the same result as full recompositing only if
+    the layers fully redraw the damaged area (e.g. the first layer is an
+    opaque DBCB_MODE_COPY background); otherwise stale dst pixels are
+    blended over again.
+    When a layer moves, both its old and new positions must be added.
+
+OCCLUSION CULLING
+    With heavy overdraw (e.g. tile map with opaque sprites on top), much of
+    dst is written several times, and only the last write is visible.
+dbc_blit_layers_culled(dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                       layers,count,coverage)
+    produces the same result as dbc_blit_layers(), but skips the parts of
+    layers that are hidden behind opaque layers in front of them.
+    dst is split into blocks of DBCB_COVERAGE_BLOCK x DBCB_COVERAGE_BLOCK
+    pixels. Layers are first processed front-to-back (from last to first),
+    marking each block that an opaque layer fully covers with the index of
+    the frontmost such layer. Then layers are blitted back-to-front, each
+    only over the runs of blocks not covered by layers in front of it.
+    'coverage' is scratch memory supplied by the caller, of
+    dbcb_coverage_size(dst_w,dst_h) unsigned shorts.
+    Layer is considered opaque if it overwrites every pixel of its
+    rectangle: DBCB_MODE_COPY and DBCB_MODE_CPYG always do, colorkey modes
+    and alpha test do without colorkey/threshold. Alpha-blending modes
+    (DBCB_MODE_ALPHA, DBCB_MODE_PMA, DBCB_MODE_GAMMA, DBCB_MODE_PMG,
+    DBCB_MODE_HALF_ALPHA, DBCB_MODE_HALF_PMA) do if the sprite has alpha of
+    255 everywhere, which dbc_blit does not check; set DBCB_LAYER_OPAQUE in
+    'flags' of such layers to declare that (modulation with color[3]!=1.0f
+    cancels it).
+    Coverage is conservative: only blocks fully inside a single opaque
+    layer are marked, so small or unaligned occluders help less. Tile maps
+    aligned to DBCB_COVERAGE_BLOCK are ideal.
+    Coverage holds 16-bit layer indices, so with more than 65535 layers
+    this falls back to dbc_blit_layers() (no culling).
+
+SPRITE ANALYSIS
+    Sprites often have wide transparent borders, or are fully opaque,
+    but dbc_blit() still processes every pixel of the rectangle.
+dbcb_analyze_sprite(src_w,src_h,src_stride_in_bytes,src_pixels,mode,info)
+    scans the sprite once, and fills dbcb_sprite_info with the tight
+    bounding box [x0;x1)x[y0;y1) of pixels that are not transparent in
+    'mode', and 'kind', which is one of:
+        DBCB_SPRITE_TRANSPARENT - blit does nothing;
+        DBCB_SPRITE_OPAQUE      - every pixel within the bounding box
+                                  replaces dst verbatim (when
+                                  not modulated);
+        DBCB_SPRITE_MIXED       - anything else.
+dbc_blit_analyzed(src_w,src_h,src_stride_in_bytes,src_pixels,
+                  dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                  x,y,color,mode,info)
+    is the same as dbc_blit(), but uses the info: returns immediately for
+    transparent sprites, blits only the bounding box, and performs
+    non-modulated blits of opaque sprites as straight copy (memcpy).
+    The result is identical to dbc_blit().
+    Transparent pixels are: alpha of 0 for DBCB_MODE_ALPHA and
+    DBCB_MODE_GAMMA; all-zero for DBCB_MODE_PMA and DBCB_MODE_PMG;
+    all-ones (white) for DBCB_MODE_MUL and DBCB_MODE_MUG (only when not
+    modulated, so the info is not used for modulated multiplication);
+    top bit clear for DBCB_MODE_5551.
+    Opaque are those with alpha of 255 (top bit set for DBCB_MODE_5551),
+    except for multiplication modes, which are never considered opaque.
+    Other modes depend on colorkey/threshold, which is only known at blit
+    time, or (half-float modes) do not leave dst bit-exact for transparent
+    pixels (-0 and NaN), so they are reported as mixed with full bounds
+    (DBCB_MODE_COPY and DBCB_MODE_CPYG as opaque).
+    The info remembers the mode and sprite size, and is ignored if they
+    do not match the blit. It is the caller's responsibility to redo the
+    analysis if sprite pixels change.
+
+MASKED BLIT
+    To clip a blit to a non-rectangular region (rounded panel, circular
+    minimap, scroll container with soft edges) without rendering into
+    a temporary surface first,
+dbc_blit_masked(src_w,src_h,src_stride_in_bytes,src_pixels,
+                dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                x,y,color,mode,mask)
+    takes 8-bit coverage mask (struct dbcb_mask: w,h,stride,pixels of
+    the mask surface, and its position x,y in dst coordinates; use 0,0
+    for the mask aligned to dst, or blit's x,y for the mask aligned to
+    src). Pixels outside the mask have coverage 0 and are not touched.
+    Coverage of 255 gives the same result as dbc_blit(), and anything in
+    between the same as dbc_blit() with color (NULL means all 1.0f)
+    multiplied by coverage/255 (up to FMA rounding, see GAMMA
+    CORRECTNESS): only color[3] for DBCB_MODE_ALPHA,
+    DBCB_MODE_GAMMA, and DBCB_MODE_HALF_ALPHA, all components for
+    DBCB_MODE_PMA, DBCB_MODE_PMG, and DBCB_MODE_HALF_PMA. For other modes
+    the mask is a stencil: any non-zero coverage means the pixel is
+    blitted as with dbc_blit(). NULL mask means plain dbc_blit().
+    The blit goes through the same tier selection (and autotuning) as
+    dbc_blit(), and is traced and counted in statistics as a single blit
+    of the rectangle clipped to the mask; it is not recorded (see
+    RECORDING). Rows are split into spans: coverage 0 is skipped, runs
+    of 255 (non-zero for stencil modes) are blitted with the same row
+    function as dbc_blit() (rows that are 255 throughout, several at
+    once), and spans with partial coverage go through masked row kernels
+    of the tier (SSE2 ones for SSE4.1). These walk the span in blocks of
+    the tier's widest kernel: blocks with coverage all 0 are skipped, all
+    255 blitted with the same kernels as dbc_blit(), and blocks with
+    partial coverage of 2 or more pixels are blended at once by a kernel
+    that takes the coverage (AVX2, DBCB_MODE_ALPHA and DBCB_MODE_PMA);
+    other pixels with partial coverage go through the tier's 1-pixel
+    modulated kernel. Cost, relative to the unmasked dbc_blit() of a
+    64x64 DBCB_MODE_ALPHA sprite: about 0.3x with mask all 0, 1.3x with
+    mask all 255, 2.5x to 4x (depending on the sprite) with a circular
+    mask with antialiased edge, mostly in the 1-pixel kernel for the edge
+    (check.c reports this one). Scanning the mask costs the same for all
+    modes, so it is relatively more for cheap ones (DBCB_MODE_COLORKEY8:
+    2.6x with mask all 255, 8x with the circle).
+
+TILED FILL
+    UI backgrounds and frames often repeat a small pattern over a large
+    area. Doing that with a dbc_blit() per tile pays the call overhead
+    per tile.
+dbc_blit_tiled(src_w,src_h,src_stride_in_bytes,src_pixels,
+               dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+               x,y,w,h,phase_x,phase_y,color,mode)
+    fills dst rectangle [x;x+w)x[y;y+h) with src repeated in both
+    directions: dst pixel (X,Y) gets src pixel
+    ((X-x+phase_x) mod src_w,(Y-y+phase_y) mod src_h) (phase can be
+    negative). The result is the same as blitting each tile with
+    dbc_blit(), clipped to the rectangle. Small patterns are first
+    replicated horizontally into a scratch buffer on stack, of
+#define DBC_BLIT_TILE_BYTES bytes
+    (default is 1024), a band of rows at a time, so that one dbc_blit()
+    call covers many tiles of a row, in rows at least 128 pixels long.
+    Larger patterns, for which this would take more dbc_blit() calls,
+    are blitted tile by tile. Replication makes 16x16 and smaller
+    patterns faster (e.g. 8x8 DBCB_MODE_ALPHA about 1.3x), and does not
+    change anything for larger ones (check.c reports both).
+dbc_blit_nine_slice(src_w,src_h,src_stride_in_bytes,src_pixels,
+                    dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                    x,y,w,h,left,top,right,bottom,color,mode)
+    draws src as a nine-slice panel into [x;x+w)x[y;y+h): src is split
+    by insets left, top, right, bottom into 3x3 parts; corners are
+    blitted as is, edges and center are tiled (dbc_blit_tiled()) to fill
+    the rest. Panel smaller than left+right (top+bottom) gets its right
+    (bottom) parts cut.
+
+GRADIENT MODULATION
+    Vignettes, fades, and gradient-tinted UI need color that changes
+    across the sprite. Instead of rendering a gradient surface and
+    applying it with DBCB_MODE_MUL afterwards,
+dbc_blit_gradient(src_w,src_h,src_stride_in_bytes,src_pixels,
+                  dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                  x,y,corners,mode)
+    takes 4 colors (16 floats: top-left, top-right, bottom-left,
+    bottom-right RGBA), and modulates each src pixel by the color
+    bilinearly interpolated between them (corners are at the centers of
+    the corner pixels of src). For 2-color gradients repeat the colors:
+    TL,TR,TL,TR for horizontal, TL,TL,BL,BL for vertical. The result is
+    the same as dbc_blit() of the single pixel with the interpolated color,
+    up to rounding (off by 1 at most): the color is stepped incrementally
+    along the row, the same way in all code paths, so the color of a pixel
+    does not depend on CPU. Works for modes where color is a multiplier
+    (DBCB_MODE_COPY, DBCB_MODE_ALPHA, DBCB_MODE_PMA, DBCB_MODE_MUL, and
+    their gamma and half-float counterparts); for other modes, or NULL
+    corners, it is the same as dbc_blit() with color=corners.
+    DBCB_MODE_COPY, DBCB_MODE_ALPHA, DBCB_MODE_PMA, and DBCB_MODE_MUL with
+    corners in [0;1] step 16.16 fixed-point multipliers (round(c*65535)),
+    with SSE2, SSE4.1, and AVX2 code. Gamma-corrected modes use 2-pixel
+    AVX2 kernels with DBC_BLIT_GAMMA_NO_TABLES (single-pixel SSE2 kernels
+    otherwise), and half-float modes 2-pixel F16C kernels (except
+    DBCB_MODE_HALF_RESOLVE with gamma tables, which is C only).
+
+COMMAND BUFFERS
+    To take blit cost off the thread that decides what to draw (e.g. game
+    simulation), blits can be recorded into a command buffer, and executed
+    later, e.g. by a compositor thread. dbcb_cmdbuf does not allocate:
+dbcb_cmdbuf_init(buf,layers,colors,capacity)
+    sets it up with caller-provided storage for 'capacity' commands
+    (dbcb_layer layers[capacity], float colors[4*capacity]),
+dbcb_cmdbuf_clear(buf)
+    empties it, and
+dbcb_cmdbuf_blit(buf,src_w,src_h,src_stride_in_bytes,src_pixels,
+                 x,y,color,mode)
+    appends a blit: arguments of dbc_blit() other than dst are stored by
+    value (including the 4 components of color; NULL stays NULL), nothing
+    is checked or dispatched. Returns 0 (and increments buf->dropped) if
+    the buffer is full. Src pixels are not copied, and must stay intact
+    until the buffer is executed.
+dbc_blit_cmdbuf(dst_w,dst_h,dst_stride_in_bytes,dst_pixels,buf)
+    executes the recorded blits in order, same as the corresponding
+    dbc_blit() calls. buf->layers[0..buf->count) is an ordinary layer array,
+    so dbc_blit_layers(), dbc_blit_layers_damaged(), and
+    dbc_blit_layers_culled() can execute the buffer too.
+    The library does not create threads or synchronize anything (see THREAD
+    SAFETY). The intended use is double buffering: the producer records
+    frame N+1 into one buffer while the compositor executes frame N from
+    the other, and they swap buffers once per frame, under whatever
+    synchronization the application uses. A buffer must not be appended to
+    while it is being executed.
+
+TILED FRAMEBUFFER
+    In a linear framebuffer a sprite touches one stretch of memory per row,
+    and rows are dst_stride apart, so a 64x64 sprite at a random position
+    in a large framebuffer touches 64 different pages (TLB entries) and
+    prefetch streams. The framebuffer can instead be kept tiled: split into
+    DBCB_FB_TILE x DBCB_FB_TILE (32x32) pixel tiles, each stored
+    contiguously (tile rows DBCB_FB_TILE*pixel_size bytes apart), tiles in
+    row-major order. Edge tiles are stored full-size, only their first
+    dst_w (dst_h) pixels in the last tile column (row) are used.
+dbcb_tiled_fb_size(dst_w,dst_h,pixel_size)
+    returns the size of such framebuffer, in bytes (0 if it does not fit
+    in int).
+dbc_blit_tiled_fb(src_w,src_h,src_stride_in_bytes,src_pixels,
+                  dst_w,dst_h,dst_pixels,x,y,color,mode)
+    is the same as dbc_blit(), but dst is tiled: the blit is clipped to
+    each tile it overlaps, and done tile by tile, a row of tiles at a time.
+    The result matches dbc_blit() into a linear framebuffer exactly.
+    The tiles are still blitted by the ordinary kernels, so the benefit is
+    only in locality, and each tile costs one dbc_blit() call: small
+    sprites in large framebuffers gain, for framebuffers that fit in cache
+    it is usually a loss. Measure (check.c reports both). Statistics,
+    tracing, and recording see the per-tile dbc_blit() calls, with tile
+    coordinates.
+dbcb_tiled_fb_load(w,h,pixel_size,src_stride_in_bytes,src_pixels,
+                   tiled_pixels)
+    copies a linear image into a tiled framebuffer (e.g. background), and
+dbcb_tiled_fb_detile(w,h,pixel_size,tiled_pixels,
+                     dst_stride_in_bytes,dst_pixels)
+    copies it back into a linear one, for presenting. This is a memcpy()
+    per tile row, writing dst sequentially.
+
 SIMD
     On x86/x64 the library attempts to detect SIMD support and
     use optimized SIMD implementations of certain functions. This,
@@ -131,6 +430,19 @@ https://gist.github.com/rygorous/f26f5f60284d9d9246f6
 #define DBC_BLIT_FORCE_GCC_ASM
     You can disable AVX2 specifically by
 #define DBC_BLIT_NO_AVX2
+    Between SSE2 and AVX2 there is an SSE4.1 tier (which also uses SSSE3's
+    pshufb), used for the non-modulated alpha, premultiplied alpha and
+    multiply modes, the modulated color key and alpha test modes, and
+    MODE_5551. The rest use SSE2 when AVX2 is not available. It can be
+    disabled by
+#define DBC_BLIT_NO_SSE41
+    AVX2 versions of half-float modes also require F16C (vcvtph2ps and
+    vcvtps2ph), which is detected separately; without it half-float
+    modes use pure C versions. There are no SSE2 versions of these modes.
+    Similarly, with DBC_BLIT_GAMMA_NO_TABLES the AVX2 tier uses FMA3
+    (if detected) for gamma-corrected blending modes, see GAMMA
+    CORRECTNESS. This can be disabled by
+#define DBC_BLIT_NO_FMA
     You can also suppress all SIMD implementations by
 #define DBC_BLIT_NO_SIMD
     Runtime CPU detection can sometimes cause problems:
@@ -152,7 +464,8 @@ https://github.com/nothings/stb/issues/81
     pure C, and/or AVX2 versions slower than SSE2. dbc_blit.h does not
     try to detect it, and simply uses the highest instruction set available.
     However, you can #define the function-like macros
-    dbcb_allow_sse2_for_mode(mode,modulated) and
+    dbcb_allow_sse2_for_mode(mode,modulated),
+    dbcb_allow_sse41_for_mode(mode,modulated) and
     dbcb_allow_avx2_for_mode(mode,modulated) to control SIMD at
     runtime on per-mode basis. This may look something like this:
 
@@ -166,13 +479,14 @@ extern int sse2_is_slow;
 
     The expressions these macros expand to do not need to be compile-time
     constants. They are each evaluated once per dbc_blit() call (assuming
-    SSE2/AVX2 are enabled).
+    SSE2/SSE4.1/AVX2 are enabled).
 
     Note: some older OSes (Windows 95 and earlier, Linux kernel
     before something like 2.4) may not have the OS-level support for SSE
     (do not preserve the state on context switch). The dbc_blit.h does not
     check for it. If you need to support them, consider checking it yourself
-    and using dbcb_allow_sse2_for_mode()/dbcb_allow_avx2_for_mode().
+    and using dbcb_allow_sse2_for_mode()/dbcb_allow_sse41_for_mode()/
+    dbcb_allow_avx2_for_mode().
 
 UNROLLING
     To improve the blitting speed of small sprites, dbc_blit uses unrolling
@@ -193,6 +507,94 @@ UNROLLING
     While unrolling may improve speed for small sprites, it significantly
     increases compilation time and binary size.
 
+AUTOTUNING
+    Instead of writing dbcb_allow_*_for_mode() by hand, you can
+#define DBC_BLIT_AUTOTUNE
+    and call
+dbcb_autotune()
+    which benchmarks every mode (modulated and not) on the running machine,
+    with each available instruction set (C, SSE2, SSE4.1, AVX2) and several
+    sprite widths (up to 8, 32, 128 pixels, and wider), and with and
+    without unrolling, and stores the choices in a table that dbc_blit()
+    consults. Until then (or without it) the highest available
+    instruction set is used, as usual. Calibration takes about 2 seconds;
+    each measurement runs for DBC_BLIT_AUTOTUNE_MS milliseconds
+    (default is 2), which can be raised for less noisy results.
+    To pay this once, the table can be persisted:
+dbcb_autotune_save(filename)
+dbcb_autotune_load(filename)
+    both return 1 on success and 0 on failure. Loading fails (and leaves
+    the table unchanged) if the file was produced on a CPU with different
+    instruction sets or with different DBC_BLIT_UNROLL. Typical use:
+if(!dbcb_autotune_load("dbc_blit.tune"))
+{
+    dbcb_autotune();
+    dbcb_autotune_save("dbc_blit.tune");
+}
+    dbcb_allow_*_for_mode() and dbcb_unroll_limit_for_mode(), if defined,
+    still apply on top of the table (the unrolling choice has no effect if
+    you define dbcb_unroll_limit_for_mode()).
+    Calibration is not thread-safe: do not call dbc_blit() from other
+    threads while it runs (it sets a global tier override that dbc_blit()
+    reads without synchronization). Same goes for dbcb_autotune_load(),
+    which rewrites the table: tune or load before other threads start
+    blitting. Autotuning uses about 100 KB of static memory
+    and <stdio.h>/<time.h>.
+
+STATISTICS
+    To see where the time goes (which modes and instruction sets are
+    used, and how much is clipped away), you can
+#define DBC_BLIT_STATS
+    which makes dbc_blit(), dbc_blit_gradient(), and dbc_blit_masked()
+    (and everything built on them) update counters:
+dbcb_stats stats;
+dbcb_stats_snapshot(&stats);
+dbcb_stats_reset();
+    Per mode and tier (DBCB_STATS_TIER_C, DBCB_STATS_TIER_SSE2,
+    DBCB_STATS_TIER_SSE41, DBCB_STATS_TIER_AVX2) they record the number
+    of calls that blit anything, and of pixels blitted after clipping; per
+    mode, the number of src pixels clipped away (fully clipped calls only
+    count here). Non-modulated C versions of DBCB_MODE_ALPHA, DBCB_MODE_PMA,
+    DBCB_MODE_GAMMA, DBCB_MODE_PMG, DBCB_MODE_MUL, and DBCB_MODE_MUG also
+    count src pixels that are transparent, opaque, or neither ('blended'),
+    as defined in SPRITE ANALYSIS; SIMD versions do not, so to get these
+    counts for SIMD-capable machine disable SIMD for the mode (see
+    dbcb_allow_*_for_mode()). Counters are doubles, and are thread-local:
+    snapshot and reset only see the calling thread. Thread-local storage
+    uses C11/C++11 if available, or compiler extensions (define
+    DBC_BLIT_THREAD_LOCAL to override, e.g. to nothing for a single
+    counter set shared by all threads). Counting per pixel slows the
+    C versions down noticeably, so this is not meant for release builds.
+
+TRACING
+    To see each blit as a span in a timeline profiler, #define the
+    function-like macros
+dbcb_trace_begin(mode,w,h,tier)
+dbcb_trace_end()
+    before the implementation. dbc_blit() calls them around the actual
+    blitting (after clipping and mode selection), with w and h of the
+    clipped rectangle (0 if nothing is visible) and tier as in STATISTICS.
+    Calls that return early (invalid mode, alpha test that rejects all
+    pixels) are not traced. By default they expand to nothing. check.c
+    has an example (CHECK_TRACE) that writes Chrome trace-event JSON.
+
+RECORDING
+    To capture the blits an application makes (e.g. to benchmark with
+    real workloads instead of synthetic ones), #define the function-like
+    macro
+dbcb_record_blit(src_w,src_h,src_stride_in_bytes,src_pixels,
+                 dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                 x,y,color,mode)
+    before the implementation. dbc_blit() calls it on entry, with its
+    arguments as passed, before any validation or clipping; this includes
+    the dbc_blit() calls made by dbc_blit_layers*() (one per layer per
+    band) and initialization calls with all-zero arguments.
+    dbc_blit_gradient() (with a gradient) and dbc_blit_masked() are not
+    recorded, as their corners and mask do not fit the record (they are
+    still counted in statistics and traced). By default it expands to
+    nothing. check.c has an example (CHECK_RECORD) that writes a binary
+    trace, and replays it against synthetic surfaces.
+
 ALIGNMENT
     By default dbc_blit assumes no alignment for pixel data. On some systems
     this may lead to less efficient code. If you have stronger guarantees,
@@ -238,8 +640,8 @@ THREAD SAFETY
     when compiled as C (it should be thread-safe when compiled as C++). If
     that is an issue, you can call dbc_blit(0,0,0,0,0,0,0,0,0,0,0,0);
     beforehand to perform the initialization explicitly. Yes, this is lame.
-    If you #define dbcb_allow_sse2_for_mode()/dbcb_allow_avx2_for_mode()/
-    dbcb_unroll_limit_for_mode(), it is your responsibility to ensure that
+    If you #define dbcb_allow_sse2_for_mode()/dbcb_allow_sse41_for_mode()/
+    dbcb_allow_avx2_for_mode()/dbcb_unroll_limit_for_mode(), it is your responsibility to ensure that
     their evaluation is thread-safe. Same goes for dbcb_load*()/dbcb_store*()
     replacements.
     The library itself does not use multithreading internally.
@@ -257,6 +659,10 @@ ACCURACY
     accuracy gradually worsens. Modulation values that exceed 1e14 in
     magnitude, or NaN, or inf may cause problems in floating point, and are
     therefore advised against.
+    Modulated DBCB_MODE_COPY with all 4 components in [0;1] (tint, fade)
+    uses 16-bit fixed-point multipliers instead of floating point. Its
+    error stays below 0.504, and the result is the same as in floating
+    point for 0.0, 1.0, and other multiples of 1/65536.
 
 GAMMA CORRECTNESS
     Several modes in dbc_blit are gamma-corrected, i.e. src and dst
@@ -287,6 +693,12 @@ Method     Error      Notes
     The default is 0. Less accurate methods are faster.
     The approximations are slower in pure C, but may be faster with SIMD,
     depending on accuracy.
+    On CPUs with FMA3, the AVX2 versions of DBCB_MODE_GAMMA, DBCB_MODE_PMG,
+    and DBCB_MODE_MUG process 8 pixels at a time, one color channel per
+    vector, and evaluate the approximations with fused multiply-add. Due to
+    the different rounding, their result is occasionally 1 off from other
+    implementations (the trivial cases, e.g. fully transparent or opaque
+    src, are still exact).
     As mentioned, modulation introduces more inaccuracies.
     The gamma-corrected modes can also be suppressed entirely by
 #define DBC_BLIT_NO_GAMMA
@@ -360,11 +772,23 @@ MISC
 #define DBC_BLIT_NO_SIMD
 #define DBC_BLIT_NO_RUNTIME_CPU_DETECTION
 #define DBC_BLIT_NO_GCC_ASM
+#define DBC_BLIT_NO_SSE41
 #define DBC_BLIT_NO_AVX2
+#define DBC_BLIT_NO_FMA
 #define DBC_BLIT_UNROLL width
+#define DBC_BLIT_AUTOTUNE
+#define DBC_BLIT_AUTOTUNE_MS milliseconds
+#define DBC_BLIT_STATS
+#define DBC_BLIT_THREAD_LOCAL storage-class
+#define DBC_BLIT_LAYER_BAND_BYTES bytes
+#define DBC_BLIT_TILE_BYTES bytes
 #define dbcb_unroll_limit_for_mode(mode,modulated) width
 #define dbcb_allow_sse2_for_mode(mode,modulated) expr
+#define dbcb_allow_sse41_for_mode(mode,modulated) expr
 #define dbcb_allow_avx2_for_mode(mode,modulated) expr
+#define dbcb_trace_begin(mode,w,h,tier) ...
+#define dbcb_trace_end() ...
+#define dbcb_record_blit(src_w,src_h,src_stride,src_pixels,dst_w,dst_h,dst_stride,dst_pixels,x,y,color,mode) ...
 #define dbcb_load*(ptr)           ...implementation... [*={16,32[,64]}]
 #define dbcb_store*(val,ptr)      ...implementation... [*={16,32[,64]}]
 #define dbcb_load128_*(ptr)       ...implementation... [*={32,64,128}]
@@ -429,6 +853,93 @@ For more information, please refer to <http://unlicense.org/>
 #define DBCB_MODE_MUG                    9
 #define DBCB_MODE_ALPHATEST             10
 #define DBCB_MODE_CPYG                  11
+#define DBCB_MODE_HALF_ALPHA            12
+#define DBCB_MODE_HALF_PMA              13
+#define DBCB_MODE_HALF_MUL              14
+#define DBCB_MODE_HALF_RESOLVE          15
+
+#define DBCB_DAMAGE_MAX_RECTS 32
+#define DBCB_COVERAGE_BLOCK    8
+#define DBCB_FB_TILE          32
+
+/* Sprite kinds. */
+#define DBCB_SPRITE_TRANSPARENT 0
+#define DBCB_SPRITE_OPAQUE      1
+#define DBCB_SPRITE_MIXED       2
+
+/* Layer flags. */
+#define DBCB_LAYER_OPAQUE      1
+
+/* Statistics (see dbcb_stats). */
+#define DBCB_STATS_MODES      16
+#define DBCB_STATS_TIERS       4
+#define DBCB_STATS_TIER_C      0
+#define DBCB_STATS_TIER_SSE2   1
+#define DBCB_STATS_TIER_SSE41  2
+#define DBCB_STATS_TIER_AVX2   3
+
+/* Arguments of dbc_blit(), other than dst. */
+typedef struct dbcb_layer
+{
+    int w,h,stride;
+    const unsigned char *pixels;
+    int x,y;
+    const float *color;
+    int mode;
+    int flags;
+} dbcb_layer;
+
+/* Rectangle [x0;x1)x[y0;y1). */
+typedef struct dbcb_rect
+{
+    int x0,y0,x1,y1;
+} dbcb_rect;
+
+/* 8-bit coverage for dbc_blit_masked(), placed at x,y in dst. */
+typedef struct dbcb_mask
+{
+    int w,h,stride;
+    const unsigned char *pixels;
+    int x,y;
+} dbcb_mask;
+
+/* Result of dbcb_analyze_sprite(). */
+typedef struct dbcb_sprite_info
+{
+    int w,h,mode;
+    int x0,y0,x1,y1;
+    int kind;
+} dbcb_sprite_info;
+
+/*
+    Recorded blits, in caller-provided storage: layers and colors hold
+    'capacity' entries (colors: 4 floats each).
+*/
+typedef struct dbcb_cmdbuf
+{
+    dbcb_layer *layers;
+    float *colors;
+    int capacity;
+    int count;
+    int dropped;
+} dbcb_cmdbuf;
+
+typedef struct dbcb_damage
+{
+    int count;
+    dbcb_rect rects[DBCB_DAMAGE_MAX_RECTS];
+} dbcb_damage;
+
+/* Counters of DBC_BLIT_STATS. */
+typedef struct dbcb_stats
+{
+    double calls  [DBCB_STATS_MODES][DBCB_STATS_TIERS];
+    double pixels [DBCB_STATS_MODES][DBCB_STATS_TIERS];
+    double clipped[DBCB_STATS_MODES];
+    double transparent[DBCB_STATS_MODES];
+    double opaque     [DBCB_STATS_MODES];
+    double blended    [DBCB_STATS_MODES];
+} dbcb_stats;
 
 #ifdef __cplusplus
 extern "C" {
@@ -443,6 +954,155 @@ DBCB_DEF void dbc_blit(
     const float *color,
     int mode);
 
+DBCB_DEF void dbc_blit_layers(
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    const dbcb_layer *layers,
+    int count);
+
+DBCB_DEF void dbcb_damage_clear(dbcb_damage *damage);
+
+DBCB_DEF void dbcb_damage_add(
+    dbcb_damage *damage,
+    int x0,int y0,int x1,int y1);
+
+DBCB_DEF void dbcb_damage_add_blit(
+    dbcb_damage *damage,
+    int src_w,int src_h,
+    int dst_w,int dst_h,
+    int x,int y);
+
+DBCB_DEF void dbc_blit_layers_damaged(
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    const dbcb_layer *layers,
+    int count,
+    const dbcb_damage *damage);
+
+DBCB_DEF int dbcb_coverage_size(int dst_w,int dst_h);
+
+DBCB_DEF void dbc_blit_layers_culled(
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    const dbcb_layer *layers,
+    int count,
+    unsigned short *coverage);
+
+DBCB_DEF void dbcb_analyze_sprite(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int mode,
+    dbcb_sprite_info *info);
+
+DBCB_DEF void dbc_blit_analyzed(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode,
+    const dbcb_sprite_info *info);
+
+DBCB_DEF void dbc_blit_masked(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode,
+    const dbcb_mask *mask);
+
+DBCB_DEF void dbc_blit_tiled(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    int x,int y,int w,int h,
+    int phase_x,int phase_y,
+    const float *color,
+    int mode);
+
+DBCB_DEF void dbc_blit_nine_slice(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    int x,int y,int w,int h,
+    int left,int top,int right,int bottom,
+    const float *color,
+    int mode);
+
+DBCB_DEF void dbc_blit_gradient(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *corners,
+    int mode);
+
+DBCB_DEF void dbcb_cmdbuf_init(
+    dbcb_cmdbuf *buf,
+    dbcb_layer *layers,
+    float *colors,
+    int capacity);
+
+DBCB_DEF void dbcb_cmdbuf_clear(dbcb_cmdbuf *buf);
+
+DBCB_DEF int dbcb_cmdbuf_blit(
+    dbcb_cmdbuf *buf,
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int x,int y,
+    const float *color,
+    int mode);
+
+DBCB_DEF void dbc_blit_cmdbuf(
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    const dbcb_cmdbuf *buf);
+
+DBCB_DEF int dbcb_tiled_fb_size(int dst_w,int dst_h,int pixel_size);
+
+DBCB_DEF void dbc_blit_tiled_fb(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode);
+
+DBCB_DEF void dbcb_tiled_fb_load(
+    int w,int h,int pixel_size,
+    int src_stride,
+    const unsigned char *src_pixels,
+    unsigned char *tiled_pixels);
+
+DBCB_DEF void dbcb_tiled_fb_detile(
+    int w,int h,int pixel_size,
+    const unsigned char *tiled_pixels,
+    int dst_stride,
+    unsigned char *dst_pixels);
+
+/*
+    Only available with DBC_BLIT_AUTOTUNE. Static builds (DBC_BLIT_STATIC)
+    declare them only if they are defined, to avoid unused declarations.
+*/
+#if defined(DBC_BLIT_AUTOTUNE) || !defined(DBC_BLIT_STATIC)
+DBCB_DEF void dbcb_autotune(void);
+DBCB_DEF int  dbcb_autotune_save(const char *filename);
+DBCB_DEF int  dbcb_autotune_load(const char *filename);
+#endif
+
+/* Only available with DBC_BLIT_STATS. */
+#if defined(DBC_BLIT_STATS) || !defined(DBC_BLIT_STATIC)
+DBCB_DEF void dbcb_stats_snapshot(dbcb_stats *stats);
+DBCB_DEF void dbcb_stats_reset(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -551,6 +1211,8 @@ typedef char dbcB_check_size_u64[sizeof(dbcb_uint64)==8?1:-1];
    You can #define it to your own implementation.
    It is used to copy lines of pixels.
 */
+#include <stddef.h> /* size_t, also available in freestanding implementations. */
+
 #ifndef dbcb_memcpy
 #if defined(__GNUC__) && (__STDC_HOSTED__==0)
 #define dbcb_memcpy(dst,src,size) __builtin_memcpy((dst),(src),(size)) /* Allow memcpy in freestanding implementation. */
@@ -560,6 +1222,11 @@ typedef char dbcB_check_size_u64[sizeof(dbcb_uint64)==8?1:-1];
 #endif
 #endif /* dbcb_memcpy */
 
+#ifdef DBC_BLIT_AUTOTUNE
+#include <stdio.h> /* dbcb_autotune_save(), dbcb_autotune_load(). */
+#include <time.h>  /* Calibration timing. */
+#endif
+
 /*
     Fixed-width load/store functions. You can #define them (all of
     them, or none) to your own implementations.
@@ -744,11 +1411,29 @@ static void dbcb_store64(dbcb_uint64 v,void *p)
 #define dbcb_allow_sse2_for_mode(mode,modulated) 1
 #endif
 
+/* Controls using SSE4.1 on per mode basis. */
+#ifndef dbcb_allow_sse41_for_mode
+#define dbcb_allow_sse41_for_mode(mode,modulated) 1
+#endif
+
 /* Controls using AVX2 on per mode basis. */
 #ifndef dbcb_allow_avx2_for_mode
 #define dbcb_allow_avx2_for_mode(mode,modulated) 1
 #endif
 
+/* Trace hooks around each blit. */
+#ifndef dbcb_trace_begin
+#define dbcb_trace_begin(mode,w,h,tier) ((void)0)
+#endif
+#ifndef dbcb_trace_end
+#define dbcb_trace_end() ((void)0)
+#endif
+
+/* Recording hook on entry to dbc_blit(). */
+#ifndef dbcb_record_blit
+#define dbcb_record_blit(src_w,src_h,src_stride,src_pixels,dst_w,dst_h,dst_stride,dst_pixels,x,y,color,mode) ((void)0)
+#endif
+
 /* Controls the amount of unrolling. Only supported values are 0 (disable unroll) 8, 16, and 32. The default is 8. */
 #ifndef DBC_BLIT_UNROLL
 #define DBC_BLIT_UNROLL 8
@@ -756,8 +1441,12 @@ static void dbcb_store64(dbcb_uint64 v,void *p)
 
 /* Controls unrolling on per mode basis. */
 #ifndef dbcb_unroll_limit_for_mode
+#ifdef DBC_BLIT_AUTOTUNE
+#define dbcb_unroll_limit_for_mode(mode,modulated) (dbcB_tune_no_unroll[mode][modulated]?0:(DBC_BLIT_UNROLL))
+#else
 #define dbcb_unroll_limit_for_mode(mode,modulated) (DBC_BLIT_UNROLL)
 #endif
+#endif
 
 #if (defined(__MINGW32__)||defined(__MINGW64__))&&!defined(DBCB_X64)
 #if !defined(DBC_BLIT_ENABLE_MINGW_SIMD) && !defined(DBC_BLIT_NO_SIMD)
@@ -806,6 +1495,22 @@ static void dbcb_store64(dbcb_uint64 v,void *p)
 #define DBCB_DECL_SSE2
 #endif /* defined(__GNUC__) */
 
+#ifndef DBC_BLIT_NO_SSE41
+#if defined(__GNUC__)
+#if defined(__SSE4_1__)
+#define DBCB_DECL_SSE41
+#else
+#ifdef DBCB_X64
+#define DBCB_DECL_SSE41 __attribute__((target("sse4.1"))) /* No stdcall in x64. */
+#else
+#define DBCB_DECL_SSE41 __attribute__((target("sse4.1"),stdcall))
+#endif /* DBCB_X64 */
+#endif /* defined(__SSE4_1__) */
+#else
+#define DBCB_DECL_SSE41
+#endif /* defined(__GNUC__) */
+#endif /* DBC_BLIT_NO_SSE41 */
+
 #ifndef DBC_BLIT_NO_AVX2
 #if defined(__GNUC__)
 #if defined(__AVX2__)
@@ -825,6 +1530,37 @@ static void dbcb_store64(dbcb_uint64 v,void *p)
 #else
 #define DBCB_DECL_AVX2
 #endif /* defined(__GNUC__) */
+/* Same as DBCB_DECL_AVX2, with F16C (used by half-float modes). */
+#if defined(__GNUC__)
+#if defined(__AVX2__) && defined(__F16C__)
+#define DBCB_DECL_F16C
+#else
+#ifdef DBCB_X64
+#define DBCB_DECL_F16C __attribute__((target("avx2,f16c"))) /* No stdcall in x64. */
+#else
+#define DBCB_DECL_F16C __attribute__((target("avx2,f16c"),stdcall))
+#endif /* DBCB_X64 */
+#endif /* defined(__AVX2__) && defined(__F16C__) */
+#else
+#define DBCB_DECL_F16C
+#endif /* defined(__GNUC__) */
+/* Same as DBCB_DECL_AVX2, with FMA3 (used by gamma-corrected modes without tables). */
+#if defined(__GNUC__)
+#if defined(__AVX2__) && defined(__FMA__)
+#define DBCB_DECL_FMA
+#else
+#ifdef DBCB_X64
+#define DBCB_DECL_FMA __attribute__((target("avx2,fma"))) /* No stdcall in x64. */
+#else
+#define DBCB_DECL_FMA __attribute__((target("avx2,fma"),stdcall))
+#endif /* DBCB_X64 */
+#endif /* defined(__AVX2__) && defined(__FMA__) */
+#else
+#define DBCB_DECL_FMA
+#endif /* defined(__GNUC__) */
+#if !defined(DBC_BLIT_NO_GAMMA) && defined(DBC_BLIT_GAMMA_NO_TABLES) && !defined(DBC_BLIT_NO_FMA)
+#define DBCB_GAMMA_FMA
+#endif
 #endif /* DBC_BLIT_NO_AVX2 */
 
 #endif /* DBCB_X86_OR_X64 */
@@ -835,9 +1571,105 @@ static void dbcb_store64(dbcb_uint64 v,void *p)
 
 #if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
 static int dbcB_has_sse2;
+#ifndef DBC_BLIT_NO_SSE41
+static int dbcB_has_sse41;
+#endif
 #ifndef DBC_BLIT_NO_AVX2
 static int dbcB_has_avx2;
+static int dbcB_has_f16c;
+static int dbcB_has_fma;
+#endif
+/*
+    Instruction sets that are enabled globally are always used (see
+    dbcB_init()), so dbc_blit() can test them at compile time.
+*/
+#if defined(__SSE2__) || (_M_IX86_FP>=2)
+#define DBCB_HAS_SSE2 1
+#if !defined(DBC_BLIT_NO_SSE41) && (defined(__SSE4_1__) || defined(__AVX__))
+#define DBCB_HAS_SSE41 1
+#endif
+#if !defined(DBC_BLIT_NO_AVX2) && defined(__AVX2__)
+#define DBCB_HAS_AVX2 1
+#if defined(__F16C__)
+#define DBCB_HAS_F16C 1
+#endif
+#if defined(__FMA__)
+#define DBCB_HAS_FMA 1
+#endif
+#endif
+#endif
+#ifndef DBCB_HAS_SSE2
+#define DBCB_HAS_SSE2 dbcB_has_sse2
+#endif
+#ifndef DBCB_HAS_SSE41
+#define DBCB_HAS_SSE41 dbcB_has_sse41
 #endif
+#ifndef DBCB_HAS_AVX2
+#define DBCB_HAS_AVX2 dbcB_has_avx2
+#endif
+#ifndef DBCB_HAS_F16C
+#define DBCB_HAS_F16C dbcB_has_f16c
+#endif
+#ifndef DBCB_HAS_FMA
+#define DBCB_HAS_FMA dbcB_has_fma
+#endif
+#endif
+
+#ifdef DBC_BLIT_AUTOTUNE
+#define DBCB_TUNE_MODES   16
+#define DBCB_TUNE_BUCKETS  4
+/*
+    Autotuning results, per mode, modulated, and width bucket (see
+    dbcB_tune_bucket()). Tier: 0 - not tuned (use highest available),
+    1 - C, 2 - SSE2, 3 - SSE4.1, 4 - AVX2. Zero-initialized means "as
+    without tuning".
+*/
+static dbcb_uint8 dbcB_tune_tier[DBCB_TUNE_MODES][2][DBCB_TUNE_BUCKETS];
+static dbcb_uint8 dbcB_tune_no_unroll[DBCB_TUNE_MODES][2];
+/*
+    If non-zero, overrides the tier (used during calibration).
+    Like the table, it is read by dbc_blit() without synchronization,
+    and is only written by dbcb_autotune() (see AUTOTUNING).
+*/
+static int dbcB_tune_force;
+#endif
+
+#ifdef DBC_BLIT_STATS
+#ifndef DBC_BLIT_THREAD_LOCAL
+#if defined(__cplusplus) && __cplusplus>=201103L
+#define DBC_BLIT_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__>=201112L
+#define DBC_BLIT_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define DBC_BLIT_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define DBC_BLIT_THREAD_LOCAL __thread
+#else
+#define DBC_BLIT_THREAD_LOCAL
+#endif
+#endif
+static DBC_BLIT_THREAD_LOCAL dbcb_stats dbcB_stats;
+
+/* Classifies src pixel, same as dbcb_analyze_sprite(). */
+static void dbcB_stats_pixel(int mode,dbcb_uint32 S)
+{
+    int transparent,opaque;
+    switch(mode)
+    {
+        case DBCB_MODE_PMA:
+        case DBCB_MODE_PMG: transparent=(S==0u); break;
+        case DBCB_MODE_MUL:
+        case DBCB_MODE_MUG: transparent=(S==0xFFFFFFFFu); break;
+        default:            transparent=((S>>24)==0u); break;
+    }
+    opaque=((S>>24)==255u&&mode!=DBCB_MODE_MUL&&mode!=DBCB_MODE_MUG);
+    if(transparent) ++dbcB_stats.transparent[mode];
+    else if(opaque) ++dbcB_stats.opaque[mode];
+    else            ++dbcB_stats.blended[mode];
+}
+#define DBCB_STATS_PIXEL(mode,S) dbcB_stats_pixel(mode,S)
+#else
+#define DBCB_STATS_PIXEL(mode,S) ((void)0)
 #endif
 
 #if !defined(DBC_BLIT_NO_GAMMA) && !defined(DBC_BLIT_GAMMA_NO_TABLES)
@@ -1024,6 +1856,89 @@ static dbcb_uint8 dbcB_float2byte(float x)
     return (dbcb_uint8)(dbcb_int32)(x+0.5f);
 }
 
+/* Checks that all modulation components are in [0;1] (false for NaN). */
+static int dbcB_color_in_0_1(const float *color)
+{
+    return color[0]>=0.0f&&color[0]<=1.0f&&
+           color[1]>=0.0f&&color[1]<=1.0f&&
+           color[2]>=0.0f&&color[2]<=1.0f&&
+           color[3]>=0.0f&&color[3]<=1.0f;
+}
+
+/*
+    Converts modulation components in [0;1] (see dbcB_color_in_0_1(),
+    outside of it the conversion overflows) to 16-bit fixed-point
+    multipliers, round(c*65536), saturated to 65535. The byte is then
+    modulated as (b*m+32768)>>16, which is exact for 1.0 (m=65535 still
+    maps b to b) and for c=k/2^n, and is otherwise within 255/2^17 of the
+    float result before rounding.
+*/
+static void dbcB_color2mul16(const float *color,dbcb_uint16 *mul)
+{
+    int i;
+    for(i=0;i<4;++i)
+    {
+        dbcb_int32 m=(dbcb_int32)(color[i]*65536.0f+0.5f);
+        mul[i]=(dbcb_uint16)(m>65535?65535:m);
+    }
+}
+
+#ifndef DBC_BLIT_NO_GAMMA
+/*
+    Half-float (IEEE 754 binary16) <-> float conversions, used by
+    half-float modes. Rounding is to nearest-even, NaNs are quieted,
+    which matches vcvtph2ps/vcvtps2ph (F16C) with imm8=0.
+*/
+static float dbcB_half2float(dbcb_uint16 h)
+{
+    dbcb_uint32 s=((dbcb_uint32)h&0x8000u)<<16;
+    dbcb_uint32 e=((dbcb_uint32)h>>10)&0x1Fu;
+    dbcb_uint32 m=(dbcb_uint32)h&0x3FFu;
+    dbcb_uint32 x;
+    float ret;
+    if(e==0x1Fu) x=s|0x7F800000u|(m?0x00400000u|(m<<13):0u);
+    else if(e) x=s|((e+112u)<<23)|(m<<13);
+    else if(!m) x=s;
+    else
+    {
+        /* Denormal. */
+        e=113u;
+        while(!(m&0x400u)) {m<<=1;--e;}
+        x=s|(e<<23)|((m&0x3FFu)<<13);
+    }
+    dbcb_memcpy(&ret,&x,4);
+    return ret;
+}
+
+static dbcb_uint16 dbcB_float2half(float f)
+{
+    dbcb_uint32 x,s;
+    dbcb_memcpy(&x,&f,4);
+    s=(x>>16)&0x8000u;
+    x&=0x7FFFFFFFu;
+    if(x>=0x7F800000u) return (dbcb_uint16)(s|(x>0x7F800000u?0x7E00u|((x>>13)&0x3FFu):0x7C00u));
+    if(x>=0x477FF000u) return (dbcb_uint16)(s|0x7C00u); /* Rounds to inf. */
+    if(x>=0x38800000u)
+    {
+        /* Normal. Carry from mantissa into exponent is correct. */
+        x-=0x38000000u;
+        x+=0x0FFFu+((x>>13)&1u);
+        return (dbcb_uint16)(s|(x>>13));
+    }
+    if(x<=0x33000000u) return (dbcb_uint16)s; /* Rounds to 0. */
+    {
+        /* Denormal. */
+        dbcb_uint32 shift=126u-(x>>23);
+        dbcb_uint32 m=(x&0x007FFFFFu)|0x00800000u;
+        dbcb_uint32 q=m>>shift;
+        dbcb_uint32 r=m&((1u<<shift)-1u);
+        dbcb_uint32 half=1u<<(shift-1u);
+        if(r>half||(r==half&&(q&1u))) ++q;
+        return (dbcb_uint16)(s|q);
+    }
+}
+#endif /* DBC_BLIT_NO_GAMMA */
+
 #ifndef DBC_BLIT_NO_GAMMA
 
 static dbcb_fp dbcB_srgb2linear(dbcb_uint8 x)
@@ -1226,6 +2141,34 @@ static dbcb_uint8 dbcB_clxm(dbcb_uint8 s,dbcb_uint8 d,float m)
     return dbcB_float2byte(dbcB_clamp0_255(ret));
 }
 
+/*
+    Fixed-point modulation (see dbcB_color2mul16()): t is the modulated
+    channel s*m/256 (8.8 fixed point), a is the modulated alpha, likewise.
+    Products are truncated the way pmulhuw does, so that SIMD versions
+    (see dbcB_blak_row_sse2()) give the same results.
+*/
+static dbcb_uint32 dbcB_mul8x16(dbcb_uint8 s,dbcb_uint16 m)
+{
+    return ((dbcb_uint32)s*256u*(dbcb_uint32)m)>>16;
+}
+
+static dbcb_uint8 dbcB_clak(dbcb_uint32 t,dbcb_uint8 d,dbcb_uint32 a)
+{
+    dbcb_uint32 ret=((t*a)>>16)+(((dbcb_uint32)d*256u*(65280u-a))>>16);
+    return (dbcb_uint8)dbcB_div255_round(ret);
+}
+
+static dbcb_uint8 dbcB_clpk(dbcb_uint32 t,dbcb_uint8 d,dbcb_uint32 a)
+{
+    dbcb_uint32 ret=dbcB_div255_round(((dbcb_uint32)d*256u*(65280u-a))>>16)+((t+128u)>>8);
+    return (dbcb_uint8)(ret>255u?255u:ret);
+}
+
+static dbcb_uint8 dbcB_clxk(dbcb_uint32 t,dbcb_uint8 d)
+{
+    return (dbcb_uint8)dbcB_div255_round(((dbcb_uint32)d*256u*t)>>16);
+}
+
 #ifndef DBC_BLIT_NO_GAMMA
 
 static dbcb_uint8 dbcB_cga(dbcb_uint8 s,dbcb_uint8 d,dbcb_uint8 a)
@@ -1302,6 +2245,18 @@ static void dbcB_b32m_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
         d);
 }
 
+/* Copies single pixel, with fixed-point modulation (see dbcB_color2mul16()). */
+static void dbcB_b32k_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const dbcb_uint16 *mul)
+{
+    dbcb_uint32 S=dbcb_load32(s);
+    dbcb_store32(dbcB_4x8to32(
+        (dbcb_uint8)(((dbcb_uint32)dbcB_getb(S,0)*mul[0]+32768u)>>16),
+        (dbcb_uint8)(((dbcb_uint32)dbcB_getb(S,1)*mul[1]+32768u)>>16),
+        (dbcb_uint8)(((dbcb_uint32)dbcB_getb(S,2)*mul[2]+32768u)>>16),
+        (dbcb_uint8)(((dbcb_uint32)dbcB_getb(S,3)*mul[3]+32768u)>>16)),
+        d);
+}
+
 /* Alpha-blends single pixel, linear. */
 static void dbcB_bla_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 {
@@ -1309,6 +2264,7 @@ static void dbcB_bla_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
     {
         dbcb_uint32 S=dbcb_load32(s);
         dbcb_uint32 D=dbcb_load32(d);
+        DBCB_STATS_PIXEL(DBCB_MODE_ALPHA,S);
         dbcb_store32(dbcB_4x8to32(
             dbcB_cla(dbcB_getb(S,0),dbcB_getb(D,0),dbcB_getb(S,3)),
             dbcB_cla(dbcB_getb(S,1),dbcB_getb(D,1),dbcB_getb(S,3)),
@@ -1319,6 +2275,7 @@ static void dbcB_bla_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
     else
     {
         dbcb_uint32 S=dbcb_load32(s);
+        DBCB_STATS_PIXEL(DBCB_MODE_ALPHA,S);
         if(S>0x00FFFFFFu)
         {
             if(S<0xFF000000u)
@@ -1387,6 +2344,7 @@ static void dbcB_blp_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
     {
         dbcb_uint32 S=dbcb_load32(s);
         dbcb_uint32 D=dbcb_load32(d);
+        DBCB_STATS_PIXEL(DBCB_MODE_PMA,S);
         dbcb_store32(dbcB_4x8to32(
             dbcB_clp(dbcB_getb(S,0),dbcB_getb(D,0),dbcB_getb(S,3)),
             dbcB_clp(dbcB_getb(S,1),dbcB_getb(D,1),dbcB_getb(S,3)),
@@ -1398,6 +2356,7 @@ static void dbcB_blp_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
     {
         dbcb_uint32 S=dbcb_load32(s);
         dbcb_uint32 D=dbcb_load32(d);
+        DBCB_STATS_PIXEL(DBCB_MODE_PMA,S);
         if(S<0xFF000000u&&D>0u)
         {
 #if !defined(DBC_BLIT_NO_INT64)
@@ -1491,6 +2450,40 @@ static void dbcB_blpm_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
     }
 }
 
+/* Alpha-blends single pixel, linear, with fixed-point modulation. */
+static void dbcB_blak_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const dbcb_uint16 *mul)
+{
+    dbcb_uint32 S=dbcb_load32(s);
+    if(S>0x00FFFFFFu)
+    {
+        dbcb_uint32 D=dbcb_load32(d);
+        dbcb_uint32 a=dbcB_mul8x16(dbcB_getb(S,3),mul[3]);
+        dbcb_store32(dbcB_4x8to32(
+            dbcB_clak(dbcB_mul8x16(dbcB_getb(S,0),mul[0]),dbcB_getb(D,0),a),
+            dbcB_clak(dbcB_mul8x16(dbcB_getb(S,1),mul[1]),dbcB_getb(D,1),a),
+            dbcB_clak(dbcB_mul8x16(dbcB_getb(S,2),mul[2]),dbcB_getb(D,2),a),
+            dbcB_clak(                             65280u,dbcB_getb(D,3),a)),
+            d);
+    }
+}
+
+/* Alpha-blends (PMA) single pixel, linear, with fixed-point modulation. */
+static void dbcB_blpk_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const dbcb_uint16 *mul)
+{
+    dbcb_uint32 S=dbcb_load32(s);
+    if(S>0u)
+    {
+        dbcb_uint32 D=dbcb_load32(d);
+        dbcb_uint32 a=dbcB_mul8x16(dbcB_getb(S,3),mul[3]);
+        dbcb_store32(dbcB_4x8to32(
+            dbcB_clpk(dbcB_mul8x16(dbcB_getb(S,0),mul[0]),dbcB_getb(D,0),a),
+            dbcB_clpk(dbcB_mul8x16(dbcB_getb(S,1),mul[1]),dbcB_getb(D,1),a),
+            dbcB_clpk(dbcB_mul8x16(dbcB_getb(S,2),mul[2]),dbcB_getb(D,2),a),
+            dbcB_clpk(                                  a,dbcB_getb(D,3),a)),
+            d);
+    }
+}
+
 /* Blits single 8-bit pixel with colorkey. */
 static void dbcB_b8m_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,dbcb_uint8 key)
 {
@@ -1742,6 +2735,7 @@ static void dbcB_b32s_4_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 static void dbcB_blx_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 {
     dbcb_uint32 S=dbcb_load32(s);
+    DBCB_STATS_PIXEL(DBCB_MODE_MUL,S);
     if(S<0xFFFFFFFFu)
     {
         if(S==0u) dbcb_store32(S,d);
@@ -1791,6 +2785,19 @@ static void dbcB_blxm_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
     }
 }
 
+/* Multiplies single pixel, linear, with fixed-point modulation. */
+static void dbcB_blxk_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const dbcb_uint16 *mul)
+{
+    dbcb_uint32 S=dbcb_load32(s);
+    dbcb_uint32 D=dbcb_load32(d);
+    dbcb_store32(dbcB_4x8to32(
+        dbcB_clxk(dbcB_mul8x16(dbcB_getb(S,0),mul[0]),dbcB_getb(D,0)),
+        dbcB_clxk(dbcB_mul8x16(dbcB_getb(S,1),mul[1]),dbcB_getb(D,1)),
+        dbcB_clxk(dbcB_mul8x16(dbcB_getb(S,2),mul[2]),dbcB_getb(D,2)),
+        dbcB_clxk(dbcB_mul8x16(dbcB_getb(S,3),mul[3]),dbcB_getb(D,3))),
+        d);
+}
+
 #ifndef DBC_BLIT_NO_GAMMA
 /*
     Note: tests for the trivial cases are to speed them up, but
@@ -1814,6 +2821,7 @@ static void dbcB_b32g_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
 static void dbcB_bga_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 {
     dbcb_uint32 S=dbcb_load32(s);
+    DBCB_STATS_PIXEL(DBCB_MODE_GAMMA,S);
     if(S>0x00FFFFFFu)
     {
         if(S>=0xFF000000u) dbcb_store32(S,d);
@@ -1848,6 +2856,7 @@ static void dbcB_bga_4_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 static void dbcB_bgp_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 {
     dbcb_uint32 S=dbcb_load32(s);
+    DBCB_STATS_PIXEL(DBCB_MODE_PMG,S);
     if(S>0u)
     {
         if(S>=0xFF000000u) dbcb_store32(S,d);
@@ -1883,6 +2892,7 @@ static void dbcB_bgp_4_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 static void dbcB_bgx_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
 {
     dbcb_uint32 S=dbcb_load32(s);
+    DBCB_STATS_PIXEL(DBCB_MODE_MUG,S);
     if(S<0xFFFFFFFFu)
     {
         if(S==0u) dbcb_store32(S,d);
@@ -1964,15 +2974,207 @@ static void dbcB_bgxm_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
     }
 }
 
-#endif /* DBC_BLIT_NO_GAMMA */
-
-/* SIMD versions. */
+/*
+    Half-float modes. Operations are done in float, in the same order
+    as in SIMD versions, so that results are bitwise identical (as long
+    as sRGB -> linear conversion is, which is the case with tables).
+*/
 
-#if !defined(DBC_BLIT_NO_SIMD)
-#if defined(DBCB_X86_OR_X64)
+/* Decodes sRGB pixel into linear floats. */
+static void dbcB_load_srgb_c(const dbcb_uint8 *s,float *v)
+{
+    dbcb_uint32 S=dbcb_load32(s);
+    v[0]=(float)dbcB_srgb2linear(dbcB_getb(S,0));
+    v[1]=(float)dbcB_srgb2linear(dbcB_getb(S,1));
+    v[2]=(float)dbcB_srgb2linear(dbcB_getb(S,2));
+    v[3]=dbcB_byte2float(dbcB_getb(S,3))*DBCB_1div255f;
+}
 
-#if defined(__GNUC__) && !defined(DBC_BLIT_NO_GCC_ASM) && ((!defined(__SSE2__) && !defined(DBCB_PREFER_INTRINSICS)) || defined(DBC_BLIT_FORCE_GCC_ASM))
-/* GCC or something, that understands GCC asm (icc, clang). */
+/* Loads RGBA16F pixel. */
+static void dbcB_load_half_c(const dbcb_uint8 *s,float *v)
+{
+    v[0]=dbcB_half2float(dbcb_load16(s  ));
+    v[1]=dbcB_half2float(dbcb_load16(s+2));
+    v[2]=dbcB_half2float(dbcb_load16(s+4));
+    v[3]=dbcB_half2float(dbcb_load16(s+6));
+}
+
+/* Stores RGBA16F pixel. */
+static void dbcB_store_half_c(const float *v,dbcb_uint8 *d)
+{
+    dbcb_store16(dbcB_float2half(v[0]),d  );
+    dbcb_store16(dbcB_float2half(v[1]),d+2);
+    dbcb_store16(dbcB_float2half(v[2]),d+4);
+    dbcb_store16(dbcB_float2half(v[3]),d+6);
+}
+
+/* Alpha-blends single pixel into half-float. */
+static void dbcB_bha_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    if(dbcb_load32(s)>0x00FFFFFFu)
+    {
+        float S[4],D[4],A,C;
+        dbcB_load_srgb_c(s,S);
+        dbcB_load_half_c(d,D);
+        A=S[3];
+        C=1.0f-A;
+        D[0]=A*S[0]+C*D[0];
+        D[1]=A*S[1]+C*D[1];
+        D[2]=A*S[2]+C*D[2];
+        D[3]=A*1.0f+C*D[3];
+        dbcB_store_half_c(D,d);
+    }
+}
+
+/* Alpha-blends 2 pixels into half-float. */
+static void dbcB_bha_2_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    dbcB_bha_1_c(s  ,d  );
+    dbcB_bha_1_c(s+4,d+8);
+}
+
+/* Alpha-blends single pixel into half-float, with modulation. */
+static void dbcB_bham_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
+{
+    if(dbcb_load32(s)>0x00FFFFFFu&&color[3]!=0.0f)
+    {
+        float S[4],D[4],A,C;
+        dbcB_load_srgb_c(s,S);
+        dbcB_load_half_c(d,D);
+        S[0]*=color[0];
+        S[1]*=color[1];
+        S[2]*=color[2];
+        S[3]*=color[3];
+        A=S[3];
+        C=1.0f-A;
+        D[0]=A*S[0]+C*D[0];
+        D[1]=A*S[1]+C*D[1];
+        D[2]=A*S[2]+C*D[2];
+        D[3]=A*1.0f+C*D[3];
+        dbcB_store_half_c(D,d);
+    }
+}
+
+/* Alpha-blends (PMA) single pixel into half-float. */
+static void dbcB_bhp_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    if(dbcb_load32(s)>0u)
+    {
+        float S[4],D[4],C;
+        dbcB_load_srgb_c(s,S);
+        dbcB_load_half_c(d,D);
+        C=1.0f-S[3];
+        D[0]=S[0]+C*D[0];
+        D[1]=S[1]+C*D[1];
+        D[2]=S[2]+C*D[2];
+        D[3]=S[3]+C*D[3];
+        dbcB_store_half_c(D,d);
+    }
+}
+
+/* Alpha-blends (PMA) 2 pixels into half-float. */
+static void dbcB_bhp_2_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    dbcB_bhp_1_c(s  ,d  );
+    dbcB_bhp_1_c(s+4,d+8);
+}
+
+/* Alpha-blends (PMA) single pixel into half-float, with modulation. */
+static void dbcB_bhpm_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
+{
+    if(dbcb_load32(s)>0u)
+    {
+        float S[4],D[4],C;
+        dbcB_load_srgb_c(s,S);
+        dbcB_load_half_c(d,D);
+        S[0]*=color[0];
+        S[1]*=color[1];
+        S[2]*=color[2];
+        S[3]*=color[3];
+        C=1.0f-S[3];
+        D[0]=S[0]+C*D[0];
+        D[1]=S[1]+C*D[1];
+        D[2]=S[2]+C*D[2];
+        D[3]=S[3]+C*D[3];
+        dbcB_store_half_c(D,d);
+    }
+}
+
+/* Multiplies single pixel into half-float. */
+static void dbcB_bhx_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    float S[4],D[4];
+    dbcB_load_srgb_c(s,S);
+    dbcB_load_half_c(d,D);
+    D[0]=S[0]*D[0];
+    D[1]=S[1]*D[1];
+    D[2]=S[2]*D[2];
+    D[3]=S[3]*D[3];
+    dbcB_store_half_c(D,d);
+}
+
+/* Multiplies 2 pixels into half-float. */
+static void dbcB_bhx_2_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    dbcB_bhx_1_c(s  ,d  );
+    dbcB_bhx_1_c(s+4,d+8);
+}
+
+/* Multiplies single pixel into half-float, with modulation. */
+static void dbcB_bhxm_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
+{
+    float S[4],D[4];
+    dbcB_load_srgb_c(s,S);
+    dbcB_load_half_c(d,D);
+    D[0]=(S[0]*color[0])*D[0];
+    D[1]=(S[1]*color[1])*D[1];
+    D[2]=(S[2]*color[2])*D[2];
+    D[3]=(S[3]*color[3])*D[3];
+    dbcB_store_half_c(D,d);
+}
+
+/* Resolves single half-float pixel into sRGB. */
+static void dbcB_bhr_1_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    float S[4];
+    dbcB_load_half_c(s,S);
+    dbcb_store32(dbcB_4x8to32(
+        dbcB_linear2srgb(dbcB_clamp0_1((dbcb_fp)S[0])),
+        dbcB_linear2srgb(dbcB_clamp0_1((dbcb_fp)S[1])),
+        dbcB_linear2srgb(dbcB_clamp0_1((dbcb_fp)S[2])),
+        dbcB_float2byte (dbcB_clamp0_255(S[3]*255.0f))),
+        d);
+}
+
+/* Resolves 2 half-float pixels into sRGB. */
+static void dbcB_bhr_2_c(const dbcb_uint8 *s,dbcb_uint8 *d)
+{
+    dbcB_bhr_1_c(s  ,d  );
+    dbcB_bhr_1_c(s+8,d+4);
+}
+
+/* Resolves single half-float pixel into sRGB, with modulation. */
+static void dbcB_bhrm_1_c(const dbcb_uint8 *s,dbcb_uint8 *d,const float *color)
+{
+    float S[4];
+    dbcB_load_half_c(s,S);
+    dbcb_store32(dbcB_4x8to32(
+        dbcB_linear2srgb(dbcB_clamp0_1((dbcb_fp)(color[0]*S[0]))),
+        dbcB_linear2srgb(dbcB_clamp0_1((dbcb_fp)(color[1]*S[1]))),
+        dbcB_linear2srgb(dbcB_clamp0_1((dbcb_fp)(color[2]*S[2]))),
+        dbcB_float2byte (dbcB_clamp0_255((color[3]*S[3])*255.0f))),
+        d);
+}
+
+#endif /* DBC_BLIT_NO_GAMMA */
+
+/* SIMD versions. */
+
+#if !defined(DBC_BLIT_NO_SIMD)
+#if defined(DBCB_X86_OR_X64)
+
+#if defined(__GNUC__) && !defined(DBC_BLIT_NO_GCC_ASM) && ((!defined(__SSE2__) && !defined(DBCB_PREFER_INTRINSICS)) || defined(DBC_BLIT_FORCE_GCC_ASM))
+/* GCC or something, that understands GCC asm (icc, clang). */
 
 /*
     Older versions of GCC (pre-4.9) and clang (pre-3.8) prevent you
@@ -2033,12 +3235,13 @@ DBCB_SSE2_SPEC dbcb_f32x4 dbcB_mm_loadu_ps(float const *P) {dbcb_f32x4 ret;__asm
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_packus_epi16(dbcb_i32x4 A,dbcb_i32x4 B) {__asm__("packuswb %1,%0":"+x"(A):"x"(B));return A;}
 // Not a proper replacement. We only call it with mask={0xB1,0xF5,0xFF}.
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_shufflelo_epi16(dbcb_i32x4 A,const int mask) {if(mask==0xB1) __asm__("pshuflw $0xB1,%0,%0":"+x"(A)); else if(mask==0xF5) __asm__("pshuflw $0xF5,%0,%0":"+x"(A)); else __asm__("pshuflw $0xFF,%0,%0":"+x"(A)); return A;}
-// Not a proper replacement. We only call it with mask=0xB1.
-DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_shufflehi_epi16(dbcb_i32x4 A,const int mask) {(void)mask;__asm__("pshufhw $0xB1,%0,%0":"+x"(A));return A;}
+// Not a proper replacement. We only call it with mask={0xB1,0xFF}.
+DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_shufflehi_epi16(dbcb_i32x4 A,const int mask) {if(mask==0xB1) __asm__("pshufhw $0xB1,%0,%0":"+x"(A)); else __asm__("pshufhw $0xFF,%0,%0":"+x"(A)); return A;}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_xor_si128(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v2du)A^(dbcB_v2du)B);}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_or_si128(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v2du)A|(dbcB_v2du)B);}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_setr_epi16(short q0,short q1,short q2,short q3,short q4,short q5,short q6,short q7) {return __extension__ (dbcb_i32x4)(dbcB_v8hi){q0,q1,q2,q3,q4,q5,q6,q7};}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_mullo_epi16(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v8hu)A*(dbcB_v8hu)B);}
+DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_mulhi_epu16(dbcb_i32x4 A,dbcb_i32x4 B) {__asm__("pmulhuw %1,%0":"+x"(A):"x"(B));return A;}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_unpacklo_epi16(dbcb_i32x4 A,dbcb_i32x4 B) {__asm__("punpcklwd %1,%0":"+x"(A):"x"(B));return A;}
 // Not a proper replacement.
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_srli_epi32(dbcb_i32x4 A,int B) {return (dbcb_i32x4)((dbcB_v4su)A>>B);}
@@ -2061,10 +3264,13 @@ DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_cmpeq_epi8(dbcb_i32x4 A,dbcb_i32x4 B) {return
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_and_si128(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v2du)A&(dbcB_v2du)B);}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_andnot_si128(dbcb_i32x4 A,dbcb_i32x4 B) {__asm__("pandn %1,%0":"+x"(A):"x"(B));return A;}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_cmpeq_epi16(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v8hi)A==(dbcB_v8hi)B);}
+DBCB_SSE2_SPEC int dbcB_mm_movemask_epi8(dbcb_i32x4 A) {int ret;__asm__("pmovmskb %1,%0":"=r"(ret):"x"(A));return ret;}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_cmpgt_epi16(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v8hi)A>(dbcB_v8hi)B);}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_set1_epi32(int A) {return __extension__ (dbcb_i32x4)(dbcB_v4si){A,A,A,A};}
 DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_cmpgt_epi32(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v4si)A>(dbcB_v4si)B);}
 DBCB_SSE2_SPEC dbcb_f32x4 dbcB_mm_div_ps(dbcb_f32x4 A,dbcb_f32x4 B) {return (dbcb_f32x4)((dbcB_v4sf)A/(dbcB_v4sf)B);}
+DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_sub_epi16(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v8hu)A-(dbcB_v8hu)B);}
+DBCB_SSE2_SPEC dbcb_i32x4 dbcB_mm_add_epi32(dbcb_i32x4 A,dbcb_i32x4 B) {return (dbcb_i32x4)((dbcB_v4su)A+(dbcB_v4su)B);}
 
 #ifndef dbcb_load128_32
 DBCB_DECL_SSE2 static dbcb_i32x4 dbcB_load128_32_le (const void *p) {dbcb_i32x4 ret;__asm__("movd   %1,%0":"=x"(ret):"m"(*(const unsigned char*)p):"memory");return ret;}
@@ -2103,6 +3309,7 @@ typedef __m128  dbcb_f32x4;
 #define dbcB_mm_or_si128                _mm_or_si128
 #define dbcB_mm_setr_epi16              _mm_setr_epi16
 #define dbcB_mm_mullo_epi16             _mm_mullo_epi16
+#define dbcB_mm_mulhi_epu16             _mm_mulhi_epu16
 #define dbcB_mm_unpacklo_epi16          _mm_unpacklo_epi16
 #define dbcB_mm_srli_epi32              _mm_srli_epi32
 #define dbcB_mm_unpackhi_epi8           _mm_unpackhi_epi8
@@ -2120,10 +3327,13 @@ typedef __m128  dbcb_f32x4;
 #define dbcB_mm_and_si128               _mm_and_si128
 #define dbcB_mm_andnot_si128            _mm_andnot_si128
 #define dbcB_mm_cmpeq_epi16             _mm_cmpeq_epi16
+#define dbcB_mm_movemask_epi8           _mm_movemask_epi8
 #define dbcB_mm_cmpgt_epi16             _mm_cmpgt_epi16
 #define dbcB_mm_set1_epi32              _mm_set1_epi32
 #define dbcB_mm_cmpgt_epi32             _mm_cmpgt_epi32
 #define dbcB_mm_div_ps                  _mm_div_ps
+#define dbcB_mm_sub_epi16               _mm_sub_epi16
+#define dbcB_mm_add_epi32               _mm_add_epi32
 
 #ifndef dbcb_load128_32
 /*
@@ -2172,6 +3382,17 @@ DBCB_DECL_SSE2 static dbcb_i32x4 dbcB_div255_round_128(dbcb_i32x4 n)
     return dbcB_mm_srli_epi16(dbcB_mm_add_epi16(n,dbcB_mm_srli_epi16(n,8)),8);
 }
 
+/*
+    Checks if all bytes of v, selected by bits (bit i is byte i, as in
+    movemask), are equal to x. E.g. bits=0x8888 selects alpha of 4 pixels.
+    Used for block-level early-outs in blending.
+*/
+DBCB_DECL_SSE2 static int dbcB_all_eq_128(dbcb_i32x4 v,int x,unsigned bits)
+{
+    unsigned m=(unsigned)dbcB_mm_movemask_epi8(dbcB_mm_cmpeq_epi8(v,dbcB_mm_set1_epi8((char)x)));
+    return (m&bits)==bits;
+}
+
 DBCB_DECL_SSE2 static dbcb_i32x4 dbcB_float2byte_clamp_128(dbcb_f32x4 x)
 {
     x=dbcB_mm_min_ps(dbcB_mm_max_ps(x,dbcB_mm_set1_ps(0.0f)),dbcB_mm_set1_ps(255.0f));
@@ -2212,6 +3433,23 @@ DBCB_DECL_SSE2 static dbcb_i32x4 dbcB_float2byte_clamp_128(dbcb_f32x4 x)
     if(ac) cl=dbcB_mm_xor_si128(al,dbcB_mm_set1_epi16(255));    \
     if(ac) ch=dbcB_mm_xor_si128(ah,dbcB_mm_set1_epi16(255));
 
+/*
+    Block-level early-outs for 4-pixel blends (s must be loaded), to match
+    what scalar versions do per pixel: fully transparent blocks leave dst
+    untouched (not even loaded), fully opaque ones are copied as is.
+    Both are exact, so results do not change. Also used by SSE4.1 code.
+*/
+#define dbcB_early128_bla\
+    if(dbcB_all_eq_128(s,  0,0x8888u)) return;                  \
+    if(dbcB_all_eq_128(s,255,0x8888u)) {dbcb_store128_128(s,dst);return;}
+
+#define dbcB_early128_blp\
+    if(dbcB_all_eq_128(s,  0,0xFFFFu)) return;                  \
+    if(dbcB_all_eq_128(s,255,0x8888u)) {dbcb_store128_128(s,dst);return;}
+
+#define dbcB_early128_blx\
+    if(dbcB_all_eq_128(s,255,0xFFFFu)) return;
+
 #define dbcB_setup128_32_SDAC(ac)\
     s=dbcb_load128_32(src);                                     \
     d=dbcb_load128_32(dst);                                     \
@@ -2255,6 +3493,204 @@ DBCB_DECL_SSE2 static void dbcB_b32m_1_sse2(const dbcb_uint8 *src,dbcb_uint8 *ds
     dbcb_store128_32(ret,dst);
 }
 
+/*
+    Fixed-point modulation (see dbcB_color2mul16()). Bytes are unpacked
+    into the high halves of 16-bit lanes, so pmulhuw yields floor(b*m/256),
+    and (x+128)>>8 of that equals (b*m+32768)>>16.
+*/
+#define dbcB_mul16_128(mul) dbcB_mm_setr_epi16(\
+    (short)mul[0],(short)mul[1],(short)mul[2],(short)mul[3],\
+    (short)mul[0],(short)mul[1],(short)mul[2],(short)mul[3])
+
+#define dbcB_step128_b32k(s,m)\
+    s=dbcB_mm_mulhi_epu16(s,m);                                 \
+    s=dbcB_mm_srli_epi16(dbcB_mm_add_epi16(s,dbcB_mm_set1_epi16(128)),8);
+
+#define DBCB_DEF_B32K_SSE2(n,suffix)\
+DBCB_DECL_SSE2 static void dbcB_b32k_##n##_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst,const dbcb_uint16 *mul)\
+{\
+    dbcb_i32x4 s,m;\
+    m=dbcB_mul16_128(mul);\
+    s=dbcb_load128_##suffix(src);\
+    s=dbcB_mm_unpacklo_epi8(dbcB_mm_set1_epi16(0),s);\
+    dbcB_step128_b32k(s,m)\
+    s=dbcB_mm_packus_epi16(s,s);\
+    dbcb_store128_##suffix(s,dst);\
+}
+
+DBCB_DEF_B32K_SSE2(1,32)     /* Copies single pixel, with fixed-point modulation. */
+DBCB_DEF_B32K_SSE2(2,64)     /* Copies 2 pixels, with fixed-point modulation. */
+
+#undef DBCB_DEF_B32K_SSE2
+
+/* Copies 4 pixels, with fixed-point modulation. */
+DBCB_DECL_SSE2 static void dbcB_b32k_4_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst,const dbcb_uint16 *mul)
+{
+    dbcb_i32x4 s,l,h,m;
+    m=dbcB_mul16_128(mul);
+    s=dbcb_load128_128(src);
+    l=dbcB_mm_unpacklo_epi8(dbcB_mm_set1_epi16(0),s);
+    h=dbcB_mm_unpackhi_epi8(dbcB_mm_set1_epi16(0),s);
+    dbcB_step128_b32k(l,m)
+    dbcB_step128_b32k(h,m)
+    dbcb_store128_128(dbcB_mm_packus_epi16(l,h),dst);
+}
+
+/*
+    Gradient rows with fixed-point modulation, see dbc_blit_gradient():
+    c and dc are colors in 16.16 fixed point, pixel i gets multipliers
+    (c+i*dc)>>16, where the sum never leaves [0;2^32) within the row.
+    Multipliers are stepped in 32-bit lanes, E for channels 0 and 2,
+    O for 1 and 3: high halves of O are already in place, those of E are
+    shifted in. Modulated channels are kept in 8.8 fixed point, the
+    arithmetic is that of dbcB_clak()/dbcB_clpk()/dbcB_clxk(), and division
+    by 255 is (x+128)*257>>16, which equals dbcB_div255_round().
+    Tier-suffixed macros are the parts that SSE4.1 versions do better:
+    merging multipliers, broadcasting and replacing the alpha lane, and
+    testing alpha of the whole block.
+*/
+#define dbcB_mulk128_sse2(E,O) dbcB_mm_or_si128(dbcB_mm_srli_epi32(E,16),dbcB_mm_and_si128(O,dbcB_mm_set1_epi32((int)0xFFFF0000)))
+#define dbcB_bcast128_sse2(x)  dbcB_mm_shufflehi_epi16(dbcB_mm_shufflelo_epi16(x,0xFF),0xFF)
+#define dbcB_alpha128_sse2(x)  dbcB_mm_or_si128(dbcB_mm_and_si128(x,dbcB_mm_setr_epi16(-1,-1,-1,0,-1,-1,-1,0)),\
+    dbcB_mm_setr_epi16(0,0,0,(short)0xFF00,0,0,0,(short)0xFF00))
+#define dbcB_clear128_sse2(s)  dbcB_all_eq_128(s,0,0x8888u)
+#define dbcB_solid128_sse2(s)  dbcB_all_eq_128(s,255,0x8888u)
+#define dbcB_zero128_sse2(s)   dbcB_all_eq_128(s,0,0xFFFFu)
+
+#define dbcB_div255k_128(x) dbcB_mm_mulhi_epu16(dbcB_mm_add_epi16(x,dbcB_mm_set1_epi16(128)),dbcB_mm_set1_epi16(257))
+
+#define dbcB_step128_b32k_row(s,m,d,r,tier)\
+    dbcB_step128_b32k(s,m)                                      \
+    r=s;(void)d;
+
+#define dbcB_step128_blak_row(s,m,d,r,tier)\
+    s=dbcB_mm_mulhi_epu16(s,m);                                 \
+    m=dbcB_bcast128_##tier(s);                                  \
+    s=dbcB_alpha128_##tier(s);                                  \
+    d=dbcB_mm_mulhi_epu16(d,dbcB_mm_sub_epi16(dbcB_mm_set1_epi16((short)0xFF00),m));\
+    r=dbcB_div255k_128(dbcB_mm_add_epi16(dbcB_mm_mulhi_epu16(s,m),d));
+
+#define dbcB_step128_blpk_row(s,m,d,r,tier)\
+    s=dbcB_mm_mulhi_epu16(s,m);                                 \
+    m=dbcB_bcast128_##tier(s);                                  \
+    d=dbcB_mm_mulhi_epu16(d,dbcB_mm_sub_epi16(dbcB_mm_set1_epi16((short)0xFF00),m));\
+    s=dbcB_mm_srli_epi16(dbcB_mm_add_epi16(s,dbcB_mm_set1_epi16(128)),8);\
+    r=dbcB_mm_add_epi16(dbcB_div255k_128(d),s);
+
+#define dbcB_step128_blxk_row(s,m,d,r,tier)\
+    s=dbcB_mm_mulhi_epu16(s,m);                                 \
+    r=dbcB_div255k_128(dbcB_mm_mulhi_epu16(d,s));
+
+/*
+    Opaque steps: with source alpha 255 and alpha multiplier 65535, a is
+    0xFEFF, so 0xFF00-a is 1, and the dst term is 0. Hence the result is
+    the same as that of the full step, without dst.
+*/
+#define dbcB_step128_blak_opaque(s,m,r)\
+    s=dbcB_mm_mulhi_epu16(s,m);                                 \
+    r=dbcB_div255k_128(dbcB_mm_mulhi_epu16(s,dbcB_mm_set1_epi16((short)0xFEFF)));
+
+#define dbcB_step128_blpk_opaque(s,m,r)\
+    dbcB_step128_b32k(s,m)                                      \
+    r=s;
+
+/* Multipliers of pixels o..o+3: E0/O0 for pixels o and o+1, E1/O1 for o+2 and o+3. */
+#define dbcB_mk128(c,dc,o)\
+    E0=dbcB_mm_setr_epi32((int)(c[0]+(dbcb_uint32)(o)*dc[0]),(int)(c[2]+(dbcb_uint32)(o)*dc[2]),\
+        (int)(c[0]+(dbcb_uint32)((o)+1)*dc[0]),(int)(c[2]+(dbcb_uint32)((o)+1)*dc[2]));\
+    O0=dbcB_mm_setr_epi32((int)(c[1]+(dbcb_uint32)(o)*dc[1]),(int)(c[3]+(dbcb_uint32)(o)*dc[3]),\
+        (int)(c[1]+(dbcb_uint32)((o)+1)*dc[1]),(int)(c[3]+(dbcb_uint32)((o)+1)*dc[3]));\
+    E1=dbcB_mm_add_epi32(E0,dbcB_mm_add_epi32(De,De));\
+    O1=dbcB_mm_add_epi32(O0,dbcB_mm_add_epi32(Do,Do));
+
+/* Block of 4 pixels (s, d), with multipliers ML and MH: r is the new dst. Blocks for which skip is true leave dst as is. */
+#define dbcB_blk128(ML,MH,tier,dst_in,skip,opaque,step)\
+    do\
+    {\
+        dbcb_i32x4 ml=ML,mh=MH,sl,sh,dl,dh,l,h;\
+        r=d;\
+        if(skip) break;\
+        sl=dbcB_mm_unpacklo_epi8(dbcB_mm_set1_epi16(0),s);\
+        sh=dbcB_mm_unpackhi_epi8(dbcB_mm_set1_epi16(0),s);\
+        opaque;\
+        if(!dst_in) d=s;\
+        dl=dbcB_mm_unpacklo_epi8(dbcB_mm_set1_epi16(0),d);\
+        dh=dbcB_mm_unpackhi_epi8(dbcB_mm_set1_epi16(0),d);\
+        step(sl,ml,dl,l,tier)\
+        step(sh,mh,dh,h,tier)\
+        r=dbcB_mm_packus_epi16(l,h);\
+    } while(0);
+
+/* Shortcut for opaque blocks in rows, where alpha multiplier is 65535 throughout. */
+#define dbcB_opaque128(fstep,tier)\
+    if(full&&dbcB_solid128_##tier(s))\
+    {\
+        fstep(sl,ml,l)\
+        fstep(sh,mh,h)\
+        r=dbcB_mm_packus_epi16(l,h);\
+        break;\
+    }
+
+/*
+    Row of n pixels, 4 at a time. Last n%4 pixels are done as the
+    (overlapping) block n-4..n-1, computed from the original dst up front
+    and stored last, or via a copy on stack, if n<4.
+*/
+#define DBCB_DEF_BLK_ROW_128(name,decl,tier,dst_in,skip,opaque,step)\
+decl static void dbcB_##name##_row_##tier(const dbcb_uint8 *src,dbcb_uint8 *dst,dbcb_int32 n,const dbcb_uint32 *c,const dbcb_uint32 *dc)\
+{\
+    dbcb_i32x4 E0,O0,E1,O1,De,Do,s,d,r,T=dbcB_mm_set1_epi16(0);\
+    dbcb_int32 i;\
+    int full=(dc[3]==0&&c[3]>=0xFFFF0000u);\
+    (void)full;\
+    De=dbcB_mm_setr_epi32((int)dc[0],(int)dc[2],(int)dc[0],(int)dc[2]);\
+    Do=dbcB_mm_setr_epi32((int)dc[1],(int)dc[3],(int)dc[1],(int)dc[3]);\
+    if(n<4)\
+    {\
+        dbcb_uint8 tail_s[16]={0},tail_d[16]={0};\
+        dbcb_memcpy(tail_s,src,(size_t)(4*n));\
+        dbcb_memcpy(tail_d,dst,(size_t)(4*n));\
+        dbcB_mk128(c,dc,0)\
+        s=dbcb_load128_128(tail_s);\
+        d=dbcb_load128_128(tail_d);\
+        dbcB_blk128(dbcB_mulk128_##tier(E0,O0),dbcB_mulk128_##tier(E1,O1),tier,dst_in,skip,opaque,step)\
+        dbcb_store128_128(r,tail_d);\
+        dbcb_memcpy(dst,tail_d,(size_t)(4*n));\
+        return;\
+    }\
+    if(n&3)\
+    {\
+        dbcB_mk128(c,dc,n-4)\
+        s=dbcb_load128_128(src+4*(n-4));\
+        d=dbcb_load128_128(dst+4*(n-4));\
+        dbcB_blk128(dbcB_mulk128_##tier(E0,O0),dbcB_mulk128_##tier(E1,O1),tier,dst_in,skip,opaque,step)\
+        T=r;\
+    }\
+    dbcB_mk128(c,dc,0)\
+    De=dbcB_mm_add_epi32(De,De);\
+    De=dbcB_mm_add_epi32(De,De);\
+    Do=dbcB_mm_add_epi32(Do,Do);\
+    Do=dbcB_mm_add_epi32(Do,Do);\
+    for(i=0;i+4<=n;i+=4)\
+    {\
+        dbcb_i32x4 ML=dbcB_mulk128_##tier(E0,O0),MH=dbcB_mulk128_##tier(E1,O1);\
+        E0=dbcB_mm_add_epi32(E0,De);\
+        O0=dbcB_mm_add_epi32(O0,Do);\
+        E1=dbcB_mm_add_epi32(E1,De);\
+        O1=dbcB_mm_add_epi32(O1,Do);\
+        s=dbcb_load128_128(src+4*i);\
+        d=(dst_in?dbcb_load128_128(dst+4*i):s);\
+        dbcB_blk128(ML,MH,tier,dst_in,skip,opaque,step)\
+        dbcb_store128_128(r,dst+4*i);\
+    }\
+    if(n&3) dbcb_store128_128(T,dst+4*(n-4));\
+}
+
+DBCB_DEF_BLK_ROW_128(b32k,DBCB_DECL_SSE2,sse2,0,0,((void)0),dbcB_step128_b32k_row)                                                         /* Copies row, with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_128(blak,DBCB_DECL_SSE2,sse2,1,dbcB_clear128_sse2(s),dbcB_opaque128(dbcB_step128_blak_opaque,sse2),dbcB_step128_blak_row) /* Alpha-blends row, linear with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_128(blpk,DBCB_DECL_SSE2,sse2,1,dbcB_zero128_sse2(s),dbcB_opaque128(dbcB_step128_blpk_opaque,sse2),dbcB_step128_blpk_row)  /* Alpha-blends (PMA) row, linear with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_128(blxk,DBCB_DECL_SSE2,sse2,1,0,((void)0),dbcB_step128_blxk_row)                                                         /* Multiplies row, linear with fixed-point gradient modulation. */
+
 /* Alpha-blends single pixel, linear. */
 DBCB_DECL_SSE2 static void dbcB_bla_1_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
@@ -2279,6 +3715,8 @@ DBCB_DECL_SSE2 static void dbcB_bla_2_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_SSE2 static void dbcB_bla_4_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x4 s,d,a,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;
+    s=dbcb_load128_128(src);
+    dbcB_early128_bla
     dbcB_setup128_128_sdac(1);
     dbcB_step128_bla(sl,dl,al,cl,l);
     dbcB_step128_bla(sh,dh,ah,ch,h);
@@ -2325,6 +3763,8 @@ DBCB_DECL_SSE2 static void dbcB_blp_2_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_SSE2 static void dbcB_blp_4_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x4 s,d,a,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;
+    s=dbcb_load128_128(src);
+    dbcB_early128_blp
     dbcB_setup128_128_sdac(1);
     dbcB_step128_blp(sl,dl,cl,l);
     dbcB_step128_blp(sh,dh,ch,h);
@@ -2373,6 +3813,8 @@ DBCB_DECL_SSE2 static void dbcB_blx_2_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_SSE2 static void dbcB_blx_4_sse2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x4 s,d,a,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;
+    s=dbcb_load128_128(src);
+    dbcB_early128_blx
     dbcB_setup128_128_sdac(0);
     (void)a;(void)al;(void)ah;(void)cl;(void)ch;
     dbcB_step128_blx(sl,dl,l);
@@ -2762,6 +4204,245 @@ DBCB_DECL_SSE2 static void dbcB_bgxm_1_sse2(const dbcb_uint8 *src,dbcb_uint8 *ds
 #endif /* DBC_BLIT_GAMMA_NO_TABLES */
 #endif /* DBC_BLIT_NO_GAMMA */
 
+#ifndef DBC_BLIT_NO_SSE41
+/*
+    SSE4.1 versions of the functions that benefit from SSSE3/SSE4.1:
+    pmovzxbw for unpacking, pshufb for alpha broadcast, and pblendvb for
+    masked copies. Arithmetic is the same as in SSE2 versions, so the
+    results are identical. Everything else uses SSE2 versions.
+*/
+#if defined(__GNUC__) && !defined(DBC_BLIT_NO_GCC_ASM) && ((!defined(__SSE2__) && !defined(DBCB_PREFER_INTRINSICS)) || defined(DBC_BLIT_FORCE_GCC_ASM))
+
+#ifdef __clang__
+#define DBCB_SSE41_SPEC __attribute__((__always_inline__,__nodebug__,__target__("sse4.1"),unused)) static __inline__
+#else
+#define DBCB_SSE41_SPEC __attribute__((__gnu_inline__,__always_inline__,__artificial__,__target__("sse4.1"))) extern __inline
+#endif
+
+DBCB_SSE41_SPEC dbcb_i32x4 dbcB_mm_cvtepu8_epi16(dbcb_i32x4 A) {dbcb_i32x4 ret;__asm__("pmovzxbw %1,%0":"=x"(ret):"x"(A));return ret;}
+DBCB_SSE41_SPEC dbcb_i32x4 dbcB_mm_shuffle_epi8(dbcb_i32x4 A,dbcb_i32x4 M) {__asm__("pshufb %1,%0":"+x"(A):"x"(M));return A;}
+// AT&T argument order. Mask is implicitly xmm0.
+DBCB_SSE41_SPEC dbcb_i32x4 dbcB_mm_blendv_epi8(dbcb_i32x4 X,dbcb_i32x4 Y,dbcb_i32x4 M) {__asm__("pblendvb %%xmm0,%1,%0":"+x"(X):"x"(Y),"Yz"(M));return X;}
+// Not a proper replacement. We only call it with mask={0x88,0xAA}.
+DBCB_SSE41_SPEC dbcb_i32x4 dbcB_mm_blend_epi16(dbcb_i32x4 X,dbcb_i32x4 Y,const int M) {if(M==0x88) __asm__("pblendw $0x88,%1,%0":"+x"(X):"x"(Y)); else __asm__("pblendw $0xAA,%1,%0":"+x"(X):"x"(Y));return X;}
+// Flag outputs, where available, let the compiler branch on ptest directly.
+#ifdef __GCC_ASM_FLAG_OUTPUTS__
+DBCB_SSE41_SPEC int dbcB_mm_testz_si128(dbcb_i32x4 A,dbcb_i32x4 B) {int ret;__asm__("ptest %2,%1":"=@ccz"(ret):"x"(A),"x"(B));return ret;}
+DBCB_SSE41_SPEC int dbcB_mm_testc_si128(dbcb_i32x4 A,dbcb_i32x4 B) {int ret;__asm__("ptest %2,%1":"=@ccc"(ret):"x"(A),"x"(B));return ret;}
+#else
+DBCB_SSE41_SPEC int dbcB_mm_testz_si128(dbcb_i32x4 A,dbcb_i32x4 B) {unsigned char ret;__asm__("ptest %2,%1\n\tsetz %0":"=q"(ret):"x"(A),"x"(B):"cc");return ret;}
+DBCB_SSE41_SPEC int dbcB_mm_testc_si128(dbcb_i32x4 A,dbcb_i32x4 B) {unsigned char ret;__asm__("ptest %2,%1\n\tsetc %0":"=q"(ret):"x"(A),"x"(B):"cc");return ret;}
+#endif
+
+#else
+
+#include <smmintrin.h>
+
+#define dbcB_mm_cvtepu8_epi16           _mm_cvtepu8_epi16
+#define dbcB_mm_shuffle_epi8            _mm_shuffle_epi8
+#define dbcB_mm_blendv_epi8             _mm_blendv_epi8
+#define dbcB_mm_blend_epi16             _mm_blend_epi16
+#define dbcB_mm_testz_si128             _mm_testz_si128
+#define dbcB_mm_testc_si128             _mm_testc_si128
+
+#endif /* defined(__GNUC__) && !defined(DBC_BLIT_NO_GCC_ASM) && !defined(__SSE2__) */
+
+/*
+    pshufb masks, that broadcast alpha of each pixel into 16-bit lanes
+    (zero-extended): for pixels 0-1, and 2-3.
+*/
+#define dbcB_alpha128_lo() dbcB_mm_setr_epi32((int)0x80038003,(int)0x80038003,(int)0x80078007,(int)0x80078007)
+#define dbcB_alpha128_hi() dbcB_mm_setr_epi32((int)0x800B800B,(int)0x800B800B,(int)0x800F800F,(int)0x800F800F)
+
+#define dbcB_setup128_128_sdac(ac)\
+    s=dbcb_load128_128(src);                                    \
+    d=dbcb_load128_128(dst);                                    \
+    if(ac) al=dbcB_mm_shuffle_epi8(s,dbcB_alpha128_lo());       \
+    if(ac) ah=dbcB_mm_shuffle_epi8(s,dbcB_alpha128_hi());       \
+    sl=dbcB_mm_cvtepu8_epi16(s);                                \
+    dl=dbcB_mm_cvtepu8_epi16(d);                                \
+    sh=dbcB_mm_unpackhi_epi8(s,dbcB_mm_set1_epi16(0));          \
+    dh=dbcB_mm_unpackhi_epi8(d,dbcB_mm_set1_epi16(0));          \
+    if(ac) cl=dbcB_mm_xor_si128(al,dbcB_mm_set1_epi16(255));    \
+    if(ac) ch=dbcB_mm_xor_si128(ah,dbcB_mm_set1_epi16(255));
+
+#define dbcB_step128_bla(s,d,a,c,ret)\
+    a=dbcB_mm_or_si128(a,dbcB_mm_setr_epi16(0,0,0,255,0,0,0,255));            \
+    ret=dbcB_mm_add_epi16(dbcB_mm_mullo_epi16(s,a),dbcB_mm_mullo_epi16(d,c)); \
+    ret=dbcB_div255_round_128(ret);
+
+#define dbcB_step128_blp(s,d,c,ret)\
+    ret=dbcB_mm_mullo_epi16(d,c);                               \
+    ret=dbcB_div255_round_128(ret);                             \
+    ret=dbcB_mm_add_epi16(ret,s);
+
+#define dbcB_step128_blx(s,d,ret)\
+    ret=dbcB_mm_mullo_epi16(s,d);                               \
+    ret=dbcB_div255_round_128(ret);
+
+/*
+    1 and 2 pixel versions share the setup: pmovzxbw only looks at
+    the low 8 bytes, and the rest of the lanes is discarded on store.
+*/
+#define DBCB_DEF_BL_SSE41(name,n,suffix,ac,step)\
+DBCB_DECL_SSE41 static void dbcB_##name##_##n##_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst)\
+{\
+    dbcb_i32x4 s,d,a,c,ret;\
+    s=dbcb_load128_##suffix(src);\
+    d=dbcb_load128_##suffix(dst);\
+    if(ac) a=dbcB_mm_shuffle_epi8(s,dbcB_alpha128_lo());\
+    s=dbcB_mm_cvtepu8_epi16(s);\
+    d=dbcB_mm_cvtepu8_epi16(d);\
+    if(ac) c=dbcB_mm_xor_si128(a,dbcB_mm_set1_epi16(255));\
+    step\
+    ret=dbcB_mm_packus_epi16(ret,ret);\
+    dbcb_store128_##suffix(ret,dst);\
+}
+
+#define DBCB_DEF_BL4_SSE41(name,ac,early,stepl,steph)\
+DBCB_DECL_SSE41 static void dbcB_##name##_4_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst)\
+{\
+    dbcb_i32x4 s,d,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;\
+    s=dbcb_load128_128(src);\
+    early\
+    dbcB_setup128_128_sdac(ac);\
+    stepl\
+    steph\
+    ret=dbcB_mm_packus_epi16(l,h);\
+    dbcb_store128_128(ret,dst);\
+}
+
+DBCB_DEF_BL_SSE41(bla,1, 32,1,dbcB_step128_bla(s,d,a,c,ret))   /* Alpha-blends single pixel, linear. */
+DBCB_DEF_BL_SSE41(bla,2, 64,1,dbcB_step128_bla(s,d,a,c,ret))   /* Alpha-blends 2 pixels, linear. */
+DBCB_DEF_BL4_SSE41(bla,1,dbcB_early128_bla,dbcB_step128_bla(sl,dl,al,cl,l),dbcB_step128_bla(sh,dh,ah,ch,h)) /* Alpha-blends 4 pixels, linear. */
+DBCB_DEF_BL_SSE41(blp,1, 32,1,dbcB_step128_blp(s,d,c,ret))     /* Alpha-blends (PMA) single pixel, linear. */
+DBCB_DEF_BL_SSE41(blp,2, 64,1,dbcB_step128_blp(s,d,c,ret))     /* Alpha-blends (PMA) 2 pixels, linear. */
+DBCB_DEF_BL4_SSE41(blp,1,dbcB_early128_blp,dbcB_step128_blp(sl,dl,cl,l),dbcB_step128_blp(sh,dh,ch,h))       /* Alpha-blends (PMA) 4 pixels, linear. */
+DBCB_DEF_BL_SSE41(blx,1, 32,0,(void)a;(void)c;dbcB_step128_blx(s,d,ret))  /* Multiplies single pixel, linear. */
+DBCB_DEF_BL_SSE41(blx,2, 64,0,(void)a;(void)c;dbcB_step128_blx(s,d,ret))  /* Multiplies 2 pixels, linear. */
+DBCB_DEF_BL4_SSE41(blx,0,dbcB_early128_blx,(void)al;(void)ah;(void)cl;(void)ch;dbcB_step128_blx(sl,dl,l),dbcB_step128_blx(sh,dh,h)) /* Multiplies 4 pixels, linear. */
+
+#undef DBCB_DEF_BL_SSE41
+#undef DBCB_DEF_BL4_SSE41
+#undef dbcB_setup128_128_sdac
+#undef dbcB_step128_bla
+#undef dbcB_step128_blp
+#undef dbcB_step128_blx
+
+#define DBCB_DEF_B8M_SSE41(n,suffix) \
+DBCB_DECL_SSE41 static void dbcB_b8m_##n##_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst,dbcb_uint8 key)\
+{\
+    dbcb_i32x4 s=dbcb_load128_##suffix(src);\
+    dbcb_i32x4 d=dbcb_load128_##suffix(dst);\
+    dbcb_i32x4 m=dbcB_mm_cmpeq_epi8(s,dbcB_mm_set1_epi8((char)key));\
+    dbcb_store128_##suffix(dbcB_mm_blendv_epi8(s,d,m),dst);\
+}
+
+#define DBCB_DEF_B16M_SSE41(n,suffix) \
+DBCB_DECL_SSE41 static void dbcB_b16m_##n##_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst,dbcb_uint16 key)\
+{\
+    dbcb_i32x4 s=dbcb_load128_##suffix(src);\
+    dbcb_i32x4 d=dbcb_load128_##suffix(dst);\
+    dbcb_i32x4 m=dbcB_mm_cmpeq_epi16(s,dbcB_mm_set1_epi16((short)key));\
+    dbcb_store128_##suffix(dbcB_mm_blendv_epi8(s,d,m),dst);\
+}
+
+#define DBCB_DEF_B5551_SSE41(n,suffix)\
+DBCB_DECL_SSE41 static void dbcB_b5551_##n##_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst)\
+{\
+    dbcb_i32x4 s=dbcb_load128_##suffix(src);\
+    dbcb_i32x4 d=dbcb_load128_##suffix(dst);\
+    dbcb_i32x4 m=dbcB_mm_cmpgt_epi16(dbcB_mm_set1_epi16(0),s);\
+    dbcb_store128_##suffix(dbcB_mm_blendv_epi8(d,s,m),dst);\
+}
+
+#define DBCB_DEF_B32T_SSE41(n,suffix)\
+DBCB_DECL_SSE41 static void dbcB_b32t_##n##_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst,dbcb_uint8 key)\
+{\
+    dbcb_i32x4 s=dbcb_load128_##suffix(src);\
+    dbcb_i32x4 d=dbcb_load128_##suffix(dst);\
+    dbcb_i32x4 m=dbcB_mm_set1_epi32((int)((dbcb_uint32)key<<24));\
+    m=dbcB_mm_cmpgt_epi32(dbcB_mm_xor_si128(dbcB_mm_set1_epi32((int)0x80000000),m),dbcB_mm_xor_si128(dbcB_mm_set1_epi32((int)0x80000000),s));\
+    dbcb_store128_##suffix(dbcB_mm_blendv_epi8(s,d,m),dst);\
+}
+
+#define DBCB_DEF_B32S_SSE41(n,suffix)\
+DBCB_DECL_SSE41 static void dbcB_b32s_##n##_sse41(const dbcb_uint8 *src,dbcb_uint8 *dst)\
+{\
+    dbcb_i32x4 s=dbcb_load128_##suffix(src);\
+    dbcb_i32x4 d=dbcb_load128_##suffix(dst);\
+    dbcb_i32x4 m=dbcB_mm_cmpgt_epi32(dbcB_mm_set1_epi32(0),s);\
+    dbcb_store128_##suffix(dbcB_mm_blendv_epi8(d,s,m),dst);\
+}
+
+DBCB_DEF_B8M_SSE41( 4, 32)   /* Blits  4 8-bit pixels with colorkey. */
+DBCB_DEF_B8M_SSE41( 8, 64)   /* Blits  8 8-bit pixels with colorkey. */
+DBCB_DEF_B8M_SSE41(16,128)   /* Blits 16 8-bit pixels with colorkey. */
+
+DBCB_DEF_B16M_SSE41( 2, 32)  /* Blits  2 16-bit pixels with colorkey. */
+DBCB_DEF_B16M_SSE41( 4, 64)  /* Blits  4 16-bit pixels with colorkey. */
+DBCB_DEF_B16M_SSE41( 8,128)  /* Blits  8 16-bit pixels with colorkey. */
+
+DBCB_DEF_B5551_SSE41( 2, 32) /* Blits  2 16-bit (5551) pixels. */
+DBCB_DEF_B5551_SSE41( 4, 64) /* Blits  4 16-bit (5551) pixels. */
+DBCB_DEF_B5551_SSE41( 8,128) /* Blits  8 16-bit (5551) pixels. */
+
+DBCB_DEF_B32T_SSE41( 2, 64)  /* Blits  2 pixels, with alpha-test. */
+DBCB_DEF_B32T_SSE41( 4,128)  /* Blits  4 pixels, with alpha-test. */
+
+DBCB_DEF_B32S_SSE41( 2, 64)  /* Blits  2 pixels, with alpha-test using threshold 128. */
+DBCB_DEF_B32S_SSE41( 4,128)  /* Blits  4 pixels, with alpha-test using threshold 128. */
+
+#undef DBCB_DEF_B8M_SSE41
+#undef DBCB_DEF_B16M_SSE41
+#undef DBCB_DEF_B5551_SSE41
+#undef DBCB_DEF_B32T_SSE41
+#undef DBCB_DEF_B32S_SSE41
+
+/* Parts of DBCB_DEF_BLK_ROW_128, that SSE4.1 does in fewer instructions. */
+#define dbcB_mulk128_sse41(E,O) dbcB_mm_blend_epi16(dbcB_mm_srli_epi32(E,16),O,0xAA)
+#define dbcB_bcast128_sse41(x)  dbcB_mm_shuffle_epi8(x,dbcB_mm_setr_epi32(0x07060706,0x07060706,0x0F0E0F0E,0x0F0E0F0E))
+#define dbcB_alpha128_sse41(x)  dbcB_mm_blend_epi16(x,dbcB_mm_set1_epi16((short)0xFF00),0x88)
+#define dbcB_clear128_sse41(s)  dbcB_mm_testz_si128(s,dbcB_mm_set1_epi32((int)0xFF000000))
+#define dbcB_solid128_sse41(s)  dbcB_mm_testc_si128(s,dbcB_mm_set1_epi32((int)0xFF000000))
+#define dbcB_zero128_sse41(s)   dbcB_mm_testz_si128(s,s)
+
+DBCB_DEF_BLK_ROW_128(b32k,DBCB_DECL_SSE41,sse41,0,0,((void)0),dbcB_step128_b32k_row)                                                           /* Copies row, with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_128(blak,DBCB_DECL_SSE41,sse41,1,dbcB_clear128_sse41(s),dbcB_opaque128(dbcB_step128_blak_opaque,sse41),dbcB_step128_blak_row) /* Alpha-blends row, linear with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_128(blpk,DBCB_DECL_SSE41,sse41,1,dbcB_zero128_sse41(s),dbcB_opaque128(dbcB_step128_blpk_opaque,sse41),dbcB_step128_blpk_row)  /* Alpha-blends (PMA) row, linear with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_128(blxk,DBCB_DECL_SSE41,sse41,1,0,((void)0),dbcB_step128_blxk_row)                                                           /* Multiplies row, linear with fixed-point gradient modulation. */
+
+#undef dbcB_mulk128_sse41
+#undef dbcB_bcast128_sse41
+#undef dbcB_alpha128_sse41
+#undef dbcB_clear128_sse41
+#undef dbcB_solid128_sse41
+#undef dbcB_zero128_sse41
+#undef dbcB_alpha128_lo
+#undef dbcB_alpha128_hi
+#endif /* DBC_BLIT_NO_SSE41 */
+
+#undef dbcB_early128_bla
+#undef dbcB_early128_blp
+#undef dbcB_early128_blx
+#undef DBCB_DEF_BLK_ROW_128
+#undef dbcB_mk128
+#undef dbcB_blk128
+#undef dbcB_opaque128
+#undef dbcB_mulk128_sse2
+#undef dbcB_bcast128_sse2
+#undef dbcB_alpha128_sse2
+#undef dbcB_clear128_sse2
+#undef dbcB_solid128_sse2
+#undef dbcB_zero128_sse2
+#undef dbcB_div255k_128
+#undef dbcB_step128_b32k_row
+#undef dbcB_step128_blak_row
+#undef dbcB_step128_blpk_row
+#undef dbcB_step128_blxk_row
+#undef dbcB_step128_blak_opaque
+#undef dbcB_step128_blpk_opaque
+
 #ifndef DBC_BLIT_NO_AVX2
 /*
     Note: some functions are reimplemented, despite having SSE2 equivalent,
@@ -2793,8 +4474,12 @@ typedef unsigned char      dbcB_v32qu __attribute__ ((__vector_size__ (32)));
 
 #ifdef __clang__
 #define DBCB_AVX2_SPEC __attribute__((__always_inline__,__nodebug__,__target__("avx2"),unused)) static __inline__
+#define DBCB_F16C_SPEC __attribute__((__always_inline__,__nodebug__,__target__("avx2,f16c"),unused)) static __inline__
+#define DBCB_FMA_SPEC  __attribute__((__always_inline__,__nodebug__,__target__("avx2,fma"),unused)) static __inline__
 #else
 #define DBCB_AVX2_SPEC __attribute__((__gnu_inline__,__always_inline__,__artificial__,__target__("avx2"))) extern __inline
+#define DBCB_F16C_SPEC __attribute__((__gnu_inline__,__always_inline__,__artificial__,__target__("avx2,f16c"))) extern __inline
+#define DBCB_FMA_SPEC  __attribute__((__gnu_inline__,__always_inline__,__artificial__,__target__("avx2,fma"))) extern __inline
 #endif
 
 #ifdef __clang__
@@ -2818,6 +4503,7 @@ DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_xor_si256(dbcb_i32x8 A,dbcb_i32x8 B) {retur
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_or_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v4du)A|(dbcB_v4du)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_setr_epi16(short q00,short q01,short q02,short q03,short q04,short q05,short q06,short q07,short q08,short q09,short q10,short q11,short q12,short q13,short q14,short q15) {return __extension__ (dbcb_i32x8)(dbcB_v16hi){q00,q01,q02,q03,q04,q05,q06,q07,q08,q09,q10,q11,q12,q13,q14,q15};}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_mullo_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hu)A*(dbcB_v16hu)B);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_mulhi_epu16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)__builtin_ia32_pmulhuw256((dbcB_v16hi)A,(dbcB_v16hi)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_unpacklo_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)__builtin_shufflevector((dbcB_v16hi)A,(dbcB_v16hi)B, 0,16, 1,17, 2,18, 3,19, 8,24, 9,25,10,26,11,27);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_srli_epi32(dbcb_i32x8 A,int B) {return (dbcb_i32x8)__builtin_ia32_psrldi256((dbcB_v8si)A,B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_unpackhi_epi8(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)__builtin_shufflevector((dbcB_v32qi)A,(dbcB_v32qi)B, 8,40, 9,41,10,42,11,43,12,44,13,45,14,46,15,47,24,56,25,57,26,58,27,59,28,60,29,61,30,62,31,63);}
@@ -2837,16 +4523,28 @@ DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpeq_epi8(dbcb_i32x8 A,dbcb_i32x8 B) {retu
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_and_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v4du)A&(dbcB_v4du)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_andnot_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)(~(dbcB_v4du)A&(dbcB_v4du)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpeq_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hi)A==(dbcB_v16hi)B);}
+DBCB_AVX2_SPEC int dbcB_mm256_movemask_epi8(dbcb_i32x8 A) {return __builtin_ia32_pmovmskb256((dbcB_v32qi)A);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpgt_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hi)A>(dbcB_v16hi)B);}
 // Not a proper replacement. We only call it with mask=0xD8.
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_permute4x64_epi64(dbcb_i32x8 X,const int M) {(void)M;return (dbcb_i32x8)__builtin_shufflevector((dbcB_v8si)X,(dbcB_v8si)X,0,1,4,5,2,3,6,7);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_set1_epi32(int A) {return __extension__ (dbcb_i32x8)(dbcB_v8si){A,A,A,A,A,A,A,A};}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpgt_epi32(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8 )((dbcB_v8si)A>(dbcB_v8si)B);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpeq_epi32(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8 )((dbcB_v8si)A==(dbcB_v8si)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_blendv_epi8 (dbcb_i32x8 X, dbcb_i32x8 Y, dbcb_i32x8 M) {(void)M;return (dbcb_i32x8)__builtin_ia32_pblendvb256((dbcB_v32qi)X,(dbcB_v32qi)Y,(dbcB_v32qi)M);}
 DBCB_AVX2_SPEC dbcb_f32x8 dbcB_mm256_div_ps(dbcb_f32x8 A,dbcb_f32x8 B) {return (dbcb_f32x8)((dbcB_v8sf)A/(dbcB_v8sf)B);}
 // Not a proper replacement. We only call it with mask=0x77.
 DBCB_AVX2_SPEC dbcb_f32x8 dbcB_mm256_blend_ps(dbcb_f32x8 X,dbcb_f32x8 Y,int M) {(void)M;return __extension__ (dbcb_f32x8)__builtin_ia32_blendvps256((dbcB_v8sf)X,(dbcB_v8sf)Y,(dbcB_v8sf){-0.0f,-0.0f,-0.0f,0.0f,-0.0f,-0.0f,-0.0f,0.0f});}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_shuffle_epi8(dbcb_i32x8 A,dbcb_i32x8 M) {return (dbcb_i32x8)__builtin_ia32_pshufb256((dbcB_v32qi)A,(dbcB_v32qi)M);}
+// Not a proper replacement. Only the low 128 bits of A are used/result are set. Rounding is to nearest.
+DBCB_F16C_SPEC dbcb_f32x8 dbcB_mm256_cvtph_ps(dbcb_i32x8 A) {typedef short dbcB_v8hi __attribute__ ((__vector_size__ (16)));return (dbcb_f32x8)__builtin_ia32_vcvtph2ps256(__builtin_shufflevector((dbcB_v16hi)A,(dbcB_v16hi)A,0,1,2,3,4,5,6,7));}
+DBCB_F16C_SPEC dbcb_i32x8 dbcB_mm256_cvtps_ph(dbcb_f32x8 A) {typedef short dbcB_v8hi __attribute__ ((__vector_size__ (16)));dbcB_v8hi r=__builtin_ia32_vcvtps2ph256((dbcB_v8sf)A,0);return (dbcb_i32x8)__builtin_shufflevector(r,r,0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7);}
+DBCB_FMA_SPEC  dbcb_f32x8 dbcB_mm256_fmadd_ps(dbcb_f32x8 A,dbcb_f32x8 B,dbcb_f32x8 C) {return (dbcb_f32x8)__builtin_ia32_vfmaddps256((dbcB_v8sf)A,(dbcB_v8sf)B,(dbcB_v8sf)C);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_sub_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hu)A-(dbcB_v16hu)B);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_add_epi32(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v8su)A+(dbcB_v8su)B);}
+// Not a proper replacement. We only call it with mask={0x88,0xAA}.
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_blend_epi16(dbcb_i32x8 X,dbcb_i32x8 Y,const int M) {return (dbcb_i32x8)(M==0x88?__builtin_ia32_pblendw256((dbcB_v16hi)X,(dbcB_v16hi)Y,0x88):__builtin_ia32_pblendw256((dbcB_v16hi)X,(dbcB_v16hi)Y,0xAA));}
+DBCB_AVX2_SPEC int dbcB_mm256_testz_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return __builtin_ia32_ptestz256((dbcB_v4di)A,(dbcB_v4di)B);}
+DBCB_AVX2_SPEC int dbcB_mm256_testc_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return __builtin_ia32_ptestc256((dbcB_v4di)A,(dbcB_v4di)B);}
 
 #ifndef dbcb_load256_32
 DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_load256_32_le (const void *p) {return __extension__ (dbcb_i32x8)(dbcB_v8si){*(const int *)p,0,0,0,0,0,0,0};}
@@ -2882,6 +4580,7 @@ DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_xor_si256(dbcb_i32x8 A,dbcb_i32x8 B) {retur
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_or_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v4du)A|(dbcB_v4du)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_setr_epi16(short q00,short q01,short q02,short q03,short q04,short q05,short q06,short q07,short q08,short q09,short q10,short q11,short q12,short q13,short q14,short q15) {return __extension__ (dbcb_i32x8)(dbcB_v16hi){q00,q01,q02,q03,q04,q05,q06,q07,q08,q09,q10,q11,q12,q13,q14,q15};}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_mullo_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hu)A*(dbcB_v16hu)B);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_mulhi_epu16(dbcb_i32x8 A,dbcb_i32x8 B) {__asm__("vpmulhuw %1,%0,%0":"+x"(A):"x"(B));return A;}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_unpacklo_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {__asm__("vpunpcklwd %1,%0,%0":"+x"(A):"x"(B));return A;}
 // Not a proper replacement.
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_srli_epi32(dbcb_i32x8 A,int B) {return (dbcb_i32x8)((dbcB_v8su)A>>B);}
@@ -2901,13 +4600,15 @@ DBCB_AVX2_SPEC dbcb_f32x8 dbcB_mm256_setr_ps (float A,float B,float C,float D,fl
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_set1_epi8(char A) {return __extension__ (dbcb_i32x8)(dbcB_v32qi){A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A,A};}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpeq_epi8(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v32qi)A==(dbcB_v32qi)B);}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_and_si256(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v4du)A&(dbcB_v4du)B);}
-DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_andnot_si256(dbcb_i32x8 A,dbcb_i32x8 B) {__asm__("vpandnot %1,%0,%0":"+x"(A):"x"(B));return A;}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_andnot_si256(dbcb_i32x8 A,dbcb_i32x8 B) {__asm__("vpandn %1,%0,%0":"+x"(A):"x"(B));return A;}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpeq_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hi)A==(dbcB_v16hi)B);}
+DBCB_AVX2_SPEC int dbcB_mm256_movemask_epi8(dbcb_i32x8 A) {int ret;__asm__("vpmovmskb %1,%0":"=r"(ret):"x"(A));return ret;}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpgt_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hi)A>(dbcB_v16hi)B);}
 // Not a proper replacement. We only call it with mask=0xD8.
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_permute4x64_epi64(dbcb_i32x8 X,const int M) {dbcb_i32x8 m=__extension__ (dbcb_i32x8)(dbcB_v8si){0,1,4,5,2,3,6,7};(void)M;__asm__("vpermd %0,%1,%0":"+x"(X):"x"(m));return X;}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_set1_epi32(int A) {return __extension__ (dbcb_i32x8)(dbcB_v8si){A,A,A,A,A,A,A,A};}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpgt_epi32(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8 )((dbcB_v8si)A>(dbcB_v8si)B);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_cmpeq_epi32(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8 )((dbcB_v8si)A==(dbcB_v8si)B);}
 //DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_blendv_epi8(dbcb_i32x8 X,dbcb_i32x8 Y,dbcb_i32x8 M) {return (dbcb_i32x8)__builtin_ia32_pblendvb256((dbcB_v32qi)X,(dbcB_v32qi)Y,(dbcB_v32qi)M);}
 // AT&T argument order.
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_blendv_epi8(dbcb_i32x8 X,dbcb_i32x8 Y,dbcb_i32x8 M) {__asm__("vpblendvb %2,%1,%0,%0":"+x"(X):"x"(Y),"x"(M));return X;}
@@ -2915,6 +4616,23 @@ DBCB_AVX2_SPEC dbcb_f32x8 dbcB_mm256_div_ps(dbcb_f32x8 A,dbcb_f32x8 B) {return (
 // Not a proper replacement. We only call it with mask=0x77.
 DBCB_AVX2_SPEC dbcb_f32x8 dbcB_mm256_blend_ps(dbcb_f32x8 X,dbcb_f32x8 Y,int M) {__asm__("vblendps $0x77,%1,%0,%0":"+x"(X):"x"(Y),"x"(M));return X;}
 DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_shuffle_epi8(dbcb_i32x8 A,dbcb_i32x8 M) {__asm__("vpshufb %1,%0,%0":"+x"(A):"x"(M));return A;}
+// Not a proper replacement. Only the low 128 bits of A are used/result are set. Rounding is to nearest.
+DBCB_F16C_SPEC dbcb_f32x8 dbcB_mm256_cvtph_ps(dbcb_i32x8 A) {dbcb_f32x8 ret;__asm__("vcvtph2ps %x1,%0":"=x"(ret):"x"(A));return ret;}
+DBCB_F16C_SPEC dbcb_i32x8 dbcB_mm256_cvtps_ph(dbcb_f32x8 A) {dbcb_i32x8 ret;__asm__("vcvtps2ph $0,%1,%x0":"=x"(ret):"x"(A));return ret;}
+// AT&T argument order: A=B*A+C.
+DBCB_FMA_SPEC  dbcb_f32x8 dbcB_mm256_fmadd_ps(dbcb_f32x8 A,dbcb_f32x8 B,dbcb_f32x8 C) {__asm__("vfmadd213ps %2,%1,%0":"+x"(A):"x"(B),"x"(C));return A;}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_sub_epi16(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v16hu)A-(dbcB_v16hu)B);}
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_add_epi32(dbcb_i32x8 A,dbcb_i32x8 B) {return (dbcb_i32x8)((dbcB_v8su)A+(dbcB_v8su)B);}
+// Not a proper replacement. We only call it with mask={0x88,0xAA}.
+DBCB_AVX2_SPEC dbcb_i32x8 dbcB_mm256_blend_epi16(dbcb_i32x8 X,dbcb_i32x8 Y,const int M) {if(M==0x88) __asm__("vpblendw $0x88,%1,%0,%0":"+x"(X):"x"(Y)); else __asm__("vpblendw $0xAA,%1,%0,%0":"+x"(X):"x"(Y));return X;}
+// Flag outputs, where available, let the compiler branch on vptest directly.
+#ifdef __GCC_ASM_FLAG_OUTPUTS__
+DBCB_AVX2_SPEC int dbcB_mm256_testz_si256(dbcb_i32x8 A,dbcb_i32x8 B) {int ret;__asm__("vptest %2,%1":"=@ccz"(ret):"x"(A),"x"(B));return ret;}
+DBCB_AVX2_SPEC int dbcB_mm256_testc_si256(dbcb_i32x8 A,dbcb_i32x8 B) {int ret;__asm__("vptest %2,%1":"=@ccc"(ret):"x"(A),"x"(B));return ret;}
+#else
+DBCB_AVX2_SPEC int dbcB_mm256_testz_si256(dbcb_i32x8 A,dbcb_i32x8 B) {unsigned char ret;__asm__("vptest %2,%1\n\tsetz %0":"=q"(ret):"x"(A),"x"(B):"cc");return ret;}
+DBCB_AVX2_SPEC int dbcB_mm256_testc_si256(dbcb_i32x8 A,dbcb_i32x8 B) {unsigned char ret;__asm__("vptest %2,%1\n\tsetc %0":"=q"(ret):"x"(A),"x"(B):"cc");return ret;}
+#endif
 
 #ifndef dbcb_load256_32
 DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_load256_32_le (const void *p) {dbcb_i32x8 ret;__asm__("vmovd   %1,%x0"  :"=x"(ret):"m"(*(const unsigned char*)p):"memory");return ret;}
@@ -2959,6 +4677,7 @@ typedef __m256  dbcb_f32x8;
 #define dbcB_mm256_or_si256             _mm256_or_si256
 #define dbcB_mm256_setr_epi16           _mm256_setr_epi16
 #define dbcB_mm256_mullo_epi16          _mm256_mullo_epi16
+#define dbcB_mm256_mulhi_epu16          _mm256_mulhi_epu16
 #define dbcB_mm256_unpacklo_epi16       _mm256_unpacklo_epi16
 #define dbcB_mm256_srli_epi32           _mm256_srli_epi32
 #define dbcB_mm256_unpackhi_epi8        _mm256_unpackhi_epi8
@@ -2977,14 +4696,24 @@ typedef __m256  dbcb_f32x8;
 #define dbcB_mm256_and_si256            _mm256_and_si256
 #define dbcB_mm256_andnot_si256         _mm256_andnot_si256
 #define dbcB_mm256_cmpeq_epi16          _mm256_cmpeq_epi16
+#define dbcB_mm256_movemask_epi8        _mm256_movemask_epi8
 #define dbcB_mm256_cmpgt_epi16          _mm256_cmpgt_epi16
 #define dbcB_mm256_permute4x64_epi64    _mm256_permute4x64_epi64
 #define dbcB_mm256_set1_epi32           _mm256_set1_epi32
 #define dbcB_mm256_cmpgt_epi32          _mm256_cmpgt_epi32
+#define dbcB_mm256_cmpeq_epi32          _mm256_cmpeq_epi32
 #define dbcB_mm256_blendv_epi8          _mm256_blendv_epi8
 #define dbcB_mm256_div_ps               _mm256_div_ps
 #define dbcB_mm256_blend_ps             _mm256_blend_ps
 #define dbcB_mm256_shuffle_epi8         _mm256_shuffle_epi8
+#define dbcB_mm256_cvtph_ps(A)          _mm256_cvtph_ps(_mm256_castsi256_si128(A))
+#define dbcB_mm256_cvtps_ph(A)          _mm256_castsi128_si256(_mm256_cvtps_ph((A),0))
+#define dbcB_mm256_fmadd_ps             _mm256_fmadd_ps
+#define dbcB_mm256_sub_epi16            _mm256_sub_epi16
+#define dbcB_mm256_add_epi32            _mm256_add_epi32
+#define dbcB_mm256_blend_epi16          _mm256_blend_epi16
+#define dbcB_mm256_testz_si256          _mm256_testz_si256
+#define dbcB_mm256_testc_si256          _mm256_testc_si256
 
 #ifndef dbcb_load256_32
 /*
@@ -3046,6 +4775,13 @@ DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_div255_round_256(dbcb_i32x8 n)
     return dbcB_mm256_srli_epi16(dbcB_mm256_add_epi16(n,dbcB_mm256_srli_epi16(n,8)),8);
 }
 
+/* Same as dbcB_all_eq_128(), for 32 bytes. */
+DBCB_DECL_AVX2 static int dbcB_all_eq_256(dbcb_i32x8 v,int x,dbcb_uint32 bits)
+{
+    dbcb_uint32 m=(dbcb_uint32)dbcB_mm256_movemask_epi8(dbcB_mm256_cmpeq_epi8(v,dbcB_mm256_set1_epi8((char)x)));
+    return (m&bits)==bits;
+}
+
 DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_float2byte_clamp_256(dbcb_f32x8 x)
 {
     x=dbcB_mm256_min_ps(dbcB_mm256_max_ps(x,dbcB_mm256_set1_ps(0.0f)),dbcB_mm256_set1_ps(255.0f));
@@ -3098,6 +4834,21 @@ DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_float2byte_clamp_256(dbcb_f32x8 x)
     if(ac) cl=dbcB_mm256_xor_si256(al,dbcB_mm256_set1_epi16(255)); \
     if(ac) ch=dbcB_mm256_xor_si256(ah,dbcB_mm256_set1_epi16(255));
 
+/*
+    Block-level early-outs for 4- and 8-pixel blends, see dbcB_early128_bla.
+    Here n is load/store size, A selects alpha bytes, X selects all bytes.
+*/
+#define dbcB_early256_bla(n,A)\
+    if(dbcB_all_eq_256(s,  0,A)) {DBCB_ZEROUPPER();return;}        \
+    if(dbcB_all_eq_256(s,255,A)) {dbcb_store256_##n(s,dst);DBCB_ZEROUPPER();return;}
+
+#define dbcB_early256_blp(n,A,X)\
+    if(dbcB_all_eq_256(s,  0,X)) {DBCB_ZEROUPPER();return;}        \
+    if(dbcB_all_eq_256(s,255,A)) {dbcb_store256_##n(s,dst);DBCB_ZEROUPPER();return;}
+
+#define dbcB_early256_blx(X)\
+    if(dbcB_all_eq_256(s,255,X)) {DBCB_ZEROUPPER();return;}
+
 #define dbcB_setup256_32_SDAC(ac)\
     s=dbcb_load256_32(src);                                        \
     d=dbcb_load256_32(dst);                                        \
@@ -3193,6 +4944,64 @@ DBCB_DECL_AVX2 static void dbcB_b32m_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *ds
     DBCB_ZEROUPPER();
 }
 
+/* Fixed-point modulation, see dbcB_step128_b32k. */
+#define dbcB_mul16_256(mul) dbcB_mm256_setr_epi16(\
+    (short)mul[0],(short)mul[1],(short)mul[2],(short)mul[3],\
+    (short)mul[0],(short)mul[1],(short)mul[2],(short)mul[3],\
+    (short)mul[0],(short)mul[1],(short)mul[2],(short)mul[3],\
+    (short)mul[0],(short)mul[1],(short)mul[2],(short)mul[3])
+
+#define dbcB_step256_b32k(s,m)\
+    s=dbcB_mm256_mulhi_epu16(s,m);                                 \
+    s=dbcB_mm256_srli_epi16(dbcB_mm256_add_epi16(s,dbcB_mm256_set1_epi16(128)),8);
+
+#define DBCB_DEF_B32K_AVX2(n,suffix)\
+DBCB_DECL_AVX2 static void dbcB_b32k_##n##_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const dbcb_uint16 *mul)\
+{\
+    dbcb_i32x8 s,m;\
+    m=dbcB_mul16_256(mul);\
+    s=dbcb_load256_##suffix(src);\
+    s=dbcB_mm256_unpacklo_epi8(dbcB_mm256_set1_epi16(0),s);\
+    dbcB_step256_b32k(s,m)\
+    s=dbcB_mm256_packus_epi16(s,s);\
+    dbcb_store256_##suffix(s,dst);\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_B32K_AVX2(1,32)     /* Copies single pixel, with fixed-point modulation. */
+DBCB_DEF_B32K_AVX2(2,64)     /* Copies 2 pixels, with fixed-point modulation. */
+
+#undef DBCB_DEF_B32K_AVX2
+
+/* Copies 4 pixels, with fixed-point modulation. */
+DBCB_DECL_AVX2 static void dbcB_b32k_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const dbcb_uint16 *mul)
+{
+    dbcb_i32x8 s,m;
+    m=dbcB_mul16_256(mul);
+    s=dbcb_load256_128(src);
+    s=dbcB_mm256_permute4x64_epi64(s,0xD8);
+    s=dbcB_mm256_unpacklo_epi8(dbcB_mm256_set1_epi16(0),s);
+    dbcB_step256_b32k(s,m)
+    s=dbcB_mm256_packus_epi16(s,s);
+    s=dbcB_mm256_permute4x64_epi64(s,0xD8);
+    dbcb_store256_128(s,dst);
+    DBCB_ZEROUPPER();
+}
+
+/* Copies 8 pixels, with fixed-point modulation. */
+DBCB_DECL_AVX2 static void dbcB_b32k_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const dbcb_uint16 *mul)
+{
+    dbcb_i32x8 s,l,h,m;
+    m=dbcB_mul16_256(mul);
+    s=dbcb_load256_256(src);
+    l=dbcB_mm256_unpacklo_epi8(dbcB_mm256_set1_epi16(0),s);
+    h=dbcB_mm256_unpackhi_epi8(dbcB_mm256_set1_epi16(0),s);
+    dbcB_step256_b32k(l,m)
+    dbcB_step256_b32k(h,m)
+    dbcb_store256_256(dbcB_mm256_packus_epi16(l,h),dst);
+    DBCB_ZEROUPPER();
+}
+
 /* Alpha-blends single pixel, linear. */
 DBCB_DECL_AVX2 static void dbcB_bla_1_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
@@ -3219,6 +5028,8 @@ DBCB_DECL_AVX2 static void dbcB_bla_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_AVX2 static void dbcB_bla_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x8 s,d,a,c,ret;
+    s=dbcb_load256_128(src);
+    dbcB_early256_bla(128,0x8888u)
     dbcB_setup256_128_sdac(1);
     dbcB_step256_bla(s,d,a,c,ret);
     ret=dbcB_mm256_packus_epi16(ret,ret);
@@ -3231,6 +5042,8 @@ DBCB_DECL_AVX2 static void dbcB_bla_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_AVX2 static void dbcB_bla_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x8 s,d,a,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;
+    s=dbcb_load256_256(src);
+    dbcB_early256_bla(256,0x88888888u)
     dbcB_setup256_256_sdac(1);
     dbcB_step256_bla(sl,dl,al,cl,l);
     dbcB_step256_bla(sh,dh,ah,ch,h);
@@ -3292,6 +5105,8 @@ DBCB_DECL_AVX2 static void dbcB_blp_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_AVX2 static void dbcB_blp_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x8 s,d,a,c,ret;
+    s=dbcb_load256_128(src);
+    dbcB_early256_blp(128,0x8888u,0xFFFFu)
     dbcB_setup256_128_sdac(1);
     dbcB_step256_blp(s,d,c,ret);
     ret=dbcB_mm256_packus_epi16(ret,ret);
@@ -3304,6 +5119,8 @@ DBCB_DECL_AVX2 static void dbcB_blp_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_AVX2 static void dbcB_blp_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x8 s,d,a,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;
+    s=dbcb_load256_256(src);
+    dbcB_early256_blp(256,0x88888888u,0xFFFFFFFFu)
     dbcB_setup256_256_sdac(1);
     dbcB_step256_blp(sl,dl,cl,l);
     dbcB_step256_blp(sh,dh,ch,h);
@@ -3367,6 +5184,8 @@ DBCB_DECL_AVX2 static void dbcB_blx_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_AVX2 static void dbcB_blx_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x8 s,d,a,c,ret;
+    s=dbcb_load256_128(src);
+    dbcB_early256_blx(0xFFFFu)
     dbcB_setup256_128_sdac(0);
     (void)a;(void)c;
     dbcB_step256_blx(s,d,ret);
@@ -3380,6 +5199,8 @@ DBCB_DECL_AVX2 static void dbcB_blx_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
 DBCB_DECL_AVX2 static void dbcB_blx_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst)
 {
     dbcb_i32x8 s,d,a,sl,sh,dl,dh,al,ah,cl,ch,l,h,ret;
+    s=dbcb_load256_256(src);
+    dbcB_early256_blx(0xFFFFFFFFu)
     dbcB_setup256_256_sdac(0);
     (void)a;(void)al;(void)ah;(void)cl;(void)ch;
     dbcB_step256_blx(sl,dl,l);
@@ -3418,11 +5239,398 @@ DBCB_DECL_AVX2 static void dbcB_blxm_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *ds
     DBCB_ZEROUPPER();
 }
 
+/*
+    4 and 8 pixels, with modulation. The color is broadcast once per call,
+    and pixels are converted to float in pairs, lane-for-lane as in the
+    2-pixel versions, so the results are identical. Pixel words are first
+    spread by dbcB_spread256(), after which unpacklo/unpackhi of each
+    vector yield 2 pixels (one per 128-bit lane).
+*/
+#define dbcB_spread256(w)\
+    dbcB_mm256_permute4x64_epi64(w,0xD8)
+
+#define dbcB_pair256_SDAC(sw,dw,lohi,ac)\
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpack##lohi##_epi8(sw,dbcB_mm256_set1_epi16(0))); \
+    D=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpack##lohi##_epi8(dw,dbcB_mm256_set1_epi16(0))); \
+    S=dbcB_mm256_mul_ps(S,K);                                      \
+    if(ac) A=dbcB_mm256_shuffle_ps(S,S,0xFF);                      \
+    if(ac) C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(255.0f),A);
+
+#define DBCB_DEF_BLM48_AVX2(name,ac,step)\
+DBCB_DECL_AVX2 static void dbcB_##name##_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_i32x8 s,d,sw,dw,r0,r1,ret;\
+    dbcb_f32x8 K,S,D,A,C;\
+    (void)A;(void)C;\
+    K=dbcB_broadcast256_128f(color);\
+    s=dbcb_load256_128(src);\
+    d=dbcb_load256_128(dst);\
+    sw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0)));\
+    dw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(d,dbcB_mm256_set1_epi16(0)));\
+    dbcB_pair256_SDAC(sw,dw,lo,ac) step; r0=ret;\
+    sw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(s,dbcB_mm256_set1_epi16(0)));\
+    dw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(d,dbcB_mm256_set1_epi16(0)));\
+    dbcB_pair256_SDAC(sw,dw,lo,ac) step; r1=ret;\
+    ret=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r1),0xD8);\
+    ret=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(ret,ret),0xD8);\
+    dbcb_store256_128(ret,dst);\
+    DBCB_ZEROUPPER();\
+}\
+DBCB_DECL_AVX2 static void dbcB_##name##_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_i32x8 s,d,sw,dw,r0,r1,r2,r3,ret;\
+    dbcb_f32x8 K,S,D,A,C;\
+    (void)A;(void)C;\
+    K=dbcB_broadcast256_128f(color);\
+    s=dbcb_load256_256(src);\
+    d=dbcb_load256_256(dst);\
+    sw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0)));\
+    dw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(d,dbcB_mm256_set1_epi16(0)));\
+    dbcB_pair256_SDAC(sw,dw,lo,ac) step; r0=ret;\
+    dbcB_pair256_SDAC(sw,dw,hi,ac) step; r2=ret;\
+    sw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(s,dbcB_mm256_set1_epi16(0)));\
+    dw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(d,dbcB_mm256_set1_epi16(0)));\
+    dbcB_pair256_SDAC(sw,dw,lo,ac) step; r1=ret;\
+    dbcB_pair256_SDAC(sw,dw,hi,ac) step; r3=ret;\
+    r0=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r1),0xD8);\
+    r2=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r2,r3),0xD8);\
+    ret=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r2),0xD8);\
+    dbcb_store256_256(ret,dst);\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_BLM48_AVX2(blam,1,dbcB_step256_blam(S,D,A,C,ret))  /* Alpha-blends 4/8 pixels, linear with modulation. */
+DBCB_DEF_BLM48_AVX2(blpm,1,dbcB_step256_blpm(S,D,C,ret))    /* Alpha-blends (PMA) 4/8 pixels, linear with modulation. */
+DBCB_DEF_BLM48_AVX2(blxm,0,dbcB_step256_blxm(S,D,ret))      /* Multiplies 4/8 pixels, linear with modulation. */
+
+#undef DBCB_DEF_BLM48_AVX2
+
+/*
+    8 pixels with modulation by coverage: pixel k is blended with color
+    (components selected by keep left as is) multiplied by m[k]/255.
+    Coverage is widened to a pair of pixels per vector like the pixels
+    themselves, and the scaled color is computed as color[c]*(m[k]/255.0f)
+    per lane, so each pixel is bit-exact with the 1-pixel version with
+    the scaled color. Coverage 0 leaves the pixel as is. Used by masked
+    blit for blocks with partial coverage.
+*/
+#define dbcB_pair256_K(mw,lohi,keep)\
+    mk=dbcB_mm256_unpacklo_epi8(dbcB_spread256(dbcB_mm256_unpack##lohi##_epi8(mw,dbcB_mm256_set1_epi16(0))),dbcB_mm256_set1_epi16(0));\
+    K=dbcB_mm256_mul_ps(B,dbcB_mm256_div_ps(dbcB_mm256_cvtepi32_ps(dbcB_mm256_or_si256(mk,keep)),dbcB_mm256_set1_ps(255.0f)));
+
+#define DBCB_DEF_BLC8_AVX2(name,keep,step)\
+DBCB_DECL_AVX2 static void dbcB_##name##_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const dbcb_uint8 *m,const float *color)\
+{\
+    dbcb_i32x8 s,d,sw,dw,mb,ml,mh,mk,r0,r1,r2,r3,ret;\
+    dbcb_f32x8 B,K,S,D,A,C;\
+    B=dbcB_broadcast256_128f(color);\
+    mb=dbcB_load256_64_le(m); /* Bytes, no swap. */\
+    mb=dbcB_mm256_unpacklo_epi8(mb,mb);\
+    ml=dbcB_mm256_unpacklo_epi16(mb,mb);\
+    mh=dbcB_mm256_unpackhi_epi16(mb,mb);\
+    s=dbcb_load256_256(src);\
+    d=dbcb_load256_256(dst);\
+    sw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0)));\
+    dw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(d,dbcB_mm256_set1_epi16(0)));\
+    dbcB_pair256_K(ml,lo,keep) dbcB_pair256_SDAC(sw,dw,lo,1) step; r0=ret;\
+    dbcB_pair256_K(mh,lo,keep) dbcB_pair256_SDAC(sw,dw,hi,1) step; r2=ret;\
+    sw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(s,dbcB_mm256_set1_epi16(0)));\
+    dw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(d,dbcB_mm256_set1_epi16(0)));\
+    dbcB_pair256_K(ml,hi,keep) dbcB_pair256_SDAC(sw,dw,lo,1) step; r1=ret;\
+    dbcB_pair256_K(mh,hi,keep) dbcB_pair256_SDAC(sw,dw,hi,1) step; r3=ret;\
+    r0=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r1),0xD8);\
+    r2=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r2,r3),0xD8);\
+    ret=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r2),0xD8);\
+    dbcb_store256_256(ret,dst);\
+    DBCB_ZEROUPPER();\
+}
+
+/* Alpha-blends 8 pixels, linear with modulation of alpha by coverage. */
+DBCB_DEF_BLC8_AVX2(blac,dbcB_mm256_setr_epi16(255,0,255,0,255,0,0,0,255,0,255,0,255,0,0,0),dbcB_step256_blam(S,D,A,C,ret))
+/* Alpha-blends (PMA) 8 pixels, linear with modulation by coverage. */
+DBCB_DEF_BLC8_AVX2(blpc,dbcB_mm256_set1_epi16(0),dbcB_step256_blpm(S,D,C,ret))
+
+#undef DBCB_DEF_BLC8_AVX2
+#undef dbcB_pair256_K
+
+/* Copies 4 pixels, with modulation. */
+DBCB_DECL_AVX2 static void dbcB_b32m_4_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)
+{
+    dbcb_i32x8 s,sw,r0,r1;
+    dbcb_f32x8 K,S;
+    K=dbcB_broadcast256_128f(color);
+    s=dbcb_load256_128(src);
+    sw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0)));
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpacklo_epi8(sw,dbcB_mm256_set1_epi16(0)));
+    r0=dbcB_float2byte_clamp_256(dbcB_mm256_mul_ps(S,K));
+    sw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(s,dbcB_mm256_set1_epi16(0)));
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpacklo_epi8(sw,dbcB_mm256_set1_epi16(0)));
+    r1=dbcB_float2byte_clamp_256(dbcB_mm256_mul_ps(S,K));
+    r0=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r1),0xD8);
+    r0=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r0),0xD8);
+    dbcb_store256_128(r0,dst);
+    DBCB_ZEROUPPER();
+}
+
+/* Copies 8 pixels, with modulation. */
+DBCB_DECL_AVX2 static void dbcB_b32m_8_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)
+{
+    dbcb_i32x8 s,sw,r0,r1,r2,r3;
+    dbcb_f32x8 K,S;
+    K=dbcB_broadcast256_128f(color);
+    s=dbcb_load256_256(src);
+    sw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0)));
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpacklo_epi8(sw,dbcB_mm256_set1_epi16(0)));
+    r0=dbcB_float2byte_clamp_256(dbcB_mm256_mul_ps(S,K));
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpackhi_epi8(sw,dbcB_mm256_set1_epi16(0)));
+    r2=dbcB_float2byte_clamp_256(dbcB_mm256_mul_ps(S,K));
+    sw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(s,dbcB_mm256_set1_epi16(0)));
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpacklo_epi8(sw,dbcB_mm256_set1_epi16(0)));
+    r1=dbcB_float2byte_clamp_256(dbcB_mm256_mul_ps(S,K));
+    S=dbcB_mm256_cvtepi32_ps(dbcB_mm256_unpackhi_epi8(sw,dbcB_mm256_set1_epi16(0)));
+    r3=dbcB_float2byte_clamp_256(dbcB_mm256_mul_ps(S,K));
+    r0=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r1),0xD8);
+    r2=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r2,r3),0xD8);
+    dbcb_store256_256(dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r2),0xD8),dst);
+    DBCB_ZEROUPPER();
+}
+
+/*
+    Row of n pixels with gradient modulation, see dbc_blit_gradient():
+    pixels 2i and 2i+1 are modulated by the colors in the low and high
+    lane of K, and K is stepped by 2*dc after each pair. Blocks for which
+    skip is true leave dst as is. Last n%8 pixels go through a copy on stack.
+*/
+#define DBCB_DEF_BLG_AVX2(name,ac,dst_in,skip,step)\
+DBCB_DECL_AVX2 static void dbcB_##name##_row_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,dbcb_int32 n,const float *c,const float *dc)\
+{\
+    dbcb_uint8 tail_s[32]={0},tail_d[32]={0};\
+    float k[8];\
+    dbcb_i32x8 s,d,sw,dw,r0,r1,r2,r3,ret;\
+    dbcb_f32x8 G,G2,K0,K1,K2,K3,K,S,D,A,C;\
+    dbcb_int32 i;\
+    (void)D;(void)A;(void)C;\
+    for(i=0;i<4;++i) {k[i]=c[i];k[4+i]=c[i]+dc[i];}\
+    G=dbcB_mm256_loadu_ps(k);\
+    G2=dbcB_broadcast256_128f(dc);\
+    G2=dbcB_mm256_add_ps(G2,G2);\
+    for(i=0;i<n;i+=8)\
+    {\
+        const dbcb_uint8 *ps=src+4*i;\
+        dbcb_uint8 *pd=dst+4*i;\
+        if(n-i<8)\
+        {\
+            dbcb_memcpy(tail_s,ps,(size_t)(4*(n-i)));\
+            dbcb_memcpy(tail_d,pd,(size_t)(4*(n-i)));\
+            ps=tail_s;\
+            pd=tail_d;\
+        }\
+        K0=G;\
+        K1=dbcB_mm256_add_ps(K0,G2);\
+        K2=dbcB_mm256_add_ps(K1,G2);\
+        K3=dbcB_mm256_add_ps(K2,G2);\
+        G=dbcB_mm256_add_ps(K3,G2);\
+        s=dbcb_load256_256(ps);\
+        if(skip) continue;\
+        d=(dst_in?dbcb_load256_256(pd):s);\
+        sw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0)));\
+        dw=dbcB_spread256(dbcB_mm256_unpacklo_epi8(d,dbcB_mm256_set1_epi16(0)));\
+        K=K0; dbcB_pair256_SDAC(sw,dw,lo,ac) step; r0=ret;\
+        K=K2; dbcB_pair256_SDAC(sw,dw,hi,ac) step; r2=ret;\
+        sw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(s,dbcB_mm256_set1_epi16(0)));\
+        dw=dbcB_spread256(dbcB_mm256_unpackhi_epi8(d,dbcB_mm256_set1_epi16(0)));\
+        K=K1; dbcB_pair256_SDAC(sw,dw,lo,ac) step; r1=ret;\
+        K=K3; dbcB_pair256_SDAC(sw,dw,hi,ac) step; r3=ret;\
+        r0=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r1),0xD8);\
+        r2=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r2,r3),0xD8);\
+        ret=dbcB_mm256_permute4x64_epi64(dbcB_mm256_packus_epi16(r0,r2),0xD8);\
+        dbcb_store256_256(ret,pd);\
+        if(pd==tail_d) dbcb_memcpy(dst+4*i,tail_d,(size_t)(4*(n-i)));\
+    }\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_BLG_AVX2(b32m,0,0,0,ret=dbcB_float2byte_clamp_256(S))                                           /* Copies row, with gradient modulation. */
+DBCB_DEF_BLG_AVX2(blam,1,1,dbcB_all_eq_256(s,0,0x88888888u),dbcB_step256_blam(S,D,A,C,ret)) /* Alpha-blends row, linear with gradient modulation. */
+DBCB_DEF_BLG_AVX2(blpm,1,1,dbcB_all_eq_256(s,0,0xFFFFFFFFu),dbcB_step256_blpm(S,D,C,ret))   /* Alpha-blends (PMA) row, linear with gradient modulation. */
+DBCB_DEF_BLG_AVX2(blxm,0,1,0,dbcB_step256_blxm(S,D,ret))                                     /* Multiplies row, linear with gradient modulation. */
+
+#undef DBCB_DEF_BLG_AVX2
+
+/*
+    Same as DBCB_DEF_BLK_ROW_128, 8 pixels at a time. Multiplier registers
+    hold pixels i and i+4, so that the merged multipliers line up with
+    the bytes that vpunpcklbw/vpunpckhbw unpack.
+*/
+#define dbcB_mulk256(E,O)  dbcB_mm256_blend_epi16(dbcB_mm256_srli_epi32(E,16),O,0xAA)
+#define dbcB_bcast256(x)   dbcB_mm256_shuffle_epi8(x,dbcB_mm256_setr_epi32(\
+    0x07060706,0x07060706,0x0F0E0F0E,0x0F0E0F0E,0x07060706,0x07060706,0x0F0E0F0E,0x0F0E0F0E))
+#define dbcB_clear256(s)   dbcB_mm256_testz_si256(s,dbcB_mm256_set1_epi32((int)0xFF000000))
+#define dbcB_solid256(s)   dbcB_mm256_testc_si256(s,dbcB_mm256_set1_epi32((int)0xFF000000))
+#define dbcB_zero256(s)    dbcB_mm256_testz_si256(s,s)
+
+#define dbcB_div255k_256(x) dbcB_mm256_mulhi_epu16(dbcB_mm256_add_epi16(x,dbcB_mm256_set1_epi16(128)),dbcB_mm256_set1_epi16(257))
+
+#define dbcB_step256_b32k_row(s,m,d,r)\
+    dbcB_step256_b32k(s,m)                                      \
+    r=s;(void)d;
+
+#define dbcB_step256_blak_row(s,m,d,r)\
+    s=dbcB_mm256_mulhi_epu16(s,m);                              \
+    m=dbcB_bcast256(s);                                         \
+    s=dbcB_mm256_blend_epi16(s,dbcB_mm256_set1_epi16((short)0xFF00),0x88);\
+    d=dbcB_mm256_mulhi_epu16(d,dbcB_mm256_sub_epi16(dbcB_mm256_set1_epi16((short)0xFF00),m));\
+    r=dbcB_div255k_256(dbcB_mm256_add_epi16(dbcB_mm256_mulhi_epu16(s,m),d));
+
+#define dbcB_step256_blpk_row(s,m,d,r)\
+    s=dbcB_mm256_mulhi_epu16(s,m);                              \
+    m=dbcB_bcast256(s);                                         \
+    d=dbcB_mm256_mulhi_epu16(d,dbcB_mm256_sub_epi16(dbcB_mm256_set1_epi16((short)0xFF00),m));\
+    s=dbcB_mm256_srli_epi16(dbcB_mm256_add_epi16(s,dbcB_mm256_set1_epi16(128)),8);\
+    r=dbcB_mm256_add_epi16(dbcB_div255k_256(d),s);
+
+#define dbcB_step256_blxk_row(s,m,d,r)\
+    s=dbcB_mm256_mulhi_epu16(s,m);                              \
+    r=dbcB_div255k_256(dbcB_mm256_mulhi_epu16(d,s));
+
+#define dbcB_step256_blak_opaque(s,m,r)\
+    s=dbcB_mm256_mulhi_epu16(s,m);                              \
+    r=dbcB_div255k_256(dbcB_mm256_mulhi_epu16(s,dbcB_mm256_set1_epi16((short)0xFEFF)));
+
+#define dbcB_step256_blpk_opaque(s,m,r)\
+    dbcB_step256_b32k(s,m)                                      \
+    r=s;
+
+/* Multipliers of pixels o..o+7: E0/O0 for pixels o, o+1, o+4, o+5, E1/O1 for the rest. Fe/Fo are the offsets of pixels 0, 1, 4, 5. */
+#define dbcB_mk256(c,dc,o)\
+    E0=dbcB_mm256_add_epi32(Fe,dbcB_mm256_setr_epi32(\
+        (int)(c[0]+(dbcb_uint32)(o)*dc[0]),(int)(c[2]+(dbcb_uint32)(o)*dc[2]),\
+        (int)(c[0]+(dbcb_uint32)(o)*dc[0]),(int)(c[2]+(dbcb_uint32)(o)*dc[2]),\
+        (int)(c[0]+(dbcb_uint32)(o)*dc[0]),(int)(c[2]+(dbcb_uint32)(o)*dc[2]),\
+        (int)(c[0]+(dbcb_uint32)(o)*dc[0]),(int)(c[2]+(dbcb_uint32)(o)*dc[2])));\
+    O0=dbcB_mm256_add_epi32(Fo,dbcB_mm256_setr_epi32(\
+        (int)(c[1]+(dbcb_uint32)(o)*dc[1]),(int)(c[3]+(dbcb_uint32)(o)*dc[3]),\
+        (int)(c[1]+(dbcb_uint32)(o)*dc[1]),(int)(c[3]+(dbcb_uint32)(o)*dc[3]),\
+        (int)(c[1]+(dbcb_uint32)(o)*dc[1]),(int)(c[3]+(dbcb_uint32)(o)*dc[3]),\
+        (int)(c[1]+(dbcb_uint32)(o)*dc[1]),(int)(c[3]+(dbcb_uint32)(o)*dc[3])));\
+    E1=dbcB_mm256_add_epi32(E0,dbcB_mm256_add_epi32(De,De));\
+    O1=dbcB_mm256_add_epi32(O0,dbcB_mm256_add_epi32(Do,Do));
+
+#define dbcB_blk256(ML,MH,dst_in,skip,opaque,step)\
+    do\
+    {\
+        dbcb_i32x8 ml=ML,mh=MH,sl,sh,dl,dh,l,h;\
+        r=d;\
+        if(skip) break;\
+        sl=dbcB_mm256_unpacklo_epi8(dbcB_mm256_set1_epi16(0),s);\
+        sh=dbcB_mm256_unpackhi_epi8(dbcB_mm256_set1_epi16(0),s);\
+        opaque;\
+        if(!dst_in) d=s;\
+        dl=dbcB_mm256_unpacklo_epi8(dbcB_mm256_set1_epi16(0),d);\
+        dh=dbcB_mm256_unpackhi_epi8(dbcB_mm256_set1_epi16(0),d);\
+        step(sl,ml,dl,l)\
+        step(sh,mh,dh,h)\
+        r=dbcB_mm256_packus_epi16(l,h);\
+    } while(0);
+
+#define dbcB_opaque256(fstep)\
+    if(full&&dbcB_solid256(s))\
+    {\
+        fstep(sl,ml,l)\
+        fstep(sh,mh,h)\
+        r=dbcB_mm256_packus_epi16(l,h);\
+        break;\
+    }
+
+#define DBCB_DEF_BLK_ROW_AVX2(name,dst_in,skip,opaque,step)\
+DBCB_DECL_AVX2 static void dbcB_##name##_row_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,dbcb_int32 n,const dbcb_uint32 *c,const dbcb_uint32 *dc)\
+{\
+    dbcb_i32x8 E0,O0,E1,O1,De,Do,Fe,Fo,s,d,r,T=dbcB_mm256_set1_epi16(0);\
+    dbcb_i32x8 M1=dbcB_mm256_setr_epi32(0,0,-1,-1,0,0,-1,-1),M4=dbcB_mm256_setr_epi32(0,0,0,0,-1,-1,-1,-1);\
+    dbcb_int32 i;\
+    int full=(dc[3]==0&&c[3]>=0xFFFF0000u);\
+    (void)full;\
+    De=dbcB_mm256_setr_epi32((int)dc[0],(int)dc[2],(int)dc[0],(int)dc[2],(int)dc[0],(int)dc[2],(int)dc[0],(int)dc[2]);\
+    Do=dbcB_mm256_setr_epi32((int)dc[1],(int)dc[3],(int)dc[1],(int)dc[3],(int)dc[1],(int)dc[3],(int)dc[1],(int)dc[3]);\
+    Fe=dbcB_mm256_add_epi32(dbcB_mm256_and_si256(De,M1),dbcB_mm256_and_si256(dbcB_mm256_slli_epi32(De,2),M4));\
+    Fo=dbcB_mm256_add_epi32(dbcB_mm256_and_si256(Do,M1),dbcB_mm256_and_si256(dbcB_mm256_slli_epi32(Do,2),M4));\
+    if(n<8)\
+    {\
+        dbcb_uint8 tail_s[32]={0},tail_d[32]={0};\
+        dbcb_memcpy(tail_s,src,(size_t)(4*n));\
+        dbcb_memcpy(tail_d,dst,(size_t)(4*n));\
+        dbcB_mk256(c,dc,0)\
+        s=dbcb_load256_256(tail_s);\
+        d=dbcb_load256_256(tail_d);\
+        dbcB_blk256(dbcB_mulk256(E0,O0),dbcB_mulk256(E1,O1),dst_in,skip,opaque,step)\
+        dbcb_store256_256(r,tail_d);\
+        dbcb_memcpy(dst,tail_d,(size_t)(4*n));\
+        DBCB_ZEROUPPER();\
+        return;\
+    }\
+    if(n&7)\
+    {\
+        dbcB_mk256(c,dc,n-8)\
+        s=dbcb_load256_256(src+4*(n-8));\
+        d=dbcb_load256_256(dst+4*(n-8));\
+        dbcB_blk256(dbcB_mulk256(E0,O0),dbcB_mulk256(E1,O1),dst_in,skip,opaque,step)\
+        T=r;\
+    }\
+    dbcB_mk256(c,dc,0)\
+    De=dbcB_mm256_add_epi32(De,De);\
+    De=dbcB_mm256_add_epi32(De,De);\
+    De=dbcB_mm256_add_epi32(De,De);\
+    Do=dbcB_mm256_add_epi32(Do,Do);\
+    Do=dbcB_mm256_add_epi32(Do,Do);\
+    Do=dbcB_mm256_add_epi32(Do,Do);\
+    for(i=0;i+8<=n;i+=8)\
+    {\
+        dbcb_i32x8 ML=dbcB_mulk256(E0,O0),MH=dbcB_mulk256(E1,O1);\
+        E0=dbcB_mm256_add_epi32(E0,De);\
+        O0=dbcB_mm256_add_epi32(O0,Do);\
+        E1=dbcB_mm256_add_epi32(E1,De);\
+        O1=dbcB_mm256_add_epi32(O1,Do);\
+        s=dbcb_load256_256(src+4*i);\
+        d=(dst_in?dbcb_load256_256(dst+4*i):s);\
+        dbcB_blk256(ML,MH,dst_in,skip,opaque,step)\
+        dbcb_store256_256(r,dst+4*i);\
+    }\
+    if(n&7) dbcb_store256_256(T,dst+4*(n-8));\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_BLK_ROW_AVX2(b32k,0,0,((void)0),dbcB_step256_b32k_row)                                               /* Copies row, with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_AVX2(blak,1,dbcB_clear256(s),dbcB_opaque256(dbcB_step256_blak_opaque),dbcB_step256_blak_row) /* Alpha-blends row, linear with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_AVX2(blpk,1,dbcB_zero256(s),dbcB_opaque256(dbcB_step256_blpk_opaque),dbcB_step256_blpk_row)  /* Alpha-blends (PMA) row, linear with fixed-point gradient modulation. */
+DBCB_DEF_BLK_ROW_AVX2(blxk,1,0,((void)0),dbcB_step256_blxk_row)                                               /* Multiplies row, linear with fixed-point gradient modulation. */
+
+#undef DBCB_DEF_BLK_ROW_AVX2
+#undef dbcB_mk256
+#undef dbcB_blk256
+#undef dbcB_opaque256
+#undef dbcB_mulk256
+#undef dbcB_bcast256
+#undef dbcB_clear256
+#undef dbcB_solid256
+#undef dbcB_zero256
+#undef dbcB_div255k_256
+#undef dbcB_step256_b32k_row
+#undef dbcB_step256_blak_row
+#undef dbcB_step256_blpk_row
+#undef dbcB_step256_blxk_row
+#undef dbcB_step256_blak_opaque
+#undef dbcB_step256_blpk_opaque
+
+#undef dbcB_spread256
+#undef dbcB_pair256_SDAC
 #undef dbcB_setup256_32_sdac
 #undef dbcB_setup256_64_sdac
 #undef dbcB_setup256_128_sdac
 #undef dbcB_setup256_256_sdac
 #undef dbcB_setup256_32_SDAC
+#undef dbcB_early256_bla
+#undef dbcB_early256_blp
+#undef dbcB_early256_blx
 #undef dbcB_setup256_64_SDAC
 #undef dbcB_step256_bla
 #undef dbcB_step256_blp
@@ -3649,7 +5857,8 @@ DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_linear2srgb_ggglgggl_avx2(dbcb_f32x8 x)
     if(dl) d=dbcB_mm256_unpacklo_epi8(d,dbcB_mm256_set1_epi16(0));\
     S=dbcB_srgb2linear_ggglgggl_avx2(s);                        \
     if(dl) D=dbcB_srgb2linear_ggglgggl_avx2(d);                 \
-    if(m) S=dbcB_mm256_mul_ps(S,dbcB_broadcast256_128f(color)); \
+    if(m==1) S=dbcB_mm256_mul_ps(S,dbcB_broadcast256_128f(color));\
+    if(m==2) S=dbcB_mm256_mul_ps(S,dbcB_mm256_loadu_ps(color)); \
     if(ac) A=dbcB_mm256_shuffle_ps(S,S,0xFF);                   \
     if(ac) C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),A);
 
@@ -3671,7 +5880,8 @@ DBCB_DECL_AVX2 static dbcb_i32x8 dbcB_linear2srgb_ggglgggl_avx2(dbcb_f32x8 x)
     if(dl) d=dbcB_mm256_unpacklo_epi8(d,dbcB_mm256_set1_epi16(0));\
     S=dbcB_srgb2linear_ggglgggl_avx2(s);                        \
     if(dl) D=dbcB_srgb2linear_ggglgggl_avx2(d);                 \
-    if(m) S=dbcB_mm256_mul_ps(S,dbcB_broadcast256_128f(color)); \
+    if(m==1) S=dbcB_mm256_mul_ps(S,dbcB_broadcast256_128f(color));\
+    if(m==2) S=dbcB_mm256_mul_ps(S,dbcB_mm256_loadu_ps(color)); \
     if(ac) A=dbcB_mm256_shuffle_ps(S,S,0xFF);                   \
     if(ac) C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),A);
 
@@ -3891,85 +6101,109 @@ DBCB_DECL_AVX2 static void dbcB_bgx_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst
     }
 }
 
+/*
+    2-pixel functions with modulation. With g=0 both pixels are modulated
+    by color, with g=1 (dbcB_*_2g_avx2(), for gradients) the second pixel
+    is modulated by color+4.
+*/
+
 /* Copies 2 pixels, gamma-corrected, with modulation. */
-DBCB_DECL_AVX2 static void dbcB_b32g_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)
-{
-    dbcb_i32x8 s,d,ret;
-    dbcb_f32x8 S,D,A,C;
-    (void)A;(void)C;
-    dbcB_setup256_64_gggl(0,0,1);
-    D=S;
-    dbcB_output256_64_gggl(1);
-    DBCB_ZEROUPPER();
+#define DBCB_DEF_B32G_2_AVX2(name,g)\
+DBCB_DECL_AVX2 static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_i32x8 s,d,ret;\
+    dbcb_f32x8 S,D,A,C;\
+    (void)A;(void)C;\
+    dbcB_setup256_64_gggl(0,0,1+g);\
+    D=S;\
+    dbcB_output256_64_gggl(1);\
+    DBCB_ZEROUPPER();\
 }
 
 /* Alpha-blends 2 pixels, gamma-corrected, with modulation. */
-DBCB_DECL_AVX2 static void dbcB_bgam_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)
-{
-    dbcb_uint32 S0=dbcb_load32(src  );
-    dbcb_uint32 S1=dbcb_load32(src+4);
-    if(S0<=0x00FFFFFFu||S1<=0x00FFFFFFu||color[3]==0.0f)
-    {
-        dbcB_bgam_1_avx2(src  ,dst  ,color);
-        dbcB_bgam_1_avx2(src+4,dst+4,color);
-    }
-    else
-    {
-        dbcb_i32x8 s,d,ret;
-        dbcb_f32x8 S,D,A,C;
-        dbcB_setup256_64_gggl(1,1,1);
-        S=dbcB_mm256_blend_ps(dbcB_mm256_set1_ps(1.0f),S,0x77);
-        D=dbcB_mm256_add_ps(dbcB_mm256_mul_ps(A,S),dbcB_mm256_mul_ps(C,D));
-        dbcB_output256_64_gggl(1);
-        DBCB_ZEROUPPER();
-    }
+#define DBCB_DEF_BGAM_2_AVX2(name,g)\
+DBCB_DECL_AVX2 static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_uint32 S0=dbcb_load32(src  );\
+    dbcb_uint32 S1=dbcb_load32(src+4);\
+    if(S0<=0x00FFFFFFu||S1<=0x00FFFFFFu||color[3]==0.0f||color[3+4*g]==0.0f)\
+    {\
+        dbcB_bgam_1_avx2(src  ,dst  ,color    );\
+        dbcB_bgam_1_avx2(src+4,dst+4,color+4*g);\
+    }\
+    else\
+    {\
+        dbcb_i32x8 s,d,ret;\
+        dbcb_f32x8 S,D,A,C;\
+        dbcB_setup256_64_gggl(1,1,1+g);\
+        S=dbcB_mm256_blend_ps(dbcB_mm256_set1_ps(1.0f),S,0x77);\
+        D=dbcB_mm256_add_ps(dbcB_mm256_mul_ps(A,S),dbcB_mm256_mul_ps(C,D));\
+        dbcB_output256_64_gggl(1);\
+        DBCB_ZEROUPPER();\
+    }\
 }
 
 /* Alpha-blends (PMA) 2 pixels, gamma-corrected, with modulation. */
-DBCB_DECL_AVX2 static void dbcB_bgpm_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)
-{
-    dbcb_uint32 S0=dbcb_load32(src  );
-    dbcb_uint32 S1=dbcb_load32(src+4);
-    if(S0==0u||S1==0u)
-    {
-        dbcB_bgpm_1_avx2(src  ,dst  ,color);
-        dbcB_bgpm_1_avx2(src+4,dst+4,color);
-    }
-    else
-    {
-        dbcb_i32x8 s,d,ret;
-        dbcb_f32x8 S,D,A,C;
-        dbcB_setup256_64_gggl(1,1,1);
-        D=dbcB_mm256_mul_ps(C,D);
-        D=dbcB_mm256_add_ps(D,S);
-        dbcB_output256_64_gggl(1);
-        DBCB_ZEROUPPER();
-    }
+#define DBCB_DEF_BGPM_2_AVX2(name,g)\
+DBCB_DECL_AVX2 static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_uint32 S0=dbcb_load32(src  );\
+    dbcb_uint32 S1=dbcb_load32(src+4);\
+    if(S0==0u||S1==0u)\
+    {\
+        dbcB_bgpm_1_avx2(src  ,dst  ,color    );\
+        dbcB_bgpm_1_avx2(src+4,dst+4,color+4*g);\
+    }\
+    else\
+    {\
+        dbcb_i32x8 s,d,ret;\
+        dbcb_f32x8 S,D,A,C;\
+        dbcB_setup256_64_gggl(1,1,1+g);\
+        D=dbcB_mm256_mul_ps(C,D);\
+        D=dbcB_mm256_add_ps(D,S);\
+        dbcB_output256_64_gggl(1);\
+        DBCB_ZEROUPPER();\
+    }\
 }
 
 /* Multiplies 2 pixels, gamma-corrected, with modulation. */
-DBCB_DECL_AVX2 static void dbcB_bgxm_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)
-{
-    dbcb_uint32 S0=dbcb_load32(src  );
-    dbcb_uint32 S1=dbcb_load32(src+4);
-    dbcb_uint32 D0=dbcb_load32(dst  );
-    dbcb_uint32 D1=dbcb_load32(dst+4);
-    if(S0==0u||S1==0u||D0==0u||D1==0u)
-    {
-        dbcB_bgxm_1_avx2(src  ,dst  ,color);
-        dbcB_bgxm_1_avx2(src+4,dst+4,color);
-    }
-    else
-    {
-        dbcb_i32x8 s,d,ret;
-        dbcb_f32x8 S,D,A,C;
-        (void)A;(void)C;
-        dbcB_setup256_64_gggl(1,0,1);
-        D=dbcB_mm256_mul_ps(S,D);
-        dbcB_output256_64_gggl(1);
-        DBCB_ZEROUPPER();
-    }
-}
+#define DBCB_DEF_BGXM_2_AVX2(name,g)\
+DBCB_DECL_AVX2 static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_uint32 S0=dbcb_load32(src  );\
+    dbcb_uint32 S1=dbcb_load32(src+4);\
+    dbcb_uint32 D0=dbcb_load32(dst  );\
+    dbcb_uint32 D1=dbcb_load32(dst+4);\
+    if(S0==0u||S1==0u||D0==0u||D1==0u)\
+    {\
+        dbcB_bgxm_1_avx2(src  ,dst  ,color    );\
+        dbcB_bgxm_1_avx2(src+4,dst+4,color+4*g);\
+    }\
+    else\
+    {\
+        dbcb_i32x8 s,d,ret;\
+        dbcb_f32x8 S,D,A,C;\
+        (void)A;(void)C;\
+        dbcB_setup256_64_gggl(1,0,1+g);\
+        D=dbcB_mm256_mul_ps(S,D);\
+        dbcB_output256_64_gggl(1);\
+        DBCB_ZEROUPPER();\
+    }\
+}
+
+DBCB_DEF_B32G_2_AVX2(dbcB_b32g_2_avx2 ,0)
+DBCB_DEF_B32G_2_AVX2(dbcB_b32g_2g_avx2,1)
+DBCB_DEF_BGAM_2_AVX2(dbcB_bgam_2_avx2 ,0)
+DBCB_DEF_BGAM_2_AVX2(dbcB_bgam_2g_avx2,1)
+DBCB_DEF_BGPM_2_AVX2(dbcB_bgpm_2_avx2 ,0)
+DBCB_DEF_BGPM_2_AVX2(dbcB_bgpm_2g_avx2,1)
+DBCB_DEF_BGXM_2_AVX2(dbcB_bgxm_2_avx2 ,0)
+DBCB_DEF_BGXM_2_AVX2(dbcB_bgxm_2g_avx2,1)
+
+#undef DBCB_DEF_B32G_2_AVX2
+#undef DBCB_DEF_BGAM_2_AVX2
+#undef DBCB_DEF_BGPM_2_AVX2
+#undef DBCB_DEF_BGXM_2_AVX2
 
 #undef dbcB_setup256_32_gggl
 #undef dbcB_output256_32_gggl
@@ -3977,6 +6211,274 @@ DBCB_DECL_AVX2 static void dbcB_bgxm_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *ds
 #undef dbcB_setup256_64_gggl
 #undef dbcB_output256_64_gggl
 
+#ifdef DBCB_GAMMA_FMA
+/*
+    FMA versions. Unlike the above, these work on planar data: each
+    vector holds one channel of 8 pixels, so no lanes are wasted on alpha
+    (which needs no conversion). Each function takes 8 pixels of src and
+    dst already loaded (unused lanes are simply ignored), and returns
+    the result. Trivial cases are resolved by blending with src/dst at
+    the end, so that they are exact.
+*/
+
+DBCB_DECL_FMA static dbcb_f32x8 dbcB_srgb2linear_fma(dbcb_i32x8 x)
+{
+    dbcb_f32x8 y=dbcB_mm256_cvtepi32_ps(x);
+/* (MACRO+0) allows MACRO to be empty. */
+#if   (DBC_BLIT_GAMMA_NO_TABLES + 0)==3 || (DBC_BLIT_GAMMA_NO_TABLES + 0)==2
+    y=dbcB_mm256_mul_ps(y,
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_S2L_C3),y,dbcB_mm256_set1_ps(DBCB_S2L_C2)),y,dbcB_mm256_set1_ps(DBCB_S2L_C1)));
+#elif (DBC_BLIT_GAMMA_NO_TABLES + 0)==1
+    y=dbcB_mm256_mul_ps(y,
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_S2L_C5),y,dbcB_mm256_set1_ps(DBCB_S2L_C4)),y,dbcB_mm256_set1_ps(DBCB_S2L_C3)),y,dbcB_mm256_set1_ps(DBCB_S2L_C2)),y,dbcB_mm256_set1_ps(DBCB_S2L_C1)));
+#else
+    dbcb_f32x8 P=dbcB_mm256_mul_ps(y,
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_S2L_P4),y,dbcB_mm256_set1_ps(DBCB_S2L_P3)),y,dbcB_mm256_set1_ps(DBCB_S2L_P2)),y,dbcB_mm256_set1_ps(DBCB_S2L_P1)));
+    dbcb_f32x8 Q=
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_S2L_Q2),y,dbcB_mm256_set1_ps(DBCB_S2L_Q1)),y,dbcB_mm256_set1_ps(DBCB_S2L_Q0));
+    y=dbcB_mm256_div_ps(P,Q);
+#endif
+    return y;
+}
+
+/* Clamping before conversion matches packus saturation in the versions above. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_linear2srgb_fma(dbcb_f32x8 x)
+{
+/* (MACRO+0) allows MACRO to be empty. */
+#if   (DBC_BLIT_GAMMA_NO_TABLES + 0)==3
+    x=dbcB_mm256_mul_ps(x,
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_C3),x,dbcB_mm256_set1_ps(DBCB_L2S_C2)),x,dbcB_mm256_set1_ps(DBCB_L2S_C1)));
+#elif (DBC_BLIT_GAMMA_NO_TABLES + 0)==2
+    dbcb_f32x8 P=dbcB_mm256_mul_ps(x,
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_P2),x,dbcB_mm256_set1_ps(DBCB_L2S_P1)));
+    dbcb_f32x8 Q=
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_Q2),x,dbcB_mm256_set1_ps(DBCB_L2S_Q1)),x,dbcB_mm256_set1_ps(DBCB_L2S_Q0));
+    x=dbcB_mm256_div_ps(P,Q);
+#elif (DBC_BLIT_GAMMA_NO_TABLES + 0)==1
+    dbcb_f32x8 P=dbcB_mm256_mul_ps(x,
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_P3),x,dbcB_mm256_set1_ps(DBCB_L2S_P2)),x,dbcB_mm256_set1_ps(DBCB_L2S_P1)));
+    dbcb_f32x8 Q=
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_Q2),x,dbcB_mm256_set1_ps(DBCB_L2S_Q1)),x,dbcB_mm256_set1_ps(DBCB_L2S_Q0));
+    x=dbcB_mm256_div_ps(P,Q);
+#else
+    dbcb_f32x8 P=dbcB_mm256_mul_ps(x,
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_P4),x,dbcB_mm256_set1_ps(DBCB_L2S_P3)),x,dbcB_mm256_set1_ps(DBCB_L2S_P2)),x,dbcB_mm256_set1_ps(DBCB_L2S_P1)));
+    dbcb_f32x8 Q=
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(
+        dbcB_mm256_fmadd_ps(dbcB_mm256_set1_ps(DBCB_L2S_Q4),x,dbcB_mm256_set1_ps(DBCB_L2S_Q3)),x,dbcB_mm256_set1_ps(DBCB_L2S_Q2)),x,dbcB_mm256_set1_ps(DBCB_L2S_Q1)),x,dbcB_mm256_set1_ps(DBCB_L2S_Q0));
+    x=dbcB_mm256_div_ps(P,Q);
+#endif
+    x=dbcB_mm256_min_ps(dbcB_mm256_max_ps(x,dbcB_mm256_set1_ps(0.0f)),dbcB_mm256_set1_ps(255.0f));
+    return dbcB_mm256_cvttps_epi32(dbcB_mm256_add_ps(x,dbcB_mm256_set1_ps(0.5f)));
+}
+
+/* Channel c (0..3) of each pixel, as int. */
+#define dbcB_channel256(v,c)\
+    dbcB_mm256_and_si256(dbcB_mm256_srli_epi32(v,8*(c)),dbcB_mm256_set1_epi32(255))
+
+/*
+    Linear src and dst color channels into S0..S2 and D0..D2, and alphas
+    into SA and DA. With m, src is modulated by color.
+*/
+#define dbcB_setup256_planar(m)\
+    S0=dbcB_srgb2linear_fma(dbcB_channel256(s,0));                              \
+    S1=dbcB_srgb2linear_fma(dbcB_channel256(s,1));                              \
+    S2=dbcB_srgb2linear_fma(dbcB_channel256(s,2));                              \
+    SA=dbcB_mm256_mul_ps(dbcB_mm256_cvtepi32_ps(dbcB_channel256(s,3)),dbcB_mm256_set1_ps(DBCB_1div255f));\
+    D0=dbcB_srgb2linear_fma(dbcB_channel256(d,0));                              \
+    D1=dbcB_srgb2linear_fma(dbcB_channel256(d,1));                              \
+    D2=dbcB_srgb2linear_fma(dbcB_channel256(d,2));                              \
+    DA=dbcB_mm256_mul_ps(dbcB_mm256_cvtepi32_ps(dbcB_channel256(d,3)),dbcB_mm256_set1_ps(DBCB_1div255f));\
+    if(m) S0=dbcB_mm256_mul_ps(S0,dbcB_mm256_set1_ps(color[0]));               \
+    if(m) S1=dbcB_mm256_mul_ps(S1,dbcB_mm256_set1_ps(color[1]));               \
+    if(m) S2=dbcB_mm256_mul_ps(S2,dbcB_mm256_set1_ps(color[2]));               \
+    if(m) SA=dbcB_mm256_mul_ps(SA,dbcB_mm256_set1_ps(color[3]));
+
+#define dbcB_clamp01_256(x)\
+    dbcB_mm256_min_ps(dbcB_mm256_max_ps(x,dbcB_mm256_set1_ps(0.0f)),dbcB_mm256_set1_ps(1.0f))
+
+/* Packs D0..D2 (converted to sRGB) and DA into ret, with optional clamping. */
+#define dbcB_output256_planar(cl)\
+    if(cl) D0=dbcB_clamp01_256(D0);                                             \
+    if(cl) D1=dbcB_clamp01_256(D1);                                             \
+    if(cl) D2=dbcB_clamp01_256(D2);                                             \
+    if(cl) DA=dbcB_clamp01_256(DA);                                             \
+    DA=dbcB_mm256_min_ps(dbcB_mm256_max_ps(dbcB_mm256_mul_ps(DA,dbcB_mm256_set1_ps(255.0f)),dbcB_mm256_set1_ps(0.0f)),dbcB_mm256_set1_ps(255.0f));\
+    ret=dbcB_mm256_cvttps_epi32(dbcB_mm256_add_ps(DA,dbcB_mm256_set1_ps(0.5f)));\
+    ret=dbcB_mm256_slli_epi32(ret,8);                                           \
+    ret=dbcB_mm256_or_si256(ret,dbcB_linear2srgb_fma(D2));                      \
+    ret=dbcB_mm256_slli_epi32(ret,8);                                           \
+    ret=dbcB_mm256_or_si256(ret,dbcB_linear2srgb_fma(D1));                      \
+    ret=dbcB_mm256_slli_epi32(ret,8);                                           \
+    ret=dbcB_mm256_or_si256(ret,dbcB_linear2srgb_fma(D0));
+
+/* Alpha-blends 8 pixels, gamma-corrected. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_bga_fma(dbcb_i32x8 s,dbcb_i32x8 d,dbcb_uint32 lanes)
+{
+    dbcb_i32x8 ret,a;
+    dbcb_f32x8 S0,S1,S2,SA,D0,D1,D2,DA,C;
+    const float *color=0;
+    (void)color;
+    if(dbcB_all_eq_256(s,  0,0x88888888u)) return d;
+    if(dbcB_all_eq_256(s,255,lanes&0x88888888u)) return s;
+    dbcB_setup256_planar(0);
+    C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),SA);
+    D0=dbcB_mm256_fmadd_ps(SA,S0,dbcB_mm256_mul_ps(C,D0));
+    D1=dbcB_mm256_fmadd_ps(SA,S1,dbcB_mm256_mul_ps(C,D1));
+    D2=dbcB_mm256_fmadd_ps(SA,S2,dbcB_mm256_mul_ps(C,D2));
+    DA=dbcB_mm256_fmadd_ps(C,DA,SA);
+    dbcB_output256_planar(0);
+    a=dbcB_mm256_srli_epi32(s,24);
+    ret=dbcB_mm256_blendv_epi8(ret,s,dbcB_mm256_cmpgt_epi32(a,dbcB_mm256_set1_epi32(254)));
+    ret=dbcB_mm256_blendv_epi8(ret,d,dbcB_mm256_cmpeq_epi32(a,dbcB_mm256_set1_epi32(0)));
+    return ret;
+}
+
+/* Alpha-blends (PMA) 8 pixels, gamma-corrected. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_bgp_fma(dbcb_i32x8 s,dbcb_i32x8 d,dbcb_uint32 lanes)
+{
+    dbcb_i32x8 ret,m;
+    dbcb_f32x8 S0,S1,S2,SA,D0,D1,D2,DA,C;
+    const float *color=0;
+    (void)color;
+    if(dbcB_all_eq_256(s,  0,0xFFFFFFFFu)) return d;
+    if(dbcB_all_eq_256(s,255,lanes&0x88888888u)) return s;
+    dbcB_setup256_planar(0);
+    C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),SA);
+    D0=dbcB_mm256_fmadd_ps(C,D0,S0);
+    D1=dbcB_mm256_fmadd_ps(C,D1,S1);
+    D2=dbcB_mm256_fmadd_ps(C,D2,S2);
+    DA=dbcB_mm256_fmadd_ps(C,DA,SA);
+    dbcB_output256_planar(1);
+    m=dbcB_mm256_cmpgt_epi32(dbcB_mm256_srli_epi32(s,24),dbcB_mm256_set1_epi32(254));
+    m=dbcB_mm256_or_si256(m,dbcB_mm256_cmpeq_epi32(d,dbcB_mm256_set1_epi32(0)));
+    ret=dbcB_mm256_blendv_epi8(ret,s,m);
+    ret=dbcB_mm256_blendv_epi8(ret,d,dbcB_mm256_cmpeq_epi32(s,dbcB_mm256_set1_epi32(0)));
+    return ret;
+}
+
+/* Multiplies 8 pixels, gamma-corrected. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_bgx_fma(dbcb_i32x8 s,dbcb_i32x8 d,dbcb_uint32 lanes)
+{
+    dbcb_i32x8 ret,m;
+    dbcb_f32x8 S0,S1,S2,SA,D0,D1,D2,DA;
+    const float *color=0;
+    (void)color;
+    if(dbcB_all_eq_256(s,255,lanes)) return d;
+    dbcB_setup256_planar(0);
+    D0=dbcB_mm256_mul_ps(S0,D0);
+    D1=dbcB_mm256_mul_ps(S1,D1);
+    D2=dbcB_mm256_mul_ps(S2,D2);
+    DA=dbcB_mm256_mul_ps(SA,DA);
+    dbcB_output256_planar(0);
+    m=dbcB_mm256_or_si256(dbcB_mm256_cmpeq_epi32(s,dbcB_mm256_set1_epi32(0)),dbcB_mm256_cmpeq_epi32(d,dbcB_mm256_set1_epi32(0)));
+    ret=dbcB_mm256_andnot_si256(m,ret);
+    ret=dbcB_mm256_blendv_epi8(ret,d,dbcB_mm256_cmpeq_epi32(s,dbcB_mm256_set1_epi32(-1)));
+    return ret;
+}
+
+/* Alpha-blends 8 pixels, gamma-corrected, with modulation. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_bgam_fma(dbcb_i32x8 s,dbcb_i32x8 d,const float *color)
+{
+    dbcb_i32x8 ret;
+    dbcb_f32x8 S0,S1,S2,SA,D0,D1,D2,DA,C;
+    if(color[3]==0.0f) return d;
+    if(dbcB_all_eq_256(s,  0,0x88888888u)) return d;
+    dbcB_setup256_planar(1);
+    C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),SA);
+    D0=dbcB_mm256_fmadd_ps(SA,S0,dbcB_mm256_mul_ps(C,D0));
+    D1=dbcB_mm256_fmadd_ps(SA,S1,dbcB_mm256_mul_ps(C,D1));
+    D2=dbcB_mm256_fmadd_ps(SA,S2,dbcB_mm256_mul_ps(C,D2));
+    DA=dbcB_mm256_fmadd_ps(C,DA,SA);
+    dbcB_output256_planar(1);
+    ret=dbcB_mm256_blendv_epi8(ret,d,dbcB_mm256_cmpeq_epi32(dbcB_mm256_srli_epi32(s,24),dbcB_mm256_set1_epi32(0)));
+    return ret;
+}
+
+/* Alpha-blends (PMA) 8 pixels, gamma-corrected, with modulation. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_bgpm_fma(dbcb_i32x8 s,dbcb_i32x8 d,const float *color)
+{
+    dbcb_i32x8 ret;
+    dbcb_f32x8 S0,S1,S2,SA,D0,D1,D2,DA,C;
+    if(dbcB_all_eq_256(s,  0,0xFFFFFFFFu)) return d;
+    dbcB_setup256_planar(1);
+    C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),SA);
+    D0=dbcB_mm256_fmadd_ps(C,D0,S0);
+    D1=dbcB_mm256_fmadd_ps(C,D1,S1);
+    D2=dbcB_mm256_fmadd_ps(C,D2,S2);
+    DA=dbcB_mm256_fmadd_ps(C,DA,SA);
+    dbcB_output256_planar(1);
+    ret=dbcB_mm256_blendv_epi8(ret,d,dbcB_mm256_cmpeq_epi32(s,dbcB_mm256_set1_epi32(0)));
+    return ret;
+}
+
+/* Multiplies 8 pixels, gamma-corrected, with modulation. */
+DBCB_DECL_FMA static dbcb_i32x8 dbcB_bgxm_fma(dbcb_i32x8 s,dbcb_i32x8 d,const float *color)
+{
+    dbcb_i32x8 ret,m;
+    dbcb_f32x8 S0,S1,S2,SA,D0,D1,D2,DA;
+    dbcB_setup256_planar(1);
+    D0=dbcB_mm256_mul_ps(S0,D0);
+    D1=dbcB_mm256_mul_ps(S1,D1);
+    D2=dbcB_mm256_mul_ps(S2,D2);
+    DA=dbcB_mm256_mul_ps(SA,DA);
+    dbcB_output256_planar(1);
+    m=dbcB_mm256_or_si256(dbcB_mm256_cmpeq_epi32(s,dbcB_mm256_set1_epi32(0)),dbcB_mm256_cmpeq_epi32(d,dbcB_mm256_set1_epi32(0)));
+    ret=dbcB_mm256_andnot_si256(m,ret);
+    return ret;
+}
+
+#undef dbcB_channel256
+#undef dbcB_setup256_planar
+#undef dbcB_clamp01_256
+#undef dbcB_output256_planar
+
+/*
+    Blits 1, 2, 4, and 8 pixels with the above. Bytes past the loaded
+    pixels are 0, so opaque/white early-outs only test the loaded ones
+    (byte mask 'lanes', as in movemask).
+*/
+#define DBCB_DEF_BG_FMA(name,n,bits)\
+DBCB_DECL_FMA static void dbcB_##name##_##n##_fma(const dbcb_uint8 *src,dbcb_uint8 *dst)\
+{\
+    dbcb_store256_##bits(dbcB_##name##_fma(dbcb_load256_##bits(src),dbcb_load256_##bits(dst),\
+        (n)==8?0xFFFFFFFFu:(1u<<(4*(n)))-1u),dst);\
+    DBCB_ZEROUPPER();\
+}
+
+#define DBCB_DEF_BGM_FMA(name,n,bits)\
+DBCB_DECL_FMA static void dbcB_##name##_##n##_fma(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_store256_##bits(dbcB_##name##_fma(dbcb_load256_##bits(src),dbcb_load256_##bits(dst),color),dst);\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_BG_FMA (bga ,1, 32) DBCB_DEF_BG_FMA (bga ,2, 64) DBCB_DEF_BG_FMA (bga ,4,128) DBCB_DEF_BG_FMA (bga ,8,256)
+DBCB_DEF_BG_FMA (bgp ,1, 32) DBCB_DEF_BG_FMA (bgp ,2, 64) DBCB_DEF_BG_FMA (bgp ,4,128) DBCB_DEF_BG_FMA (bgp ,8,256)
+DBCB_DEF_BG_FMA (bgx ,1, 32) DBCB_DEF_BG_FMA (bgx ,2, 64) DBCB_DEF_BG_FMA (bgx ,4,128) DBCB_DEF_BG_FMA (bgx ,8,256)
+DBCB_DEF_BGM_FMA(bgam,1, 32) DBCB_DEF_BGM_FMA(bgam,2, 64) DBCB_DEF_BGM_FMA(bgam,4,128) DBCB_DEF_BGM_FMA(bgam,8,256)
+DBCB_DEF_BGM_FMA(bgpm,1, 32) DBCB_DEF_BGM_FMA(bgpm,2, 64) DBCB_DEF_BGM_FMA(bgpm,4,128) DBCB_DEF_BGM_FMA(bgpm,8,256)
+DBCB_DEF_BGM_FMA(bgxm,1, 32) DBCB_DEF_BGM_FMA(bgxm,2, 64) DBCB_DEF_BGM_FMA(bgxm,4,128) DBCB_DEF_BGM_FMA(bgxm,8,256)
+
+#undef DBCB_DEF_BG_FMA
+#undef DBCB_DEF_BGM_FMA
+#endif /* DBCB_GAMMA_FMA */
+
 #else
 DBCB_DECL_AVX2 static void dbcB_bga_1_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst) {dbcB_bga_1_c(src,dst);}
 DBCB_DECL_AVX2 static void dbcB_bgp_1_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst) {dbcB_bgp_1_c(src,dst);}
@@ -3993,7 +6495,211 @@ DBCB_DECL_AVX2 static void dbcB_b32g_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *ds
 DBCB_DECL_AVX2 static void dbcB_bgam_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bgam_1_avx2(src  ,dst  ,color);dbcB_bgam_1_avx2(src+4,dst+4,color);}
 DBCB_DECL_AVX2 static void dbcB_bgpm_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bgpm_1_avx2(src  ,dst  ,color);dbcB_bgpm_1_avx2(src+4,dst+4,color);}
 DBCB_DECL_AVX2 static void dbcB_bgxm_2_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bgxm_1_avx2(src  ,dst  ,color);dbcB_bgxm_1_avx2(src+4,dst+4,color);}
+DBCB_DECL_AVX2 static void dbcB_b32g_2g_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_b32g_1_avx2(src  ,dst  ,color);dbcB_b32g_1_avx2(src+4,dst+4,color+4);}
+DBCB_DECL_AVX2 static void dbcB_bgam_2g_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bgam_1_avx2(src  ,dst  ,color);dbcB_bgam_1_avx2(src+4,dst+4,color+4);}
+DBCB_DECL_AVX2 static void dbcB_bgpm_2g_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bgpm_1_avx2(src  ,dst  ,color);dbcB_bgpm_1_avx2(src+4,dst+4,color+4);}
+DBCB_DECL_AVX2 static void dbcB_bgxm_2g_avx2(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bgxm_1_avx2(src  ,dst  ,color);dbcB_bgxm_1_avx2(src+4,dst+4,color+4);}
+#endif /* DBC_BLIT_GAMMA_NO_TABLES */
+
+/*
+    Half-float modes (need F16C). Each function processes 2 pixels,
+    which matches the gggl gggl layout of the gamma-corrected functions.
+*/
+
+#if defined(DBC_BLIT_DATA_BIG_ENDIAN)
+/* dbcb_load256_*() swap 32-bit values, so swap 16-bit halves back. */
+#define dbcB_swap16x2_256(v) dbcB_mm256_or_si256(dbcB_mm256_slli_epi32(v,16),dbcB_mm256_srli_epi32(v,16))
+#else
+#define dbcB_swap16x2_256(v) (v)
+#endif
+
+/* Loads 2 RGBA16F pixels. */
+DBCB_DECL_F16C static dbcb_f32x8 dbcB_load_half_f16c(const dbcb_uint8 *p)
+{
+    return dbcB_mm256_cvtph_ps(dbcB_swap16x2_256(dbcb_load256_128(p)));
+}
+
+/* Stores 2 RGBA16F pixels. */
+DBCB_DECL_F16C static void dbcB_store_half_f16c(dbcb_f32x8 v,dbcb_uint8 *p)
+{
+    dbcb_i32x8 h=dbcB_mm256_cvtps_ph(v);
+    dbcb_store256_128(dbcB_swap16x2_256(h),p);
+}
+
+/* Decodes 2 sRGB pixels into linear floats. */
+DBCB_DECL_F16C static dbcb_f32x8 dbcB_load_srgb_f16c(const dbcb_uint8 *p)
+{
+#ifdef DBC_BLIT_GAMMA_NO_TABLES
+    dbcb_i32x8 s=dbcb_load256_64(p);
+    s=dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0));
+    s=dbcB_mm256_permute4x64_epi64(s,0xD8);
+    s=dbcB_mm256_unpacklo_epi8(s,dbcB_mm256_set1_epi16(0));
+    return dbcB_srgb2linear_ggglgggl_avx2(s);
+#else
+    dbcb_uint32 S0=dbcb_load32(p),S1=dbcb_load32(p+4);
+    return dbcB_mm256_setr_ps(
+        (float)dbcB_srgb2linear(dbcB_getb(S0,0)),
+        (float)dbcB_srgb2linear(dbcB_getb(S0,1)),
+        (float)dbcB_srgb2linear(dbcB_getb(S0,2)),
+        dbcB_byte2float(dbcB_getb(S0,3))*DBCB_1div255f,
+        (float)dbcB_srgb2linear(dbcB_getb(S1,0)),
+        (float)dbcB_srgb2linear(dbcB_getb(S1,1)),
+        (float)dbcB_srgb2linear(dbcB_getb(S1,2)),
+        dbcB_byte2float(dbcB_getb(S1,3))*DBCB_1div255f);
+#endif
+}
+
+/* Alpha-blends 2 pixels into half-float. */
+DBCB_DECL_F16C static void dbcB_bha_2_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst)
+{
+    if((dbcb_load32(src)|dbcb_load32(src+4))>0x00FFFFFFu)
+    {
+        dbcb_f32x8 S,D,A,C;
+        S=dbcB_load_srgb_f16c(src);
+        D=dbcB_load_half_f16c(dst);
+        A=dbcB_mm256_shuffle_ps(S,S,0xFF);
+        C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),A);
+        S=dbcB_mm256_blend_ps(dbcB_mm256_set1_ps(1.0f),S,0x77);
+        D=dbcB_mm256_add_ps(dbcB_mm256_mul_ps(A,S),dbcB_mm256_mul_ps(C,D));
+        dbcB_store_half_f16c(D,dst);
+    }
+    DBCB_ZEROUPPER();
+}
+
+/*
+    2-pixel functions with modulation. With g=0 both pixels are modulated
+    by color, with g=1 (dbcB_*_2g_f16c(), for gradients) the second pixel
+    is modulated by color+4.
+*/
+#define dbcB_color256_f16c(color,g) ((g)?dbcB_mm256_loadu_ps(color):dbcB_broadcast256_128f(color))
+
+/* Alpha-blends 2 pixels into half-float, with modulation. */
+#define DBCB_DEF_BHAM_2_F16C(name,g)\
+DBCB_DECL_F16C static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    if((dbcb_load32(src)|dbcb_load32(src+4))>0x00FFFFFFu&&(color[3]!=0.0f||color[3+4*g]!=0.0f))\
+    {\
+        dbcb_f32x8 S,D,A,C;\
+        S=dbcB_load_srgb_f16c(src);\
+        D=dbcB_load_half_f16c(dst);\
+        S=dbcB_mm256_mul_ps(S,dbcB_color256_f16c(color,g));\
+        A=dbcB_mm256_shuffle_ps(S,S,0xFF);\
+        C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),A);\
+        S=dbcB_mm256_blend_ps(dbcB_mm256_set1_ps(1.0f),S,0x77);\
+        D=dbcB_mm256_add_ps(dbcB_mm256_mul_ps(A,S),dbcB_mm256_mul_ps(C,D));\
+        dbcB_store_half_f16c(D,dst);\
+    }\
+    DBCB_ZEROUPPER();\
+}
+
+/* Alpha-blends (PMA) 2 pixels into half-float. */
+DBCB_DECL_F16C static void dbcB_bhp_2_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst)
+{
+    if((dbcb_load32(src)|dbcb_load32(src+4))>0u)
+    {
+        dbcb_f32x8 S,D,C;
+        S=dbcB_load_srgb_f16c(src);
+        D=dbcB_load_half_f16c(dst);
+        C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),dbcB_mm256_shuffle_ps(S,S,0xFF));
+        D=dbcB_mm256_add_ps(S,dbcB_mm256_mul_ps(C,D));
+        dbcB_store_half_f16c(D,dst);
+    }
+    DBCB_ZEROUPPER();
+}
+
+/* Alpha-blends (PMA) 2 pixels into half-float, with modulation. */
+#define DBCB_DEF_BHPM_2_F16C(name,g)\
+DBCB_DECL_F16C static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    if((dbcb_load32(src)|dbcb_load32(src+4))>0u)\
+    {\
+        dbcb_f32x8 S,D,C;\
+        S=dbcB_load_srgb_f16c(src);\
+        D=dbcB_load_half_f16c(dst);\
+        S=dbcB_mm256_mul_ps(S,dbcB_color256_f16c(color,g));\
+        C=dbcB_mm256_sub_ps(dbcB_mm256_set1_ps(1.0f),dbcB_mm256_shuffle_ps(S,S,0xFF));\
+        D=dbcB_mm256_add_ps(S,dbcB_mm256_mul_ps(C,D));\
+        dbcB_store_half_f16c(D,dst);\
+    }\
+    DBCB_ZEROUPPER();\
+}
+
+/* Multiplies 2 pixels into half-float. */
+DBCB_DECL_F16C static void dbcB_bhx_2_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst)
+{
+    dbcb_f32x8 S=dbcB_load_srgb_f16c(src);
+    dbcb_f32x8 D=dbcB_load_half_f16c(dst);
+    dbcB_store_half_f16c(dbcB_mm256_mul_ps(S,D),dst);
+    DBCB_ZEROUPPER();
+}
+
+/* Multiplies 2 pixels into half-float, with modulation. */
+#define DBCB_DEF_BHXM_2_F16C(name,g)\
+DBCB_DECL_F16C static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_f32x8 S=dbcB_load_srgb_f16c(src);\
+    dbcb_f32x8 D=dbcB_load_half_f16c(dst);\
+    S=dbcB_mm256_mul_ps(S,dbcB_color256_f16c(color,g));\
+    dbcB_store_half_f16c(dbcB_mm256_mul_ps(S,D),dst);\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_BHAM_2_F16C(dbcB_bham_2_f16c ,0)
+DBCB_DEF_BHAM_2_F16C(dbcB_bham_2g_f16c,1)
+DBCB_DEF_BHPM_2_F16C(dbcB_bhpm_2_f16c ,0)
+DBCB_DEF_BHPM_2_F16C(dbcB_bhpm_2g_f16c,1)
+DBCB_DEF_BHXM_2_F16C(dbcB_bhxm_2_f16c ,0)
+DBCB_DEF_BHXM_2_F16C(dbcB_bhxm_2g_f16c,1)
+
+#undef DBCB_DEF_BHAM_2_F16C
+#undef DBCB_DEF_BHPM_2_F16C
+#undef DBCB_DEF_BHXM_2_F16C
+
+#ifdef DBC_BLIT_GAMMA_NO_TABLES
+/* Resolves 2 half-float pixels into sRGB. */
+DBCB_DECL_F16C static void dbcB_bhr_2_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst)
+{
+    dbcb_i32x8 ret;
+    dbcb_f32x8 D=dbcB_load_half_f16c(src);
+    D=dbcB_mm256_min_ps(dbcB_mm256_max_ps(D,dbcB_mm256_set1_ps(0.0f)),dbcB_mm256_set1_ps(1.0f));
+    ret=dbcB_linear2srgb_ggglgggl_avx2(D);
+    ret=dbcB_mm256_packus_epi16(ret,ret);
+    ret=dbcB_mm256_permute4x64_epi64(ret,0xD8);
+    ret=dbcB_mm256_packus_epi16(ret,ret);
+    dbcb_store256_64(ret,dst);
+    DBCB_ZEROUPPER();
+}
+
+/* Resolves 2 half-float pixels into sRGB, with modulation. */
+#define DBCB_DEF_BHRM_2_F16C(name,g)\
+DBCB_DECL_F16C static void name(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color)\
+{\
+    dbcb_i32x8 ret;\
+    dbcb_f32x8 D=dbcB_load_half_f16c(src);\
+    D=dbcB_mm256_mul_ps(dbcB_color256_f16c(color,g),D);\
+    D=dbcB_mm256_min_ps(dbcB_mm256_max_ps(D,dbcB_mm256_set1_ps(0.0f)),dbcB_mm256_set1_ps(1.0f));\
+    ret=dbcB_linear2srgb_ggglgggl_avx2(D);\
+    ret=dbcB_mm256_packus_epi16(ret,ret);\
+    ret=dbcB_mm256_permute4x64_epi64(ret,0xD8);\
+    ret=dbcB_mm256_packus_epi16(ret,ret);\
+    dbcb_store256_64(ret,dst);\
+    DBCB_ZEROUPPER();\
+}
+
+DBCB_DEF_BHRM_2_F16C(dbcB_bhrm_2_f16c ,0)
+DBCB_DEF_BHRM_2_F16C(dbcB_bhrm_2g_f16c,1)
+
+#undef DBCB_DEF_BHRM_2_F16C
+#else
+/* With tables linear -> sRGB is scalar anyway. */
+DBCB_DECL_F16C static void dbcB_bhr_2_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst) {dbcB_bhr_2_c(src,dst);}
+DBCB_DECL_F16C static void dbcB_bhrm_2_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bhrm_1_c(src,dst,color);dbcB_bhrm_1_c(src+8,dst+4,color);}
+DBCB_DECL_F16C static void dbcB_bhrm_2g_f16c(const dbcb_uint8 *src,dbcb_uint8 *dst,const float *color) {dbcB_bhrm_1_c(src,dst,color);dbcB_bhrm_1_c(src+8,dst+4,color+4);}
 #endif /* DBC_BLIT_GAMMA_NO_TABLES */
+
+#undef dbcB_swap16x2_256
+#undef dbcB_color256_f16c
+
 #endif /* DBC_BLIT_NO_GAMMA */
 
 #endif /* DBC_BLIT_NO_AVX2 */
@@ -4013,18 +6719,20 @@ static void name(                                                      \
     dbcb_int32 x,dbcb_int32 y,                                         \
     const float *color)
 
-#define DBCB_FN_HEADER(pixel_size,mode,modulated) \
+#define DBCB_FN_HEADER2(src_pixel_size,dst_pixel_size,mode,modulated) \
     dbcb_int32 w=x1-x0,h=y1-y0;                                        \
     dbcb_int32 iy=0;                                                   \
-    const dbcb_uint8 *src=src_pixels+y0*src_stride+x0*pixel_size;      \
-    dbcb_uint8 *dst=dst_pixels+(y0+y)*dst_stride+(x0+x)*pixel_size;    \
+    const dbcb_uint8 *src=src_pixels+y0*src_stride+x0*src_pixel_size;  \
+    dbcb_uint8 *dst=dst_pixels+(y0+y)*dst_stride+(x0+x)*dst_pixel_size;\
     dbcb_uint8 key8=0;                                                 \
     dbcb_uint16 key16=0;                                               \
+    dbcb_uint16 mul16[4]={0,0,0,0};                                    \
     dbcb_int32 unroll_max=(dbcb_unroll_limit_for_mode(mode,modulated));\
     (void)color;                                                       \
     (void)mode;                                                        \
     (void)key8;                                                        \
     (void)key16;                                                       \
+    (void)mul16;                                                       \
     (void)unroll_max;                                                  \
     if(color&&color[0]>=0.0f&&color[0]<=65535.0f)                      \
     {                                                                  \
@@ -4032,8 +6740,13 @@ static void name(                                                      \
         key8=(dbcb_uint8)key16;                                        \
         if(mode==DBCB_MODE_ALPHATEST&&(float)key8!=color[0]) ++key8;   \
     }                                                                  \
+    /* Only the color01 path uses it; other colors would overflow. */  \
+    if(color&&mode==DBCB_MODE_COPY&&dbcB_color_in_0_1(color))          \
+        dbcB_color2mul16(color,mul16);                                 \
     if(w<=0||h<=0) return;
 
+#define DBCB_FN_HEADER(pixel_size,mode,modulated) DBCB_FN_HEADER2(pixel_size,pixel_size,mode,modulated)
+
 #define DBCB_FN_SWITCH0_CASE(pixel_size,i)\
             case  i: for(;iy<h;++iy) {dbcb_memcpy(dst,src,(dbcb_uint32)( i*(pixel_size)));src+=src_stride;dst+=dst_stride;} return;\
 
@@ -4327,8 +7040,31 @@ static void name(                                                      \
         DBCB_FN_LOOP_BOTTOM                                           \
     }
 
+/* For modes with different src and dst pixel sizes. No unrolling. */
+#define DBCB_DEF_FN_H(name,mode,modulated,src_pixel_size,dst_pixel_size,blit1,blit2) \
+    DBCB_FN_SIG(name)                                                 \
+    {                                                                 \
+        DBCB_FN_HEADER2(src_pixel_size,dst_pixel_size,mode,modulated) \
+        for(;iy<h;++iy)                                               \
+        {                                                             \
+            const dbcb_uint8 *s=src;                                  \
+            dbcb_uint8 *d=dst;                                        \
+            dbcb_int32 ix=0;                                          \
+            for(;ix<(w>>1);++ix)                                      \
+            {                                                         \
+                blit2;                                                \
+                s+=2*(src_pixel_size);                                \
+                d+=2*(dst_pixel_size);                                \
+            }                                                         \
+            if(w&1) blit1;                                            \
+            src+=src_stride;                                          \
+            dst+=dst_stride;                                          \
+        }                                                             \
+    }
+
 DBCB_DEF_FN_0 (dbcB_f32_c   ,DBCB_MODE_COPY      ,0, 4)
 DBCB_DEF_FN_1 (dbcB_f32m_c  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32m_1_c(s,d,color)))
+DBCB_DEF_FN_1 (dbcB_f32k_c  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32k_1_c(s,d,mul16)))
 DBCB_DEF_FN_4 (dbcB_fla_c   ,DBCB_MODE_ALPHA     ,0, 4,(dbcB_bla_1_c(s,d)),(dbcB_bla_2_c(s,d)),(dbcB_bla_4_c(s,d)))
 DBCB_DEF_FN_1 (dbcB_flam_c  ,DBCB_MODE_ALPHA     ,1, 4,(dbcB_blam_1_c(s,d,color)))
 DBCB_DEF_FN_4 (dbcB_flp_c   ,DBCB_MODE_PMA       ,0, 4,(dbcB_blp_1_c(s,d)),(dbcB_blp_2_c(s,d)),(dbcB_blp_4_c(s,d)))
@@ -4352,12 +7088,21 @@ DBCB_DEF_FN_4 (dbcB_fgp_c   ,DBCB_MODE_PMG       ,0, 4,(dbcB_bgp_1_c(s,d)),(dbcB
 DBCB_DEF_FN_1 (dbcB_fgpm_c  ,DBCB_MODE_PMG       ,1, 4,(dbcB_bgpm_1_c(s,d,color)))
 DBCB_DEF_FN_4 (dbcB_fgx_c   ,DBCB_MODE_MUG       ,0, 4,(dbcB_bgx_1_c(s,d)),(dbcB_bgx_2_c(s,d)),(dbcB_bgx_4_c(s,d)))
 DBCB_DEF_FN_1 (dbcB_fgxm_c  ,DBCB_MODE_MUG       ,1, 4,(dbcB_bgxm_1_c(s,d,color)))
+DBCB_DEF_FN_H (dbcB_fha_c   ,DBCB_MODE_HALF_ALPHA  ,0,4,8,(dbcB_bha_1_c(s,d)),(dbcB_bha_2_c(s,d)))
+DBCB_DEF_FN_H (dbcB_fham_c  ,DBCB_MODE_HALF_ALPHA  ,1,4,8,(dbcB_bham_1_c(s,d,color)),(dbcB_bham_1_c(s,d,color),dbcB_bham_1_c(s+4,d+8,color)))
+DBCB_DEF_FN_H (dbcB_fhp_c   ,DBCB_MODE_HALF_PMA    ,0,4,8,(dbcB_bhp_1_c(s,d)),(dbcB_bhp_2_c(s,d)))
+DBCB_DEF_FN_H (dbcB_fhpm_c  ,DBCB_MODE_HALF_PMA    ,1,4,8,(dbcB_bhpm_1_c(s,d,color)),(dbcB_bhpm_1_c(s,d,color),dbcB_bhpm_1_c(s+4,d+8,color)))
+DBCB_DEF_FN_H (dbcB_fhx_c   ,DBCB_MODE_HALF_MUL    ,0,4,8,(dbcB_bhx_1_c(s,d)),(dbcB_bhx_2_c(s,d)))
+DBCB_DEF_FN_H (dbcB_fhxm_c  ,DBCB_MODE_HALF_MUL    ,1,4,8,(dbcB_bhxm_1_c(s,d,color)),(dbcB_bhxm_1_c(s,d,color),dbcB_bhxm_1_c(s+4,d+8,color)))
+DBCB_DEF_FN_H (dbcB_fhr_c   ,DBCB_MODE_HALF_RESOLVE,0,8,4,(dbcB_bhr_1_c(s,d)),(dbcB_bhr_2_c(s,d)))
+DBCB_DEF_FN_H (dbcB_fhrm_c  ,DBCB_MODE_HALF_RESOLVE,1,8,4,(dbcB_bhrm_1_c(s,d,color)),(dbcB_bhrm_1_c(s,d,color),dbcB_bhrm_1_c(s+8,d+4,color)))
 #endif /* DBC_BLIT_NO_GAMMA */
 
 #ifndef DBC_BLIT_NO_SIMD
 #ifdef DBCB_X86_OR_X64
 DBCB_DECL_SSE2 DBCB_DEF_FN_0 (dbcB_f32_sse2   ,DBCB_MODE_COPY      ,0, 4)
 DBCB_DECL_SSE2 DBCB_DEF_FN_1 (dbcB_f32m_sse2  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32m_1_sse2(s,d,color)))
+DBCB_DECL_SSE2 DBCB_DEF_FN_4 (dbcB_f32k_sse2  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32k_1_sse2(s,d,mul16)),(dbcB_b32k_2_sse2(s,d,mul16)),(dbcB_b32k_4_sse2(s,d,mul16)))
 DBCB_DECL_SSE2 DBCB_DEF_FN_4 (dbcB_fla_sse2   ,DBCB_MODE_ALPHA     ,0, 4,(dbcB_bla_1_sse2(s,d)),(dbcB_bla_2_sse2(s,d)),(dbcB_bla_4_sse2(s,d)))
 DBCB_DECL_SSE2 DBCB_DEF_FN_1 (dbcB_flam_sse2  ,DBCB_MODE_ALPHA     ,1, 4,(dbcB_blam_1_sse2(s,d,color)))
 DBCB_DECL_SSE2 DBCB_DEF_FN_4 (dbcB_flp_sse2   ,DBCB_MODE_PMA       ,0, 4,(dbcB_blp_1_sse2(s,d)),(dbcB_blp_2_sse2(s,d)),(dbcB_blp_4_sse2(s,d)))
@@ -4383,20 +7128,48 @@ DBCB_DECL_SSE2 DBCB_DEF_FN_1 (dbcB_fgx_sse2   ,DBCB_MODE_MUG       ,0, 4,(dbcB_b
 DBCB_DECL_SSE2 DBCB_DEF_FN_1 (dbcB_fgxm_sse2  ,DBCB_MODE_MUG       ,1, 4,(dbcB_bgxm_1_sse2(s,d,color)))
 #endif /* DBC_BLIT_NO_GAMMA */
 
+#ifndef DBC_BLIT_NO_SSE41
+DBCB_DECL_SSE41 DBCB_DEF_FN_4 (dbcB_fla_sse41  ,DBCB_MODE_ALPHA     ,0, 4,(dbcB_bla_1_sse41(s,d)),(dbcB_bla_2_sse41(s,d)),(dbcB_bla_4_sse41(s,d)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_4 (dbcB_flp_sse41  ,DBCB_MODE_PMA       ,0, 4,(dbcB_blp_1_sse41(s,d)),(dbcB_blp_2_sse41(s,d)),(dbcB_blp_4_sse41(s,d)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_16(dbcB_f8m_sse41  ,DBCB_MODE_COLORKEY8 ,1, 1,(dbcB_b8m_1_c(s,d,key8)),(dbcB_b8m_2_c(s,d,key8)),(dbcB_b8m_4_sse41(s,d,key8)),(dbcB_b8m_8_sse41(s,d,key8)),(dbcB_b8m_16_sse41(s,d,key8)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_8 (dbcB_f16m_sse41 ,DBCB_MODE_COLORKEY16,1, 2,(dbcB_b16m_1_c(s,d,key16)),(dbcB_b16m_2_sse41(s,d,key16)),(dbcB_b16m_4_sse41(s,d,key16)),(dbcB_b16m_8_sse41(s,d,key16)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_8 (dbcB_f5551_sse41,DBCB_MODE_5551      ,0, 2,(dbcB_b5551_1_c(s,d)),(dbcB_b5551_2_sse41(s,d)),(dbcB_b5551_4_sse41(s,d)),(dbcB_b5551_8_sse41(s,d)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_4 (dbcB_flx_sse41  ,DBCB_MODE_MUL       ,0, 4,(dbcB_blx_1_sse41(s,d)),(dbcB_blx_2_sse41(s,d)),(dbcB_blx_4_sse41(s,d)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_4 (dbcB_f32t_sse41 ,DBCB_MODE_ALPHATEST ,1, 4,(dbcB_b32t_1_c(s,d,key8)),(dbcB_b32t_2_sse41(s,d,key8)),(dbcB_b32t_4_sse41(s,d,key8)))
+DBCB_DECL_SSE41 DBCB_DEF_FN_4 (dbcB_f32s_sse41 ,DBCB_MODE_ALPHATEST ,1, 4,(dbcB_b32s_1_c(s,d)),(dbcB_b32s_2_sse41(s,d)),(dbcB_b32s_4_sse41(s,d)))
+
+/* Whether mode has SSE4.1 version (otherwise SSE2 one is used). */
+static int dbcB_sse41_mode(int mode,int modulated)
+{
+    switch(mode)
+    {
+        case DBCB_MODE_ALPHA:
+        case DBCB_MODE_PMA:
+        case DBCB_MODE_MUL:        return !modulated;
+        case DBCB_MODE_COLORKEY8:
+        case DBCB_MODE_COLORKEY16:
+        case DBCB_MODE_ALPHATEST:  return modulated;
+        case DBCB_MODE_5551:       return 1;
+    }
+    return 0;
+}
+#endif /* DBC_BLIT_NO_SSE41 */
+
 #ifndef DBC_BLIT_NO_AVX2
 DBCB_DECL_AVX2 DBCB_DEF_FN_0 (dbcB_f32_avx2   ,DBCB_MODE_COPY      ,0, 4)
-DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_f32m_avx2  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32m_1_avx2(s,d,color)),(dbcB_b32m_2_avx2(s,d,color)))
+DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_f32m_avx2  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32m_1_avx2(s,d,color)),(dbcB_b32m_2_avx2(s,d,color)),(dbcB_b32m_4_avx2(s,d,color)),(dbcB_b32m_8_avx2(s,d,color)))
+DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_f32k_avx2  ,DBCB_MODE_COPY      ,1, 4,(dbcB_b32k_1_avx2(s,d,mul16)),(dbcB_b32k_2_avx2(s,d,mul16)),(dbcB_b32k_4_avx2(s,d,mul16)),(dbcB_b32k_8_avx2(s,d,mul16)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_fla_avx2   ,DBCB_MODE_ALPHA     ,0, 4,(dbcB_bla_1_avx2(s,d)),(dbcB_bla_2_avx2(s,d)),(dbcB_bla_4_avx2(s,d)),(dbcB_bla_8_avx2(s,d)))
-DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_flam_avx2  ,DBCB_MODE_ALPHA     ,1, 4,(dbcB_blam_1_avx2(s,d,color)),(dbcB_blam_2_avx2(s,d,color)))
+DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_flam_avx2  ,DBCB_MODE_ALPHA     ,1, 4,(dbcB_blam_1_avx2(s,d,color)),(dbcB_blam_2_avx2(s,d,color)),(dbcB_blam_4_avx2(s,d,color)),(dbcB_blam_8_avx2(s,d,color)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_flp_avx2   ,DBCB_MODE_PMA       ,0, 4,(dbcB_blp_1_avx2(s,d)),(dbcB_blp_2_avx2(s,d)),(dbcB_blp_4_avx2(s,d)),(dbcB_blp_8_avx2(s,d)))
-DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_flpm_avx2  ,DBCB_MODE_PMA       ,1, 4,(dbcB_blpm_1_avx2(s,d,color)),(dbcB_blpm_2_avx2(s,d,color)))
+DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_flpm_avx2  ,DBCB_MODE_PMA       ,1, 4,(dbcB_blpm_1_avx2(s,d,color)),(dbcB_blpm_2_avx2(s,d,color)),(dbcB_blpm_4_avx2(s,d,color)),(dbcB_blpm_8_avx2(s,d,color)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_0 (dbcB_f8_avx2    ,DBCB_MODE_COLORKEY8 ,0, 1)
 DBCB_DECL_AVX2 DBCB_DEF_FN_32(dbcB_f8m_avx2   ,DBCB_MODE_COLORKEY8 ,1, 1,(dbcB_b8m_1_c(s,d,key8)),(dbcB_b8m_2_c(s,d,key8)),(dbcB_b8m_4_avx2(s,d,key8)),(dbcB_b8m_8_avx2(s,d,key8)),(dbcB_b8m_16_avx2(s,d,key8)),(dbcB_b8m_32_avx2(s,d,key8)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_0 (dbcB_f16_avx2   ,DBCB_MODE_COLORKEY16,0, 2)
 DBCB_DECL_AVX2 DBCB_DEF_FN_16(dbcB_f16m_avx2  ,DBCB_MODE_COLORKEY16,1, 2,(dbcB_b16m_1_c(s,d,key16)),(dbcB_b16m_2_avx2(s,d,key16)),(dbcB_b16m_4_avx2(s,d,key16)),(dbcB_b16m_8_avx2(s,d,key16)),(dbcB_b16m_16_avx2(s,d,key16)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_16(dbcB_f5551_avx2 ,DBCB_MODE_5551      ,0, 2,(dbcB_b5551_1_c(s,d)),(dbcB_b5551_2_avx2(s,d)),(dbcB_b5551_4_avx2(s,d)),(dbcB_b5551_8_avx2(s,d)),(dbcB_b5551_16_avx2(s,d)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_flx_avx2   ,DBCB_MODE_MUL       ,0, 4,(dbcB_blx_1_avx2(s,d)),(dbcB_blx_2_avx2(s,d)),(dbcB_blx_4_avx2(s,d)),(dbcB_blx_8_avx2(s,d)))
-DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_flxm_avx2  ,DBCB_MODE_MUL       ,1, 4,(dbcB_blxm_1_avx2(s,d,color)),(dbcB_blxm_2_avx2(s,d,color)))
+DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_flxm_avx2  ,DBCB_MODE_MUL       ,1, 4,(dbcB_blxm_1_avx2(s,d,color)),(dbcB_blxm_2_avx2(s,d,color)),(dbcB_blxm_4_avx2(s,d,color)),(dbcB_blxm_8_avx2(s,d,color)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_0 (dbcB_f32a_avx2  ,DBCB_MODE_ALPHATEST ,0, 4)
 DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_f32t_avx2  ,DBCB_MODE_ALPHATEST ,1, 4,(dbcB_b32t_1_c(s,d,key8)),(dbcB_b32t_2_avx2(s,d,key8)),(dbcB_b32t_4_avx2(s,d,key8)),(dbcB_b32t_8_avx2(s,d,key8)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_8 (dbcB_f32s_avx2  ,DBCB_MODE_ALPHATEST ,1, 4,(dbcB_b32s_1_c(s,d)),(dbcB_b32s_2_avx2(s,d)),(dbcB_b32s_4_avx2(s,d)),(dbcB_b32s_8_avx2(s,d)))
@@ -4409,6 +7182,22 @@ DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_fgp_avx2   ,DBCB_MODE_PMG       ,0, 4,(dbcB_b
 DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_fgpm_avx2  ,DBCB_MODE_PMG       ,1, 4,(dbcB_bgpm_1_avx2(s,d,color)),(dbcB_bgpm_2_avx2(s,d,color)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_fgx_avx2   ,DBCB_MODE_MUG       ,0, 4,(dbcB_bgx_1_avx2(s,d)),(dbcB_bgx_2_avx2(s,d)))
 DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_fgxm_avx2  ,DBCB_MODE_MUG       ,1, 4,(dbcB_bgxm_1_avx2(s,d,color)),(dbcB_bgxm_2_avx2(s,d,color)))
+#ifdef DBCB_GAMMA_FMA
+DBCB_DECL_FMA  DBCB_DEF_FN_8 (dbcB_fga_fma    ,DBCB_MODE_GAMMA     ,0, 4,(dbcB_bga_1_fma(s,d)),(dbcB_bga_2_fma(s,d)),(dbcB_bga_4_fma(s,d)),(dbcB_bga_8_fma(s,d)))
+DBCB_DECL_FMA  DBCB_DEF_FN_8 (dbcB_fgam_fma   ,DBCB_MODE_GAMMA     ,1, 4,(dbcB_bgam_1_fma(s,d,color)),(dbcB_bgam_2_fma(s,d,color)),(dbcB_bgam_4_fma(s,d,color)),(dbcB_bgam_8_fma(s,d,color)))
+DBCB_DECL_FMA  DBCB_DEF_FN_8 (dbcB_fgp_fma    ,DBCB_MODE_PMG       ,0, 4,(dbcB_bgp_1_fma(s,d)),(dbcB_bgp_2_fma(s,d)),(dbcB_bgp_4_fma(s,d)),(dbcB_bgp_8_fma(s,d)))
+DBCB_DECL_FMA  DBCB_DEF_FN_8 (dbcB_fgpm_fma   ,DBCB_MODE_PMG       ,1, 4,(dbcB_bgpm_1_fma(s,d,color)),(dbcB_bgpm_2_fma(s,d,color)),(dbcB_bgpm_4_fma(s,d,color)),(dbcB_bgpm_8_fma(s,d,color)))
+DBCB_DECL_FMA  DBCB_DEF_FN_8 (dbcB_fgx_fma    ,DBCB_MODE_MUG       ,0, 4,(dbcB_bgx_1_fma(s,d)),(dbcB_bgx_2_fma(s,d)),(dbcB_bgx_4_fma(s,d)),(dbcB_bgx_8_fma(s,d)))
+DBCB_DECL_FMA  DBCB_DEF_FN_8 (dbcB_fgxm_fma   ,DBCB_MODE_MUG       ,1, 4,(dbcB_bgxm_1_fma(s,d,color)),(dbcB_bgxm_2_fma(s,d,color)),(dbcB_bgxm_4_fma(s,d,color)),(dbcB_bgxm_8_fma(s,d,color)))
+#endif
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fha_f16c   ,DBCB_MODE_HALF_ALPHA  ,0,4,8,(dbcB_bha_1_c(s,d)),(dbcB_bha_2_f16c(s,d)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fham_f16c  ,DBCB_MODE_HALF_ALPHA  ,1,4,8,(dbcB_bham_1_c(s,d,color)),(dbcB_bham_2_f16c(s,d,color)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fhp_f16c   ,DBCB_MODE_HALF_PMA    ,0,4,8,(dbcB_bhp_1_c(s,d)),(dbcB_bhp_2_f16c(s,d)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fhpm_f16c  ,DBCB_MODE_HALF_PMA    ,1,4,8,(dbcB_bhpm_1_c(s,d,color)),(dbcB_bhpm_2_f16c(s,d,color)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fhx_f16c   ,DBCB_MODE_HALF_MUL    ,0,4,8,(dbcB_bhx_1_c(s,d)),(dbcB_bhx_2_f16c(s,d)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fhxm_f16c  ,DBCB_MODE_HALF_MUL    ,1,4,8,(dbcB_bhxm_1_c(s,d,color)),(dbcB_bhxm_2_f16c(s,d,color)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fhr_f16c   ,DBCB_MODE_HALF_RESOLVE,0,8,4,(dbcB_bhr_1_c(s,d)),(dbcB_bhr_2_f16c(s,d)))
+DBCB_DECL_F16C DBCB_DEF_FN_H (dbcB_fhrm_f16c  ,DBCB_MODE_HALF_RESOLVE,1,8,4,(dbcB_bhrm_1_c(s,d,color)),(dbcB_bhrm_2_f16c(s,d,color)))
 #endif /* DBC_BLIT_NO_GAMMA */
 #endif /* DBC_BLIT_NO_AVX2 */
 #endif /* DBCB_X86_OR_X64 */
@@ -4416,6 +7205,7 @@ DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_fgxm_avx2  ,DBCB_MODE_MUG       ,1, 4,(dbcB_b
 
 #undef DBCB_FN_SIG
 #undef DBCB_FN_HEADER
+#undef DBCB_FN_HEADER2
 #undef DBCB_FN_SWITCH0_CASE
 #undef DBCB_FN_SWITCH0
 #undef DBCB_FN_SWITCH_LEFT
@@ -4437,6 +7227,7 @@ DBCB_DECL_AVX2 DBCB_DEF_FN_2 (dbcB_fgxm_avx2  ,DBCB_MODE_MUG       ,1, 4,(dbcB_b
 #undef DBCB_DEF_FN_8
 #undef DBCB_DEF_FN_16
 #undef DBCB_DEF_FN_32
+#undef DBCB_DEF_FN_H
 
 /*============================================================================*/
 /* Initialization */
@@ -4507,6 +7298,7 @@ static void dbcB_cpuid(int level,int sublevel,unsigned *eax,unsigned *ebx,unsign
 #endif
 }
 
+#if !defined(DBC_BLIT_NO_AVX2)
 /* Only return lower 32 bits of xgetbv. */
 static unsigned dbcB_xgetbv(unsigned level)
 {
@@ -4528,6 +7320,7 @@ static unsigned dbcB_xgetbv(unsigned level)
 #endif
     return ret;
 }
+#endif /* !defined(DBC_BLIT_NO_AVX2) */
 #endif /* !defined(DBC_BLIT_NO_SIMD) && !defined(DBC_BLIT_NO_RUNTIME_CPU_DETECTION) && defined(DBCB_X86_OR_X64) && !defined(_WIN16) */
 
 static int dbcB_init()
@@ -4537,9 +7330,18 @@ static int dbcB_init()
 #if defined(__SSE2__) || (_M_IX86_FP>=2) /* MSVC does not have __SSE2__ macro. */
     /* Always enable SSE2 if it is globally enabled. */
     dbcB_has_sse2=1;
+#if !defined(DBC_BLIT_NO_SSE41) && (defined(__SSE4_1__) || defined(__AVX__))
+    dbcB_has_sse41=1;
+#endif
 #if !defined(DBC_BLIT_NO_AVX2) && defined(__AVX2__)
     /* Always enable AVX2 if it is globally enabled. */
     dbcB_has_avx2=1;
+#if defined(__F16C__)
+    dbcB_has_f16c=1;
+#endif
+#if defined(__FMA__)
+    dbcB_has_fma=1;
+#endif
 #endif
 #endif
 #if !defined(DBCB_NO_RUNTIME_CPU_DETECTION) && !defined(_WIN16)
@@ -4564,12 +7366,17 @@ static int dbcB_init()
         {
             dbcB_cpuid(1,0,&eax,&ebx,&ecx,&edx);
             if(edx&0x04000000u) dbcB_has_sse2=1;
+#if !defined(DBC_BLIT_NO_SSE41)
+            if((ecx&0x00080200u)==0x00080200u) dbcB_has_sse41=1; /* SSSE3 & SSE4.1. */
+#endif
 #if !defined(DBC_BLIT_NO_AVX2)
             if(ecx&0x18000000u) /* CPU has AVX & XGETBV. */
             {
                 unsigned xcr0=dbcB_xgetbv(0);
                 if((xcr0&0x6)==0x6) /* OS-level support for AVX. */
                 {
+                    if(ecx&0x20000000u) dbcB_has_f16c=1;
+                    if(ecx&0x00001000u) dbcB_has_fma=1;
                     if(maxlevel>=7)
                     {
                         dbcB_cpuid(7,0,&eax,&ebx,&ecx,&edx);
@@ -4594,27 +7401,70 @@ static int dbcB_init()
 /*============================================================================*/
 /* Blitter API */
 
-DBCB_DEF void dbc_blit(
+#ifdef DBC_BLIT_STATS
+static void dbcB_stats_blit(int mode,int tier,int src_w,int src_h,dbcb_int32 x0,dbcb_int32 y0,dbcb_int32 x1,dbcb_int32 y1)
+{
+    double total=(src_w>0&&src_h>0?(double)src_w*(double)src_h:0.0);
+    double shown=(x1>x0&&y1>y0?(double)(x1-x0)*(double)(y1-y0):0.0);
+    dbcB_stats.clipped[mode]+=total-shown;
+    /* Fully clipped calls never reach a kernel. */
+    if(shown==0.0) return;
+    ++dbcB_stats.calls[mode][tier];
+    dbcB_stats.pixels[mode][tier]+=shown;
+}
+#define DBCB_STATS_BLIT(tier) dbcB_stats_blit(mode,tier,src_w,src_h,x0,y0,x1,y1)
+#else
+#define DBCB_STATS_BLIT(tier) ((void)0)
+#endif
+
+#ifdef DBC_BLIT_AUTOTUNE
+static int dbcB_tune_bucket(dbcb_int32 w)
+{
+    if(w<=8)   return 0;
+    if(w<=32)  return 1;
+    if(w<=128) return 2;
+    return 3;
+}
+#endif
+
+/* Row function, see DBCB_FN_SIG. */
+typedef void (*dbcB_fn)(
+    dbcb_int32 src_stride,const dbcb_uint8 *src_pixels,
+    dbcb_int32 dst_stride,dbcb_uint8 *dst_pixels,
+    dbcb_int32 x0,dbcb_int32 y0,dbcb_int32 x1,dbcb_int32 y1,
+    dbcb_int32 x,dbcb_int32 y,
+    const float *color);
+
+/* Calls fn where mask is non-zero, see Masked blit. */
+static void dbcB_launch_masked(
+    dbcB_fn fn,int mode,int tier,int modulated,const dbcb_mask *mask,
+    dbcb_int32 src_stride,const dbcb_uint8 *src_pixels,
+    dbcb_int32 dst_stride,dbcb_uint8 *dst_pixels,
+    dbcb_int32 x0,dbcb_int32 y0,dbcb_int32 x1,dbcb_int32 y1,
+    dbcb_int32 x,dbcb_int32 y,
+    const float *color);
+
+/*
+    dbc_blit() past initialization and recording. With mask, only blits
+    where it is non-zero (see dbc_blit_masked()), with the same tier and
+    row functions.
+*/
+static void dbcB_blit(
     int src_w,int src_h,int src_stride_in_bytes,
     const unsigned char *src_pixels,
     int dst_w,int dst_h,int dst_stride_in_bytes,
     unsigned char *dst_pixels,
     int x,int y,
     const float *color,
-    int mode)
+    int mode,
+    const dbcb_mask *mask)
 {
-    int modulated=1,alpha128=0;
+    int modulated=1,alpha128=0,color01=0,launch_tier=DBCB_STATS_TIER_C;
     dbcb_int32 x0,y0,x1,y1;
-    static int initialized=
-    /* Better thread-safety for C++. */
-#ifndef __cplusplus
-    0;
-    if(!initialized) initialized=
+#ifdef DBC_BLIT_AUTOTUNE
+    int tier;
 #endif
-    dbcB_init();
-    (void)initialized;
-
-    if(mode<DBCB_MODE_COPY||mode>DBCB_MODE_CPYG) return;
+    if(mode<DBCB_MODE_COPY||mode>DBCB_MODE_HALF_RESOLVE) return;
 
     if(!color) modulated=0;
     else
@@ -4635,7 +7485,11 @@ DBCB_DEF void dbc_blit(
             case DBCB_MODE_PMG:
             case DBCB_MODE_MUL:
             case DBCB_MODE_MUG:
-            case DBCB_MODE_CPYG:       modulated=!(color[0]==1.0f&&color[1]==1.0f&&color[2]==1.0f&&color[3]==1.0f); break;
+            case DBCB_MODE_CPYG:
+            case DBCB_MODE_HALF_ALPHA:
+            case DBCB_MODE_HALF_PMA:
+            case DBCB_MODE_HALF_MUL:
+            case DBCB_MODE_HALF_RESOLVE: modulated=!(color[0]==1.0f&&color[1]==1.0f&&color[2]==1.0f&&color[3]==1.0f); break;
         }
     }
 
@@ -4646,14 +7500,38 @@ DBCB_DEF void dbc_blit(
     if(x+src_w>dst_w) x1=dst_w-x; else x1=src_w;
     if(y<0) y0=-y; else y0=0;
     if(y+src_h>dst_h) y1=dst_h-y; else y1=src_h;
+    if(mask)
+    {
+        /* Mask, in src coordinates. */
+        if(x0<mask->x-x) x0=mask->x-x;
+        if(y0<mask->y-y) y0=mask->y-y;
+        if(x1>mask->x+mask->w-x) x1=mask->x+mask->w-x;
+        if(y1>mask->y+mask->h-y) y1=mask->y+mask->h-y;
+    }
 
     if(!modulated) color=0;
+    else if(mode==DBCB_MODE_COPY) color01=dbcB_color_in_0_1(color);
+
+#ifdef DBC_BLIT_AUTOTUNE
+    tier=(dbcB_tune_force?dbcB_tune_force:dbcB_tune_tier[mode][modulated][dbcB_tune_bucket(x1-x0)]);
+    (void)tier;
+#endif
 
-#define DBCB_LAUNCH(fn) fn(src_stride_in_bytes,src_pixels,dst_stride_in_bytes,dst_pixels,x0,y0,x1,y1,x,y,color)
+#define DBCB_LAUNCH(fn) (mask?\
+    dbcB_launch_masked(fn,mode,launch_tier,modulated,mask,src_stride_in_bytes,src_pixels,dst_stride_in_bytes,dst_pixels,x0,y0,x1,y1,x,y,color):\
+    fn(src_stride_in_bytes,src_pixels,dst_stride_in_bytes,dst_pixels,x0,y0,x1,y1,x,y,color))
+#define DBCB_TRACE_BEGIN(tier) dbcb_trace_begin(mode,(int)(x1>x0?x1-x0:0),(int)(y1>y0?y1-y0:0),tier)
 
 #if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
 #if !defined(DBC_BLIT_NO_AVX2)
-    if(!dbcB_has_avx2||!(dbcb_allow_avx2_for_mode(mode,modulated))) goto no_avx2;
+    if(!DBCB_HAS_AVX2||!(dbcb_allow_avx2_for_mode(mode,modulated))) goto no_avx2;
+    if(mode>=DBCB_MODE_HALF_ALPHA&&!DBCB_HAS_F16C) goto no_avx2;
+#ifdef DBC_BLIT_AUTOTUNE
+    if(tier&&tier<4) goto no_avx2;
+#endif
+    DBCB_STATS_BLIT(DBCB_STATS_TIER_AVX2);
+    DBCB_TRACE_BEGIN(DBCB_STATS_TIER_AVX2);
+    launch_tier=DBCB_STATS_TIER_AVX2;
     if(!modulated)
     {
         switch(mode)
@@ -4668,9 +7546,28 @@ DBCB_DEF void dbc_blit(
             case DBCB_MODE_ALPHATEST:  DBCB_LAUNCH(dbcB_f32a_avx2 ); break;
 #ifndef DBC_BLIT_NO_GAMMA
             case DBCB_MODE_CPYG:       DBCB_LAUNCH(dbcB_f32c_avx2 ); break;
+#ifdef DBCB_GAMMA_FMA
+            case DBCB_MODE_GAMMA:
+                          if(DBCB_HAS_FMA) DBCB_LAUNCH(dbcB_fga_fma );
+                          else             DBCB_LAUNCH(dbcB_fga_avx2 );
+                          break;
+            case DBCB_MODE_PMG:
+                          if(DBCB_HAS_FMA) DBCB_LAUNCH(dbcB_fgp_fma );
+                          else             DBCB_LAUNCH(dbcB_fgp_avx2 );
+                          break;
+            case DBCB_MODE_MUG:
+                          if(DBCB_HAS_FMA) DBCB_LAUNCH(dbcB_fgx_fma );
+                          else             DBCB_LAUNCH(dbcB_fgx_avx2 );
+                          break;
+#else
             case DBCB_MODE_GAMMA:      DBCB_LAUNCH(dbcB_fga_avx2  ); break;
             case DBCB_MODE_PMG:        DBCB_LAUNCH(dbcB_fgp_avx2  ); break;
             case DBCB_MODE_MUG:        DBCB_LAUNCH(dbcB_fgx_avx2  ); break;
+#endif
+            case DBCB_MODE_HALF_ALPHA:   DBCB_LAUNCH(dbcB_fha_f16c ); break;
+            case DBCB_MODE_HALF_PMA:     DBCB_LAUNCH(dbcB_fhp_f16c ); break;
+            case DBCB_MODE_HALF_MUL:     DBCB_LAUNCH(dbcB_fhx_f16c ); break;
+            case DBCB_MODE_HALF_RESOLVE: DBCB_LAUNCH(dbcB_fhr_f16c ); break;
 #endif
         }
     }
@@ -4678,7 +7575,10 @@ DBCB_DEF void dbc_blit(
     {
         switch(mode)
         {
-            case DBCB_MODE_COPY:       DBCB_LAUNCH(dbcB_f32m_avx2 ); break;
+            case DBCB_MODE_COPY:
+                          if(color01) DBCB_LAUNCH(dbcB_f32k_avx2 );
+                          else        DBCB_LAUNCH(dbcB_f32m_avx2 );
+                         break;
             case DBCB_MODE_ALPHA:      DBCB_LAUNCH(dbcB_flam_avx2 ); break;
             case DBCB_MODE_PMA:        DBCB_LAUNCH(dbcB_flpm_avx2 ); break;
             case DBCB_MODE_COLORKEY8:  DBCB_LAUNCH(dbcB_f8m_avx2  ); break;
@@ -4691,17 +7591,82 @@ DBCB_DEF void dbc_blit(
                           break;
 #ifndef DBC_BLIT_NO_GAMMA
             case DBCB_MODE_CPYG:       DBCB_LAUNCH(dbcB_f32g_avx2 ); break;
+#ifdef DBCB_GAMMA_FMA
+            case DBCB_MODE_GAMMA:
+                          if(DBCB_HAS_FMA) DBCB_LAUNCH(dbcB_fgam_fma);
+                          else             DBCB_LAUNCH(dbcB_fgam_avx2);
+                          break;
+            case DBCB_MODE_PMG:
+                          if(DBCB_HAS_FMA) DBCB_LAUNCH(dbcB_fgpm_fma);
+                          else             DBCB_LAUNCH(dbcB_fgpm_avx2);
+                          break;
+            case DBCB_MODE_MUG:
+                          if(DBCB_HAS_FMA) DBCB_LAUNCH(dbcB_fgxm_fma);
+                          else             DBCB_LAUNCH(dbcB_fgxm_avx2);
+                          break;
+#else
             case DBCB_MODE_GAMMA:      DBCB_LAUNCH(dbcB_fgam_avx2 ); break;
             case DBCB_MODE_PMG:        DBCB_LAUNCH(dbcB_fgpm_avx2 ); break;
             case DBCB_MODE_MUG:        DBCB_LAUNCH(dbcB_fgxm_avx2 ); break;
+#endif
+            case DBCB_MODE_HALF_ALPHA:   DBCB_LAUNCH(dbcB_fham_f16c); break;
+            case DBCB_MODE_HALF_PMA:     DBCB_LAUNCH(dbcB_fhpm_f16c); break;
+            case DBCB_MODE_HALF_MUL:     DBCB_LAUNCH(dbcB_fhxm_f16c); break;
+            case DBCB_MODE_HALF_RESOLVE: DBCB_LAUNCH(dbcB_fhrm_f16c); break;
 #endif
         }
     }
+    dbcb_trace_end();
     return;
 no_avx2:
 #endif /* !defined(DBC_BLIT_NO_AVX2) */
+
+#if !defined(DBC_BLIT_NO_SSE41)
+    if(!DBCB_HAS_SSE41||!(dbcb_allow_sse41_for_mode(mode,modulated))) goto no_sse41;
+    if(!dbcB_sse41_mode(mode,modulated)) goto no_sse41;
+#ifdef DBC_BLIT_AUTOTUNE
+    if(tier&&tier<3) goto no_sse41;
+#endif
+    DBCB_STATS_BLIT(DBCB_STATS_TIER_SSE41);
+    DBCB_TRACE_BEGIN(DBCB_STATS_TIER_SSE41);
+    launch_tier=DBCB_STATS_TIER_SSE41;
+    if(!modulated)
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_ALPHA:      DBCB_LAUNCH(dbcB_fla_sse41  ); break;
+            case DBCB_MODE_PMA:        DBCB_LAUNCH(dbcB_flp_sse41  ); break;
+            case DBCB_MODE_5551:       DBCB_LAUNCH(dbcB_f5551_sse41); break;
+            case DBCB_MODE_MUL:        DBCB_LAUNCH(dbcB_flx_sse41  ); break;
+        }
+    }
+    else
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_COLORKEY8:  DBCB_LAUNCH(dbcB_f8m_sse41  ); break;
+            case DBCB_MODE_COLORKEY16: DBCB_LAUNCH(dbcB_f16m_sse41 ); break;
+            case DBCB_MODE_5551:       DBCB_LAUNCH(dbcB_f5551_sse41); break;
+            case DBCB_MODE_ALPHATEST:
+                          if(alpha128) DBCB_LAUNCH(dbcB_f32s_sse41 );
+                          else         DBCB_LAUNCH(dbcB_f32t_sse41 );
+                          break;
+        }
+    }
+    dbcb_trace_end();
+    return;
+no_sse41:
+#endif /* !defined(DBC_BLIT_NO_SSE41) */
+
     
-    if(!dbcB_has_sse2||!(dbcb_allow_sse2_for_mode(mode,modulated))) goto no_sse2;
+    if(!DBCB_HAS_SSE2||!(dbcb_allow_sse2_for_mode(mode,modulated))) goto no_sse2;
+    if(mode>=DBCB_MODE_HALF_ALPHA) goto no_sse2; /* No SSE2 versions of half-float modes. */
+#ifdef DBC_BLIT_AUTOTUNE
+    if(tier&&tier<2) goto no_sse2;
+#endif
+    DBCB_STATS_BLIT(DBCB_STATS_TIER_SSE2);
+    DBCB_TRACE_BEGIN(DBCB_STATS_TIER_SSE2);
+    launch_tier=DBCB_STATS_TIER_SSE2;
     if(!modulated)
     {
         switch(mode)
@@ -4726,7 +7691,10 @@ no_avx2:
     {
         switch(mode)
         {
-            case DBCB_MODE_COPY:       DBCB_LAUNCH(dbcB_f32m_sse2 ); break;
+            case DBCB_MODE_COPY:
+                          if(color01) DBCB_LAUNCH(dbcB_f32k_sse2 );
+                          else        DBCB_LAUNCH(dbcB_f32m_sse2 );
+                         break;
             case DBCB_MODE_ALPHA:      DBCB_LAUNCH(dbcB_flam_sse2 ); break;
             case DBCB_MODE_PMA:        DBCB_LAUNCH(dbcB_flpm_sse2 ); break;
             case DBCB_MODE_COLORKEY8:  DBCB_LAUNCH(dbcB_f8m_sse2  ); break;
@@ -4745,9 +7713,12 @@ no_avx2:
 #endif
         }
     }
+    dbcb_trace_end();
     return;
 no_sse2:
 #endif /* !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64) */
+    DBCB_STATS_BLIT(DBCB_STATS_TIER_C);
+    DBCB_TRACE_BEGIN(DBCB_STATS_TIER_C);
     if(!modulated)
     {
         switch(mode)
@@ -4765,6 +7736,10 @@ no_sse2:
             case DBCB_MODE_GAMMA:      DBCB_LAUNCH(dbcB_fga_c  ); break;
             case DBCB_MODE_PMG:        DBCB_LAUNCH(dbcB_fgp_c  ); break;
             case DBCB_MODE_MUG:        DBCB_LAUNCH(dbcB_fgx_c  ); break;
+            case DBCB_MODE_HALF_ALPHA:   DBCB_LAUNCH(dbcB_fha_c ); break;
+            case DBCB_MODE_HALF_PMA:     DBCB_LAUNCH(dbcB_fhp_c ); break;
+            case DBCB_MODE_HALF_MUL:     DBCB_LAUNCH(dbcB_fhx_c ); break;
+            case DBCB_MODE_HALF_RESOLVE: DBCB_LAUNCH(dbcB_fhr_c ); break;
 #endif
         }
     }
@@ -4772,7 +7747,10 @@ no_sse2:
     {
         switch(mode)
         {
-            case DBCB_MODE_COPY:       DBCB_LAUNCH(dbcB_f32m_c ); break;
+            case DBCB_MODE_COPY:
+                          if(color01) DBCB_LAUNCH(dbcB_f32k_c );
+                          else        DBCB_LAUNCH(dbcB_f32m_c );
+                         break;
             case DBCB_MODE_ALPHA:      DBCB_LAUNCH(dbcB_flam_c ); break;
             case DBCB_MODE_PMA:        DBCB_LAUNCH(dbcB_flpm_c ); break;
             case DBCB_MODE_COLORKEY8:  DBCB_LAUNCH(dbcB_f8m_c  ); break;
@@ -4788,13 +7766,1809 @@ no_sse2:
             case DBCB_MODE_GAMMA:      DBCB_LAUNCH(dbcB_fgam_c ); break;
             case DBCB_MODE_PMG:        DBCB_LAUNCH(dbcB_fgpm_c ); break;
             case DBCB_MODE_MUG:        DBCB_LAUNCH(dbcB_fgxm_c ); break;
+            case DBCB_MODE_HALF_ALPHA:   DBCB_LAUNCH(dbcB_fham_c); break;
+            case DBCB_MODE_HALF_PMA:     DBCB_LAUNCH(dbcB_fhpm_c); break;
+            case DBCB_MODE_HALF_MUL:     DBCB_LAUNCH(dbcB_fhxm_c); break;
+            case DBCB_MODE_HALF_RESOLVE: DBCB_LAUNCH(dbcB_fhrm_c); break;
 #endif
         }
     }
+    dbcb_trace_end();
 
+#undef DBCB_TRACE_BEGIN
 #undef DBCB_LAUNCH
 }
 
+DBCB_DEF void dbc_blit(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode)
+{
+    static int initialized=
+    /* Better thread-safety for C++. */
+#ifndef __cplusplus
+    0;
+    if(!initialized) initialized=
+#endif
+    dbcB_init();
+    (void)initialized;
+
+    dbcb_record_blit(
+        src_w,src_h,src_stride_in_bytes,src_pixels,
+        dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+        x,y,color,mode);
+
+    dbcB_blit(
+        src_w,src_h,src_stride_in_bytes,src_pixels,
+        dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+        x,y,
+        color,
+        mode,
+        0);
+}
+
+#ifndef DBC_BLIT_LAYER_BAND_BYTES
+#define DBC_BLIT_LAYER_BAND_BYTES 32768
+#endif
+
+/* Size of dst pixel for mode, in bytes. */
+static int dbcB_dst_pixel_size(int mode)
+{
+    switch(mode)
+    {
+        case DBCB_MODE_COLORKEY8:    return 1;
+        case DBCB_MODE_COLORKEY16:
+        case DBCB_MODE_5551:         return 2;
+        case DBCB_MODE_HALF_ALPHA:
+        case DBCB_MODE_HALF_PMA:
+        case DBCB_MODE_HALF_MUL:     return 8;
+        default:                     return 4;
+    }
+}
+
+/* Size of src pixel for mode, in bytes. */
+static int dbcB_src_pixel_size(int mode)
+{
+    switch(mode)
+    {
+        case DBCB_MODE_HALF_ALPHA:
+        case DBCB_MODE_HALF_PMA:
+        case DBCB_MODE_HALF_MUL:     return 4;
+        case DBCB_MODE_HALF_RESOLVE: return 8;
+        default:                     return dbcB_dst_pixel_size(mode);
+    }
+}
+
+DBCB_DEF void dbc_blit_layers(
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    const dbcb_layer *layers,
+    int count)
+{
+    dbcb_int32 i,y,band,pixel_size=1;
+    if(!layers||count<=0||dst_w<=0||dst_h<=0) return;
+    for(i=0;i<count;++i)
+        if(dbcB_dst_pixel_size(layers[i].mode)>pixel_size)
+            pixel_size=dbcB_dst_pixel_size(layers[i].mode);
+    band=(DBC_BLIT_LAYER_BAND_BYTES)/(dst_w*pixel_size);
+    if(band<1) band=1;
+    for(y=0;y<dst_h;y+=band)
+    {
+        dbcb_int32 h=(dst_h-y<band?dst_h-y:band);
+        unsigned char *dst=dst_pixels+y*dst_stride_in_bytes;
+        for(i=0;i<count;++i)
+        {
+            const dbcb_layer *l=layers+i;
+            if(l->y>=y+h||l->y+l->h<=y) continue;
+            dbc_blit(
+                l->w,l->h,l->stride,l->pixels,
+                dst_w,h,dst_stride_in_bytes,dst,
+                l->x,l->y-y,
+                l->color,
+                l->mode);
+        }
+    }
+}
+
+/* Blit layer into [x0;x1)x[y0;y1) sub-surface of dst (already clipped to dst). */
+static void dbcB_blit_layer_rect(
+    const dbcb_layer *l,
+    dbcb_int32 dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    dbcb_int32 x0,dbcb_int32 y0,dbcb_int32 x1,dbcb_int32 y1)
+{
+    dbc_blit(
+        l->w,l->h,l->stride,l->pixels,
+        x1-x0,y1-y0,dst_stride_in_bytes,
+        dst_pixels+y0*dst_stride_in_bytes+x0*dbcB_dst_pixel_size(l->mode),
+        l->x-x0,l->y-y0,
+        l->color,
+        l->mode);
+}
+
+/*============================================================================*/
+/* Damage tracking */
+
+/* Areas are in double, to not depend on dbcb_int64. */
+static double dbcB_rect_area(const dbcb_rect *r)
+{
+    return (double)(r->x1-r->x0)*(double)(r->y1-r->y0);
+}
+
+static dbcb_rect dbcB_rect_union(const dbcb_rect *a,const dbcb_rect *b)
+{
+    dbcb_rect r;
+    r.x0=(a->x0<b->x0?a->x0:b->x0);
+    r.y0=(a->y0<b->y0?a->y0:b->y0);
+    r.x1=(a->x1>b->x1?a->x1:b->x1);
+    r.y1=(a->y1>b->y1?a->y1:b->y1);
+    return r;
+}
+
+static int dbcB_rect_overlap(const dbcb_rect *a,const dbcb_rect *b)
+{
+    return a->x0<b->x1&&b->x0<a->x1&&a->y0<b->y1&&b->y0<a->y1;
+}
+
+/* Area wasted by replacing (disjoint) a and b with their bounding box. */
+static double dbcB_rect_waste(const dbcb_rect *a,const dbcb_rect *b)
+{
+    dbcb_rect u=dbcB_rect_union(a,b);
+    return dbcB_rect_area(&u)-dbcB_rect_area(a)-dbcB_rect_area(b);
+}
+
+static void dbcB_damage_remove(dbcb_damage *damage,int i)
+{
+    damage->rects[i]=damage->rects[--damage->count];
+}
+
+/*
+    Merge rectangles until they are disjoint, and no pair is cheap to merge.
+    Small waste (relative to merged area) is accepted, since every extra
+    rectangle costs a dbc_blit() call per layer.
+*/
+static void dbcB_damage_merge(dbcb_damage *damage)
+{
+    int i,j;
+again:
+    for(i=0;i<damage->count;++i)
+        for(j=i+1;j<damage->count;++j)
+        {
+            dbcb_rect *a=damage->rects+i,*b=damage->rects+j;
+            if(dbcB_rect_overlap(a,b)||4.0*dbcB_rect_waste(a,b)<=dbcB_rect_area(a)+dbcB_rect_area(b))
+            {
+                *a=dbcB_rect_union(a,b);
+                dbcB_damage_remove(damage,j);
+                goto again;
+            }
+        }
+}
+
+DBCB_DEF void dbcb_damage_clear(dbcb_damage *damage)
+{
+    damage->count=0;
+}
+
+DBCB_DEF void dbcb_damage_add(
+    dbcb_damage *damage,
+    int x0,int y0,int x1,int y1)
+{
+    if(x0>=x1||y0>=y1) return;
+    if(damage->count==DBCB_DAMAGE_MAX_RECTS)
+    {
+        /* Full: merge the cheapest pair. */
+        int i,j,bi=0,bj=1;
+        double best=-1.0;
+        for(i=0;i<damage->count;++i)
+            for(j=i+1;j<damage->count;++j)
+            {
+                double w=dbcB_rect_waste(damage->rects+i,damage->rects+j);
+                if(best<0.0||w<best) {best=w;bi=i;bj=j;}
+            }
+        damage->rects[bi]=dbcB_rect_union(damage->rects+bi,damage->rects+bj);
+        dbcB_damage_remove(damage,bj);
+    }
+    damage->rects[damage->count].x0=x0;
+    damage->rects[damage->count].y0=y0;
+    damage->rects[damage->count].x1=x1;
+    damage->rects[damage->count].y1=y1;
+    ++damage->count;
+    dbcB_damage_merge(damage);
+}
+
+DBCB_DEF void dbcb_damage_add_blit(
+    dbcb_damage *damage,
+    int src_w,int src_h,
+    int dst_w,int dst_h,
+    int x,int y)
+{
+    /* Same clipping as in dbc_blit(), in dst coordinates. */
+    dbcb_int32 x0,y0,x1,y1;
+    if(x<0) x0=-x; else x0=0;
+    if(x+src_w>dst_w) x1=dst_w-x; else x1=src_w;
+    if(y<0) y0=-y; else y0=0;
+    if(y+src_h>dst_h) y1=dst_h-y; else y1=src_h;
+    dbcb_damage_add(damage,x+x0,y+y0,x+x1,y+y1);
+}
+
+DBCB_DEF void dbc_blit_layers_damaged(
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    const dbcb_layer *layers,
+    int count,
+    const dbcb_damage *damage)
+{
+    dbcb_int32 i,k;
+    if(!layers||!damage||count<=0) return;
+    for(k=0;k<damage->count;++k)
+    {
+        dbcb_rect r=damage->rects[k];
+        if(r.x0<0) r.x0=0;
+        if(r.y0<0) r.y0=0;
+        if(r.x1>dst_w) r.x1=dst_w;
+        if(r.y1>dst_h) r.y1=dst_h;
+        if(r.x0>=r.x1||r.y0>=r.y1) continue;
+        for(i=0;i<count;++i)
+        {
+            const dbcb_layer *l=layers+i;
+            if(l->x>=r.x1||l->x+l->w<=r.x0||l->y>=r.y1||l->y+l->h<=r.y0) continue;
+            dbcB_blit_layer_rect(l,dst_stride_in_bytes,dst_pixels,r.x0,r.y0,r.x1,r.y1);
+        }
+    }
+}
+
+/*============================================================================*/
+/* Occlusion culling */
+
+/* Whether layer overwrites every dst pixel it touches. */
+static int dbcB_layer_opaque(const dbcb_layer *l)
+{
+    const float *c=l->color;
+    switch(l->mode)
+    {
+        case DBCB_MODE_COPY:
+        case DBCB_MODE_CPYG:       return 1;
+        case DBCB_MODE_COLORKEY8:  return !(c&&c[0]>=0.0f&&c[0]<=255.0f);
+        case DBCB_MODE_COLORKEY16: return !(c&&c[0]>=0.0f&&c[0]<=65535.0f);
+        case DBCB_MODE_ALPHATEST:  return !(c&&c[0]>0.0f);
+        case DBCB_MODE_ALPHA:
+        case DBCB_MODE_PMA:
+        case DBCB_MODE_GAMMA:
+        case DBCB_MODE_PMG:
+        case DBCB_MODE_HALF_ALPHA:
+        case DBCB_MODE_HALF_PMA:   return (l->flags&DBCB_LAYER_OPAQUE)&&!(c&&c[3]!=1.0f);
+        default:                   return 0;
+    }
+}
+
+DBCB_DEF int dbcb_coverage_size(int dst_w,int dst_h)
+{
+    if(dst_w<=0||dst_h<=0) return 0;
+    return ((dst_w+DBCB_COVERAGE_BLOCK-1)/DBCB_COVERAGE_BLOCK)*((dst_h+DBCB_COVERAGE_BLOCK-1)/DBCB_COVERAGE_BLOCK);
+}
+
+DBCB_DEF void dbc_blit_layers_culled(
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    const dbcb_layer *layers,
+    int count,
+    unsigned short *coverage)
+{
+    const dbcb_int32 B=DBCB_COVERAGE_BLOCK;
+    dbcb_int32 i,n,bw,bx,by;
+    if(!layers||!coverage||count<=0||dst_w<=0||dst_h<=0) return;
+    /* Coverage holds 16-bit layer indices. */
+    if(count>65535)
+    {
+        dbc_blit_layers(dst_w,dst_h,dst_stride_in_bytes,dst_pixels,layers,count);
+        return;
+    }
+    bw=(dst_w+B-1)/B;
+    n=dbcb_coverage_size(dst_w,dst_h);
+    for(i=0;i<n;++i) coverage[i]=0;
+    /* Front-to-back: mark blocks fully covered by opaque layers. */
+    for(i=count-1;i>=0;--i)
+    {
+        const dbcb_layer *l=layers+i;
+        dbcb_int32 x0=l->x,y0=l->y,x1=l->x+l->w,y1=l->y+l->h;
+        dbcb_int32 bx0,by0,bx1,by1;
+        if(!dbcB_layer_opaque(l)) continue;
+        if(x0<0) x0=0;
+        if(y0<0) y0=0;
+        /* Blocks on the right/bottom edge of dst may be partial. */
+        if(x1>=dst_w) x1=bw*B;
+        if(y1>=dst_h) y1=n/bw*B;
+        bx0=(x0+B-1)/B;
+        by0=(y0+B-1)/B;
+        bx1=x1/B;
+        by1=y1/B;
+        for(by=by0;by<by1;++by)
+            for(bx=bx0;bx<bx1;++bx)
+                if(!coverage[by*bw+bx]) coverage[by*bw+bx]=(unsigned short)(i+1);
+    }
+    /* Back-to-front: blit the runs of blocks not covered by layers in front. */
+    for(i=0;i<count;++i)
+    {
+        const dbcb_layer *l=layers+i;
+        dbcb_int32 x0=l->x,y0=l->y,x1=l->x+l->w,y1=l->y+l->h;
+        if(x0<0) x0=0;
+        if(y0<0) y0=0;
+        if(x1>dst_w) x1=dst_w;
+        if(y1>dst_h) y1=dst_h;
+        if(x0>=x1||y0>=y1) continue;
+        for(by=y0/B;by*B<y1;++by)
+        {
+            const unsigned short *c=coverage+by*bw;
+            dbcb_int32 ry0=(by*B>y0?by*B:y0),ry1=(by*B+B<y1?by*B+B:y1);
+            bx=x0/B;
+            while(bx*B<x1)
+            {
+                dbcb_int32 start;
+                while(bx*B<x1&&c[bx]>i+1) ++bx;
+                start=bx;
+                while(bx*B<x1&&c[bx]<=i+1) ++bx;
+                if(bx>start)
+                    dbcB_blit_layer_rect(l,dst_stride_in_bytes,dst_pixels,
+                        (start*B>x0?start*B:x0),ry0,(bx*B<x1?bx*B:x1),ry1);
+            }
+        }
+    }
+}
+
+/*============================================================================*/
+/* Sprite analysis */
+
+DBCB_DEF void dbcb_analyze_sprite(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int mode,
+    dbcb_sprite_info *info)
+{
+    dbcb_int32 x,y,x0=src_w,y0=src_h,x1=0,y1=0;
+    /* Bits: 1 - some pixel is visible, 2 - some visible pixel is not opaque. */
+    dbcb_uint32 seen=0;
+    info->w=src_w;
+    info->h=src_h;
+    info->mode=mode;
+    info->x0=0;
+    info->y0=0;
+    info->x1=src_w;
+    info->y1=src_h;
+    info->kind=DBCB_SPRITE_MIXED;
+    if(src_w<=0||src_h<=0)
+    {
+        info->x1=info->y1=0;
+        info->kind=DBCB_SPRITE_TRANSPARENT;
+        return;
+    }
+    switch(mode)
+    {
+        case DBCB_MODE_COPY:
+        case DBCB_MODE_CPYG:
+            info->kind=DBCB_SPRITE_OPAQUE;
+            return;
+        case DBCB_MODE_ALPHA:
+        case DBCB_MODE_GAMMA:
+        case DBCB_MODE_PMA:
+        case DBCB_MODE_PMG:
+        case DBCB_MODE_MUL:
+        case DBCB_MODE_MUG:
+        case DBCB_MODE_5551:
+            break;
+        default:
+            return;
+    }
+    for(y=0;y<src_h;++y)
+    {
+        const dbcb_uint8 *s=src_pixels+y*src_stride_in_bytes;
+        dbcb_int32 first=-1,last=-1;
+        for(x=0;x<src_w;++x)
+        {
+            int visible,opaque;
+            if(mode==DBCB_MODE_5551)
+            {
+                dbcb_uint16 S=dbcb_load16(s+2*x);
+                visible=opaque=((S&0x8000u)!=0);
+            }
+            else
+            {
+                dbcb_uint32 S=dbcb_load32(s+4*x);
+                switch(mode)
+                {
+                    case DBCB_MODE_PMA:
+                    case DBCB_MODE_PMG: visible=(S!=0u); break;
+                    case DBCB_MODE_MUL:
+                    case DBCB_MODE_MUG: visible=(S!=0xFFFFFFFFu); break;
+                    default:            visible=((S>>24)!=0u); break;
+                }
+                opaque=((S>>24)==255u&&mode!=DBCB_MODE_MUL&&mode!=DBCB_MODE_MUG);
+            }
+            if(visible)
+            {
+                if(first<0) first=x;
+                last=x;
+                seen|=(opaque?1u:3u);
+            }
+        }
+        if(first>=0)
+        {
+            if(first<x0) x0=first;
+            if(last+1>x1) x1=last+1;
+            if(y<y0) y0=y;
+            y1=y+1;
+        }
+    }
+    if(!seen)
+    {
+        info->x1=info->y1=0;
+        info->kind=DBCB_SPRITE_TRANSPARENT;
+        return;
+    }
+    /*
+        Opaque only if the whole bounding box is: transparent pixels
+        inside it would otherwise be copied.
+    */
+    if(seen==1u)
+    {
+        for(y=y0;y<y1&&seen==1u;++y)
+        {
+            const dbcb_uint8 *s=src_pixels+y*src_stride_in_bytes;
+            for(x=x0;x<x1;++x)
+            {
+                if(mode==DBCB_MODE_5551) {if(!(dbcb_load16(s+2*x)&0x8000u)) {seen=3u;break;}}
+                else if((dbcb_load32(s+4*x)>>24)!=255u) {seen=3u;break;}
+            }
+        }
+    }
+    info->x0=x0;
+    info->y0=y0;
+    info->x1=x1;
+    info->y1=y1;
+    info->kind=(seen==1u?DBCB_SPRITE_OPAQUE:DBCB_SPRITE_MIXED);
+}
+
+DBCB_DEF void dbc_blit_analyzed(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode,
+    const dbcb_sprite_info *info)
+{
+    dbcb_int32 pixel_size=dbcB_src_pixel_size(mode);
+    int modulated=(color&&!(color[0]==1.0f&&color[1]==1.0f&&color[2]==1.0f&&color[3]==1.0f));
+    if(mode==DBCB_MODE_5551) modulated=0;
+    /* Modulated white is not transparent in multiplication modes. */
+    if(modulated&&(mode==DBCB_MODE_MUL||mode==DBCB_MODE_MUG)) info=0;
+    if(info&&info->w==src_w&&info->h==src_h&&info->mode==mode)
+    {
+        if(info->kind==DBCB_SPRITE_TRANSPARENT) return;
+        src_pixels+=info->y0*src_stride_in_bytes+info->x0*pixel_size;
+        x+=info->x0;
+        y+=info->y0;
+        src_w=info->x1-info->x0;
+        src_h=info->y1-info->y0;
+        if(info->kind==DBCB_SPRITE_OPAQUE&&!modulated)
+        {
+            /* Non-modulated colorkey modes are straight copy. */
+            if(mode==DBCB_MODE_5551) mode=DBCB_MODE_COLORKEY16;
+            else                     mode=DBCB_MODE_COPY;
+            color=0;
+        }
+    }
+    dbc_blit(
+        src_w,src_h,src_stride_in_bytes,src_pixels,
+        dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+        x,y,
+        color,
+        mode);
+}
+
+/*============================================================================*/
+/* Masked blit */
+
+/* Coverage of width mask bytes if they are all 0 or all 255, -1 otherwise. */
+static dbcb_int32 dbcB_mask_run(const dbcb_uint8 *m,dbcb_int32 width)
+{
+    dbcb_uint32 v;
+    dbcb_int32 k;
+    if(width<4)
+    {
+        if(m[0]!=0&&m[0]!=255) return -1;
+        for(k=1;k<width;++k) if(m[k]!=m[0]) return -1;
+        return m[0];
+    }
+    v=dbcb_load32(m);
+    if(v!=0u&&v!=0xFFFFFFFFu) return -1;
+    for(k=4;k<width;k+=4) if(dbcb_load32(m+k)!=v) return -1;
+    return (dbcb_int32)(v&255u);
+}
+
+/*
+    Row of n pixels with coverage m, in blocks of width pixels: blocks that
+    are all 0 are skipped, all 255 blitted with blitw. In other blocks,
+    if wide is set and at least 2 pixels have partial coverage, the block
+    is blitted in place with blitc (modulation by coverage m+i, leaves
+    pixels with coverage 0 as they are). Pixels with coverage 255 are
+    blitted with blitw onto a copy of dst and copied back if there are
+    at least 2 of them, or blitc was used; otherwise with blit1. Remaining
+    partial coverage is blitted with blitp, modulated by scaled (color
+    with components [first;4) multiplied by coverage/255). Same kernels
+    (lane for lane) as dbc_blit() uses for the tier, so results match it.
+*/
+#define DBCB_DEF_MASKED_ROW(name,src_pixel_size,dst_pixel_size,first,width,blitw,blit1,blitp,wide,blitc) \
+static void name(const dbcb_uint8 *s,dbcb_uint8 *d,const dbcb_uint8 *m, \
+    dbcb_int32 n,const float *color)                                    \
+{                                                                       \
+    dbcb_uint8 t[(width)*(dst_pixel_size)];                             \
+    float scaled[4]={0.0f,0.0f,0.0f,0.0f};                              \
+    dbcb_int32 i,k,v,full,part,usew,usec,last=-1;                       \
+    for(i=0;i<n;)                                                       \
+    {                                                                   \
+        dbcb_int32 end=(n-i>=(width)?i+(width):n);                      \
+        usew=usec=0;                                                    \
+        if(end-i==(width))                                              \
+        {                                                               \
+            v=dbcB_mask_run(m+i,width);                                 \
+            if(v<0)                                                     \
+            {                                                           \
+                full=part=0;                                            \
+                for(k=0;k<(width);++k)                                  \
+                {                                                       \
+                    full+=(m[i+k]==255);                                \
+                    part+=(m[i+k]!=0&&m[i+k]!=255);                     \
+                }                                                       \
+                usec=((wide)&&part>=2);                                 \
+                usew=(full>=2||(usec&&full));                           \
+                if(usew)                                                \
+                {                                                       \
+                    dbcb_memcpy(t,d,(size_t)((width)*(dst_pixel_size)));\
+                    {dbcb_uint8 *d=t; blitw;}                           \
+                }                                                       \
+                if(usec) blitc;                                         \
+                if(usew)                                                \
+                    for(k=0;k<(width);++k)                              \
+                        if(m[i+k]==255)                                 \
+                            dbcb_memcpy(d+k*(dst_pixel_size),t+k*(dst_pixel_size),(size_t)(dst_pixel_size));\
+                if(usec||(usew&&part==0)) v=0;                          \
+            }                                                           \
+            if(v>=0)                                                    \
+            {                                                           \
+                if(v==255) blitw;                                       \
+                i+=(width);                                             \
+                s+=(width)*(src_pixel_size);                            \
+                d+=(width)*(dst_pixel_size);                            \
+                continue;                                               \
+            }                                                           \
+        }                                                               \
+        for(;i<end;++i,s+=src_pixel_size,d+=dst_pixel_size)             \
+        {                                                               \
+            v=m[i];                                                     \
+            if(v==0) continue;                                          \
+            if(v==255) {if(!usew) blit1; continue;}                     \
+            if(v!=last)                                                 \
+            {                                                           \
+                float f=(float)v/255.0f;                                \
+                for(k=0;k<4;++k) scaled[k]=(k>=(first)?color[k]*f:color[k]);\
+                last=v;                                                 \
+            }                                                           \
+            blitp;                                                      \
+        }                                                               \
+    }                                                                   \
+}
+
+DBCB_DEF_MASKED_ROW(dbcB_mla_row_c    ,4,4,3,4,dbcB_bla_4_c(s,d),dbcB_bla_1_c(s,d),dbcB_blam_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mlam_row_c   ,4,4,3,1,dbcB_blam_1_c(s,d,color),dbcB_blam_1_c(s,d,color),dbcB_blam_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mlp_row_c    ,4,4,0,4,dbcB_blp_4_c(s,d),dbcB_blp_1_c(s,d),dbcB_blpm_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mlpm_row_c   ,4,4,0,1,dbcB_blpm_1_c(s,d,color),dbcB_blpm_1_c(s,d,color),dbcB_blpm_1_c(s,d,scaled),0,(void)0)
+#ifndef DBC_BLIT_NO_GAMMA
+DBCB_DEF_MASKED_ROW(dbcB_mga_row_c    ,4,4,3,4,dbcB_bga_4_c(s,d),dbcB_bga_1_c(s,d),dbcB_bgam_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mgam_row_c   ,4,4,3,1,dbcB_bgam_1_c(s,d,color),dbcB_bgam_1_c(s,d,color),dbcB_bgam_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mgp_row_c    ,4,4,0,4,dbcB_bgp_4_c(s,d),dbcB_bgp_1_c(s,d),dbcB_bgpm_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mgpm_row_c   ,4,4,0,1,dbcB_bgpm_1_c(s,d,color),dbcB_bgpm_1_c(s,d,color),dbcB_bgpm_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mha_row_c    ,4,8,3,2,dbcB_bha_2_c(s,d),dbcB_bha_1_c(s,d),dbcB_bham_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mham_row_c   ,4,8,3,1,dbcB_bham_1_c(s,d,color),dbcB_bham_1_c(s,d,color),dbcB_bham_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mhp_row_c    ,4,8,0,2,dbcB_bhp_2_c(s,d),dbcB_bhp_1_c(s,d),dbcB_bhpm_1_c(s,d,scaled),0,(void)0)
+DBCB_DEF_MASKED_ROW(dbcB_mhpm_row_c   ,4,8,0,1,dbcB_bhpm_1_c(s,d,color),dbcB_bhpm_1_c(s,d,color),dbcB_bhpm_1_c(s,d,scaled),0,(void)0)
+#endif /* DBC_BLIT_NO_GAMMA */
+
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mla_row_sse2 ,4,4,3,4,dbcB_bla_4_sse2(s,d),dbcB_bla_1_sse2(s,d),dbcB_blam_1_sse2(s,d,scaled),0,(void)0)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mlam_row_sse2,4,4,3,1,dbcB_blam_1_sse2(s,d,color),dbcB_blam_1_sse2(s,d,color),dbcB_blam_1_sse2(s,d,scaled),0,(void)0)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mlp_row_sse2 ,4,4,0,4,dbcB_blp_4_sse2(s,d),dbcB_blp_1_sse2(s,d),dbcB_blpm_1_sse2(s,d,scaled),0,(void)0)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mlpm_row_sse2,4,4,0,1,dbcB_blpm_1_sse2(s,d,color),dbcB_blpm_1_sse2(s,d,color),dbcB_blpm_1_sse2(s,d,scaled),0,(void)0)
+#ifndef DBC_BLIT_NO_GAMMA
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mga_row_sse2 ,4,4,3,1,dbcB_bga_1_sse2(s,d),dbcB_bga_1_sse2(s,d),dbcB_bgam_1_sse2(s,d,scaled),0,(void)0)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mgam_row_sse2,4,4,3,1,dbcB_bgam_1_sse2(s,d,color),dbcB_bgam_1_sse2(s,d,color),dbcB_bgam_1_sse2(s,d,scaled),0,(void)0)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mgp_row_sse2 ,4,4,0,1,dbcB_bgp_1_sse2(s,d),dbcB_bgp_1_sse2(s,d),dbcB_bgpm_1_sse2(s,d,scaled),0,(void)0)
+DBCB_DECL_SSE2 DBCB_DEF_MASKED_ROW(dbcB_mgpm_row_sse2,4,4,0,1,dbcB_bgpm_1_sse2(s,d,color),dbcB_bgpm_1_sse2(s,d,color),dbcB_bgpm_1_sse2(s,d,scaled),0,(void)0)
+#endif /* DBC_BLIT_NO_GAMMA */
+#ifndef DBC_BLIT_NO_AVX2
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mla_row_avx2 ,4,4,3,8,dbcB_bla_8_avx2(s,d),dbcB_bla_1_avx2(s,d),dbcB_blam_1_avx2(s,d,scaled),1,dbcB_blac_8_avx2(s,d,m+i,color))
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mlam_row_avx2,4,4,3,8,dbcB_blam_8_avx2(s,d,color),dbcB_blam_1_avx2(s,d,color),dbcB_blam_1_avx2(s,d,scaled),1,dbcB_blac_8_avx2(s,d,m+i,color))
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mlp_row_avx2 ,4,4,0,8,dbcB_blp_8_avx2(s,d),dbcB_blp_1_avx2(s,d),dbcB_blpm_1_avx2(s,d,scaled),1,dbcB_blpc_8_avx2(s,d,m+i,color))
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mlpm_row_avx2,4,4,0,8,dbcB_blpm_8_avx2(s,d,color),dbcB_blpm_1_avx2(s,d,color),dbcB_blpm_1_avx2(s,d,scaled),1,dbcB_blpc_8_avx2(s,d,m+i,color))
+#ifndef DBC_BLIT_NO_GAMMA
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mga_row_avx2 ,4,4,3,2,dbcB_bga_2_avx2(s,d),dbcB_bga_1_avx2(s,d),dbcB_bgam_1_avx2(s,d,scaled),0,(void)0)
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mgam_row_avx2,4,4,3,2,dbcB_bgam_2_avx2(s,d,color),dbcB_bgam_1_avx2(s,d,color),dbcB_bgam_1_avx2(s,d,scaled),0,(void)0)
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mgp_row_avx2 ,4,4,0,2,dbcB_bgp_2_avx2(s,d),dbcB_bgp_1_avx2(s,d),dbcB_bgpm_1_avx2(s,d,scaled),0,(void)0)
+DBCB_DECL_AVX2 DBCB_DEF_MASKED_ROW(dbcB_mgpm_row_avx2,4,4,0,2,dbcB_bgpm_2_avx2(s,d,color),dbcB_bgpm_1_avx2(s,d,color),dbcB_bgpm_1_avx2(s,d,scaled),0,(void)0)
+#ifdef DBCB_GAMMA_FMA
+DBCB_DECL_FMA  DBCB_DEF_MASKED_ROW(dbcB_mga_row_fma  ,4,4,3,8,dbcB_bga_8_fma(s,d),dbcB_bga_1_fma(s,d),dbcB_bgam_1_fma(s,d,scaled),0,(void)0)
+DBCB_DECL_FMA  DBCB_DEF_MASKED_ROW(dbcB_mgam_row_fma ,4,4,3,8,dbcB_bgam_8_fma(s,d,color),dbcB_bgam_1_fma(s,d,color),dbcB_bgam_1_fma(s,d,scaled),0,(void)0)
+DBCB_DECL_FMA  DBCB_DEF_MASKED_ROW(dbcB_mgp_row_fma  ,4,4,0,8,dbcB_bgp_8_fma(s,d),dbcB_bgp_1_fma(s,d),dbcB_bgpm_1_fma(s,d,scaled),0,(void)0)
+DBCB_DECL_FMA  DBCB_DEF_MASKED_ROW(dbcB_mgpm_row_fma ,4,4,0,8,dbcB_bgpm_8_fma(s,d,color),dbcB_bgpm_1_fma(s,d,color),dbcB_bgpm_1_fma(s,d,scaled),0,(void)0)
+#endif /* DBCB_GAMMA_FMA */
+DBCB_DECL_F16C DBCB_DEF_MASKED_ROW(dbcB_mha_row_f16c ,4,8,3,2,dbcB_bha_2_f16c(s,d),dbcB_bha_1_c(s,d),dbcB_bham_1_c(s,d,scaled),0,(void)0)
+DBCB_DECL_F16C DBCB_DEF_MASKED_ROW(dbcB_mham_row_f16c,4,8,3,2,dbcB_bham_2_f16c(s,d,color),dbcB_bham_1_c(s,d,color),dbcB_bham_1_c(s,d,scaled),0,(void)0)
+DBCB_DECL_F16C DBCB_DEF_MASKED_ROW(dbcB_mhp_row_f16c ,4,8,0,2,dbcB_bhp_2_f16c(s,d),dbcB_bhp_1_c(s,d),dbcB_bhpm_1_c(s,d,scaled),0,(void)0)
+DBCB_DECL_F16C DBCB_DEF_MASKED_ROW(dbcB_mhpm_row_f16c,4,8,0,2,dbcB_bhpm_2_f16c(s,d,color),dbcB_bhpm_1_c(s,d,color),dbcB_bhpm_1_c(s,d,scaled),0,(void)0)
+#endif /* DBC_BLIT_NO_GAMMA */
+#endif /* DBC_BLIT_NO_AVX2 */
+#endif
+
+#undef DBCB_DEF_MASKED_ROW
+
+/* Tier: see DBCB_STATS_TIER_* (SSE4.1 uses SSE2 rows). */
+static void dbcB_masked_row(int mode,int tier,int modulated,
+    const dbcb_uint8 *s,dbcb_uint8 *d,const dbcb_uint8 *m,dbcb_int32 n,const float *color)
+{
+#define DBCB_MASKED_CASE(mode,fn,fnm) case mode: if(modulated) fnm(s,d,m,n,color); else fn(s,d,m,n,color); return;
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+#ifndef DBC_BLIT_NO_AVX2
+    if(tier==DBCB_STATS_TIER_AVX2)
+    {
+        switch(mode)
+        {
+            DBCB_MASKED_CASE(DBCB_MODE_ALPHA     ,dbcB_mla_row_avx2,dbcB_mlam_row_avx2)
+            DBCB_MASKED_CASE(DBCB_MODE_PMA       ,dbcB_mlp_row_avx2,dbcB_mlpm_row_avx2)
+#ifndef DBC_BLIT_NO_GAMMA
+#ifdef DBCB_GAMMA_FMA
+            case DBCB_MODE_GAMMA:
+            case DBCB_MODE_PMG:
+                if(!DBCB_HAS_FMA) break;
+                if(mode==DBCB_MODE_GAMMA) {if(modulated) dbcB_mgam_row_fma(s,d,m,n,color); else dbcB_mga_row_fma(s,d,m,n,color);}
+                else                      {if(modulated) dbcB_mgpm_row_fma(s,d,m,n,color); else dbcB_mgp_row_fma(s,d,m,n,color);}
+                return;
+#endif /* DBCB_GAMMA_FMA */
+            DBCB_MASKED_CASE(DBCB_MODE_HALF_ALPHA,dbcB_mha_row_f16c,dbcB_mham_row_f16c)
+            DBCB_MASKED_CASE(DBCB_MODE_HALF_PMA  ,dbcB_mhp_row_f16c,dbcB_mhpm_row_f16c)
+#endif /* DBC_BLIT_NO_GAMMA */
+        }
+#ifndef DBC_BLIT_NO_GAMMA
+        switch(mode)
+        {
+            DBCB_MASKED_CASE(DBCB_MODE_GAMMA     ,dbcB_mga_row_avx2,dbcB_mgam_row_avx2)
+            DBCB_MASKED_CASE(DBCB_MODE_PMG       ,dbcB_mgp_row_avx2,dbcB_mgpm_row_avx2)
+        }
+#endif /* DBC_BLIT_NO_GAMMA */
+    }
+#endif /* DBC_BLIT_NO_AVX2 */
+    if(tier)
+    {
+        switch(mode)
+        {
+            DBCB_MASKED_CASE(DBCB_MODE_ALPHA     ,dbcB_mla_row_sse2,dbcB_mlam_row_sse2)
+            DBCB_MASKED_CASE(DBCB_MODE_PMA       ,dbcB_mlp_row_sse2,dbcB_mlpm_row_sse2)
+#ifndef DBC_BLIT_NO_GAMMA
+            DBCB_MASKED_CASE(DBCB_MODE_GAMMA     ,dbcB_mga_row_sse2,dbcB_mgam_row_sse2)
+            DBCB_MASKED_CASE(DBCB_MODE_PMG       ,dbcB_mgp_row_sse2,dbcB_mgpm_row_sse2)
+#endif /* DBC_BLIT_NO_GAMMA */
+        }
+    }
+#else
+    (void)tier;
+#endif
+    switch(mode)
+    {
+        DBCB_MASKED_CASE(DBCB_MODE_ALPHA     ,dbcB_mla_row_c,dbcB_mlam_row_c)
+        DBCB_MASKED_CASE(DBCB_MODE_PMA       ,dbcB_mlp_row_c,dbcB_mlpm_row_c)
+#ifndef DBC_BLIT_NO_GAMMA
+        DBCB_MASKED_CASE(DBCB_MODE_GAMMA     ,dbcB_mga_row_c,dbcB_mgam_row_c)
+        DBCB_MASKED_CASE(DBCB_MODE_PMG       ,dbcB_mgp_row_c,dbcB_mgpm_row_c)
+        DBCB_MASKED_CASE(DBCB_MODE_HALF_ALPHA,dbcB_mha_row_c,dbcB_mham_row_c)
+        DBCB_MASKED_CASE(DBCB_MODE_HALF_PMA  ,dbcB_mhp_row_c,dbcB_mhpm_row_c)
+#endif /* DBC_BLIT_NO_GAMMA */
+    }
+#undef DBCB_MASKED_CASE
+}
+
+/* Non-zero if some byte of v is zero. */
+#define dbcB_has_zero_byte(v) ((((v)-0x01010101u)&~(v)&0x80808080u)!=0u)
+
+/* Length of the prefix of n mask bytes that are equal to b (eq), or not (b=0 only). */
+static dbcb_int32 dbcB_mask_prefix_c(const dbcb_uint8 *m,dbcb_int32 n,int b,int eq)
+{
+    dbcb_int32 i=0;
+    if(eq)
+    {
+        dbcb_uint32 w=(b?0xFFFFFFFFu:0u);
+        while(i+4<=n&&dbcb_load32(m+i)==w) i+=4;
+    }
+    else while(i+4<=n&&!dbcB_has_zero_byte(dbcb_load32(m+i))) i+=4;
+    while(i<n&&(m[i]==b)==eq) ++i;
+    return i;
+}
+
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+DBCB_DECL_SSE2 static dbcb_int32 dbcB_mask_prefix_sse2(const dbcb_uint8 *m,dbcb_int32 n,int b,int eq)
+{
+    dbcb_int32 i=0;
+    int bits=(eq?0xFFFF:0);
+    dbcb_i32x4 v=dbcB_mm_set1_epi8((char)b);
+    while(i+16<=n&&dbcB_mm_movemask_epi8(dbcB_mm_cmpeq_epi8(dbcb_load128_128(m+i),v))==bits) i+=16;
+    return i+dbcB_mask_prefix_c(m+i,n-i,b,eq);
+}
+#define dbcB_mask_prefix(m,n,b,eq) (DBCB_HAS_SSE2?dbcB_mask_prefix_sse2(m,n,b,eq):dbcB_mask_prefix_c(m,n,b,eq))
+#else
+#define dbcB_mask_prefix(m,n,b,eq) dbcB_mask_prefix_c(m,n,b,eq)
+#endif
+
+/*
+    Length of the span of coverage at m (at most n), and its kind in *v:
+    0 or 255 for a run of that, -1 for mixed coverage, which extends until
+    a run of DBCB_MASK_SPAN bytes of 0 or 255 starts. With stencil, any
+    non-zero coverage counts as 255.
+*/
+#define DBCB_MASK_SPAN 16
+
+static dbcb_int32 dbcB_mask_span(const dbcb_uint8 *m,dbcb_int32 n,int stencil,dbcb_int32 *v)
+{
+    dbcb_int32 i,k;
+    if(stencil)
+    {
+        *v=(m[0]?255:0);
+        return dbcB_mask_prefix(m,n,0,!m[0]);
+    }
+    for(i=0;i<n;)
+    {
+        if(m[i]!=0&&m[i]!=255) {++i;continue;}
+        k=dbcB_mask_prefix(m+i,n-i,m[i],1);
+        if(k>=DBCB_MASK_SPAN||k==n)
+        {
+            if(i>0) break;
+            *v=m[0];
+            return k;
+        }
+        i+=k;
+    }
+    *v=-1;
+    return i;
+}
+
+/*
+    Runs of coverage 0 are skipped, runs of 255 go to fn (rows that are
+    255 throughout, several at once), mixed spans to the masked rows of
+    the tier. Stencil modes (without masked rows) have no mixed spans.
+*/
+static void dbcB_launch_masked(
+    dbcB_fn fn,int mode,int tier,int modulated,const dbcb_mask *mask,
+    dbcb_int32 src_stride,const dbcb_uint8 *src_pixels,
+    dbcb_int32 dst_stride,dbcb_uint8 *dst_pixels,
+    dbcb_int32 x0,dbcb_int32 y0,dbcb_int32 x1,dbcb_int32 y1,
+    dbcb_int32 x,dbcb_int32 y,
+    const float *color)
+{
+    static const float white[4]={1.0f,1.0f,1.0f,1.0f};
+    dbcb_int32 pixel_size=dbcB_src_pixel_size(mode),dst_pixel_size=dbcB_dst_pixel_size(mode);
+    dbcb_int32 i,j,n,v,full=y0; /* Rows [full;j) are 255 throughout, not blitted yet. */
+    int stencil=1;
+    switch(mode)
+    {
+        case DBCB_MODE_ALPHA:
+        case DBCB_MODE_PMA:
+#ifndef DBC_BLIT_NO_GAMMA
+        case DBCB_MODE_GAMMA:
+        case DBCB_MODE_PMG:
+        case DBCB_MODE_HALF_ALPHA:
+        case DBCB_MODE_HALF_PMA:
+#endif
+            stencil=0;
+            break;
+    }
+    for(j=y0;j<y1;++j)
+    {
+        const dbcb_uint8 *m=mask->pixels+(j+y-mask->y)*mask->stride+(x0+x-mask->x);
+        n=dbcB_mask_span(m,x1-x0,stencil,&v);
+        if(n==x1-x0&&v==255) continue;
+        if(full<j) fn(src_stride,src_pixels,dst_stride,dst_pixels,x0,full,x1,j,x,y,color);
+        full=j+1;
+        for(i=x0;i<x1;i+=n)
+        {
+            if(i>x0) n=dbcB_mask_span(m+(i-x0),x1-i,stencil,&v);
+            if(v==255)
+                fn(src_stride,src_pixels,dst_stride,dst_pixels,i,j,i+n,j+1,x,y,color);
+            else if(v<0)
+                dbcB_masked_row(mode,tier,modulated,
+                    src_pixels+j*src_stride+i*pixel_size,
+                    dst_pixels+(j+y)*dst_stride+(i+x)*dst_pixel_size,
+                    m+(i-x0),n,(modulated?color:white));
+        }
+    }
+    if(full<y1) fn(src_stride,src_pixels,dst_stride,dst_pixels,x0,full,x1,y1,x,y,color);
+}
+
+DBCB_DEF void dbc_blit_masked(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode,
+    const dbcb_mask *mask)
+{
+    dbcb_int32 x0,y0,x1,y1;
+    if(!mask)
+    {
+        dbc_blit(
+            src_w,src_h,src_stride_in_bytes,src_pixels,
+            dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+            x,y,
+            color,
+            mode);
+        return;
+    }
+    if(mode<DBCB_MODE_COPY||mode>DBCB_MODE_HALF_RESOLVE) return;
+    /* Intersection of src, dst, and mask, in dst coordinates. */
+    x0=x;       if(x0<0) x0=0;         if(x0<mask->x) x0=mask->x;
+    y0=y;       if(y0<0) y0=0;         if(y0<mask->y) y0=mask->y;
+    x1=x+src_w; if(x1>dst_w) x1=dst_w; if(x1>mask->x+mask->w) x1=mask->x+mask->w;
+    y1=y+src_h; if(y1>dst_h) y1=dst_h; if(y1>mask->y+mask->h) y1=mask->y+mask->h;
+    if(x0>=x1||y0>=y1) return;
+    dbc_blit(0,0,0,0,0,0,0,0,0,0,0,0); /* Initialization. */
+    dbcB_blit(
+        src_w,src_h,src_stride_in_bytes,src_pixels,
+        dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+        x,y,
+        color,
+        mode,
+        mask);
+}
+
+/*============================================================================*/
+/* Tiled fill */
+
+#ifndef DBC_BLIT_TILE_BYTES
+#define DBC_BLIT_TILE_BYTES 1024
+#endif
+
+/* Minimum width of replicated strip, in pixels. */
+#define DBCB_TILE_STRIP_W 128
+
+/* a mod b, for b>0, result in [0;b). */
+static dbcb_int32 dbcB_mod(dbcb_int32 a,dbcb_int32 b)
+{
+    a%=b;
+    return a<0?a+b:a;
+}
+
+DBCB_DEF void dbc_blit_tiled(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    int x,int y,int w,int h,
+    int phase_x,int phase_y,
+    const float *color,
+    int mode)
+{
+    dbcb_uint8 scratch[DBC_BLIT_TILE_BYTES];
+    const dbcb_uint8 *strip=src_pixels;
+    dbcb_int32 pixel_size=dbcB_src_pixel_size(mode);
+    dbcb_int32 strip_w=src_w,strip_stride=src_stride_in_bytes,band_h=src_h;
+    dbcb_int32 x0,y0,x1,y1,X,Y,Y0,u,v,v0,v1,cols,rows,i,j;
+    if(mode<DBCB_MODE_COPY||mode>DBCB_MODE_HALF_RESOLVE) return;
+    if(src_w<=0||src_h<=0||w<=0||h<=0) return;
+    x0=x;   if(x0<0) x0=0;
+    y0=y;   if(y0<0) y0=0;
+    x1=x+w; if(x1>dst_w) x1=dst_w;
+    y1=y+h; if(y1>dst_h) y1=dst_h;
+    if(x0>=x1||y0>=y1) return;
+    /*
+        Replicate src horizontally, if at least 2 copies fit and are
+        needed. The strip holds a band of src rows, so that it stays at
+        least DBCB_TILE_STRIP_W pixels wide with a small scratch: rows
+        are then longer, so the row kernels run fewer times.
+    */
+    if(x1-x0>src_w)
+    {
+        band_h=(dbcb_int32)(DBC_BLIT_TILE_BYTES)/(pixel_size*DBCB_TILE_STRIP_W);
+        if(band_h<1) band_h=1;
+        if(band_h>src_h) band_h=src_h;
+        strip_w=(dbcb_int32)(DBC_BLIT_TILE_BYTES)/(band_h*pixel_size);
+        if(strip_w>x1-x0+src_w) strip_w=x1-x0+src_w;
+        /* Not if it takes more dbc_blit() calls than tile by tile. */
+        if(strip_w>=2*src_w&&band_h*strip_w>=src_h*src_w)
+        {
+            strip=scratch;
+            strip_stride=strip_w*pixel_size;
+        }
+        else
+        {
+            strip_w=src_w;
+            band_h=src_h;
+        }
+    }
+    /* Band by band, so that each band is replicated once. */
+    for(v0=0;v0<src_h;v0+=band_h)
+    {
+        v1=(v0+band_h<src_h?v0+band_h:src_h);
+        if(strip==scratch)
+        {
+            for(j=v0;j<v1;++j)
+            {
+                dbcb_uint8 *row=scratch+(j-v0)*strip_stride;
+                dbcb_memcpy(row,src_pixels+j*src_stride_in_bytes,(size_t)(src_w*pixel_size));
+                /* Doubling copies. */
+                for(i=src_w;i<strip_w;i+=i)
+                    dbcb_memcpy(row+i*pixel_size,row,(size_t)((i<strip_w-i?i:strip_w-i)*pixel_size));
+            }
+        }
+        /* Y0 is the dst row of src row 0, in each period. */
+        for(Y0=y0-dbcB_mod(y0-y+phase_y,src_h);Y0+v0<y1;Y0+=src_h)
+        {
+            Y=Y0+v0;
+            if(Y<y0) Y=y0;
+            rows=(Y0+v1<y1?Y0+v1:y1)-Y;
+            if(rows<=0) continue;
+            v=Y-Y0;
+            for(X=x0;X<x1;X+=cols)
+            {
+                u=dbcB_mod(X-x+phase_x,src_w);
+                cols=strip_w-u;
+                if(cols>x1-X) cols=x1-X;
+                dbc_blit(
+                    cols,rows,strip_stride,strip+(strip==scratch?v-v0:v)*strip_stride+u*pixel_size,
+                    dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                    X,Y,
+                    color,
+                    mode);
+            }
+        }
+    }
+}
+
+DBCB_DEF void dbc_blit_nine_slice(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    int x,int y,int w,int h,
+    int left,int top,int right,int bottom,
+    const float *color,
+    int mode)
+{
+    dbcb_int32 pixel_size=dbcB_src_pixel_size(mode);
+    /* Src and dst x (y) of the 3 columns (rows), and their widths (heights). */
+    dbcb_int32 sx[3],dx[3],cw[3],sw[3],sy[3],dy[3],ch[3],sh[3];
+    dbcb_int32 i,j;
+    if(mode<DBCB_MODE_COPY||mode>DBCB_MODE_HALF_RESOLVE) return;
+    if(w<=0||h<=0||left<0||top<0||right<0||bottom<0) return;
+    if(left+right>src_w||top+bottom>src_h) return;
+    cw[0]=(left<w?left:w);
+    cw[2]=(right<w-cw[0]?right:w-cw[0]);
+    cw[1]=w-cw[0]-cw[2];
+    ch[0]=(top<h?top:h);
+    ch[2]=(bottom<h-ch[0]?bottom:h-ch[0]);
+    ch[1]=h-ch[0]-ch[2];
+    sx[0]=0; sx[1]=left; sx[2]=src_w-right;
+    sw[0]=left; sw[1]=src_w-left-right; sw[2]=right;
+    sy[0]=0; sy[1]=top;  sy[2]=src_h-bottom;
+    sh[0]=top;  sh[1]=src_h-top-bottom; sh[2]=bottom;
+    dx[0]=x; dx[1]=x+cw[0]; dx[2]=x+w-cw[2];
+    dy[0]=y; dy[1]=y+ch[0]; dy[2]=y+h-ch[2];
+    for(j=0;j<3;++j)
+        for(i=0;i<3;++i)
+        {
+            if(cw[i]<=0||ch[j]<=0||sw[i]<=0||sh[j]<=0) continue;
+            if(i!=1&&j!=1)
+                dbc_blit(
+                    cw[i],ch[j],src_stride_in_bytes,src_pixels+sy[j]*src_stride_in_bytes+sx[i]*pixel_size,
+                    dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                    dx[i],dy[j],
+                    color,
+                    mode);
+            else
+                dbc_blit_tiled(
+                    sw[i],sh[j],src_stride_in_bytes,src_pixels+sy[j]*src_stride_in_bytes+sx[i]*pixel_size,
+                    dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+                    dx[i],dy[j],cw[i],ch[j],
+                    0,0,
+                    color,
+                    mode);
+        }
+}
+
+/*============================================================================*/
+/* Gradient modulation */
+
+/*
+    Row of n pixels with gradient modulation: pixel i is modulated by color
+    c+i*dc, stepped incrementally, separately for even and odd pixels (by
+    2*dc), so that results match the 2-pixel lanes of dbcB_*_row_avx2.
+*/
+#define DBCB_DEF_GRADIENT_ROW(name,src_pixel_size,dst_pixel_size,blit)   \
+static void name(const dbcb_uint8 *s,dbcb_uint8 *d,dbcb_int32 n,        \
+    const float *c,const float *dc)                                     \
+{                                                                       \
+    float colors[8],dc2[4];                                             \
+    dbcb_int32 i,k;                                                     \
+    for(k=0;k<4;++k)                                                    \
+    {                                                                   \
+        colors[k]=c[k];                                                 \
+        colors[4+k]=c[k]+dc[k];                                         \
+        dc2[k]=dc[k]+dc[k];                                             \
+    }                                                                   \
+    for(i=0;i<n;++i)                                                    \
+    {                                                                   \
+        float *color=colors+4*(i&1);                                    \
+        blit;                                                           \
+        color[0]+=dc2[0]; color[1]+=dc2[1];                             \
+        color[2]+=dc2[2]; color[3]+=dc2[3];                             \
+        s+=src_pixel_size; d+=dst_pixel_size;                           \
+    }                                                                   \
+}
+
+DBCB_DEF_GRADIENT_ROW(dbcB_b32m_row_c   ,4,4,dbcB_b32m_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_blam_row_c   ,4,4,dbcB_blam_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_blpm_row_c   ,4,4,dbcB_blpm_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_blxm_row_c   ,4,4,dbcB_blxm_1_c(s,d,color))
+#ifndef DBC_BLIT_NO_GAMMA
+DBCB_DEF_GRADIENT_ROW(dbcB_b32g_row_c   ,4,4,dbcB_b32g_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bgam_row_c   ,4,4,dbcB_bgam_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bgpm_row_c   ,4,4,dbcB_bgpm_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bgxm_row_c   ,4,4,dbcB_bgxm_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bham_row_c   ,4,8,dbcB_bham_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bhpm_row_c   ,4,8,dbcB_bhpm_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bhxm_row_c   ,4,8,dbcB_bhxm_1_c(s,d,color))
+DBCB_DEF_GRADIENT_ROW(dbcB_bhrm_row_c   ,8,4,dbcB_bhrm_1_c(s,d,color))
+#endif /* DBC_BLIT_NO_GAMMA */
+
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_b32m_row_sse2,4,4,dbcB_b32m_1_sse2(s,d,color))
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_blam_row_sse2,4,4,dbcB_blam_1_sse2(s,d,color))
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_blpm_row_sse2,4,4,dbcB_blpm_1_sse2(s,d,color))
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_blxm_row_sse2,4,4,dbcB_blxm_1_sse2(s,d,color))
+#ifndef DBC_BLIT_NO_GAMMA
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_b32g_row_sse2,4,4,dbcB_b32g_1_sse2(s,d,color))
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_bgam_row_sse2,4,4,dbcB_bgam_1_sse2(s,d,color))
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_bgpm_row_sse2,4,4,dbcB_bgpm_1_sse2(s,d,color))
+DBCB_DECL_SSE2 DBCB_DEF_GRADIENT_ROW(dbcB_bgxm_row_sse2,4,4,dbcB_bgxm_1_sse2(s,d,color))
+#endif /* DBC_BLIT_NO_GAMMA */
+#endif
+
+/*
+    Same as DBCB_DEF_GRADIENT_ROW, 2 pixels at a time: blit2 takes the
+    colors of both pixels (8 floats), blit1 does the last odd pixel.
+    Colors are stepped the same way, so results match.
+*/
+#define DBCB_DEF_GRADIENT_ROW_2(name,src_pixel_size,dst_pixel_size,blit1,blit2)\
+static void name(const dbcb_uint8 *s,dbcb_uint8 *d,dbcb_int32 n,        \
+    const float *c,const float *dc)                                     \
+{                                                                       \
+    float colors[8],dc2[4];                                             \
+    dbcb_int32 i,k;                                                     \
+    for(k=0;k<4;++k)                                                    \
+    {                                                                   \
+        colors[k]=c[k];                                                 \
+        colors[4+k]=c[k]+dc[k];                                         \
+        dc2[k]=dc[k]+dc[k];                                             \
+    }                                                                   \
+    for(i=0;i+2<=n;i+=2)                                                \
+    {                                                                   \
+        blit2;                                                          \
+        for(k=0;k<8;++k) colors[k]+=dc2[k&3];                           \
+        s+=2*src_pixel_size; d+=2*dst_pixel_size;                       \
+    }                                                                   \
+    if(n&1) blit1;                                                      \
+}
+
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64) && !defined(DBC_BLIT_NO_AVX2) && !defined(DBC_BLIT_NO_GAMMA)
+DBCB_DECL_AVX2 DBCB_DEF_GRADIENT_ROW_2(dbcB_b32g_row_avx2,4,4,dbcB_b32g_1_avx2(s,d,colors),dbcB_b32g_2g_avx2(s,d,colors))
+DBCB_DECL_AVX2 DBCB_DEF_GRADIENT_ROW_2(dbcB_bgam_row_avx2,4,4,dbcB_bgam_1_avx2(s,d,colors),dbcB_bgam_2g_avx2(s,d,colors))
+DBCB_DECL_AVX2 DBCB_DEF_GRADIENT_ROW_2(dbcB_bgpm_row_avx2,4,4,dbcB_bgpm_1_avx2(s,d,colors),dbcB_bgpm_2g_avx2(s,d,colors))
+DBCB_DECL_AVX2 DBCB_DEF_GRADIENT_ROW_2(dbcB_bgxm_row_avx2,4,4,dbcB_bgxm_1_avx2(s,d,colors),dbcB_bgxm_2g_avx2(s,d,colors))
+DBCB_DECL_F16C DBCB_DEF_GRADIENT_ROW_2(dbcB_bham_row_f16c,4,8,dbcB_bham_1_c(s,d,colors),dbcB_bham_2g_f16c(s,d,colors))
+DBCB_DECL_F16C DBCB_DEF_GRADIENT_ROW_2(dbcB_bhpm_row_f16c,4,8,dbcB_bhpm_1_c(s,d,colors),dbcB_bhpm_2g_f16c(s,d,colors))
+DBCB_DECL_F16C DBCB_DEF_GRADIENT_ROW_2(dbcB_bhxm_row_f16c,4,8,dbcB_bhxm_1_c(s,d,colors),dbcB_bhxm_2g_f16c(s,d,colors))
+DBCB_DECL_F16C DBCB_DEF_GRADIENT_ROW_2(dbcB_bhrm_row_f16c,8,4,dbcB_bhrm_1_c(s,d,colors),dbcB_bhrm_2g_f16c(s,d,colors))
+#endif
+
+#undef DBCB_DEF_GRADIENT_ROW
+#undef DBCB_DEF_GRADIENT_ROW_2
+
+/*
+    Row of n pixels with fixed-point gradient modulation: c and dc are
+    colors in 16.16 fixed point, pixel i is modulated with multipliers
+    (c+i*dc)>>16 (see dbcB_color2mul16()), sums wrap. The caller keeps
+    the sums in [0;2^32) over the row, so no saturation is needed.
+    Integer stepping is exact, so SIMD rows (dbcB_*k_row_sse2(), etc.)
+    give the same results.
+*/
+#define DBCB_DEF_GRADIENT_ROW_K(name,blit)                               \
+static void name(const dbcb_uint8 *s,dbcb_uint8 *d,dbcb_int32 n,        \
+    const dbcb_uint32 *c,const dbcb_uint32 *dc)                         \
+{                                                                       \
+    dbcb_uint32 M[4];                                                   \
+    dbcb_int32 i,k;                                                     \
+    dbcb_uint16 mul[4];                                                 \
+    for(k=0;k<4;++k) M[k]=c[k];                                         \
+    for(i=0;i<n;++i)                                                    \
+    {                                                                   \
+        for(k=0;k<4;++k)                                                \
+        {                                                               \
+            mul[k]=(dbcb_uint16)(M[k]>>16);                             \
+            M[k]+=dc[k];                                                \
+        }                                                               \
+        blit;                                                           \
+        s+=4; d+=4;                                                     \
+    }                                                                   \
+}
+
+DBCB_DEF_GRADIENT_ROW_K(dbcB_b32k_row_c,dbcB_b32k_1_c(s,d,mul))
+DBCB_DEF_GRADIENT_ROW_K(dbcB_blak_row_c,dbcB_blak_1_c(s,d,mul))
+DBCB_DEF_GRADIENT_ROW_K(dbcB_blpk_row_c,dbcB_blpk_1_c(s,d,mul))
+DBCB_DEF_GRADIENT_ROW_K(dbcB_blxk_row_c,dbcB_blxk_1_c(s,d,mul))
+
+#undef DBCB_DEF_GRADIENT_ROW_K
+
+/*
+    Tier: 0 - C, 1 - SSE2, 2 - SSE4.1, 3 - AVX2 (see DBCB_STATS_TIER_*).
+    Mode is one of DBCB_MODE_COPY, DBCB_MODE_ALPHA, DBCB_MODE_PMA,
+    DBCB_MODE_MUL.
+*/
+static void dbcB_gradient_row_k(int mode,int tier,
+    const dbcb_uint8 *s,dbcb_uint8 *d,dbcb_int32 n,const dbcb_uint32 *c,const dbcb_uint32 *dc)
+{
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+#ifndef DBC_BLIT_NO_AVX2
+    if(tier==DBCB_STATS_TIER_AVX2)
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_COPY:  dbcB_b32k_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_ALPHA: dbcB_blak_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_PMA:   dbcB_blpk_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_MUL:   dbcB_blxk_row_avx2(s,d,n,c,dc); return;
+        }
+    }
+#endif /* DBC_BLIT_NO_AVX2 */
+#ifndef DBC_BLIT_NO_SSE41
+    if(tier==DBCB_STATS_TIER_SSE41)
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_COPY:  dbcB_b32k_row_sse41(s,d,n,c,dc); return;
+            case DBCB_MODE_ALPHA: dbcB_blak_row_sse41(s,d,n,c,dc); return;
+            case DBCB_MODE_PMA:   dbcB_blpk_row_sse41(s,d,n,c,dc); return;
+            case DBCB_MODE_MUL:   dbcB_blxk_row_sse41(s,d,n,c,dc); return;
+        }
+    }
+#endif /* DBC_BLIT_NO_SSE41 */
+    if(tier)
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_COPY:  dbcB_b32k_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_ALPHA: dbcB_blak_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_PMA:   dbcB_blpk_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_MUL:   dbcB_blxk_row_sse2(s,d,n,c,dc); return;
+        }
+    }
+#else
+    (void)tier;
+#endif
+    switch(mode)
+    {
+        case DBCB_MODE_COPY:  dbcB_b32k_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_ALPHA: dbcB_blak_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_PMA:   dbcB_blpk_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_MUL:   dbcB_blxk_row_c(s,d,n,c,dc); break;
+    }
+}
+
+/* Tier: 0 - C, 1 - SSE2, 3 - AVX2 (F16C for half-float modes, see DBCB_STATS_TIER_*). */
+static void dbcB_gradient_row(int mode,int tier,
+    const dbcb_uint8 *s,dbcb_uint8 *d,dbcb_int32 n,const float *c,const float *dc)
+{
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+#ifndef DBC_BLIT_NO_AVX2
+    if(tier==DBCB_STATS_TIER_AVX2)
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_COPY:  dbcB_b32m_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_ALPHA: dbcB_blam_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_PMA:   dbcB_blpm_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_MUL:   dbcB_blxm_row_avx2(s,d,n,c,dc); return;
+#ifndef DBC_BLIT_NO_GAMMA
+            case DBCB_MODE_CPYG:         dbcB_b32g_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_GAMMA:        dbcB_bgam_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_PMG:          dbcB_bgpm_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_MUG:          dbcB_bgxm_row_avx2(s,d,n,c,dc); return;
+            case DBCB_MODE_HALF_ALPHA:   dbcB_bham_row_f16c(s,d,n,c,dc); return;
+            case DBCB_MODE_HALF_PMA:     dbcB_bhpm_row_f16c(s,d,n,c,dc); return;
+            case DBCB_MODE_HALF_MUL:     dbcB_bhxm_row_f16c(s,d,n,c,dc); return;
+            case DBCB_MODE_HALF_RESOLVE: dbcB_bhrm_row_f16c(s,d,n,c,dc); return;
+#endif /* DBC_BLIT_NO_GAMMA */
+        }
+    }
+#endif /* DBC_BLIT_NO_AVX2 */
+    if(tier)
+    {
+        switch(mode)
+        {
+            case DBCB_MODE_COPY:  dbcB_b32m_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_ALPHA: dbcB_blam_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_PMA:   dbcB_blpm_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_MUL:   dbcB_blxm_row_sse2(s,d,n,c,dc); return;
+#ifndef DBC_BLIT_NO_GAMMA
+            case DBCB_MODE_CPYG:  dbcB_b32g_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_GAMMA: dbcB_bgam_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_PMG:   dbcB_bgpm_row_sse2(s,d,n,c,dc); return;
+            case DBCB_MODE_MUG:   dbcB_bgxm_row_sse2(s,d,n,c,dc); return;
+#endif /* DBC_BLIT_NO_GAMMA */
+        }
+    }
+#else
+    (void)tier;
+#endif
+    switch(mode)
+    {
+        case DBCB_MODE_COPY:         dbcB_b32m_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_ALPHA:        dbcB_blam_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_PMA:          dbcB_blpm_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_MUL:          dbcB_blxm_row_c(s,d,n,c,dc); break;
+#ifndef DBC_BLIT_NO_GAMMA
+        case DBCB_MODE_CPYG:         dbcB_b32g_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_GAMMA:        dbcB_bgam_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_PMG:          dbcB_bgpm_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_MUG:          dbcB_bgxm_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_HALF_ALPHA:   dbcB_bham_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_HALF_PMA:     dbcB_bhpm_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_HALF_MUL:     dbcB_bhxm_row_c(s,d,n,c,dc); break;
+        case DBCB_MODE_HALF_RESOLVE: dbcB_bhrm_row_c(s,d,n,c,dc); break;
+#endif /* DBC_BLIT_NO_GAMMA */
+    }
+}
+
+DBCB_DEF void dbc_blit_gradient(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *corners,
+    int mode)
+{
+    dbcb_int32 pixel_size=dbcB_src_pixel_size(mode),dst_pixel_size=dbcB_dst_pixel_size(mode);
+    dbcb_int32 x0,y0,x1,y1,i,j;
+    dbcb_uint32 ck[8],dck[8];
+    float left[4],right[4],step[4],c[4];
+    double km[8],kq[8],iw,ih;
+    int tier=DBCB_STATS_TIER_C,fixed;
+    if(mode<DBCB_MODE_COPY||mode>DBCB_MODE_HALF_RESOLVE) return;
+    if(!corners||mode==DBCB_MODE_COLORKEY8||mode==DBCB_MODE_COLORKEY16||
+        mode==DBCB_MODE_5551||mode==DBCB_MODE_ALPHATEST)
+    {
+        /* Not a gradient: same as dbc_blit() with the top-left color. */
+        dbc_blit(
+            src_w,src_h,src_stride_in_bytes,src_pixels,
+            dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+            x,y,
+            corners,
+            mode);
+        return;
+    }
+#ifdef DBC_BLIT_NO_GAMMA
+    if(mode!=DBCB_MODE_COPY&&mode!=DBCB_MODE_ALPHA&&mode!=DBCB_MODE_PMA&&mode!=DBCB_MODE_MUL) return;
+#endif
+    /* Visible part, in src coordinates. */
+    x0=(x<0?-x:0); x1=src_w; if(x+x1>dst_w) x1=dst_w-x;
+    y0=(y<0?-y:0); y1=src_h; if(y+y1>dst_h) y1=dst_h-y;
+    if(x0>=x1||y0>=y1)
+    {
+        DBCB_STATS_BLIT(DBCB_STATS_TIER_C);
+        return;
+    }
+    dbc_blit(0,0,0,0,0,0,0,0,0,0,0,0); /* Initialization. */
+    /* Linear modes with corners in [0;1] use fixed-point multipliers. */
+    fixed=(mode<=DBCB_MODE_PMA||mode==DBCB_MODE_MUL);
+    for(i=0;i<4;++i)
+        if(!dbcB_color_in_0_1(corners+4*i)) fixed=0;
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+    if(mode<DBCB_MODE_HALF_ALPHA&&DBCB_HAS_SSE2&&(dbcb_allow_sse2_for_mode(mode,1)))
+        tier=DBCB_STATS_TIER_SSE2;
+#ifndef DBC_BLIT_NO_SSE41
+    if(fixed)
+        if(DBCB_HAS_SSE41&&(dbcb_allow_sse41_for_mode(mode,1)))
+            tier=DBCB_STATS_TIER_SSE41;
+#endif /* DBC_BLIT_NO_SSE41 */
+#ifndef DBC_BLIT_NO_AVX2
+    /*
+        With gamma tables the gamma and resolve kernels are plain C, and
+        calling them from the AVX2 rows costs an SSE/AVX transition per
+        pixel, so these modes stay on the SSE2 rows.
+    */
+    if(DBCB_HAS_AVX2&&(dbcb_allow_avx2_for_mode(mode,1))&&(mode<DBCB_MODE_HALF_ALPHA||DBCB_HAS_F16C))
+#ifndef DBC_BLIT_GAMMA_NO_TABLES
+        if(mode<=DBCB_MODE_PMA||mode==DBCB_MODE_MUL||(mode>=DBCB_MODE_HALF_ALPHA&&mode<=DBCB_MODE_HALF_MUL))
+#endif
+            tier=DBCB_STATS_TIER_AVX2;
+#endif /* DBC_BLIT_NO_AVX2 */
+#endif
+    DBCB_STATS_BLIT(tier);
+    dbcb_trace_begin(mode,(int)(x1-x0),(int)(y1-y0),tier);
+    if(fixed)
+    {
+        /*
+            16.16 fixed point, with the bias for rounding to 16 bits.
+            Colors are scaled by 65535*65536, so multipliers are
+            round(c*65535), within 1 of dbcB_color2mul16() and the same for
+            0 and 1. Then sums stay in [2^15;2^32-2^15] over the row, with
+            the step truncated towards zero. Both the row start and the
+            step are linear in j, and are stepped in double: the drift is
+            far below the 2^15 margin.
+        */
+        iw=(src_w>1?1.0/(double)(src_w-1):0.0);
+        ih=(src_h>1?1.0/(double)(src_h-1):0.0);
+        for(i=0;i<4;++i)
+        {
+            double t0=(double)corners[4+i]-(double)corners[i],t1=(double)corners[12+i]-(double)corners[8+i];
+            double a0=corners[i]+t0*iw*(double)x0,a1=corners[8+i]+t1*iw*(double)x0;
+            km[4+i]=(a1-a0)*4294901760.0*ih;
+            km[i]=a0*4294901760.0+32768.0+km[4+i]*(double)y0;
+            kq[4+i]=(t1-t0)*iw*4294901760.0*ih;
+            kq[i]=t0*iw*4294901760.0+kq[4+i]*(double)y0;
+        }
+        /* Row j+1 is set up before row j is blitted, to overlap the two. */
+        for(j=y0;j<=y1;++j)
+        {
+            dbcb_uint32 *k=ck+4*(j&1),*dk=dck+4*(j&1);
+            for(i=0;i<4&&j<y1;++i)
+            {
+                double m=km[i],q=kq[i];
+                km[i]+=km[4+i];
+                kq[i]+=kq[4+i];
+#ifndef DBC_BLIT_NO_INT64
+                k[i]=(dbcb_uint32)(dbcb_int64)m;
+                dk[i]=(dbcb_uint32)(dbcb_int64)q;
+#else
+                k[i]=(dbcb_uint32)m;
+                dk[i]=(q<0.0?0u-(dbcb_uint32)(-q):(dbcb_uint32)q);
+#endif
+            }
+            if(j>y0)
+                dbcB_gradient_row_k(mode,tier,
+                    src_pixels+(j-1)*src_stride_in_bytes+x0*pixel_size,
+                    dst_pixels+(y+j-1)*dst_stride_in_bytes+(x+x0)*dst_pixel_size,
+                    x1-x0,ck+4*((j-1)&1),dck+4*((j-1)&1));
+        }
+        dbcb_trace_end();
+        return;
+    }
+    for(j=y0;j<y1;++j)
+    {
+        /* Row ends are interpolated directly, pixels in between incrementally. */
+        float fy=(src_h>1?(float)j/(float)(src_h-1):0.0f);
+        for(i=0;i<4;++i)
+        {
+            left[i]=corners[i]+(corners[8+i]-corners[i])*fy;
+            right[i]=corners[4+i]+(corners[12+i]-corners[4+i])*fy;
+            step[i]=(src_w>1?(right[i]-left[i])/(float)(src_w-1):0.0f);
+            c[i]=left[i]+step[i]*(float)x0;
+        }
+        dbcB_gradient_row(mode,tier,
+            src_pixels+j*src_stride_in_bytes+x0*pixel_size,
+            dst_pixels+(y+j)*dst_stride_in_bytes+(x+x0)*dst_pixel_size,
+            x1-x0,c,step);
+    }
+    dbcb_trace_end();
+}
+
+/*============================================================================*/
+/* Command buffers */
+
+DBCB_DEF void dbcb_cmdbuf_init(
+    dbcb_cmdbuf *buf,
+    dbcb_layer *layers,
+    float *colors,
+    int capacity)
+{
+    buf->layers=layers;
+    buf->colors=colors;
+    buf->capacity=(capacity>0?capacity:0);
+    buf->count=0;
+    buf->dropped=0;
+}
+
+DBCB_DEF void dbcb_cmdbuf_clear(dbcb_cmdbuf *buf)
+{
+    buf->count=0;
+    buf->dropped=0;
+}
+
+DBCB_DEF int dbcb_cmdbuf_blit(
+    dbcb_cmdbuf *buf,
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int x,int y,
+    const float *color,
+    int mode)
+{
+    dbcb_layer *l;
+    if(buf->count>=buf->capacity) {++buf->dropped;return 0;}
+    l=buf->layers+buf->count;
+    l->w=src_w;
+    l->h=src_h;
+    l->stride=src_stride_in_bytes;
+    l->pixels=src_pixels;
+    l->x=x;
+    l->y=y;
+    l->color=0;
+    l->mode=mode;
+    l->flags=0;
+    if(color)
+    {
+        /* Color is kept in the buffer, so the caller's copy can go away. */
+        float *c=buf->colors+4*buf->count;
+        c[0]=color[0];
+        c[1]=color[1];
+        c[2]=color[2];
+        c[3]=color[3];
+        l->color=c;
+    }
+    ++buf->count;
+    return 1;
+}
+
+DBCB_DEF void dbc_blit_cmdbuf(
+    int dst_w,int dst_h,int dst_stride_in_bytes,
+    unsigned char *dst_pixels,
+    const dbcb_cmdbuf *buf)
+{
+    int i;
+    for(i=0;i<buf->count;++i)
+    {
+        const dbcb_layer *l=buf->layers+i;
+        dbc_blit(
+            l->w,l->h,l->stride,l->pixels,
+            dst_w,dst_h,dst_stride_in_bytes,dst_pixels,
+            l->x,l->y,
+            l->color,
+            l->mode);
+    }
+}
+
+/*============================================================================*/
+/* Tiled framebuffer */
+
+DBCB_DEF int dbcb_tiled_fb_size(int dst_w,int dst_h,int pixel_size)
+{
+    const int T=DBCB_FB_TILE;
+    int tiles_x,tiles_y;
+    if(dst_w<=0||dst_h<=0||pixel_size<=0) return 0;
+    tiles_x=dst_w/T+(dst_w%T!=0);
+    tiles_y=dst_h/T+(dst_h%T!=0);
+    if(tiles_x>0x7FFFFFFF/(T*T*pixel_size)/tiles_y) return 0;
+    return tiles_x*tiles_y*T*T*pixel_size;
+}
+
+DBCB_DEF void dbc_blit_tiled_fb(
+    int src_w,int src_h,int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode)
+{
+    const int T=DBCB_FB_TILE;
+    int ps=dbcB_dst_pixel_size(mode);
+    int tiles_x=(dst_w+T-1)/T;
+    int x0=x,y0=y,x1=x+src_w,y1=y+src_h;
+    int tx,ty;
+    if(x0<0) x0=0;
+    if(y0<0) y0=0;
+    if(x1>dst_w) x1=dst_w;
+    if(y1>dst_h) y1=dst_h;
+    if(x0>=x1||y0>=y1) return;
+    for(ty=y0/T;ty<=(y1-1)/T;++ty)
+    {
+        int th=(dst_h-ty*T<T?dst_h-ty*T:T);
+        for(tx=x0/T;tx<=(x1-1)/T;++tx)
+        {
+            int tw=(dst_w-tx*T<T?dst_w-tx*T:T);
+            dbc_blit(
+                src_w,src_h,src_stride_in_bytes,src_pixels,
+                tw,th,T*ps,dst_pixels+(ty*tiles_x+tx)*T*T*ps,
+                x-tx*T,y-ty*T,
+                color,
+                mode);
+        }
+    }
+}
+
+/* Copies between linear image and tiled framebuffer. */
+static void dbcB_tiled_fb_copy(
+    int w,int h,int pixel_size,
+    unsigned char *linear,int stride,
+    unsigned char *tiled,
+    int detile)
+{
+    const int T=DBCB_FB_TILE;
+    int tiles_x=(w+T-1)/T;
+    int tile_row=T*pixel_size;
+    int i,tx;
+    for(i=0;i<h;++i)
+    {
+        unsigned char *l=linear+i*stride;
+        unsigned char *t=tiled+((i/T)*tiles_x*T+(i%T))*tile_row;
+        for(tx=0;tx<tiles_x;++tx)
+        {
+            int n=(w-tx*T<T?w-tx*T:T)*pixel_size;
+            if(detile) dbcb_memcpy(l,t,(size_t)n);
+            else       dbcb_memcpy(t,l,(size_t)n);
+            l+=tile_row;
+            t+=T*tile_row;
+        }
+    }
+}
+
+DBCB_DEF void dbcb_tiled_fb_load(
+    int w,int h,int pixel_size,
+    int src_stride_in_bytes,
+    const unsigned char *src_pixels,
+    unsigned char *tiled_pixels)
+{
+    dbcB_tiled_fb_copy(w,h,pixel_size,(unsigned char*)src_pixels,src_stride_in_bytes,tiled_pixels,0);
+}
+
+DBCB_DEF void dbcb_tiled_fb_detile(
+    int w,int h,int pixel_size,
+    const unsigned char *tiled_pixels,
+    int dst_stride_in_bytes,
+    unsigned char *dst_pixels)
+{
+    dbcB_tiled_fb_copy(w,h,pixel_size,dst_pixels,dst_stride_in_bytes,(unsigned char*)tiled_pixels,1);
+}
+
+/*============================================================================*/
+/* Autotuning */
+
+#ifdef DBC_BLIT_AUTOTUNE
+
+#ifndef DBC_BLIT_AUTOTUNE_MS
+#define DBC_BLIT_AUTOTUNE_MS 2
+#endif
+
+#define DBCB_TUNE_W 256
+#define DBCB_TUNE_H 16
+
+static dbcb_uint8 dbcB_tune_src[DBCB_TUNE_W*DBCB_TUNE_H*8];
+static dbcb_uint8 dbcB_tune_dst[DBCB_TUNE_W*DBCB_TUNE_H*8];
+static dbcb_uint8 dbcB_tune_ref[DBCB_TUNE_W*DBCB_TUNE_H*8];
+
+/* Seconds per blit of w x DBCB_TUNE_H sprite (dst is restored before each). */
+static double dbcB_tune_measure(int mode,const float *color,dbcb_int32 w)
+{
+    dbcb_int32 ps=dbcB_dst_pixel_size(mode),sps=dbcB_src_pixel_size(mode),i;
+    clock_t t0,t1,limit=(clock_t)((double)CLOCKS_PER_SEC*(DBC_BLIT_AUTOTUNE_MS)/1000.0);
+    double n=0.0;
+    if(limit<1) limit=1;
+    t0=clock();
+    do
+    {
+        for(i=0;i<16;++i)
+        {
+            dbcb_memcpy(dbcB_tune_dst,dbcB_tune_ref,(size_t)(w*DBCB_TUNE_H*ps));
+            dbc_blit(
+                w,DBCB_TUNE_H,w*sps,dbcB_tune_src,
+                w,DBCB_TUNE_H,w*ps,dbcB_tune_dst,
+                0,0,
+                color,
+                mode);
+        }
+        n+=16.0;
+        t1=clock();
+    } while(t1-t0<limit);
+    return (double)(t1-t0)/(double)CLOCKS_PER_SEC/n;
+}
+
+/* Best of 3, to filter out interruptions. */
+static double dbcB_tune_measure3(int mode,const float *color,dbcb_int32 w)
+{
+    double t=dbcB_tune_measure(mode,color,w),u;
+    u=dbcB_tune_measure(mode,color,w); if(u<t) t=u;
+    u=dbcB_tune_measure(mode,color,w); if(u<t) t=u;
+    return t;
+}
+
+DBCB_DEF void dbcb_autotune(void)
+{
+    static const dbcb_int32 widths[DBCB_TUNE_BUCKETS]={6,24,96,DBCB_TUNE_W};
+    static const float color[4]={0.9f,0.8f,0.7f,0.6f};
+    static const float key[4]={0.0f,0.0f,0.0f,0.0f};
+    static const float threshold[4]={100.0f,0.0f,0.0f,0.0f};
+    dbcb_uint32 rng=1u;
+    dbcb_int32 i,mode,modulated,b,t;
+    int max_tier=1,has_sse41=0,has_f16c=0;
+    dbc_blit(0,0,0,0,0,0,0,0,0,0,0,0); /* Initialization. */
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+    if(dbcB_has_sse2) max_tier=2;
+#ifndef DBC_BLIT_NO_SSE41
+    if(dbcB_has_sse2&&dbcB_has_sse41) max_tier=3;
+    has_sse41=dbcB_has_sse41;
+#endif
+#ifndef DBC_BLIT_NO_AVX2
+    if(dbcB_has_sse2&&dbcB_has_avx2) max_tier=4;
+    has_f16c=dbcB_has_f16c;
+#endif
+#endif
+    /*
+        Random pixels, with alpha (top byte of each 32-bit word)
+        0, 255, or random in roughly equal proportion.
+    */
+    for(i=0;i<(dbcb_int32)sizeof(dbcB_tune_src);++i)
+    {
+        rng=rng*1664525u+1013904223u;
+        dbcB_tune_src[i]=(dbcb_uint8)(rng>>24);
+        if((i&3)==3) dbcB_tune_src[i]=(rng>>16)%3==0?0:((rng>>16)%3==1?255:dbcB_tune_src[i]);
+        rng=rng*1664525u+1013904223u;
+        dbcB_tune_ref[i]=(dbcb_uint8)(rng>>24);
+    }
+    for(mode=DBCB_MODE_COPY;mode<DBCB_TUNE_MODES;++mode)
+    {
+#ifdef DBC_BLIT_NO_GAMMA
+        if(mode==DBCB_MODE_GAMMA||mode==DBCB_MODE_PMG||mode==DBCB_MODE_MUG||mode>=DBCB_MODE_CPYG) continue;
+#endif
+        for(modulated=0;modulated<2;++modulated)
+        {
+            const float *c=0;
+            if(modulated)
+            {
+                switch(mode)
+                {
+                    case DBCB_MODE_COLORKEY8:
+                    case DBCB_MODE_COLORKEY16: c=key; break;
+                    case DBCB_MODE_ALPHATEST:  c=threshold; break;
+                    case DBCB_MODE_5551:       c=0; break; /* Ignores modulation. */
+                    default:                   c=color; break;
+                }
+            }
+            for(b=0;b<DBCB_TUNE_BUCKETS;++b)
+            {
+                double best=-1.0;
+                int best_tier=max_tier;
+                for(t=max_tier;t>=1;--t)
+                {
+                    double u;
+                    if(t==4&&mode>=DBCB_MODE_HALF_ALPHA&&!has_f16c) continue;
+#ifndef DBC_BLIT_NO_SSE41
+                    if(t==3&&(!has_sse41||!dbcB_sse41_mode(mode,modulated))) continue;
+#else
+                    if(t==3) continue;
+#endif
+                    if(t==2&&mode>=DBCB_MODE_HALF_ALPHA) continue;
+                    dbcB_tune_force=t;
+                    u=dbcB_tune_measure3(mode,c,widths[b]);
+                    /* Lower tier has to be noticeably faster to win. */
+                    if(best<0.0||u<0.97*best) {best=u;best_tier=t;}
+                }
+                dbcB_tune_force=0;
+                dbcB_tune_tier[mode][modulated][b]=(dbcb_uint8)best_tier;
+            }
+            dbcB_tune_no_unroll[mode][modulated]=0;
+#if DBC_BLIT_UNROLL>0
+            {
+                /* Unrolling only matters for narrow sprites. */
+                double u0,u1;
+                u0=dbcB_tune_measure3(mode,c,widths[0]);
+                dbcB_tune_no_unroll[mode][modulated]=1;
+                u1=dbcB_tune_measure3(mode,c,widths[0]);
+                dbcB_tune_no_unroll[mode][modulated]=(dbcb_uint8)(u1<0.97*u0);
+            }
+#endif
+        }
+    }
+}
+
+/* Describes the CPU and configuration the table is valid for. */
+static void dbcB_tune_signature(int *sig)
+{
+    sig[0]=0;
+    sig[1]=0;
+    sig[2]=0;
+    sig[3]=0;
+    sig[4]=(DBC_BLIT_UNROLL);
+#if !defined(DBC_BLIT_NO_SIMD) && defined(DBCB_X86_OR_X64)
+    sig[0]=dbcB_has_sse2;
+#ifndef DBC_BLIT_NO_SSE41
+    sig[1]=dbcB_has_sse41;
+#endif
+#ifndef DBC_BLIT_NO_AVX2
+    sig[2]=dbcB_has_avx2;
+    sig[3]=dbcB_has_f16c;
+#endif
+#endif
+}
+
+DBCB_DEF int dbcb_autotune_save(const char *filename)
+{
+    FILE *f;
+    int sig[5],mode,modulated,ok;
+    dbc_blit(0,0,0,0,0,0,0,0,0,0,0,0); /* Initialization. */
+    dbcB_tune_signature(sig);
+    f=fopen(filename,"w");
+    if(!f) return 0;
+    fprintf(f,"dbc_blit autotune 2\n");
+    fprintf(f,"%d %d %d %d %d\n",sig[0],sig[1],sig[2],sig[3],sig[4]);
+    for(mode=0;mode<DBCB_TUNE_MODES;++mode)
+        for(modulated=0;modulated<2;++modulated)
+            fprintf(f,"%d %d %d %d %d %d %d\n",mode,modulated,
+                dbcB_tune_tier[mode][modulated][0],dbcB_tune_tier[mode][modulated][1],
+                dbcB_tune_tier[mode][modulated][2],dbcB_tune_tier[mode][modulated][3],
+                dbcB_tune_no_unroll[mode][modulated]);
+    ok=!ferror(f);
+    if(fclose(f)) ok=0;
+    return ok;
+}
+
+DBCB_DEF int dbcb_autotune_load(const char *filename)
+{
+    dbcb_uint8 tier[DBCB_TUNE_MODES][2][DBCB_TUNE_BUCKETS];
+    dbcb_uint8 no_unroll[DBCB_TUNE_MODES][2];
+    FILE *f;
+    int sig[5],s[5],version=0,i,j,ok=1;
+    dbc_blit(0,0,0,0,0,0,0,0,0,0,0,0); /* Initialization. */
+    dbcB_tune_signature(sig);
+    f=fopen(filename,"r");
+    if(!f) return 0;
+    if(fscanf(f,"dbc_blit autotune %d",&version)!=1||version!=2) ok=0;
+    if(ok&&fscanf(f,"%d %d %d %d %d",s+0,s+1,s+2,s+3,s+4)!=5) ok=0;
+    for(i=0;ok&&i<5;++i) if(s[i]!=sig[i]) ok=0;
+    for(i=0;ok&&i<DBCB_TUNE_MODES*2;++i)
+    {
+        int v[7];
+        if(fscanf(f,"%d %d %d %d %d %d %d",v+0,v+1,v+2,v+3,v+4,v+5,v+6)!=7) {ok=0;break;}
+        if(v[0]!=i/2||v[1]!=i%2) {ok=0;break;}
+        for(j=2;j<6;++j) if(v[j]<0||v[j]>4) ok=0;
+        if(v[6]<0||v[6]>1) ok=0;
+        for(j=0;j<DBCB_TUNE_BUCKETS;++j) tier[i/2][i%2][j]=(dbcb_uint8)v[2+j];
+        no_unroll[i/2][i%2]=(dbcb_uint8)v[6];
+    }
+    fclose(f);
+    if(!ok) return 0;
+    dbcb_memcpy(dbcB_tune_tier,tier,sizeof(tier));
+    dbcb_memcpy(dbcB_tune_no_unroll,no_unroll,sizeof(no_unroll));
+    return 1;
+}
+
+#endif /* DBC_BLIT_AUTOTUNE */
+
+#ifdef DBC_BLIT_STATS
+/*============================================================================*/
+/* Statistics */
+
+DBCB_DEF void dbcb_stats_snapshot(dbcb_stats *stats)
+{
+    *stats=dbcB_stats;
+}
+
+DBCB_DEF void dbcb_stats_reset(void)
+{
+    static dbcb_stats zero; /* Never written to. */
+    dbcB_stats=zero;
+}
+#endif /* DBC_BLIT_STATS */
+
 #ifdef _MSC_VER
 #pragma warning( pop )
 #endif
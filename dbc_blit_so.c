@@ -0,0 +1,98 @@
+/*
+    Linux shared library (libdbc_blit.so) build of dbc_blit.h.
+    See Makefile, target 'shared'.
+
+    On x86/x64 this file is compiled several times. With DBCB_SO_TIER set
+    to c, sse2, sse41, or avx2 (and matching compiler flags, e.g.
+    -DDBC_BLIT_NO_SIMD for c, -mavx2 -mf16c for avx2) it produces
+    a complete hidden copy of the library, with every API function
+    aliased under a name suffixed by the tier (dbc_blit_avx2(), etc.). Since the instruction
+    set is enabled globally, each copy has no runtime CPU checks in it.
+    Without DBCB_SO_TIER it produces the exported API functions, which are
+    GNU IFUNC symbols: the dynamic loader calls the resolver once, when the
+    library is loaded, and binds the symbol directly to the best copy.
+
+    On other architectures it is compiled once, without DBCB_SO_TIER and
+    with DBCB_SO_SINGLE, as plain shared library.
+*/
+
+/* List of API functions: X(name). */
+#define DBCB_SO_API(X)          \
+    X(dbc_blit)                 \
+    X(dbc_blit_layers)          \
+    X(dbcb_damage_clear)        \
+    X(dbcb_damage_add)          \
+    X(dbcb_damage_add_blit)     \
+    X(dbc_blit_layers_damaged)  \
+    X(dbcb_coverage_size)       \
+    X(dbc_blit_layers_culled)   \
+    X(dbcb_analyze_sprite)      \
+    X(dbc_blit_analyzed)        \
+    X(dbc_blit_masked)          \
+    X(dbc_blit_tiled)           \
+    X(dbc_blit_nine_slice)      \
+    X(dbc_blit_gradient)        \
+    X(dbcb_cmdbuf_init)         \
+    X(dbcb_cmdbuf_clear)        \
+    X(dbcb_cmdbuf_blit)         \
+    X(dbc_blit_cmdbuf)          \
+    X(dbcb_tiled_fb_size)       \
+    X(dbc_blit_tiled_fb)        \
+    X(dbcb_tiled_fb_load)       \
+    X(dbcb_tiled_fb_detile)
+
+#if defined(DBCB_SO_SINGLE)
+
+#define DBC_BLIT_IMPLEMENTATION
+#include "dbc_blit.h"
+
+#elif defined(DBCB_SO_TIER)
+
+#define DBCB_SO_PASTE2(a,b) a##_##b
+#define DBCB_SO_PASTE(a,b) DBCB_SO_PASTE2(a,b)
+
+/* Static copy of the library, API functions exported to the resolver via aliases. */
+#define DBC_BLIT_STATIC
+#define DBC_BLIT_IMPLEMENTATION
+#include "dbc_blit.h"
+
+/* Compiled with -fvisibility=hidden, so nothing here is exported. */
+#define DBCB_SO_ALIAS(name) extern __typeof__(name) DBCB_SO_PASTE(name,DBCB_SO_TIER) __attribute__((alias(#name)));
+DBCB_SO_API(DBCB_SO_ALIAS)
+#undef DBCB_SO_ALIAS
+
+#else /* Resolver. */
+
+#include "dbc_blit.h"
+
+#define DBCB_SO_DECL(name) extern __typeof__(name) name##_c,name##_sse2,name##_sse41,name##_avx2;
+DBCB_SO_API(DBCB_SO_DECL)
+#undef DBCB_SO_DECL
+
+/* Same requirements as in dbcB_init(): AVX2 versions also use F16C. */
+static int dbcB_so_tier(void)
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")&&__builtin_cpu_supports("f16c")) return 4;
+    if(__builtin_cpu_supports("sse4.1")&&__builtin_cpu_supports("ssse3")) return 3;
+    if(__builtin_cpu_supports("sse2")) return 2;
+    return 1;
+}
+
+#define DBCB_SO_RESOLVER(name)                                        \
+static __typeof__(name) *dbcB_so_resolve_##name(void)                 \
+{                                                                     \
+    switch(dbcB_so_tier())                                            \
+    {                                                                 \
+        case 4:  return name##_avx2;                                  \
+        case 3:  return name##_sse41;                                 \
+        case 2:  return name##_sse2;                                  \
+        default: return name##_c;                                     \
+    }                                                                 \
+}                                                                     \
+__attribute__((visibility("default"),ifunc("dbcB_so_resolve_" #name))) \
+__typeof__(name) name;
+DBCB_SO_API(DBCB_SO_RESOLVER)
+#undef DBCB_SO_RESOLVER
+
+#endif
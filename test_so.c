@@ -0,0 +1,70 @@
+#include "dbc_blit.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <time.h>
+
+#define LIBRARY_NAME "./libdbc_blit.so"
+
+typedef void (*dbc_blit_fn)(
+    int src_w,int src_h,int src_stride,
+    const unsigned char *src_pixels,
+    int dst_w,int dst_h,int dst_stride,
+    unsigned char *dst_pixels,
+    int x,int y,
+    const float *color,
+    int mode);
+
+int main()
+{
+    void *h;
+    dbc_blit_fn f;
+    static unsigned src[128*128*4];
+    static unsigned dst[128*128*4];
+    int i,N=20000;
+    double t;
+    printf("Testing link-time loading.\n");
+    fflush(stdout);
+    src[0]=0x80AABBCC;
+    dst[0]=0x7F112233;
+    printf("alphablend(%08X->%08X)=",src[0],dst[0]);
+    fflush(stdout);
+    dbc_blit(1,1,4,(unsigned char*)src,1,1,4,(unsigned char*)dst,0,0,0,DBCB_MODE_ALPHA);
+    printf("%08X (%s)\n",dst[0],(dst[0]==0xBF5E6F80?"ok":"FAIL"));
+    printf("Speed: ");
+    fflush(stdout);
+    t=clock();
+    for(i=0;i<N;++i)
+        dbc_blit(128,128,128*4,(unsigned char*)src,128,128,128*4,(unsigned char*)dst,0,0,0,DBCB_MODE_ALPHA);
+    t=clock()-t;
+    printf("%.3f ns/pixel.\n",1.0e+9*t/N/CLOCKS_PER_SEC/(128*128));
+
+    printf("Testing run-time loading.\n");
+    fflush(stdout);
+    if(!(h=dlopen(LIBRARY_NAME,RTLD_NOW)))
+    {
+        printf("Failed loading library: \"%s\".\n",LIBRARY_NAME);
+        return 1;
+    }
+    if(!(*(void**)(&f)=dlsym(h,"dbc_blit")))
+    {
+        printf("Failed locating function: \"dbc_blit\" .\n");
+        return 1;
+    }
+    printf("dbc_blit() loaded.\n");
+    src[0]=0x80AABBCC;
+    dst[0]=0x7F112233;
+    printf("alphablend(%08X->%08X)=",src[0],dst[0]);
+    fflush(stdout);
+    f(1,1,4,(unsigned char*)src,1,1,4,(unsigned char*)dst,0,0,0,DBCB_MODE_ALPHA);
+    printf("%08X (%s)\n",dst[0],(dst[0]==0xBF5E6F80?"ok":"FAIL"));
+    printf("Speed: ");
+    fflush(stdout);
+    t=clock();
+    for(i=0;i<N;++i)
+        f(128,128,128*4,(unsigned char*)src,128,128,128*4,(unsigned char*)dst,0,0,0,DBCB_MODE_ALPHA);
+    t=clock()-t;
+    printf("%.3f ns/pixel.\n",1.0e+9*t/N/CLOCKS_PER_SEC/(128*128));
+    dlclose(h);
+    return 0;
+}